@@ -0,0 +1,300 @@
+/*Tables refined where their interpolation is not accurate and extended on demand
+(see adaptive_table.h)*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "adaptive_table.h"
+
+/****************************************************************************
+How it works:
+  the plane of log10(x), log10(y) is divided in the tiles of a fixed lattice (tile ix,iy
+  covers log10(x) in [ix, ix+1)*ADAPTIVE_TAB_TILE_LX and so for y), and each tile is a
+  quadtree: a node knows ln(f) at its 4 corners and, if it was split, where its 4 children
+  are. A node is split if the bilinear interpolation of ln(f) differs (relative, in f)
+  more than ADAPTIVE_TAB_TOL from f_exact at the middle of its sides and at its center;
+  these 5 values are also the corners of the children, so a split costs 5 evaluations.
+  So the nodes are dense only where f bends (e.g. where the ionization rises), and
+  sparse where it is close to a power law.
+  The tiles are found through a hash table of their lattice position: the ones covering
+  the range given to MakeAdaptiveTable() are made at the start, any other one the first
+  time a point falls in it (AdaptiveTableInterpolate() makes it, evaluating f_exact, and
+  logs it); a tile never changes after it is made. Since the lattice is fixed and a tile
+  depends only on f_exact, all the MPI ranks have the same values wherever they made the
+  tiles (but see [Rob] in Refine()).
+  Memory: at most ADAPTIVE_TAB_MAX_NODES nodes (then leaves are not split anymore, which
+  is logged) and ADAPTIVE_TAB_MAX_TILES tiles (then the points in new tiles are out of
+  the table, as they were for a LogTable).
+  Threads: the lookups only read tiles that are complete (the pointer to a tile is stored
+  in the hash table, with release semantics, after the tile is made), new tiles are made
+  one at a time under a mutex, so lookups can come from OpenMP threads and from the
+  helper thread of ASYNC_OP_REBUILD (adi_async.c).
+*****************************************************************************/
+
+#define N_SLOTS (2*ADAPTIVE_TAB_MAX_TILES)
+
+// Nodes of a tile being made (grows as needed)
+typedef struct TILE_BUILDER {
+  AdaptiveNode *node;
+  int n, size;
+  int depth;       // Max depth reached
+  double err_max;  // Max error of the leaves
+} TileBuilder;
+
+static unsigned int SlotOf(int ix, int iy) {
+  return ((unsigned int)ix*73856093u ^ (unsigned int)iy*19349663u) & (N_SLOTS - 1);
+}
+
+/****************************************************************************
+Finds the tile ix,iy, returns NULL if it was not made
+*****************************************************************************/
+static AdaptiveTile *FindTile(AdaptiveTable *at, int ix, int iy) {
+  unsigned int s = SlotOf(ix, iy);
+  AdaptiveTile *t;
+
+  while ((t = __atomic_load_n(&at->slot[s], __ATOMIC_ACQUIRE)) != NULL) {
+    if (t->ix == ix && t->iy == iy) return t;
+    s = (s + 1) & (N_SLOTS - 1);
+  }
+  return NULL;
+}
+
+static void InsertTile(AdaptiveTable *at, AdaptiveTile *t) {
+  unsigned int s = SlotOf(t->ix, t->iy);
+
+  while (at->slot[s] != NULL) s = (s + 1) & (N_SLOTS - 1);
+  at->n_tiles++;
+  __atomic_store_n(&at->slot[s], t, __ATOMIC_RELEASE);
+}
+
+static int NewNode(TileBuilder *tb) {
+  if (tb->n == tb->size) {
+    tb->size *= 2;
+    tb->node = realloc(tb->node, tb->size*sizeof(AdaptiveNode));
+    if (tb->node == NULL) {
+      print("\n> AdaptiveTable: Error! Not enough memory for a tile");
+      QUIT_PLUTO(1);
+    }
+  }
+  tb->node[tb->n].child = -1;
+  return tb->n++;
+}
+
+/****************************************************************************
+Splits node n (lower corner lx, ly in log10, sizes wx, wy) while the interpolation
+is not within ADAPTIVE_TAB_TOL
+*****************************************************************************/
+static void Refine(AdaptiveTable *at, TileBuilder *tb, int n, double lx, double ly,
+                   double wx, double wy, int depth) {
+  int c, q, i, j, first;
+  double g[3][3];  // ln(f) on the 3x3 points of the node, g[j][i] (i along x)
+  double err, e;
+
+  for (q = 0; q < 4; q++) g[2*(q/2)][2*(q%2)] = tb->node[n].lnf[q];
+  g[0][1] = log(at->f_exact(pow(10.0, lx + 0.5*wx), pow(10.0, ly)));
+  g[2][1] = log(at->f_exact(pow(10.0, lx + 0.5*wx), pow(10.0, ly + wy)));
+  g[1][0] = log(at->f_exact(pow(10.0, lx), pow(10.0, ly + 0.5*wy)));
+  g[1][2] = log(at->f_exact(pow(10.0, lx + wx), pow(10.0, ly + 0.5*wy)));
+  g[1][1] = log(at->f_exact(pow(10.0, lx + 0.5*wx), pow(10.0, ly + 0.5*wy)));
+
+  // The bilinear interpolation is the mean of 2 corners in the middle of a side, of 4 at the center
+  err = fabs(expm1(0.5*(g[0][0] + g[0][2]) - g[0][1]));
+  e = fabs(expm1(0.5*(g[2][0] + g[2][2]) - g[2][1]));   err = MAX(err, e);
+  e = fabs(expm1(0.5*(g[0][0] + g[2][0]) - g[1][0]));   err = MAX(err, e);
+  e = fabs(expm1(0.5*(g[0][2] + g[2][2]) - g[1][2]));   err = MAX(err, e);
+  e = fabs(expm1(0.25*(g[0][0] + g[0][2] + g[2][0] + g[2][2]) - g[1][1]));   err = MAX(err, e);
+
+  if (err <= ADAPTIVE_TAB_TOL || depth == ADAPTIVE_TAB_MAX_DEPTH) {
+    tb->err_max = MAX(tb->err_max, err);
+    return;
+  }
+  /* [Rob] The budget of nodes is shared by the tiles made in parallel at the start, so once it
+     is reached which leaves stay coarse can depend on the threads (and differ between ranks) */
+  if (__atomic_add_fetch(&at->n_nodes, 4, __ATOMIC_RELAXED) > ADAPTIVE_TAB_MAX_NODES) {
+    __atomic_sub_fetch(&at->n_nodes, 4, __ATOMIC_RELAXED);
+    if (!__atomic_exchange_n(&at->capped, 1, __ATOMIC_RELAXED))
+      print("\n> AdaptiveTable(%s): ADAPTIVE_TAB_MAX_NODES (%ld) reached, leaves are not split anymore",
+            at->name, (long)ADAPTIVE_TAB_MAX_NODES);
+    tb->err_max = MAX(tb->err_max, err);
+    return;
+  }
+
+  first = NewNode(tb);  // (NewNode() can move tb->node)
+  for (c = 1; c < 4; c++) NewNode(tb);
+  tb->node[n].child = first;
+  tb->depth = MAX(tb->depth, depth + 1);
+  for (c = 0; c < 4; c++) {
+    i = c%2;
+    j = c/2;
+    for (q = 0; q < 4; q++) tb->node[tb->node[n].child + c].lnf[q] = g[j + q/2][i + q%2];
+  }
+  for (c = 0; c < 4; c++)
+    Refine(at, tb, tb->node[n].child + c, lx + 0.5*wx*(c%2), ly + 0.5*wy*(c/2),
+           0.5*wx, 0.5*wy, depth + 1);
+}
+
+/****************************************************************************
+Makes the tile ix,iy (it does not insert it in the hash table)
+*****************************************************************************/
+static AdaptiveTile *MakeTile(AdaptiveTable *at, int ix, int iy, int *depth, double *err_max) {
+  int q;
+  double lx = ix*ADAPTIVE_TAB_TILE_LX, ly = iy*ADAPTIVE_TAB_TILE_LY;
+  TileBuilder tb;
+  AdaptiveTile *t;
+
+  tb.size = 64;
+  tb.n = 0;
+  tb.depth = 0;
+  tb.err_max = 0.0;
+  tb.node = malloc(tb.size*sizeof(AdaptiveNode));
+  NewNode(&tb);
+  for (q = 0; q < 4; q++)
+    tb.node[0].lnf[q] = log(at->f_exact(pow(10.0, lx + ADAPTIVE_TAB_TILE_LX*(q%2)),
+                                        pow(10.0, ly + ADAPTIVE_TAB_TILE_LY*(q/2))));
+  __atomic_add_fetch(&at->n_nodes, 1, __ATOMIC_RELAXED);
+  Refine(at, &tb, 0, lx, ly, ADAPTIVE_TAB_TILE_LX, ADAPTIVE_TAB_TILE_LY, 0);
+
+  t = malloc(sizeof(AdaptiveTile));
+  t->ix = ix;
+  t->iy = iy;
+  t->n_nodes = tb.n;
+  t->node = realloc(tb.node, tb.n*sizeof(AdaptiveNode));
+  *depth = tb.depth;
+  *err_max = tb.err_max;
+  return t;
+}
+
+/****************************************************************************
+Makes the tiles covering x_min..x_max, y_min..y_max (in parallel with OpenMP, if
+enabled, as MakeDevotoTable()). f_exact(x, y) must be positive and reentrant
+*****************************************************************************/
+void MakeAdaptiveTable(AdaptiveTable *at, double (*f_exact)(double, double), const char *name,
+                       double x_min, double x_max, double y_min, double y_max) {
+  int m, ix0, ix1, iy0, iy1, nx, ny, depth_max = 0;
+  double err_max = 0.0;
+  AdaptiveTile **made;
+
+  strncpy(at->name, name, sizeof(at->name) - 1);
+  at->name[sizeof(at->name) - 1] = '\0';
+  at->f_exact = f_exact;
+  at->slot = calloc(N_SLOTS, sizeof(AdaptiveTile *));
+  at->n_tiles = 0;
+  at->n_nodes = 0;
+  at->capped = 0;
+  pthread_mutex_init(&at->lock, NULL);
+
+  ix0 = (int)floor(log10(x_min)/ADAPTIVE_TAB_TILE_LX);
+  ix1 = (int)floor(log10(x_max)/ADAPTIVE_TAB_TILE_LX);
+  iy0 = (int)floor(log10(y_min)/ADAPTIVE_TAB_TILE_LY);
+  iy1 = (int)floor(log10(y_max)/ADAPTIVE_TAB_TILE_LY);
+  nx = ix1 - ix0 + 1;
+  ny = iy1 - iy0 + 1;
+  if (nx*ny > ADAPTIVE_TAB_MAX_TILES) {
+    print1("\n> MakeAdaptiveTable(): Error! %s needs %d tiles, more than ADAPTIVE_TAB_MAX_TILES",
+           name, nx*ny);
+    QUIT_PLUTO(1);
+  }
+
+  made = malloc(nx*ny*sizeof(AdaptiveTile *));
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) reduction(max:depth_max, err_max)
+  #endif
+  for (m = 0; m < nx*ny; m++) {
+    int depth;
+    double err;
+    made[m] = MakeTile(at, ix0 + m%nx, iy0 + m/nx, &depth, &err);
+    depth_max = MAX(depth_max, depth);
+    err_max = MAX(err_max, err);
+  }
+  for (m = 0; m < nx*ny; m++) InsertTile(at, made[m]);
+  free(made);
+
+  print1("\n> MakeAdaptiveTable(): %s, %d tiles (%g x %g decades), %ld nodes, depth up to %d,"
+         " rel. error max %.1e", name, at->n_tiles, ADAPTIVE_TAB_TILE_LX, ADAPTIVE_TAB_TILE_LY,
+         at->n_nodes, depth_max, err_max);
+}
+
+void FreeAdaptiveTable(AdaptiveTable *at) {
+  int s;
+
+  for (s = 0; s < N_SLOTS; s++) {
+    if (at->slot[s] == NULL) continue;
+    free(at->slot[s]->node);
+    free(at->slot[s]);
+  }
+  free(at->slot);
+  pthread_mutex_destroy(&at->lock);
+}
+
+/****************************************************************************
+Makes the tile ix,iy (unless another thread made it meanwhile) and logs it;
+returns NULL if there is no room for it (ADAPTIVE_TAB_MAX_TILES)
+*****************************************************************************/
+static AdaptiveTile *ExtendAdaptiveTable(AdaptiveTable *at, int ix, int iy) {
+  int depth;
+  double err;
+  AdaptiveTile *t;
+
+  pthread_mutex_lock(&at->lock);
+  t = FindTile(at, ix, iy);
+  if (t == NULL && at->n_tiles < ADAPTIVE_TAB_MAX_TILES) {
+    t = MakeTile(at, ix, iy, &depth, &err);
+    InsertTile(at, t);
+    // print, not print1: the rank meeting the point is not necessarily the first one
+    print("\n> AdaptiveTable(%s), rank %d: new tile T %.3e..%.3e, rho %.3e..%.3e,"
+          " %d nodes, depth %d, rel. error max %.1e (%d tiles, %ld nodes)", at->name, prank,
+          pow(10.0, ix*ADAPTIVE_TAB_TILE_LX), pow(10.0, (ix + 1)*ADAPTIVE_TAB_TILE_LX),
+          pow(10.0, iy*ADAPTIVE_TAB_TILE_LY), pow(10.0, (iy + 1)*ADAPTIVE_TAB_TILE_LY),
+          t->n_nodes, depth, err, at->n_tiles, at->n_nodes);
+  }
+  pthread_mutex_unlock(&at->lock);
+  return t;
+}
+
+/****************************************************************************
+Interpolates the table at x, y: returns 0, or 1 if the point is not valid
+(x, y <= 0, NaN) or there is no room for its tile (*f is not set)
+*****************************************************************************/
+int AdaptiveTableInterpolate(AdaptiveTable *at, double x, double y, double *f) {
+  int ix, iy, s;
+  double u, v;
+  AdaptiveTile *t;
+  const AdaptiveNode *nd;
+
+  if (!(x > 0.0 && y > 0.0 && x < 1.e300 && y < 1.e300)) return 1;
+  u = log10(x)*(1.0/ADAPTIVE_TAB_TILE_LX);
+  v = log10(y)*(1.0/ADAPTIVE_TAB_TILE_LY);
+  ix = (int)floor(u);
+  iy = (int)floor(v);
+  u -= ix;
+  v -= iy;
+
+  t = FindTile(at, ix, iy);
+  if (t == NULL && (t = ExtendAdaptiveTable(at, ix, iy)) == NULL) return 1;
+
+  // [Opt] At most ADAPTIVE_TAB_MAX_DEPTH steps down, each one halving u and v
+  nd = t->node;
+  while (nd->child >= 0) {
+    s = (u >= 0.5) + 2*(v >= 0.5);
+    u = 2.0*u - (s & 1);
+    v = 2.0*v - (s >> 1);
+    nd = t->node + nd->child + s;
+  }
+  *f = exp((1.0 - v)*((1.0 - u)*nd->lnf[0] + u*nd->lnf[1]) +
+                  v *((1.0 - u)*nd->lnf[2] + u*nd->lnf[3]));
+  return 0;
+}
+
+/****************************************************************************
+The same for n points, returns the number of points out of the table
+*****************************************************************************/
+int AdaptiveTableInterpolateBatch(AdaptiveTable *at, const double *x, const double *y,
+                                  double *f, int n) {
+  int m, n_out = 0;
+
+  for (m = 0; m < n; m++) n_out += AdaptiveTableInterpolate(at, x[m], y[m], f + m);
+  return n_out;
+}
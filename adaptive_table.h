@@ -0,0 +1,65 @@
+#ifndef ADAPTIVE_TABLE_H
+#define ADAPTIVE_TABLE_H
+#include <pthread.h>
+/* 2D tables of a positive function f(x, y) (x = T, y = rho, as the transport tables) which are
+   refined where the interpolation is not accurate and extended when a point falls outside
+   them, evaluating the exact function: the plane of log10(x), log10(y) is divided in tiles
+   of a fixed lattice, made the first time a point falls in them, and each tile is a quadtree
+   whose leaves are interpolated bilinearly in ln(f), log10(x), log10(y) (see adaptive_table.c) */
+
+// Sizes of the tiles, in log10(x) and log10(y)
+#ifndef ADAPTIVE_TAB_TILE_LX
+  #define ADAPTIVE_TAB_TILE_LX 0.1
+#endif
+#ifndef ADAPTIVE_TAB_TILE_LY
+  #define ADAPTIVE_TAB_TILE_LY 0.5
+#endif
+// A leaf is split in 4 if the interpolation differs from f more than this (relative)
+#ifndef ADAPTIVE_TAB_TOL
+  #define ADAPTIVE_TAB_TOL 1.e-3
+#endif
+// Max number of splits from a tile to its smallest leaves
+#ifndef ADAPTIVE_TAB_MAX_DEPTH
+  #define ADAPTIVE_TAB_MAX_DEPTH 6
+#endif
+/* Bounds of the memory of a table: when there are ADAPTIVE_TAB_MAX_NODES nodes (40 bytes
+   each) the leaves are not split anymore, when there are ADAPTIVE_TAB_MAX_TILES tiles the
+   points outside them are out of the table (as for a LogTable) */
+#ifndef ADAPTIVE_TAB_MAX_NODES
+  #define ADAPTIVE_TAB_MAX_NODES (1L << 20)
+#endif
+#ifndef ADAPTIVE_TAB_MAX_TILES
+  #define ADAPTIVE_TAB_MAX_TILES 4096
+#endif
+
+/* A node of a quadtree: the values at its corners and its children (if it was split),
+   in the order (x low, y low), (x high, y low), (x low, y high), (x high, y high) */
+typedef struct ADAPTIVE_NODE {
+  double lnf[4];  /**< ln(f) at the corners */
+  int child;      /**< Index (in the tile) of the first of the 4 children, -1 for a leaf */
+} AdaptiveNode;
+
+typedef struct ADAPTIVE_TILE {
+  int ix, iy;          /**< Position in the lattice: log10(x) from ix*ADAPTIVE_TAB_TILE_LX, ... */
+  int n_nodes;
+  AdaptiveNode *node;  /**< node[0] is the whole tile */
+} AdaptiveTile;
+
+typedef struct ADAPTIVE_TABLE {
+  char name[32];
+  double (*f_exact)(double x, double y);  /**< Function tabulated (reentrant) */
+  AdaptiveTile **slot;  /**< Hash table of the tiles (open addressing, 2*ADAPTIVE_TAB_MAX_TILES slots) */
+  int n_tiles;
+  long n_nodes;         /**< Nodes of all the tiles */
+  int capped;           /**< Tells whether ADAPTIVE_TAB_MAX_NODES was reached (it is logged once) */
+  pthread_mutex_t lock; /**< Serializes the making of new tiles */
+} AdaptiveTable;
+
+void MakeAdaptiveTable(AdaptiveTable *at, double (*f_exact)(double, double), const char *name,
+                       double x_min, double x_max, double y_min, double y_max);
+void FreeAdaptiveTable(AdaptiveTable *at);
+int AdaptiveTableInterpolate(AdaptiveTable *at, double x, double y, double *f);
+int AdaptiveTableInterpolateBatch(AdaptiveTable *at, const double *x, const double *y,
+                                  double *f, int n);
+
+#endif
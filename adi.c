@@ -10,21 +10,35 @@ and thermal conduction) terms with the Alternating Direction Implicit algorithm*
 #include "adi.h"
 #include "capillary_wall.h"
 #include "debug_utilities.h"
+#include "pvte_law_heat_capacity.h"
+#include "cell_state.h"
+#include "inv_eos_table.h"
 #include <time.h>
 #include <stdlib.h>
 
 // I initialize the diffusion time, since it is nedded before the diffusion starts;
 double t_diff = 0;
 
+/* Max relative change of T allowed to the Newton step which corrects the carried
+   temperature, above it I go back to the full EOS inversion (GetPV_Temperature) */
+#define T_CARRY_MAX_REL_STEP 0.2
+
 #if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT
   // Temperature, to make it available outside (by means of a function)
   static double **T_old;
+  #if CARRY_T_ADI
+    // Tells whether T_old holds the temperature carried from the previous ADI call
+    static int T_old_carried = 0;
+  #endif
 #endif
 
 void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
   static int first_call=1;
   int i,j,k, l;
   int recompute_operators=1; /*Tells whether the discrete diffusion operators have to be recomputed*/
+  #if ASYNC_OP_REBUILD
+    static long sub_tag = 0; // Counts the sub-iterations (of all the steps), to tag the rebuilt operators
+  #endif
   
   static Lines lines[2]; /*I define two of them as they are 1 per direction (r and z)*/
   #if RESISTIVITY == ALTERNATING_DIRECTION_IMPLICIT
@@ -36,10 +50,19 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
   #if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT
     static double **T_new;
     static double **dEdT;
+    #if COUPLED_TC_RES
+      // Joule heating already given to T by the coupled scheme
+      static double **dUjoule;
+    #endif
     double v[NVAR]; /*[Ema] I hope that NVAR as dimension is fine!*/
     // double rhoe_old, rhoe_new;
     int nv;
   #endif
+  #if VISCOSITY_ADI
+    // r*vr and vz (the quantities diffused by the viscosity schemes)
+    static double **Vr_new, **Vr_old, **Vz_new, **Vz_old;
+    double ekin_old;
+  #endif
 
   int s;
   double t_start_sub;
@@ -48,6 +71,9 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
   const double dt = g_dt;
   double ****Uc, ****Vc;
   double *r, *r_1;
+  /* Lines of the point-wise work: in parallel they are the local ones (the pieces of
+     the lines inside the block of this process, see adi_mpi.c) */
+  Lines *lines_pw = lines;
 
   #if FIRST_JDIR_THEN_IDIR == RANDOM
     if (first_call)
@@ -70,14 +96,22 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
   /* Some shortcuts */
   Vc = d->Vc;
   Uc = d->Uc;
-  r = grid[IDIR].x_glob;
+  r = grid[IDIR].x;
   r_1 = grid[IDIR].r_1;
 
   /* -------------------------------------------------------------------
   Build geometry and allocate some stuff
   ----------------------------------------------------------------------*/
   if (first_call) {
-    GeometryADI(lines, grid);
+    #ifdef PARALLEL
+      // The lines are the global ones, only the sweeps use them (see adi_mpi.c)
+      SetGlobalIndexesADI(grid);
+      GeometryADI(lines, GlobalGridADI(grid));
+      SetLocalIndexesADI();
+      PartitionLinesADI(lines, grid);
+    #else
+      GeometryADI(lines, grid);
+    #endif
 
     #if RESISTIVITY == ALTERNATING_DIRECTION_IMPLICIT
       Br_new = ARRAY_2D(NX2_TOT, NX1_TOT, double);
@@ -100,13 +134,26 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
       T_new = ARRAY_2D(NX2_TOT, NX1_TOT, double);
       T_old = ARRAY_2D(NX2_TOT, NX1_TOT, double);
       dEdT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      #if COUPLED_TC_RES
+        dUjoule = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      #endif
       TOT_LOOP (k,j,i) {
         T_new[j][i] = 0.0;
       }
     #endif
 
+    #if VISCOSITY_ADI
+      Vr_new = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      Vr_old = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      Vz_new = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      Vz_old = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    #endif
+
     first_call=0;
   }
+  #ifdef PARALLEL
+    lines_pw = LocalLinesADI();
+  #endif
 
   /* -------------------------------------------------------------------------
       Compute the conservative vector in order to start the cycle.
@@ -114,7 +161,7 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
       contains Vc as well as Uc (for future improvements).
       [Ema] (Comment copied from sts.c)
     --------------------------------------------------------------------------- */
-  PrimToConsLines (Vc, Uc, lines);
+  PrimToConsLines (Vc, Uc, lines_pw);
 
   #if RESISTIVITY == ALTERNATING_DIRECTION_IMPLICIT
     DOM_LOOP(k,j,i) {
@@ -136,26 +183,43 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
       printf("\ns:%d\n", s);
     #endif
     Boundary(d, ALL_DIR, grid);
+    // Vc has changed (ghosts, and the hydro step or the previous sub-iteration)
+    InvalidateCellState(d);
+    #if ASYNC_OP_REBUILD
+      /* If the next sub-iteration has to recompute the operators, they are built by a
+         helper thread (from the current state) while this sub-iteration runs */
+      sub_tag++;
+      SetSubIterationADI(sub_tag);
+      if (s+1 < adi_steps && ((s+1)%DIFF_OP_RECOMPUTE_PERIOD) == 0)
+        LaunchOperatorRebuildADI(d, grid, lines_pw, sub_tag+1);
+    #endif
 
     /* ---- Build temperature vector ---- */
-    // I must re-buil the temperature at every step as it depends on U[][][][ENG]
     #if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT
-      #if EOS==PVTE_LAW
-        DOM_LOOP(k,j,i) {
-          for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
-          if (GetPV_Temperature(v, &(T_old[j][i]) )!=0) {
-            #if WARN_ERR_COMP_TEMP
-              print1("ADI:[Ema]Err.comp.temp\n");
-            #endif
-          }
-          T_old[j][i] = T_old[j][i] / KELVIN;
+      #if EOS==PVTE_LAW && CARRY_T_ADI
+        /* The temperature left by the previous sub-iteration is kept, I only have
+           to correct it (at the first sub-iteration) for the energy change due to
+           the hydro step, or build it from scratch if I have no previous T */
+        if (s == 0) {
+          if (T_old_carried)
+            CorrectCarriedTemperature(d, T_old, lines_pw);
+          else
+            BuildTemperature(d, T_old);
+          T_old_carried = 1;
         }
+      #elif EOS==PVTE_LAW
+        // I must re-buil the temperature at every step as it depends on U[][][][ENG]
+        BuildTemperature(d, T_old);
       #else
         print1("ADI:[Ema]Err.comp.temp, this EOS not implemented!")
       #endif
 
       /* ---- Avdance T with ADI ---- */
-      #if METHOD_TC==SPLIT_IMPLICIT
+      #if COUPLED_TC_RES
+        // B*r is advanced here too (together with T)
+        DouglasRachfordCoupled(T_new, T_old, Br_new, Br_old, dUres, dUjoule, dEdT, d, grid, lines,
+                               ORDER, dt_reduced, t_start_sub, NSUBS_COUPLED, recompute_operators);
+      #elif METHOD_TC==SPLIT_IMPLICIT
         // [Err] Decomment next, unless you tested SPLIT_IMPLICIT for TC 
         // #error SPLIT_IMPLICIT has not yet been tested with thermal conduction
         // if (NSUBS_TC!=1) {
@@ -172,6 +236,9 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
         FractionalTheta(T_new, T_old, NULL, dEdT, d, grid, lines, TDIFF, ORDER, dt_reduced, t_start_sub, FRACTIONAL_THETA_THETA_TC);
       #elif METHOD_TC==DOUGLAS_RACHFORD
         DouglasRachford(T_new, T_old, NULL, dEdT, d, grid, lines, TDIFF, ORDER, dt_reduced, t_start_sub, NSUBS_TC, recompute_operators);
+      #elif METHOD_TC==JFNK
+        // One nonlinear backward Euler step (NSUBS_TC is not used)
+        JFNK_TC(T_new, T_old, dEdT, d, grid, lines, ORDER, dt_reduced, t_start_sub);
       #elif METHOD_TC==PEACEMAN_RACHFORD_MOD
         PeacemanRachfordMod(T_new, T_old, NULL, dEdT, d, grid, lines, TDIFF, ORDER, dt_reduced, t_start_sub, FRACT_TC, NSUBS_TC);
       #elif METHOD_TC==STRANG_LIE
@@ -185,7 +252,7 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
 
       /* ---- Update cons variables ---- */
       KDOM_LOOP(k)
-        LINES_LOOP(lines[IDIR], l, j, i) {
+        LINES_LOOP(lines_pw[IDIR], l, j, i) {
           // I get the int. energy from the temperature
           #if EOS==IDEAL
             #error Not implemented for ideal eos (but it is easy to add it!)
@@ -210,6 +277,10 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
                 #endif
                 /*I think in this way the update should conserve the energy*/
                 Uc[k][j][i][ENG] += dEdT[j][i]*(T_new[j][i]-T_old[j][i]);
+                #if COUPLED_TC_RES
+                  // The Joule heating is given to the energy by dUres
+                  Uc[k][j][i][ENG] -= dUjoule[j][i];
+                #endif
               #endif
           #else
             print1("ADI:[Ema] Error computing internal energy, this EOS not implemented!");
@@ -225,7 +296,9 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
       // No need to re-build the magnetic field, as it does not depend on U[][][][whatever]
 
       /* ---- Avdance B*r with ADI ---- */
-      #if METHOD_RES==SPLIT_IMPLICIT
+      #if COUPLED_TC_RES
+        // B*r (and dUres) have already been advanced together with T
+      #elif METHOD_RES==SPLIT_IMPLICIT
         SplitImplicit(Br_new, Br_old, dUres, NULL, d, grid, lines, BDIFF, ORDER, dt_reduced, t_start_sub, NSUBS_RES);
       #elif METHOD_RES==FRACTIONAL_THETA
         if (NSUBS_RES!=1) {
@@ -249,11 +322,15 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
 
       /* ---- Update cons variables ---- */
       KDOM_LOOP(k)
-        LINES_LOOP(lines[IDIR], l, j, i) {
+        LINES_LOOP(lines_pw[IDIR], l, j, i) {
           Uc[k][j][i][BX3] = Br_new[j][i]*r_1[i];
 
           #if (JOULE_EFFECT_AND_MAG_ENG && (!MAG_PS_OUTSIDE_SSTEP))
             Uc[k][j][i][ENG] += dUres[j][i];
+            #if (THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && CARRY_T_ADI && !COUPLED_TC_RES)
+              // The carried T must follow the energy given by Joule effect
+              T_old[j][i] += dUres[j][i]/dEdT[j][i];
+            #endif
           #endif
         }
 
@@ -261,14 +338,54 @@ void ADI(const Data *d, Time_Step *Dts, Grid *grid) {
       SwapDoublePointers (&Br_new, &Br_old);
     #endif
 
+    #if VISCOSITY_ADI
+      /* Vc velocities are still consistent with Uc here (TC and RES do not change them) */
+      KDOM_LOOP(k)
+        LINES_LOOP(lines_pw[IDIR], l, j, i) {
+          Vr_old[j][i] = r[i]*Vc[VX1][k][j][i];
+          Vz_old[j][i] = Vc[VX2][k][j][i];
+        }
+      DouglasRachford(Vr_new, Vr_old, NULL, NULL, d, grid, lines, VRDIFF, ORDER, dt_reduced, t_start_sub, NSUBS_VISC, recompute_operators);
+      DouglasRachford(Vz_new, Vz_old, NULL, NULL, d, grid, lines, VZDIFF, ORDER, dt_reduced, t_start_sub, NSUBS_VISC, recompute_operators);
+
+      /* ---- Update cons variables ---- */
+      // ENG is left as it is: the kinetic energy lost goes into internal energy (viscous heating)
+      KDOM_LOOP(k)
+        LINES_LOOP(lines_pw[IDIR], l, j, i) {
+          ekin_old = 0.5*(Uc[k][j][i][MX1]*Uc[k][j][i][MX1] + Uc[k][j][i][MX2]*Uc[k][j][i][MX2])/Uc[k][j][i][RHO];
+          Uc[k][j][i][MX1] = Uc[k][j][i][RHO]*Vr_new[j][i]*r_1[i];
+          Uc[k][j][i][MX2] = Uc[k][j][i][RHO]*Vz_new[j][i];
+          #if (THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && CARRY_T_ADI)
+            // The carried T must follow the viscous heating
+            T_old[j][i] += (ekin_old - 0.5*(Uc[k][j][i][MX1]*Uc[k][j][i][MX1]
+                            + Uc[k][j][i][MX2]*Uc[k][j][i][MX2])/Uc[k][j][i][RHO])/dEdT[j][i];
+          #endif
+        }
+    #endif
+
     /* -------------------------------------------------------------------------
         Compute back the primitive vector from the updated conservative vector.
         ------------------------------------------------------------------------- */
-    ConsToPrimLines (Uc, Vc, d->flag, lines);
+    ConsToPrimLines (Uc, Vc, d->flag, lines_pw);
 
     t_start_sub += dt_reduced;
   }
 
+  #if ASYNC_OP_REBUILD
+    if (g_stepNumber%ASYNC_OP_REPORT_PERIOD == 0)
+      ReportOperatorRebuildADI();
+  #endif
+  #if CELL_STATE_REPORT
+    if (g_stepNumber%WARM_T_REPORT_PERIOD == 0)
+      ReportCellState();
+  #endif
+  #if SAHA_EXP_COUNT
+    if (g_stepNumber%SAHA_EXP_REPORT_PERIOD == 0)
+      ReportSahaExpCount(SAHA_EXP_REPORT_PERIOD);
+  #endif
+
+  InvalidateCellState(d);
+
   // Update the time where the diffusion process has arrived
   t_diff = t_start_sub;
 }
@@ -284,6 +401,8 @@ void InitializeLines(Lines *lines, int N){
   lines->lidx = ARRAY_1D(N, int);
   lines->ridx = ARRAY_1D(N, int);
   lines->N = N;
+  lines->lbeg = 0; // In parallel they are set by PartitionLinesADI()
+  lines->lend = N;
   for (i=0; i<NADI; i++) {
     lines->lbound[i] = ARRAY_1D(N, Bcs);
     lines->rbound[i] = ARRAY_1D(N, Bcs);
@@ -334,6 +453,138 @@ void GeometryADI(Lines *lines, Grid *grid){
   }
 }
 
+/****************************************************************************
+Gives the geometric factors of the TC and RES operators (see OperatorGeometry in adi.h),
+made at the first call from grid (the one passed to the BuildIJ functions) and then
+shared by BuildIJ_TC(), BuildIJ_Res() and the helper thread of ASYNC_OP_REBUILD (which
+calls them after the first, synchronous, build).
+In parallel grid is the local one and the vectors are indexed with the local indexes,
+as the operators are built on the local block (DouglasRachford() passes grid and the
+local lines, see LocalLinesADI()): passing GlobalGridADI(grid) here (or to the
+BuildIJ functions) would mix global factors with local cells.
+Instead of 2D arrays (NX2_TOT x NX1_TOT) of each factor, 1D vectors along i or j.
+*****************************************************************************/
+const OperatorGeometry *GetOperatorGeometry(Grid *grid) {
+  static int first_call = 1;
+  static OperatorGeometry g;
+  int i, j;
+  double *r, *rL, *rR, *r_1, *ArR, *ArL, *dVr, *dVz;
+  double *inv_dri, *inv_dzi, *inv_dr, *inv_dz;
+
+  if (!first_call) return &g;
+
+  // Name shorthands (see set_geometry.c)
+  r = grid[IDIR].x;
+  rL = grid[IDIR].xl;
+  rR = grid[IDIR].xr;
+  r_1 = grid[IDIR].r_1;
+  ArR = grid[IDIR].A;
+  ArL = grid[IDIR].A - 1;
+  dVr = grid[IDIR].dV;
+  dVz = grid[JDIR].dV;
+  inv_dri = grid[IDIR].inv_dxi; // reciprocal of cell spacing between centers
+  inv_dzi = grid[JDIR].inv_dxi;
+  inv_dr = grid[IDIR].inv_dx;   // reciprocal of cell spacing between interfaces
+  inv_dz = grid[JDIR].inv_dx;
+
+  g.tc_Ip = ARRAY_1D(NX1_TOT, double);
+  g.tc_Im = ARRAY_1D(NX1_TOT, double);
+  g.tc_CI = ARRAY_1D(NX1_TOT, double);
+  g.res_Ip = ARRAY_1D(NX1_TOT, double);
+  g.res_Im = ARRAY_1D(NX1_TOT, double);
+  g.res_CI = ARRAY_1D(NX1_TOT, double);
+  g.tc_Jp = ARRAY_1D(NX2_TOT, double);
+  g.tc_Jm = ARRAY_1D(NX2_TOT, double);
+  g.tc_CJ = ARRAY_1D(NX2_TOT, double);
+  g.res_Jp = ARRAY_1D(NX2_TOT, double);
+  g.res_Jm = ARRAY_1D(NX2_TOT, double);
+
+  // The left interface of the first ghost has no left neighbour (it is never used)
+  for (i = 0; i < NX1_TOT; i++) {
+    g.tc_Ip[i] = ArR[i]*inv_dri[i];
+    g.tc_Im[i] = i > 0 ? ArL[i]*inv_dri[i-1] : 0.0;
+    g.tc_CI[i] = 1.0/dVr[i];
+    g.res_Ip[i] = inv_dr[i]*inv_dri[i]/rR[i];
+    if (i == 0)
+      g.res_Im[i] = 0.0;
+    else if (rL[i] != 0.0)
+      g.res_Im[i] = inv_dr[i]*inv_dri[i-1]/rL[i];
+    else
+      g.res_Im[i] = 1/(r[i]*r[i])/rR[i];
+    g.res_CI[i] = 1.0/r_1[i];
+  }
+  for (j = 0; j < NX2_TOT; j++) {
+    g.tc_Jp[j] = inv_dzi[j];
+    g.tc_Jm[j] = j > 0 ? inv_dzi[j-1] : 0.0;
+    g.tc_CJ[j] = 1.0/dVz[j];
+    g.res_Jp[j] = inv_dz[j]*inv_dzi[j];
+    g.res_Jm[j] = j > 0 ? inv_dz[j]*inv_dzi[j-1] : 0.0;
+  }
+  first_call = 0;
+  return &g;
+}
+
+#if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && EOS==PVTE_LAW
+/* ***********************************************************
+ * Computes the temperature (code units) on the whole domain
+ * by inverting the EOS (through the cell state cache, so that
+ * the transport coefficients and dEdT can reuse it)
+ * ***********************************************************/
+void BuildTemperature(const Data *d, double **T) {
+  int i,j,k;
+
+  DOM_LOOP(k,j,i) {
+    T[j][i] = CellTemperature(d, k, j, i) / KELVIN;
+  }
+}
+
+/* ***********************************************************
+ * Corrects the temperature carried from the previous ADI call
+ * for the change of internal energy (and density) due to the
+ * hydro step, with one Newton step on rhoe(T) = rhoe,
+ * starting from the carried temperature.
+ * rhoe is taken from Uc, so Uc must be up to date.
+ * If the Newton step is too large I invert the EOS from scratch
+ * (from the table T(rho, rhoe), if INV_EOS_TABLE).
+ * ***********************************************************/
+void CorrectCarriedTemperature(const Data *d, double **T, Lines *lines) {
+  int i,j,k,l,nv;
+  double v[NVAR];
+  double *u;
+  double rhoe, rhoe_T, drhoe_dT;
+  double T_K, dT_K;
+  double ****Vc = d->Vc;
+  double ****Uc = d->Uc;
+
+  KDOM_LOOP(k)
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      u = Uc[k][j][i];
+      for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+      rhoe = u[ENG] - 0.5*(u[MX1]*u[MX1] + u[MX2]*u[MX2] + u[MX3]*u[MX3])/u[RHO]
+                    - 0.5*(u[BX1]*u[BX1] + u[BX2]*u[BX2] + u[BX3]*u[BX3]);
+
+      T_K = T[j][i]*KELVIN;
+      rhoe_T = InternalEnergyAndDerivative(v, T_K, &drhoe_dT);
+      dT_K = (rhoe - rhoe_T)/drhoe_dT;
+
+      if (T_K > 0.0 && fabs(dT_K) <= T_CARRY_MAX_REL_STEP*T_K) {
+        T[j][i] = (T_K + dT_K)/KELVIN;
+      #if INV_EOS_TABLE
+      } else if (GetTemperatureFromEnergyTable(v[RHO], rhoe, &T_K) == 0) {
+        T[j][i] = T_K/KELVIN;
+      #endif
+      } else {
+        if (GetPV_Temperature(v, &(T[j][i]) )!=0) {
+          #if WARN_ERR_COMP_TEMP
+            print1("ADI:[Ema]Err.comp.temp\n");
+          #endif
+        }
+        T[j][i] = T[j][i] / KELVIN;
+      }
+    }
+}
+#endif
+
 /* ***********************************************************
  * Function to swap double pointers to double
  * ***********************************************************/
@@ -36,6 +36,16 @@
 #define DIRICHLET    1
 #define NEUMANN_HOM  2
 
+// By default the temperature is rebuilt from the EOS at every ADI sub-iteration
+#ifndef CARRY_T_ADI
+  #define CARRY_T_ADI NO
+#endif
+
+// By default thermal conduction and resistivity are advanced separately
+#ifndef COUPLED_TC_RES
+  #define COUPLED_TC_RES NO
+#endif
+
 // macro for calling RuntimeSet()
 #define AFTER_SETOUTPUT 1
 
@@ -47,6 +57,11 @@
   for ((line_idx)=lines.dom_line_idx[(l)=0]; (l)<lines.N; (line_idx)=lines.dom_line_idx[++(l)]) \
   for ((line_sweeper)=lines.lidx[(l)]; (line_sweeper)<=lines.ridx[(l)]; (line_sweeper)++)
 
+// As LINES_LOOP, but only on the lines solved by this process (see adi_mpi.c)
+#define OWN_LINES_LOOP(lines, l, line_idx , line_sweeper) \
+  for ((l)=lines.lbeg; (l)<lines.lend; (l)++) \
+  for ((line_idx)=lines.dom_line_idx[(l)], (line_sweeper)=lines.lidx[(l)]; (line_sweeper)<=lines.ridx[(l)]; (line_sweeper)++)
+
 // Macros which are valid choices for setting FIRST_JDIR_THEN_IDIR (in addition, YES and NO are valid too)
 #define RANDOM 2
 #define AVERAGE 3
@@ -112,6 +127,74 @@
   #define TDIFF 300
 #endif
 
+// Distributed ADI: only Douglas-Rachford schemes (adi_solvers.c) exchange the lines between the sweeps
+#ifdef PARALLEL
+  #if (THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && METHOD_TC != DOUGLAS_RACHFORD) || \
+      (RESISTIVITY == ALTERNATING_DIRECTION_IMPLICIT && METHOD_RES != DOUGLAS_RACHFORD) || COUPLED_TC_RES
+    #error In parallel the ADI is only implemented for the (uncoupled) DOUGLAS_RACHFORD method
+  #endif
+  #if FIRST_JDIR_THEN_IDIR == RANDOM
+    #error FIRST_JDIR_THEN_IDIR RANDOM would give a different order on every process
+  #endif
+  #if DIMENSIONS != 2
+    #error The distributed ADI assumes a 2D domain
+  #endif
+#endif
+
+// Optically thin radiative loss (tabulated) as implicit sink of the thermal conduction
+#ifndef RAD_LOSS_ADI
+  #define RAD_LOSS_ADI NO
+#endif
+#if RAD_LOSS_ADI
+  #if THERMAL_CONDUCTION != ALTERNATING_DIRECTION_IMPLICIT
+    #error RAD_LOSS_ADI requires ADI for thermal conduction
+  #elif METHOD_TC != DOUGLAS_RACHFORD || COUPLED_TC_RES
+    #error RAD_LOSS_ADI is only implemented for the (uncoupled) DOUGLAS_RACHFORD method
+  #endif
+  #if COOLING != NO
+    #error RAD_LOSS_ADI must not be used together with COOLING
+  #endif
+#endif
+
+// Rebuild of the operators of the next sub-iteration on a helper thread (see adi_async.c)
+#ifndef ASYNC_OP_REBUILD
+  #define ASYNC_OP_REBUILD NO
+#endif
+#if ASYNC_OP_REBUILD
+  #if (THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && METHOD_TC != DOUGLAS_RACHFORD) || \
+      (RESISTIVITY == ALTERNATING_DIRECTION_IMPLICIT && METHOD_RES != DOUGLAS_RACHFORD) || COUPLED_TC_RES
+    #error ASYNC_OP_REBUILD is only implemented for the (uncoupled) DOUGLAS_RACHFORD method
+  #endif
+  #ifndef ASYNC_OP_REPORT_PERIOD
+    #define ASYNC_OP_REPORT_PERIOD 100
+  #endif
+#endif
+
+// Viscosity with ADI: vr*r and vz are two more diffusion problems (with their own bcs)
+#ifndef VISCOSITY_ADI
+  #define VISCOSITY_ADI NO
+#endif
+#if VISCOSITY_ADI
+  #if (THERMAL_CONDUCTION==ALTERNATING_DIRECTION_IMPLICIT) && \
+      (RESISTIVITY==ALTERNATING_DIRECTION_IMPLICIT)
+    #define VRDIFF 2
+  #elif (THERMAL_CONDUCTION==ALTERNATING_DIRECTION_IMPLICIT) || \
+        (RESISTIVITY==ALTERNATING_DIRECTION_IMPLICIT)
+    #define VRDIFF 1
+  #else
+    #error VISCOSITY_ADI needs ADI for thermal conduction or resistivity (otherwise ADI() is not called)
+  #endif
+  #define VZDIFF (VRDIFF+1)
+  #undef  NADI
+  #define NADI   (VRDIFF+2)
+  #if VISCOSITY != NO
+    #error VISCOSITY_ADI must not be used together with VISCOSITY of PLUTO
+  #endif
+#else
+  #define VRDIFF 400 // On purpose a very high number which I will never use
+  #define VZDIFF 500
+#endif
+
 /******************************************/
 /* I define the schemes                   */
 #define FRACTIONAL_THETA      1
@@ -120,6 +203,7 @@
 #define DOUGLAS_RACHFORD      4
 #define PEACEMAN_RACHFORD_MOD 5
 #define STRANG                6
+#define JFNK                  7   // Only for thermal conduction
 /**************************************************/
 /* Consistency check of some definitions          */
 #if RESISTIVITY==ALTERNATING_DIRECTION_IMPLICIT
@@ -137,6 +221,20 @@
   #if METHOD_TC==PEACEMAN_RACHFORD_MOD && !defined(FRACT_TC)
     #error FRACT_TC must be defined when FRACTIONAL_THETA is used
   #endif
+  #if METHOD_TC==JFNK && EOS!=PVTE_LAW
+    #error JFNK is only implemented for PVTE_LAW
+  #endif
+#endif
+#if COUPLED_TC_RES
+  #if (THERMAL_CONDUCTION!=ALTERNATING_DIRECTION_IMPLICIT) || (RESISTIVITY!=ALTERNATING_DIRECTION_IMPLICIT)
+    #error COUPLED_TC_RES requires ADI for both thermal conduction and resistivity
+  #endif
+  #if !JOULE_EFFECT_AND_MAG_ENG || (POW_INSIDE_ADI != YES) || MAG_PS_OUTSIDE_SSTEP
+    #error COUPLED_TC_RES requires the Joule effect to be computed inside the ADI scheme
+  #endif
+  #if EOS!=PVTE_LAW || FIRST_JDIR_THEN_IDIR == AVERAGE
+    #error COUPLED_TC_RES is only implemented for PVTE_LAW and a single order of directions
+  #endif
 #endif
 /***************************************************/
 
@@ -156,17 +254,49 @@ typedef struct LINES{
   Bcs *lbound[NADI],*rbound[NADI];   /**< Left and right boundary conditions */
   int *lidx, *ridx;      /**< Leftmost and rightmost indexes of the lines. */
   double N;              /**< Number of lines */
+  int lbeg, lend;        /**< Lines lbeg <= l < lend are the ones solved by this process
+                              (all of them in serial) */
 } Lines;
 
 // I define a function pointer type, that will take the value of the right bc function
 // typedef void (*BoundaryADI) (Lines lines[2], const Data *d, Grid *grid, double t);
 typedef void BoundaryADI (Lines lines[2], const Data *d, Grid *grid, double t, int dir);
-// I define a function pointer type, that will take the value of the right IJ builder function
+/* I define a function pointer type, that will take the value of the right IJ builder function.
+   Note: CI and CJ are the reciprocals of the capacities (1/C of dv/dt = div(H grad(v))/C),
+   so that the updates multiply by them instead of dividing */
 typedef void BuildIJ (const Data *d, Grid *grid, Lines *lines, double **Ip, double **Im,
                       double **Jp, double **Jm, double **CI, double **CJ, double **dEdT);
 
+/* Geometric factors of the operators of thermal conduction (tc_) and magnetic diffusion
+   (res_): each one depends only on i or only on j, so they are 1D vectors, indexed as the
+   cells of the grid they are made for (see GetOperatorGeometry()) */
+typedef struct OPERATOR_GEOMETRY {
+  double *tc_Ip, *tc_Im;    /**< A_r/(r_{i+1}-r_i) at the right and left interfaces, along i */
+  double *tc_Jp, *tc_Jm;    /**< 1/(z_{j+1}-z_j) at the upper and lower interfaces, along j */
+  double *tc_CI, *tc_CJ;    /**< 1/dV along i and j (to be divided by dEdT) */
+  double *res_Ip, *res_Im;  /**< 1/(dr dri r) at the right and left interfaces, along i */
+  double *res_Jp, *res_Jm;  /**< 1/(dz dzi) at the upper and lower interfaces, along j */
+  double *res_CI;           /**< r, along i (the 1/C along j is 1) */
+} OperatorGeometry;
+
 void InitializeLines (Lines *, int);
 void GeometryADI (Lines *lines, Grid *grid);
+const OperatorGeometry *GetOperatorGeometry(Grid *grid);
+#ifdef PARALLEL
+  // Layout of the cells of the local lines (the other layouts are IDIR and JDIR, see adi_mpi.c)
+  #define ADI_BLOCK 2
+  void SetGlobalIndexesADI(Grid *grid);
+  void SetLocalIndexesADI();
+  Grid *GlobalGridADI(Grid *grid);
+  void PartitionLinesADI(Lines *lines, Grid *grid);
+  Lines *LocalLinesADI();
+  void ExchangeLinesADI(double ***src, int from, double ***dst, int to, int nf);
+  void SyncLinesADI(double **v, int dir);
+  void SyncGhostsADI(double **v, int dir);
+  void OperatorsOnLinesADI(int diff, int dir1, int recompute,
+                           double ***H1p, double ***H1m, double ***C1,
+                           double ***H2p, double ***H2m, double ***C2);
+#endif
 void BoundaryADI_Res(Lines lines[2], const Data *d, Grid *grid, double t, int dir);
 void BoundaryADI_TC(Lines lines[2], const Data *d, Grid *grid, double t, int dir);
 
@@ -206,33 +336,58 @@ void Strang    (double **v_new, double **v_old,
                 double dt, double t0, int M);
 
 void ExplicitUpdate (double **v, double **b, double **source,
-                     double **Hp, double **Hm, double **C,
+                     double **Hp, double **Hm, double **C_1,
                      Lines *lines, Bcs *lbound, Bcs *rbound,
                      int compute_inflow, double *inflow, Grid *grid,
                      double dt, int dir);
                      
 void ExplicitUpdateDR (double **v, double **b, double **b_der, double **source,
-                       double **Hp, double **Hm, double **C,
+                       double **Hp, double **Hm, double **C_1,
                        Lines *lines,
                        int compute_inflow, double *inflow, Grid *grid,
                        double dt, int dir);
 void ApplyBCsonGhosts(double **v, Lines *lines,
                       Bcs *lbound, Bcs *rbound,
                       int dir);
-void ImplicitUpdate (double **v, double **b, double **source,
-                     double **Hp, double **Hm, double **C,
+void ImplicitUpdate (double **v, double **b, double **source, double **sink,
+                     double **Hp, double **Hm, double **C_1,
                      Lines *lines, Bcs *lbound, Bcs *rbound,
                      int compute_inflow, double *inflow, Grid *grid,
                      double dt, int dir);
 
 void tdm_solver(double *x, double const *diagonal, double *up,
                 double const *lower, double *rhs, int const N);
+void btdm_solver(double (*x)[2], double (*diagonal)[4], double (*up)[4],
+                 double (*lower)[4], double (*rhs)[2], int const N);
+
+#if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && METHOD_TC == JFNK
+  void JFNK_TC(double **T_new, double **T_old, double **dEdT,
+               const Data *d, Grid *grid, Lines *lines,
+               int order, double dt, double t0);
+#endif
+
+#if COUPLED_TC_RES
+  void DouglasRachfordCoupled(double **T_new, double **T_old,
+                              double **Br_new, double **Br_old,
+                              double **dUres, double **dUjoule, double **dEdT,
+                              const Data *d, Grid *grid, Lines *lines, int order,
+                              double dt, double t0, int M, int recompute_operators);
+#endif
 
 double GetCurrADI();
 
 double GetT_old(int j, int i);
 
+#if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && EOS==PVTE_LAW
+  void BuildTemperature(const Data *d, double **T);
+  void CorrectCarriedTemperature(const Data *d, double **T, Lines *lines);
+#endif
+
 #if THERMAL_CONDUCTION  == ALTERNATING_DIRECTION_IMPLICIT
+  #if RAD_LOSS_ADI
+    void BuildRadLossTC(const Data *d, Lines *lines, double **T_lin, double **dEdT,
+                        double **source, double **sink);
+  #endif
   void BuildIJ_TC (const Data *d, Grid *grid, Lines *lines, double **Ip, double **Im,
                   double **Jp, double **Jm, double **CI, double **CJ, double **dEdT);
   #ifdef TEST_ADI
@@ -255,6 +410,22 @@ double GetT_old(int j, int i);
   void ComplainAnisotropic(double *v, double  *eta, double r, double z, double theta);
 #endif
 
+#if VISCOSITY_ADI
+  void BuildIJ_ViscR (const Data *d, Grid *grid, Lines *lines, double **Ip, double **Im,
+                      double **Jp, double **Jm, double **CI, double **CJ, double **useless);
+  void BuildIJ_ViscZ (const Data *d, Grid *grid, Lines *lines, double **Ip, double **Im,
+                      double **Jp, double **Jm, double **CI, double **CJ, double **useless);
+  void BoundaryADI_Visc(Lines lines[2], const Data *d, Grid *grid, double t, int dir);
+#endif
+
+#if ASYNC_OP_REBUILD
+  void SetSubIterationADI(long tag);
+  void LaunchOperatorRebuildADI(const Data *d, Grid *grid, Lines *lines, long tag);
+  int TakeRebuiltOperatorsADI(int diff, double ***Ip, double ***Im, double ***Jp,
+                              double ***Jm, double ***CI, double ***CJ, double **dEdT);
+  void ReportOperatorRebuildADI();
+#endif
+
 /* Stuff to do prim->cons and cons->prim conversions*/
 void ConsToPrimLines (Data_Arr U, Data_Arr V, unsigned char ***flag, Lines *lines);
 void PrimToConsLines (Data_Arr V, Data_Arr U, Lines *lines);
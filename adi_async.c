@@ -0,0 +1,245 @@
+/*Rebuild of the discrete diffusion operators of the Douglas-Rachford schemes on a
+helper thread (ASYNC_OP_REBUILD), overlapped with the sweeps of the current sub-iteration*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "adi.h"
+#include "capillary_wall.h"
+#include "cell_state.h"
+
+#if ASYNC_OP_REBUILD
+#include <pthread.h>
+#include <time.h>
+
+/****************************************************************************
+How it works:
+  - every sub-iteration has a tag (a counter which never restarts, so tags of different
+    steps never match), which ADI() gives to SetSubIterationADI() at its start;
+  - at the start of a sub-iteration whose next one has to recompute the operators,
+    ADI() calls LaunchOperatorRebuildADI() with the tag of the next sub-iteration: I copy Vc
+    in a snapshot and a helper thread builds, from the snapshot, a set of operators (for
+    every diffusion problem advanced with DouglasRachford()) tagged with it;
+  - meanwhile the main thread performs the current sub-iteration: when DouglasRachford()
+    calls TakeRebuiltOperatorsADI() I hand out only a set whose tag is the current one,
+    waiting for the helper only if it is building exactly that set. The set under
+    construction is for the next sub-iteration, so the current one never waits for it
+    (if the current set is not there the caller builds it, concurrently with the helper);
+  - the sets live in two slots (by tag parity), so the helper can build the set of the
+    next sub-iteration while the one of the current sub-iteration has not been taken yet.
+So the operators of a sub-iteration are built from the state at the start of the previous
+one (as it already happens for DIFF_OP_RECOMPUTE_PERIOD > 1), while the ones of the first
+sub-iteration of every step are always built on the main thread (from the post-hydro state).
+The helper only reads the snapshot, the grid and the geometry of the lines, and writes
+the sets of its slot. When the main thread builds a set itself, the two builds run at the
+same time: so the builders (BuildIJ_TC(), BuildIJ_Res(), BuildIJ_Visc*()) must not keep
+static scratch arrays (their kappa, eta, nu are allocated at every call), and the cell
+state cache they read is the one of their own Data (d_snap for the helper).
+What is made once and then only read (the tables of the transport coefficients and EOS,
+GetOperatorGeometry(), GetCapRegionMap(), the cache of d_snap) is made on the main thread:
+for this the very first rebuild is done on the main thread, before any build on the helper.
+[Rob] A new static scratch in the builders or below them (e.g. in the EOS) brings back
+the race: keep them free of it.
+*****************************************************************************/
+
+typedef struct OPERATOR_SET {
+  double **Ip, **Im, **Jp, **Jm, **CI, **CJ;
+} OperatorSet;
+
+static OperatorSet next_ops[2][NADI]; // Operators built by the helper thread (2 slots)
+static double **next_dEdT[2];         // dEdT built by the helper together with the TC operators
+static int ready[2][NADI];            // Tells whether next_ops[slot][diff] holds a set not yet taken
+static long slot_tag[2] = {-1, -1};   // Sub-iteration the sets of every slot have been built for
+static long cur_tag = -1;             // Sub-iteration currently running
+static long job_tag = -1;             // Sub-iteration the set being built by the helper is for
+static int job_slot;
+static Data *d_snap;                  // Snapshot of the state the helper builds from
+static Grid *job_grid;
+static Lines *job_lines;
+static pthread_t helper;
+static int helper_running = 0;
+
+// Timing (seconds): time spent building by the helper, and waiting for it by the main thread
+static double t_build_last = 0.0;
+static double t_build_tot = 0.0, t_wait_tot = 0.0;
+static long n_rebuilds = 0;
+
+static double ElapsedSeconds(struct timespec *beg, struct timespec *end) {
+  return (end->tv_sec - beg->tv_sec) + 1.e-9*(end->tv_nsec - beg->tv_nsec);
+}
+
+/****************************************************************************
+Body of the helper thread: builds the operators of all the diffusion problems
+in the slot job_slot
+*****************************************************************************/
+static void *RebuildOperators(void *unused) {
+  struct timespec t_beg, t_end;
+  OperatorSet *ops = next_ops[job_slot];
+
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  #if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT
+    BuildIJ_TC(d_snap, job_grid, job_lines, ops[TDIFF].Ip, ops[TDIFF].Im,
+               ops[TDIFF].Jp, ops[TDIFF].Jm, ops[TDIFF].CI, ops[TDIFF].CJ,
+               next_dEdT[job_slot]);
+    ready[job_slot][TDIFF] = 1;
+  #endif
+  #if RESISTIVITY == ALTERNATING_DIRECTION_IMPLICIT
+    BuildIJ_Res(d_snap, job_grid, job_lines, ops[BDIFF].Ip, ops[BDIFF].Im,
+                ops[BDIFF].Jp, ops[BDIFF].Jm, ops[BDIFF].CI, ops[BDIFF].CJ,
+                NULL);
+    ready[job_slot][BDIFF] = 1;
+  #endif
+  #if VISCOSITY_ADI
+    BuildIJ_ViscR(d_snap, job_grid, job_lines, ops[VRDIFF].Ip, ops[VRDIFF].Im,
+                  ops[VRDIFF].Jp, ops[VRDIFF].Jm, ops[VRDIFF].CI, ops[VRDIFF].CJ,
+                  NULL);
+    ready[job_slot][VRDIFF] = 1;
+    BuildIJ_ViscZ(d_snap, job_grid, job_lines, ops[VZDIFF].Ip, ops[VZDIFF].Im,
+                  ops[VZDIFF].Jp, ops[VZDIFF].Jm, ops[VZDIFF].CI, ops[VZDIFF].CJ,
+                  NULL);
+    ready[job_slot][VZDIFF] = 1;
+  #endif
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_build_last = ElapsedSeconds(&t_beg, &t_end);
+
+  return NULL;
+}
+
+/****************************************************************************
+Waits for the helper thread (if it is running) and accounts the waiting time
+*****************************************************************************/
+static void WaitOperatorRebuildADI() {
+  struct timespec t_beg, t_end;
+
+  if (!helper_running) return;
+
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  if (pthread_join(helper, NULL) != 0) {
+    print1("\n[WaitOperatorRebuildADI] Error while joining the helper thread");
+    QUIT_PLUTO(1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  helper_running = 0;
+
+  t_wait_tot += ElapsedSeconds(&t_beg, &t_end);
+  t_build_tot += t_build_last;
+  n_rebuilds++;
+}
+
+/****************************************************************************
+Tells which sub-iteration is running (tag), i.e. which set TakeRebuiltOperatorsADI()
+may hand out
+*****************************************************************************/
+void SetSubIterationADI(long tag) {
+  cur_tag = tag;
+}
+
+/****************************************************************************
+Takes a snapshot of the state and starts the rebuild of the operators of the
+sub-iteration tag on the helper thread (to be called after the ghost cells have been set)
+*****************************************************************************/
+void LaunchOperatorRebuildADI(const Data *d, Grid *grid, Lines *lines, long tag) {
+  static int first_call = 1;
+  int i,j,k,n,l;
+
+  // The snapshot and the slot may still be in use by the previous rebuild
+  WaitOperatorRebuildADI();
+
+  if (first_call) {
+    // (under PARALLEL too the operators are built on the local block, with the local indexes)
+    d_snap = alloc_Data();
+    for (l = 0; l < 2; l++) {
+      for (n = 0; n < NADI; n++) {
+        next_ops[l][n].Ip = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+        next_ops[l][n].Im = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+        next_ops[l][n].Jp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+        next_ops[l][n].Jm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+        next_ops[l][n].CI = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+        next_ops[l][n].CJ = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+        ready[l][n] = 0;
+      }
+      next_dEdT[l] = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      TOT_LOOP(k,j,i) next_dEdT[l][j][i] = 0.0;
+    }
+  }
+
+  copy_Data_Vc(d_snap, d);
+  // (this also creates the cache of d_snap here, on the main thread)
+  InvalidateCellState(d_snap);
+  job_grid = grid;
+  job_lines = lines;
+  job_tag = tag;
+  job_slot = (int)(tag%2);
+  // A set of this slot never taken (it should not happen) is simply overwritten
+  slot_tag[job_slot] = tag;
+  for (n = 0; n < NADI; n++) ready[job_slot][n] = 0;
+
+  if (first_call) {
+    /* The first rebuild runs here, so that the tables of the transport coefficients
+       (and EOS) are built before the helper and the main thread can build concurrently */
+    RebuildOperators(NULL);
+    first_call = 0;
+    return;
+  }
+
+  if (pthread_create(&helper, NULL, RebuildOperators, NULL) != 0) {
+    print1("\n[LaunchOperatorRebuildADI] Error while creating the helper thread");
+    QUIT_PLUTO(1);
+  }
+  helper_running = 1;
+}
+
+/****************************************************************************
+If a set of operators has been built for the diffusion problem diff and the current
+sub-iteration, I swap it with the one pointed by Ip,..,CJ (and copy its dEdT in dEdT,
+for TDIFF). Returns 1 if the swap has been done, 0 if the operators have to be built
+by the caller.
+*****************************************************************************/
+int TakeRebuiltOperatorsADI(int diff, double ***Ip, double ***Im, double ***Jp,
+                            double ***Jm, double ***CI, double ***CJ, double **dEdT) {
+  int i,j,k;
+  int slot;
+
+  if (diff < 0 || diff >= NADI || cur_tag < 0) return 0;
+  slot = (int)(cur_tag%2);
+
+  if (helper_running && job_slot == slot) {
+    // The helper is writing this slot: I wait only if it is building the current set
+    if (job_tag != cur_tag) return 0;
+    WaitOperatorRebuildADI();
+  }
+  if (slot_tag[slot] != cur_tag || !ready[slot][diff]) return 0;
+
+  SwapDoublePointers(Ip, &next_ops[slot][diff].Ip);
+  SwapDoublePointers(Im, &next_ops[slot][diff].Im);
+  SwapDoublePointers(Jp, &next_ops[slot][diff].Jp);
+  SwapDoublePointers(Jm, &next_ops[slot][diff].Jm);
+  SwapDoublePointers(CI, &next_ops[slot][diff].CI);
+  SwapDoublePointers(CJ, &next_ops[slot][diff].CJ);
+  // dEdT belongs to ADI() (it is used also to update the energy), so I copy it
+  if (diff == TDIFF && dEdT != NULL) {
+    TOT_LOOP(k,j,i) dEdT[j][i] = next_dEdT[slot][j][i];
+  }
+  ready[slot][diff] = 0;
+
+  return 1;
+}
+
+/****************************************************************************
+Prints how much of the rebuild time has been hidden behind the sweeps
+*****************************************************************************/
+void ReportOperatorRebuildADI() {
+  double t_hidden;
+
+  WaitOperatorRebuildADI();
+  if (n_rebuilds == 0) return;
+
+  t_hidden = t_build_tot - t_wait_tot;
+  print1("\n[ADI] Async operator rebuilds: %ld, build time %.4e s, waited %.4e s, hidden %.4e s (%.1f%%)",
+         n_rebuilds, t_build_tot, t_wait_tot, t_hidden,
+         t_build_tot > 0.0 ? 100.0*t_hidden/t_build_tot : 0.0);
+}
+#endif
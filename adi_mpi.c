@@ -0,0 +1,564 @@
+#include "pluto.h"
+#include "adi.h"
+#include "field2d.h"
+#include <limits.h>
+
+#ifdef PARALLEL
+/****************************************************************************
+Distributed ADI (PLUTO domain decomposition).
+The data stay distributed as PLUTO has them: inside ADI() every process does the
+point-wise work (cons<->prim, temperature, diffusion coefficients and operators,
+energy updates) only on its block, i.e. on the pieces of the lines inside it (the
+local lines, see LocalLinesADI(), in local indexes).
+The sweeps need whole lines: the lines of both directions are split among the
+processes (the own lines, see PartitionLinesADI()) and every process solves only
+its own ones, in the global indexes (SetGlobalIndexesADI(), GlobalGridADI()).
+Only the cells of the lines are moved, by ExchangeLinesADI(), between three layouts:
+  - ADI_BLOCK: the cells of the local lines (local indexes);
+  - IDIR, JDIR: the cells of the own lines of that direction (global indexes).
+So the block -> lines exchanges feed the sweeps, SyncLinesADI() is the transpose
+between the sweeps of the two directions and the lines -> block exchanges give the
+results back. The ghosts of the lines are never exchanged: the sweeps set them
+from the boundary conditions of the lines.
+[Opt] The arrays of the sweeps are allocated with the size of the global domain
+(so that the sweep kernels index them as in serial), but only the cells of the own
+lines are ever touched.
+*****************************************************************************/
+
+static int nx1_loc, nx2_loc, nx1_tot_loc, nx2_tot_loc;
+static int ibeg_loc, iend_loc, jbeg_loc, jend_loc;
+
+static int nproc;
+static int *line_beg[2]; /* Lines of process p (in dir) are line_beg[dir][p] <= l < line_beg[dir][p+1] */
+static Lines *lines_glob;      // The lines given to PartitionLinesADI()
+static Lines lines_loc[2];     // The local lines (see LocalLinesADI())
+static int ioff, joff;         // Global index - local index, in the block of this process
+static int ni_glob, nj_glob;   // NX1_TOT, NX2_TOT of the global domain
+
+/* Owners of the cells (by global index): of the own lines, row_owner[j] (IDIR) and
+   col_owner[i] (JDIR), and of the blocks, blk_rank[blk_row[j]*nblk_col + blk_col[i]] */
+static int *row_owner, *col_owner;
+static int *blk_row, *blk_col, *blk_rank, nblk_col;
+
+/* What a process sends and receives in an exchange between two layouts: the cells
+   for (from) process p are the ones rdispl[p] <= n < rdispl[p]+rcount[p] (the same
+   for the sent ones), each one given by its indexes in the array it is taken from
+   (sj, si) or put in (rj, ri). Both the sides list the cells in the same order
+   (by row, then by column, in global indexes), so they need no other information */
+typedef struct EXCHANGE_PLAN {
+  int nsend, nrecv;
+  int *scount, *sdispl, *rcount, *rdispl;
+  int *sj, *si, *rj, *ri;
+} ExchangePlan;
+
+static ExchangePlan plans[3][3];   // plans[from][to], made at the first use
+static int plan_done[3][3];
+
+static void SetOwners(Grid *grid);
+static void MakeLocalLines(Grid *grid);
+
+/****************************************************************************
+Sets the global indexes (NX1, NX1_TOT, IBEG, IEND, ...) to the ones of the
+global domain, saving the local ones
+*****************************************************************************/
+void SetGlobalIndexesADI(Grid *grid) {
+  nx1_loc = NX1;          nx2_loc = NX2;
+  nx1_tot_loc = NX1_TOT;  nx2_tot_loc = NX2_TOT;
+  ibeg_loc = IBEG;        iend_loc = IEND;
+  jbeg_loc = JBEG;        jend_loc = JEND;
+
+  NX1 = grid[IDIR].np_int_glob;      NX2 = grid[JDIR].np_int_glob;
+  NX1_TOT = grid[IDIR].np_tot_glob;  NX2_TOT = grid[JDIR].np_tot_glob;
+  IBEG = grid[IDIR].gbeg;            IEND = grid[IDIR].gend;
+  JBEG = grid[JDIR].gbeg;            JEND = grid[JDIR].gend;
+}
+
+/****************************************************************************
+Restores the local indexes saved by SetGlobalIndexesADI()
+*****************************************************************************/
+void SetLocalIndexesADI() {
+  NX1 = nx1_loc;          NX2 = nx2_loc;
+  NX1_TOT = nx1_tot_loc;  NX2_TOT = nx2_tot_loc;
+  IBEG = ibeg_loc;        IEND = iend_loc;
+  JBEG = jbeg_loc;        JEND = jend_loc;
+}
+
+/****************************************************************************
+Builds (only once) a grid covering the global domain: the arrays are the _glob
+ones, the others (A, dV, r_1, inv_dx, inv_dxi) are computed as PLUTO does for
+cylindrical geometry
+*****************************************************************************/
+Grid *GlobalGridADI(Grid *grid) {
+  static Grid grid_glob[3];
+  static int first_call = 1;
+  int dir, i, N;
+  Grid *g;
+
+  if (!first_call) return grid_glob;
+
+  #if GEOMETRY != CYLINDRICAL
+    #error The global grid of the distributed ADI is only implemented for cylindrical geometry
+  #endif
+  for (dir = 0; dir < 3; dir++) {
+    grid_glob[dir] = grid[dir];
+  }
+  for (dir = IDIR; dir <= JDIR; dir++) {
+    g = &grid_glob[dir];
+    N = grid[dir].np_tot_glob;
+    g->x = grid[dir].x_glob;
+    g->xl = grid[dir].xl_glob;
+    g->xr = grid[dir].xr_glob;
+    g->dx = grid[dir].dx_glob;
+    g->A = ARRAY_1D(N, double);
+    g->dV = ARRAY_1D(N, double);
+    g->r_1 = ARRAY_1D(N, double);
+    g->inv_dx = ARRAY_1D(N, double);
+    g->inv_dxi = ARRAY_1D(N, double);
+    for (i = 0; i < N; i++) {
+      if (dir == IDIR) {
+        g->A[i] = fabs(g->xr[i]);
+        g->dV[i] = fabs(0.5*(g->xr[i]*g->xr[i] - g->xl[i]*g->xl[i]));
+        g->r_1[i] = 1.0/g->x[i];
+      } else {
+        g->A[i] = 1.0;
+        g->dV[i] = g->dx[i];
+        g->r_1[i] = 0.0;
+      }
+      g->inv_dx[i] = 1.0/g->dx[i];
+      g->inv_dxi[i] = (i < N-1) ? 1.0/(g->x[i+1] - g->x[i]) : g->inv_dxi[i-1];
+    }
+    g->np_int = grid[dir].np_int_glob;
+    g->np_tot = grid[dir].np_tot_glob;
+    g->beg = g->lbeg = grid[dir].gbeg;
+    g->end = g->lend = grid[dir].gend;
+  }
+  first_call = 0;
+  return grid_glob;
+}
+
+
+/****************************************************************************
+Splits the lines of both directions among the processes, giving to each one
+(about) the same number of cells, and sets lbeg, lend of the lines.
+It also finds the owners of the cells and builds the local lines, which are
+needed by the exchanges (lines must be kept, grid is the local one).
+*****************************************************************************/
+void PartitionLinesADI(Lines *lines, Grid *grid) {
+  int dir, l, p;
+  long int ncells, ncum;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  for (dir = IDIR; dir <= JDIR; dir++) {
+    line_beg[dir] = ARRAY_1D(nproc+1, int);
+    ncells = 0;
+    for (l = 0; l < lines[dir].N; l++)
+      ncells += lines[dir].ridx[l] - lines[dir].lidx[l] + 1;
+
+    ncum = 0;
+    p = 0;
+    line_beg[dir][0] = 0;
+    for (l = 0; l < lines[dir].N; l++) {
+      // The first line whose cells start beyond the share of process p goes to p+1
+      while (p < nproc-1 && ncum >= (ncells*(p+1))/nproc) {
+        line_beg[dir][++p] = l;
+      }
+      ncum += lines[dir].ridx[l] - lines[dir].lidx[l] + 1;
+    }
+    while (p < nproc) line_beg[dir][++p] = lines[dir].N;
+
+    lines[dir].lbeg = line_beg[dir][prank];
+    lines[dir].lend = line_beg[dir][prank+1];
+  }
+
+  lines_glob = lines;
+  ni_glob = grid[IDIR].np_tot_glob;
+  nj_glob = grid[JDIR].np_tot_glob;
+  ioff = grid[IDIR].beg - grid[IDIR].lbeg;
+  joff = grid[JDIR].beg - grid[JDIR].lbeg;
+  SetOwners(grid);
+  MakeLocalLines(grid);
+}
+
+/****************************************************************************
+Finds the owners of the cells in the layouts IDIR, JDIR (from the partition of
+the lines) and ADI_BLOCK (from the blocks of all the processes, which form a
+cartesian decomposition: a block is found by its column and its row)
+*****************************************************************************/
+static void SetOwners(Grid *grid) {
+  int ni = ni_glob, nj = nj_glob;
+  int box[4], *boxes;
+  int i, j, l, p, nblk_row;
+
+  row_owner = ARRAY_1D(nj, int);
+  col_owner = ARRAY_1D(ni, int);
+  for (p = 0; p < nproc; p++) {
+    for (l = line_beg[IDIR][p]; l < line_beg[IDIR][p+1]; l++)
+      row_owner[lines_glob[IDIR].dom_line_idx[l]] = p;
+    for (l = line_beg[JDIR][p]; l < line_beg[JDIR][p+1]; l++)
+      col_owner[lines_glob[JDIR].dom_line_idx[l]] = p;
+  }
+
+  box[0] = grid[IDIR].beg;  box[1] = grid[IDIR].end;
+  box[2] = grid[JDIR].beg;  box[3] = grid[JDIR].end;
+  boxes = ARRAY_1D(4*nproc, int);
+  MPI_Allgather(box, 4, MPI_INT, boxes, 4, MPI_INT, MPI_COMM_WORLD);
+
+  // I mark the first cell of every block column (row), then I number the columns (rows)
+  blk_col = ARRAY_1D(ni, int);
+  blk_row = ARRAY_1D(nj, int);
+  for (i = 0; i < ni; i++) blk_col[i] = -1;
+  for (j = 0; j < nj; j++) blk_row[j] = -1;
+  for (p = 0; p < nproc; p++) {
+    blk_col[boxes[4*p]] = 0;
+    blk_row[boxes[4*p+2]] = 0;
+  }
+  nblk_col = 0;
+  for (i = 0; i < ni; i++) {
+    if (blk_col[i] == 0) nblk_col++;
+    blk_col[i] = nblk_col-1;
+  }
+  nblk_row = 0;
+  for (j = 0; j < nj; j++) {
+    if (blk_row[j] == 0) nblk_row++;
+    blk_row[j] = nblk_row-1;
+  }
+  blk_rank = ARRAY_1D(nblk_row*nblk_col, int);
+  for (p = 0; p < nproc; p++)
+    blk_rank[blk_row[boxes[4*p+2]]*nblk_col + blk_col[boxes[4*p]]] = p;
+  FreeArray1D(boxes);
+}
+
+/****************************************************************************
+Builds the local lines: the pieces of the (global) lines inside the block of this
+process, in local indexes, all of them solved by this process (lbeg = 0, lend = N).
+The lines without cells in the block are left out.
+*****************************************************************************/
+static void MakeLocalLines(Grid *grid) {
+  int beg[2], end[2], off[2];
+  int dir, across, pass, l, n, idx, lo, hi;
+  Lines *lg, *ll;
+
+  beg[IDIR] = grid[IDIR].beg;  end[IDIR] = grid[IDIR].end;  off[IDIR] = ioff;
+  beg[JDIR] = grid[JDIR].beg;  end[JDIR] = grid[JDIR].end;  off[JDIR] = joff;
+  for (dir = IDIR; dir <= JDIR; dir++) {
+    lg = &lines_glob[dir];
+    ll = &lines_loc[dir];
+    across = (dir == IDIR) ? JDIR : IDIR; // Direction of dom_line_idx
+    // I count them first, then I fill them
+    for (pass = 0; pass < 2; pass++) {
+      n = 0;
+      for (l = 0; l < lg->N; l++) {
+        idx = lg->dom_line_idx[l];
+        lo = MAX(lg->lidx[l], beg[dir]);
+        hi = MIN(lg->ridx[l], end[dir]);
+        if (idx < beg[across] || idx > end[across] || lo > hi) continue;
+        if (pass) {
+          ll->dom_line_idx[n] = idx - off[across];
+          ll->lidx[n] = lo - off[dir];
+          ll->ridx[n] = hi - off[dir];
+        }
+        n++;
+      }
+      if (!pass) {
+        // (one more, as LINES_LOOP reads dom_line_idx[N] when it ends)
+        InitializeLines(ll, n+1);
+        ll->N = n;
+        ll->lend = n;
+      }
+    }
+  }
+}
+
+/****************************************************************************
+Gives the local lines (see MakeLocalLines()): the point-wise work of ADI() is
+done on them
+*****************************************************************************/
+Lines *LocalLinesADI() {
+  return lines_loc;
+}
+
+/****************************************************************************
+Owner of the cell (j, i) (global indexes) in the layout lay
+*****************************************************************************/
+static int CellOwner(int lay, int j, int i) {
+  if (lay == IDIR) return row_owner[j];
+  if (lay == JDIR) return col_owner[i];
+  return blk_rank[blk_row[j]*nblk_col + blk_col[i]];
+}
+
+/****************************************************************************
+Lists the cells (global indexes) of this process in the layout lay, by row and then
+by column, in jc, ic (if they are not NULL), and gives their number
+*****************************************************************************/
+static int LayoutCells(int lay, int *jc, int *ic) {
+  int n = 0, l, i, j, jmin, jmax;
+  Lines *ll;
+
+  if (lay == IDIR) {
+    ll = &lines_glob[IDIR];
+    for (l = ll->lbeg; l < ll->lend; l++)
+      for (i = ll->lidx[l]; i <= ll->ridx[l]; i++) {
+        if (jc != NULL) { jc[n] = ll->dom_line_idx[l];  ic[n] = i; }
+        n++;
+      }
+  } else if (lay == JDIR) {
+    ll = &lines_glob[JDIR];
+    jmin = INT_MAX;
+    jmax = INT_MIN;
+    for (l = ll->lbeg; l < ll->lend; l++) {
+      jmin = MIN(jmin, ll->lidx[l]);
+      jmax = MAX(jmax, ll->ridx[l]);
+    }
+    for (j = jmin; j <= jmax; j++)
+      for (l = ll->lbeg; l < ll->lend; l++) {
+        if (j < ll->lidx[l] || j > ll->ridx[l]) continue;
+        if (jc != NULL) { jc[n] = j;  ic[n] = ll->dom_line_idx[l]; }
+        n++;
+      }
+  } else {
+    ll = &lines_loc[IDIR];
+    for (l = 0; l < ll->N; l++)
+      for (i = ll->lidx[l]; i <= ll->ridx[l]; i++) {
+        if (jc != NULL) { jc[n] = ll->dom_line_idx[l] + joff;  ic[n] = i + ioff; }
+        n++;
+      }
+  }
+  return n;
+}
+
+/****************************************************************************
+Sorts the n cells jc, ic by their owner in the layout lay (keeping their order),
+giving count and displ per process and the sorted indexes oj, oi (local indexes
+if local != 0)
+*****************************************************************************/
+static void SortCellsByOwner(int n, int *jc, int *ic, int lay, int local,
+                             int *count, int *displ, int **oj, int **oi) {
+  int m, p, k;
+  int *pos = ARRAY_1D(nproc, int);
+
+  for (p = 0; p < nproc; p++) count[p] = 0;
+  for (m = 0; m < n; m++) count[CellOwner(lay, jc[m], ic[m])]++;
+  k = 0;
+  for (p = 0; p < nproc; p++) {
+    displ[p] = pos[p] = k;
+    k += count[p];
+  }
+  *oj = ARRAY_1D(MAX(n,1), int);
+  *oi = ARRAY_1D(MAX(n,1), int);
+  for (m = 0; m < n; m++) {
+    k = pos[CellOwner(lay, jc[m], ic[m])]++;
+    (*oj)[k] = jc[m] - (local ? joff : 0);
+    (*oi)[k] = ic[m] - (local ? ioff : 0);
+  }
+  FreeArray1D(pos);
+}
+
+/****************************************************************************
+Gives the plan of the exchanges from the layout from to the layout to,
+making it at the first call
+*****************************************************************************/
+static ExchangePlan *GetExchangePlan(int from, int to) {
+  ExchangePlan *pl = &(plans[from][to]);
+  int *jc, *ic;
+
+  if (plan_done[from][to]) return pl;
+
+  pl->scount = ARRAY_1D(nproc, int);
+  pl->sdispl = ARRAY_1D(nproc, int);
+  pl->rcount = ARRAY_1D(nproc, int);
+  pl->rdispl = ARRAY_1D(nproc, int);
+
+  // I send my cells of the layout from, each one to its owner in the layout to
+  pl->nsend = LayoutCells(from, NULL, NULL);
+  jc = ARRAY_1D(MAX(pl->nsend,1), int);
+  ic = ARRAY_1D(MAX(pl->nsend,1), int);
+  LayoutCells(from, jc, ic);
+  SortCellsByOwner(pl->nsend, jc, ic, to, from == ADI_BLOCK,
+                   pl->scount, pl->sdispl, &(pl->sj), &(pl->si));
+  FreeArray1D(jc);
+  FreeArray1D(ic);
+
+  // I receive my cells of the layout to, each one from its owner in the layout from
+  pl->nrecv = LayoutCells(to, NULL, NULL);
+  jc = ARRAY_1D(MAX(pl->nrecv,1), int);
+  ic = ARRAY_1D(MAX(pl->nrecv,1), int);
+  LayoutCells(to, jc, ic);
+  SortCellsByOwner(pl->nrecv, jc, ic, from, to == ADI_BLOCK,
+                   pl->rcount, pl->rdispl, &(pl->rj), &(pl->ri));
+  FreeArray1D(jc);
+  FreeArray1D(ic);
+
+  plan_done[from][to] = 1;
+  return pl;
+}
+
+/****************************************************************************
+Moves the values of the nf fields src[f] to the fields dst[f] following the plan pl
+*****************************************************************************/
+static void ExchangeByPlan(ExchangePlan *pl, double ***src, double ***dst, int nf) {
+  static double *sendbuf, *recvbuf;
+  static int buf_size = 0;
+  static int *scount, *sdispl, *rcount, *rdispl;
+  int n, m, f, p;
+
+  m = nf*MAX(pl->nsend, pl->nrecv);
+  if (m > buf_size) {
+    if (buf_size > 0) {
+      FreeArray1D(sendbuf);
+      FreeArray1D(recvbuf);
+    } else {
+      scount = ARRAY_1D(nproc, int);
+      sdispl = ARRAY_1D(nproc, int);
+      rcount = ARRAY_1D(nproc, int);
+      rdispl = ARRAY_1D(nproc, int);
+    }
+    sendbuf = ARRAY_1D(m, double);
+    recvbuf = ARRAY_1D(m, double);
+    buf_size = m;
+  }
+  for (p = 0; p < nproc; p++) {
+    scount[p] = nf*pl->scount[p];  sdispl[p] = nf*pl->sdispl[p];
+    rcount[p] = nf*pl->rcount[p];  rdispl[p] = nf*pl->rdispl[p];
+  }
+
+  m = 0;
+  for (n = 0; n < pl->nsend; n++)
+    for (f = 0; f < nf; f++)
+      sendbuf[m++] = src[f][pl->sj[n]][pl->si[n]];
+
+  MPI_Alltoallv(sendbuf, scount, sdispl, MPI_DOUBLE,
+                recvbuf, rcount, rdispl, MPI_DOUBLE, MPI_COMM_WORLD);
+
+  m = 0;
+  for (n = 0; n < pl->nrecv; n++)
+    for (f = 0; f < nf; f++)
+      dst[f][pl->rj[n]][pl->ri[n]] = recvbuf[m++];
+}
+
+/****************************************************************************
+Moves the values of the nf fields src[f] (laid out as from) to the fields dst[f]
+(laid out as to), with from, to = ADI_BLOCK, IDIR, JDIR (see the top of the file).
+Only the cells of the lines are written, src and dst may be the same fields.
+*****************************************************************************/
+void ExchangeLinesADI(double ***src, int from, double ***dst, int to, int nf) {
+  ExchangeByPlan(GetExchangePlan(from, to), src, dst, nf);
+}
+
+/****************************************************************************
+Transpose between the sweeps: v, updated on the own lines of direction dir, is
+brought on the own lines of the other direction
+*****************************************************************************/
+void SyncLinesADI(double **v, int dir) {
+  ExchangeLinesADI(&v, dir, &v, (dir == IDIR) ? JDIR : IDIR, 1);
+}
+
+/****************************************************************************
+Gives the plan of SyncGhostsADI() for the ghosts of the lines of dir, making it at
+the first call (nshared is the number of the shared ghosts in the whole domain)
+*****************************************************************************/
+static ExchangePlan *GetGhostPlan(int dir, int *nshared) {
+  static ExchangePlan gplans[2];
+  static int gplan_done[2], nsh;
+  ExchangePlan *pl = &(gplans[dir]);
+  int ni = ni_glob, nj = nj_glob;
+  int other = (dir == IDIR) ? JDIR : IDIR;
+  int *jc, *ic, *jr, *ir;
+  int d, l, i, j, ns, nr;
+  unsigned char **ghost[2];
+  Lines *lg;
+
+  if (gplan_done[dir]) {
+    *nshared = nsh;
+    return pl;
+  }
+
+  // I mark the ghosts of all the lines of both the directions
+  for (d = IDIR; d <= JDIR; d++) {
+    ghost[d] = ARRAY_2D(nj, ni, unsigned char);
+    for (j = 0; j < nj; j++)
+      for (i = 0; i < ni; i++) ghost[d][j][i] = 0;
+    lg = &lines_glob[d];
+    for (l = 0; l < lg->N; l++) {
+      if (d == IDIR) {
+        ghost[d][lg->dom_line_idx[l]][lg->lidx[l]-1] = 1;
+        ghost[d][lg->dom_line_idx[l]][lg->ridx[l]+1] = 1;
+      } else {
+        ghost[d][lg->lidx[l]-1][lg->dom_line_idx[l]] = 1;
+        ghost[d][lg->ridx[l]+1][lg->dom_line_idx[l]] = 1;
+      }
+    }
+  }
+
+  // I send the shared ghosts of my lines of dir, and receive the ones of my lines of other
+  nsh = ns = nr = 0;
+  jc = ARRAY_1D(nj*ni, int);  ic = ARRAY_1D(nj*ni, int);
+  jr = ARRAY_1D(nj*ni, int);  ir = ARRAY_1D(nj*ni, int);
+  for (j = 0; j < nj; j++)
+    for (i = 0; i < ni; i++) {
+      if (!(ghost[IDIR][j][i] && ghost[JDIR][j][i])) continue;
+      nsh++;
+      if (CellOwner(dir, j, i) == prank) { jc[ns] = j;  ic[ns++] = i; }
+      if (CellOwner(other, j, i) == prank) { jr[nr] = j;  ir[nr++] = i; }
+    }
+  pl->scount = ARRAY_1D(nproc, int);
+  pl->sdispl = ARRAY_1D(nproc, int);
+  pl->rcount = ARRAY_1D(nproc, int);
+  pl->rdispl = ARRAY_1D(nproc, int);
+  pl->nsend = ns;
+  pl->nrecv = nr;
+  SortCellsByOwner(ns, jc, ic, other, 0, pl->scount, pl->sdispl, &(pl->sj), &(pl->si));
+  SortCellsByOwner(nr, jr, ir, dir, 0, pl->rcount, pl->rdispl, &(pl->rj), &(pl->ri));
+
+  FreeArray1D(jc);  FreeArray1D(ic);
+  FreeArray1D(jr);  FreeArray1D(ir);
+  FreeArray2D((void **) ghost[IDIR]);
+  FreeArray2D((void **) ghost[JDIR]);
+  gplan_done[dir] = 1;
+  *nshared = nsh;
+  return pl;
+}
+
+/****************************************************************************
+Where a ghost of a line of dir is also a ghost of a line of the other direction
+(at the inner corners of the domain, e.g. at the end of the capillary wall), in
+serial the last one who sets it wins: after ApplyBCsonGhosts() on the lines of dir,
+I give the ghosts of my own lines of dir to the owners of the lines of the other
+direction which share them (v is in the global indexes).
+*****************************************************************************/
+void SyncGhostsADI(double **v, int dir) {
+  int nshared;
+  ExchangePlan *pl = GetGhostPlan(dir, &nshared);
+
+  if (nshared > 0) ExchangeByPlan(pl, &v, &v, 1);
+}
+
+/****************************************************************************
+The operators of diff (H1p, H1m, C1 of the sweeps along dir1 and H2p, H2m, C2 of
+the ones along the other direction) are built on the local block: I set the
+pointers to copies of them laid out as the own lines of their direction, where the
+sweeps use them. The copies are updated only if the operators have been rebuilt
+(recompute != 0).
+It must be called with the global indexes set (the copies are allocated with them).
+*****************************************************************************/
+void OperatorsOnLinesADI(int diff, int dir1, int recompute,
+                         double ***H1p, double ***H1m, double ***C1,
+                         double ***H2p, double ***H2m, double ***C2) {
+  static double **ops[NADI][6]; // The copies, for every diff
+  double **blk[3];
+  int dir2 = (dir1 == IDIR) ? JDIR : IDIR;
+  int n;
+
+  if (ops[diff][0] == NULL) {
+    for (n = 0; n < 6; n++) ops[diff][n] = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    recompute = 1;
+  }
+  if (recompute) {
+    blk[0] = *H1p;  blk[1] = *H1m;  blk[2] = *C1;
+    ExchangeLinesADI(blk, ADI_BLOCK, ops[diff], dir1, 3);
+    blk[0] = *H2p;  blk[1] = *H2m;  blk[2] = *C2;
+    ExchangeLinesADI(blk, ADI_BLOCK, ops[diff]+3, dir2, 3);
+  }
+  *H1p = ops[diff][0];  *H1m = ops[diff][1];  *C1 = ops[diff][2];
+  *H2p = ops[diff][3];  *H2m = ops[diff][4];  *C2 = ops[diff][5];
+}
+#endif
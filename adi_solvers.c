@@ -8,6 +8,7 @@ and thermal conduction) terms with the Alternating Direction Implicit algorithm*
 
 #include "pluto.h"
 #include "adi.h"
+#include "field2d.h"
 #include "capillary_wall.h"
 #include "debug_utilities.h"
 #include <time.h>
@@ -16,13 +17,67 @@ and thermal conduction) terms with the Alternating Direction Implicit algorithm*
 /*Relative tollerance for checking that at each call of an ADI scheme, the algorithm advances for all the reqired total time*/
 #define   DT_REL_TOLL  1e-8
 
+/****************************************************************************
+Kernels on the raw rows of the fields, used for the lines in direction IDIR (whose
+cells are contiguous). The arguments are restrict-qualified (the fields passed never
+overlap), so that the loops are vectorized without run-time aliasing checks.
+*****************************************************************************/
+// Coefficients of the tridiagonal system of ImplicitUpdate() for the cells ibeg <= i <= iend
+static void AssembleRow(double *restrict diagonal, double *restrict upper,
+                        double *restrict lower, double *restrict rhs,
+                        double const *restrict b, double const *restrict C_1,
+                        double const *restrict Hp, double const *restrict Hm,
+                        int ibeg, int iend, double dt) {
+  int i;
+  for (i = ibeg; i <= iend; i++) {
+    diagonal[i] = 1 + dt*C_1[i] * (Hp[i]+Hm[i]);
+    rhs[i] = b[i];
+    upper[i] = -dt*C_1[i]*Hp[i];
+    lower[i] = -dt*C_1[i]*Hm[i];
+  }
+}
+
+// a += s*dt
+static void AddScaledRow(double *restrict a, double const *restrict s,
+                         int ibeg, int iend, double dt) {
+  int i;
+  for (i = ibeg; i <= iend; i++)
+    a[i] += s[i]*dt;
+}
+
+// rhs = b + source*dt (source can be NULL)
+static void RhsRow(double *restrict rhs, double const *restrict b,
+                   double const *restrict source, int ibeg, int iend, double dt) {
+  int i;
+  if (source != NULL) {
+    for (i = ibeg; i <= iend; i++)
+      rhs[i] = b[i] + source[i]*dt;
+  } else {
+    for (i = ibeg; i <= iend; i++)
+      rhs[i] = b[i];
+  }
+}
+
+// Explicit update: v = rhs + dt*C_1*(Hp*(b[i+1]-b[i]) - Hm*(b[i]-b[i-1]))
+static void ExplicitRow(double *restrict v, double const *restrict rhs,
+                        double const *restrict b, double const *restrict Hp,
+                        double const *restrict Hm, double const *restrict C_1,
+                        int ibeg, int iend, double dt) {
+  int i;
+  for (i = ibeg; i <= iend; i++)
+    v[i] = rhs[i] + dt*C_1[i] * (b[i+1]*Hp[i] - b[i]*(Hp[i]+Hm[i]) + b[i-1]*Hm[i]);
+}
+
 /****************************************************************************
 Performs an implicit update of a diffusive problem (either for B or for T).
 It also applies the bcs on the ghost cells of the output matrix (**v) (useful later
 for instance for ResEnergyIncrease())
+The (optional) source is added explicitly, while the (optional) sink is a linear
+implicit term: the equation solved is dv/dt = div(H grad(v))/C + source - sink*v,
+with C_1 = 1/C (as in BuildIJ, see adi.h)
 *****************************************************************************/
-void ImplicitUpdate (double **v, double **b, double **source,
-                     double **Hp, double **Hm, double **C,
+void ImplicitUpdate (double **v, double **b, double **source, double **sink,
+                     double **Hp, double **Hm, double **C_1,
                      Lines *lines, Bcs *lbound, Bcs *rbound,
                      int compute_inflow, double *inflow, Grid *grid,
                      double dt, int dir) {
@@ -36,13 +91,14 @@ void ImplicitUpdate (double **v, double **b, double **source,
   // const int zero=0;
   int i,j;
   static int first_call = 1;
-  int Nlines = lines->N;
   int ridx, lidx, l;
   /* I allocate these as big as if I had to cover the whole domain, so that I
    don't need to reallocate at every domain line that I update */
   static double *diagonal, *upper, *lower, *rhs, *x;
   double *dz, *rR, *rL;
   double vol_lidx, vol_ridx;
+  // Raw rows of the fields (dir==IDIR), the loops on them are done by the *Row() kernels
+  double *vj, *bj, *Cj_1, *Hpj, *Hmj;
 
   if (first_call) {
     diagonal = ARRAY_1D(MAX(NX1_TOT, NX2_TOT), double);
@@ -51,7 +107,6 @@ void ImplicitUpdate (double **v, double **b, double **source,
     lower = ARRAY_1D(MAX(NX1_TOT, NX2_TOT), double);
     x = ARRAY_1D(MAX(NX1_TOT, NX2_TOT), double);
   }
-
   rR = grid[IDIR].xr_glob;
   rL = grid[IDIR].xl_glob;
   dz = grid[JDIR].dx_glob;
@@ -61,53 +116,53 @@ void ImplicitUpdate (double **v, double **b, double **source,
   * Case direction IDIR
   *********************/
 
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       j = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
-
-      upper[lidx] = -dt/C[j][lidx]*Hp[j][lidx];
-      lower[ridx] = -dt/C[j][ridx]*Hm[j][ridx];
-      rhs[lidx] = b[j][lidx];
-      rhs[ridx] = b[j][ridx];
-      for (i = lidx+1; i < ridx; i++) {
-        diagonal[i] = 1 + dt/C[j][i] * (Hp[j][i]+Hm[j][i]);
-        rhs[i] = b[j][i];
-        upper[i] = -dt/C[j][i]*Hp[j][i];
-        lower[i] = -dt/C[j][i]*Hm[j][i];
-      }
+      vj = FIELD_ROW(v, j);
+      bj = FIELD_ROW(b, j);
+      Cj_1 = FIELD_ROW(C_1, j);
+      Hpj = FIELD_ROW(Hp, j);
+      Hmj = FIELD_ROW(Hm, j);
+
+      upper[lidx] = -dt*Cj_1[lidx]*Hpj[lidx];
+      lower[ridx] = -dt*Cj_1[ridx]*Hmj[ridx];
+      rhs[lidx] = bj[lidx];
+      rhs[ridx] = bj[ridx];
+      AssembleRow(diagonal, upper, lower, rhs, bj, Cj_1, Hpj, Hmj, lidx+1, ridx-1, dt);
       /* I include the effect of the source */
-      if (source != NULL) {
-        for (i = lidx; i <= ridx; i++)
-          rhs[i] += source[j][i]*dt;
-      }
+      if (source != NULL)
+        AddScaledRow(rhs, FIELD_ROW(source, j), lidx, ridx, dt);
       // I set the Bcs for left boundary
       if (lbound[l].kind == DIRICHLET){
-        diagonal[lidx] = 1 + dt/C[j][lidx]*(Hp[j][lidx]+2*Hm[j][lidx]);
-        rhs[lidx] += dt/C[j][lidx]*Hm[j][lidx]*2*lbound[l].values[0];
+        diagonal[lidx] = 1 + dt*Cj_1[lidx]*(Hpj[lidx]+2*Hmj[lidx]);
+        rhs[lidx] += dt*Cj_1[lidx]*Hmj[lidx]*2*lbound[l].values[0];
       } else if (lbound[l].kind == NEUMANN_HOM) {
-        diagonal[lidx] = 1 + dt/C[j][lidx]*Hp[j][lidx];
+        diagonal[lidx] = 1 + dt*Cj_1[lidx]*Hpj[lidx];
       } else {
         print1("\n[ImplicitUpdate]Error setting left bc (in dir i), not known bc kind!");
         QUIT_PLUTO(1);
       }
       // I set the Bcs for right boundary
       if (rbound[l].kind == DIRICHLET){
-        diagonal[ridx] = 1 + dt/C[j][ridx]*(2*Hp[j][ridx]+Hm[j][ridx]);
-        rhs[ridx] += dt/C[j][ridx]*Hp[j][ridx]*2*rbound[l].values[0];
+        diagonal[ridx] = 1 + dt*Cj_1[ridx]*(2*Hpj[ridx]+Hmj[ridx]);
+        rhs[ridx] += dt*Cj_1[ridx]*Hpj[ridx]*2*rbound[l].values[0];
       } else if (rbound[l].kind == NEUMANN_HOM) {
-        diagonal[ridx] = 1 + dt/C[j][ridx]*Hm[j][ridx];
+        diagonal[ridx] = 1 + dt*Cj_1[ridx]*Hmj[ridx];
       } else {
         print1("\n[ImplicitUpdate]Error setting right bc (in dir i), not known bc kind!");
         QUIT_PLUTO(1);
       }
+      /* I include the implicit (diagonal) sink */
+      if (sink != NULL)
+        AddScaledRow(diagonal, FIELD_ROW(sink, j), lidx, ridx, dt);
 
       /*---------------------------------------------------------------------*/
       /* --- Now I solve the system --- */
       tdm_solver( x+lidx, diagonal+lidx, upper+lidx, lower+lidx+1, rhs+lidx, ridx-lidx+1);
       /*[Opt] Is this for a waste of time? maybe I could engineer better the use of tdm_solver function(or the way it is written)*/
-      for (i=lidx; i<=ridx; i++)
-        v[j][i] = x[i];
+      CopyRow(vj, x, lidx, ridx);
 
       /*---------------------------------------------------------------------*/
       /*--- I set the boundary values (ghost cells) in the solution
@@ -115,16 +170,16 @@ void ImplicitUpdate (double **v, double **b, double **source,
       // Cells near left boundary
       if (lbound[l].kind == DIRICHLET){
         // I assign the ghost value (needed by ResEnergyIncrease and maybe others..)
-        v[j][lidx-1] = 2*lbound[l].values[0] - b[j][lidx];
+        vj[lidx-1] = 2*lbound[l].values[0] - bj[lidx];
         if (compute_inflow) {
           /*--- I compute the inflow ---*/
           // I am not sure this "2" in front of pi is ok
-          *inflow += (v[j][lidx-1]-v[j][lidx]) * Hm[j][lidx] * 2*CONST_PI*dz[j] * dt;
+          *inflow += (vj[lidx-1]-vj[lidx]) * Hmj[lidx] * 2*CONST_PI*dz[j] * dt;
         }
 
       } else if (lbound[l].kind == NEUMANN_HOM) {
         /* I assign the ghost value (needed by ResEnergyIncrease and maybe others..).*/
-        v[j][lidx-1] = v[j][lidx];
+        vj[lidx-1] = vj[lidx];
         if (compute_inflow) {
           /*--- I compute the inflow (0!!!)---*/
           *inflow += 0;
@@ -137,14 +192,14 @@ void ImplicitUpdate (double **v, double **b, double **source,
 
       // Cells near right boundary
       if (rbound[l].kind == DIRICHLET){
-        v[j][ridx+1] = 2*rbound[l].values[0] - v[j][ridx];
+        vj[ridx+1] = 2*rbound[l].values[0] - vj[ridx];
         if (compute_inflow) {
           /*--- I compute the inflow ---*/
-          *inflow += (v[j][ridx+1]-v[j][ridx]) * Hp[j][ridx] * 2*CONST_PI*dz[j] * dt;
+          *inflow += (vj[ridx+1]-vj[ridx]) * Hpj[ridx] * 2*CONST_PI*dz[j] * dt;
         }
 
       } else if (rbound[l].kind == NEUMANN_HOM) {
-        v[j][ridx+1] = v[j][ridx];
+        vj[ridx+1] = vj[ridx];
         if (compute_inflow) {
           /*--- I compute the inflow (0!!!)---*/
           *inflow += 0;
@@ -160,20 +215,20 @@ void ImplicitUpdate (double **v, double **b, double **source,
     * Case direction JDIR
     *********************/
 
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       i = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
 
-      upper[lidx] = -dt/C[lidx][i]*Hp[lidx][i];
-      lower[ridx] = -dt/C[ridx][i]*Hm[ridx][i];
+      upper[lidx] = -dt*C_1[lidx][i]*Hp[lidx][i];
+      lower[ridx] = -dt*C_1[ridx][i]*Hm[ridx][i];
       rhs[lidx] = b[lidx][i];
       rhs[ridx] = b[ridx][i];
       for (j = lidx+1; j < ridx; j++) {
-        diagonal[j] = 1 + dt/C[j][i] * (Hp[j][i]+Hm[j][i]);
+        diagonal[j] = 1 + dt*C_1[j][i] * (Hp[j][i]+Hm[j][i]);
         rhs[j] = b[j][i];
-        upper[j] = -dt/C[j][i]*Hp[j][i];
-        lower[j] = -dt/C[j][i]*Hm[j][i];
+        upper[j] = -dt*C_1[j][i]*Hp[j][i];
+        lower[j] = -dt*C_1[j][i]*Hm[j][i];
       }
       /* I include the effect of the source */
       if (source != NULL) {
@@ -182,24 +237,29 @@ void ImplicitUpdate (double **v, double **b, double **source,
       }
       // I set the Bcs for left boundary
       if (lbound[l].kind == DIRICHLET){
-        diagonal[lidx] = 1 + dt/C[lidx][i]*(Hp[lidx][i]+2*Hm[lidx][i]);
-        rhs[lidx] += dt/C[lidx][i]*Hm[lidx][i]*2*lbound[l].values[0];
+        diagonal[lidx] = 1 + dt*C_1[lidx][i]*(Hp[lidx][i]+2*Hm[lidx][i]);
+        rhs[lidx] += dt*C_1[lidx][i]*Hm[lidx][i]*2*lbound[l].values[0];
       } else if (lbound[l].kind == NEUMANN_HOM) {
-        diagonal[lidx] = 1 + dt/C[lidx][i]*Hp[lidx][i];
+        diagonal[lidx] = 1 + dt*C_1[lidx][i]*Hp[lidx][i];
       } else {
         print1("\n[ImplicitUpdate]Error setting left bc (in dir j), not known bc kind!");
         QUIT_PLUTO(1);
       }
       // I set the Bcs for right boundary
       if (rbound[l].kind == DIRICHLET){
-        diagonal[ridx] = 1 + dt/C[ridx][i]*(2*Hp[ridx][i]+Hm[ridx][i]);
-        rhs[ridx] += dt/C[ridx][i]*Hp[ridx][i]*2*rbound[l].values[0];
+        diagonal[ridx] = 1 + dt*C_1[ridx][i]*(2*Hp[ridx][i]+Hm[ridx][i]);
+        rhs[ridx] += dt*C_1[ridx][i]*Hp[ridx][i]*2*rbound[l].values[0];
       } else if (rbound[l].kind == NEUMANN_HOM) {
-        diagonal[ridx] = 1 + dt/C[ridx][i]*Hm[ridx][i];
+        diagonal[ridx] = 1 + dt*C_1[ridx][i]*Hm[ridx][i];
       } else {
         print1("\n[ImplicitUpdate]Error setting right bcs (in dir j), not known bc kind!");
         QUIT_PLUTO(1);
       }
+      /* I include the implicit (diagonal) sink */
+      if (sink != NULL) {
+        for (j = lidx; j <= ridx; j++)
+          diagonal[j] += sink[j][i]*dt;
+      }
 
       /*---------------------------------------------------------------------*/
       /* --- Now I solve the system --- */
@@ -266,21 +326,22 @@ It also applies the bcs on the ghost cells of the input matrix (**b) (useful lat
 for instance for ResEnergyIncrease())
 *****************************************************************************/
 void ExplicitUpdate (double **v, double **b, double **source,
-                     double **Hp, double **Hm, double **C,
+                     double **Hp, double **Hm, double **C_1,
                      Lines *lines, Bcs *lbound, Bcs *rbound,
                      int compute_inflow, double *inflow, Grid *grid,
                      double dt, int dir) {
   int i,j,l;
   int ridx, lidx;
-  int Nlines = lines->N;
   double *rR, *rL;
   double *dz;
   double vol_lidx, vol_ridx;
   static double **rhs;
   static int first_call = 1;
+  // Raw rows of the fields (dir==IDIR), the loops on them are done by the *Row() kernels
+  double *vj, *rhsj, *bj, *Cj_1, *Hpj, *Hmj;
 
   if (first_call) {
-    rhs = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    rhs = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     first_call = 0;
   }
 
@@ -293,40 +354,40 @@ void ExplicitUpdate (double **v, double **b, double **source,
     * Case direction IDIR
     *********************/
 
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       j = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
-
-      if (source != NULL) {
-        for (i = lidx; i <= ridx; i++)
-          rhs[j][i] = b[j][i] + source[j][i]*dt;
-      } else {
-        /*[Opt] Maybe I could assign directly the address. BE CAREFUL:
-        if I assign the address, then I have to recover the old address of rhs (by saving temporarly the old rhs address
-        inside another variable), otherwise
-        at the next call of this function I will write over the memory of the old b*/
-        for (i = lidx; i <= ridx; i++)
-          rhs[j][i] = b[j][i];
-      }
+      vj = FIELD_ROW(v, j);
+      rhsj = FIELD_ROW(rhs, j);
+      Cj_1 = FIELD_ROW(C_1, j);
+      Hpj = FIELD_ROW(Hp, j);
+      Hmj = FIELD_ROW(Hm, j);
+      bj = FIELD_ROW(b, j);
+
+      /*[Opt] Maybe I could assign directly the address (when source == NULL). BE CAREFUL:
+      if I assign the address, then I have to recover the old address of rhs (by saving temporarly the old rhs address
+      inside another variable), otherwise
+      at the next call of this function I will write over the memory of the old b*/
+      RhsRow(rhsj, bj, source != NULL ? FIELD_ROW(source, j) : NULL, lidx, ridx, dt);
 
       /*--- I set the boundary values (ghost cells) ---*/
       // Cells near left boundary
       if (lbound[l].kind == DIRICHLET){
         // I assign the ghost value (needed by ResEnergyIncrease and maybe others..)
         // [Err] decomment next line
-        b[j][lidx-1] = 2*lbound[l].values[0] - b[j][lidx];
+        bj[lidx-1] = 2*lbound[l].values[0] - bj[lidx];
         //[Err] Experimental: 2nd order accurate bc for cell centered FD (as explained in L.Chen draft on FDM)
-        // b[j][lidx-1] = 1/3*b[j][lidx+1] + 8/3*lbound[l].values[0] - 2*b[j][lidx];
+        // bj[lidx-1] = 1/3*bj[lidx+1] + 8/3*lbound[l].values[0] - 2*bj[lidx];
         if (compute_inflow) {
           /*--- I compute the inflow ---*/
           // I am not sure this "2" in front of pi is ok
-          *inflow += (b[j][lidx-1]-b[j][lidx]) * Hm[j][lidx] * 2*CONST_PI*dz[j] * dt;
+          *inflow += (bj[lidx-1]-bj[lidx]) * Hmj[lidx] * 2*CONST_PI*dz[j] * dt;
         }
 
       } else if (lbound[l].kind == NEUMANN_HOM) {
         /* I assign the ghost value (needed by ResEnergyIncrease and maybe others..).*/
-        b[j][lidx-1] = b[j][lidx];
+        bj[lidx-1] = bj[lidx];
         if (compute_inflow) {
           /*--- I compute the inflow (0!!!)---*/
           *inflow += 0;
@@ -339,16 +400,16 @@ void ExplicitUpdate (double **v, double **b, double **source,
       // Cells near right boundary
       if (rbound[l].kind == DIRICHLET){
         // [Err] decomment next line
-        b[j][ridx+1] = 2*rbound[l].values[0] - b[j][ridx];
+        bj[ridx+1] = 2*rbound[l].values[0] - bj[ridx];
         //[Err] Experimental: 2nd order accurate bc for cell centered FD (as explained in L.Chen draft on FDM)
-        // b[j][ridx+1] = 1/3*b[j][ridx-1] + 8/3*rbound[l].values[0] - 2*b[j][ridx];
+        // bj[ridx+1] = 1/3*bj[ridx-1] + 8/3*rbound[l].values[0] - 2*bj[ridx];
         if (compute_inflow) {
           /*--- I compute the inflow ---*/
-          *inflow += (b[j][ridx+1]-b[j][ridx]) * Hp[j][ridx] * 2*CONST_PI*dz[j] * dt;
+          *inflow += (bj[ridx+1]-bj[ridx]) * Hpj[ridx] * 2*CONST_PI*dz[j] * dt;
         }
 
       } else if (rbound[l].kind == NEUMANN_HOM) {
-        b[j][ridx+1] = b[j][ridx];
+        bj[ridx+1] = bj[ridx];
         if (compute_inflow) {
           /*--- I compute the inflow (0!!!)---*/
           *inflow += 0;
@@ -360,8 +421,7 @@ void ExplicitUpdate (double **v, double **b, double **source,
       }
 
       /*--- Actual update ---*/
-      for (i = lidx; i <= ridx; i++)
-        v[j][i] = rhs[j][i] + dt/C[j][i] * (b[j][i+1]*Hp[j][i] - b[j][i]*(Hp[j][i]+Hm[j][i]) + b[j][i-1]*Hm[j][i]);
+      ExplicitRow(vj, rhsj, bj, Hpj, Hmj, Cj_1, lidx, ridx, dt);
 
     }
   } else if (dir == JDIR) {
@@ -371,7 +431,7 @@ void ExplicitUpdate (double **v, double **b, double **source,
     rR = grid[IDIR].xr_glob;
     rL = grid[IDIR].xl_glob;
 
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       i = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
@@ -437,7 +497,7 @@ void ExplicitUpdate (double **v, double **b, double **source,
 
       /*--- Actual update ---*/
       for (j = lidx; j <= ridx; j++){
-        v[j][i] = rhs[j][i] + dt/C[j][i] * (b[j+1][i]*Hp[j][i] - b[j][i]*(Hp[j][i]+Hm[j][i]) + b[j-1][i]*Hm[j][i]);
+        v[j][i] = rhs[j][i] + dt*C_1[j][i] * (b[j+1][i]*Hp[j][i] - b[j][i]*(Hp[j][i]+Hm[j][i]) + b[j-1][i]*Hm[j][i]);
         // print1("v[%d][%d]=%e\n", j,i,v[j][i]);
       }
     }
@@ -458,21 +518,22 @@ It also applies the bcs on the ghost cells of the input matrix (**b) (useful lat
 for instance for ResEnergyIncrease())
 *****************************************************************************/
 void ExplicitUpdateDR (double **v, double **b, double **b_der, double **source,
-                       double **Hp, double **Hm, double **C,
+                       double **Hp, double **Hm, double **C_1,
                        Lines *lines,
                        int compute_inflow, double *inflow, Grid *grid,
                        double dt, int dir) {
   int i,j,l;
   int ridx, lidx;
-  int Nlines = lines->N;
   double *rR, *rL;
   double *dz;
   static double **rhs;
   static int first_call = 1;
   double vol_lidx, vol_ridx;
+  // Raw rows of the fields (dir==IDIR), the loops on them are done by the *Row() kernels
+  double *vj, *rhsj, *bj, *b_derj, *Cj_1, *Hpj, *Hmj;
 
   if (first_call) {
-    rhs = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    rhs = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     first_call = 0;
   }
 
@@ -485,41 +546,41 @@ void ExplicitUpdateDR (double **v, double **b, double **b_der, double **source,
     * Case direction IDIR
     *********************/
 
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       j = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
-
-      if (source != NULL) {
-        for (i = lidx; i <= ridx; i++)
-          rhs[j][i] = b[j][i] + source[j][i]*dt;
-      } else {
-        /*[Opt] Maybe I could assign directly the address. BE CAREFUL:
-        if I assign the address, then I have to recover the old address of rhs (by saving temporarly the old rhs address
-        inside another variable), otherwise
-        at the next call of this function I will write over the memory of the old b*/
-        for (i = lidx; i <= ridx; i++)
-          rhs[j][i] = b[j][i];
-      }
+      vj = FIELD_ROW(v, j);
+      rhsj = FIELD_ROW(rhs, j);
+      Cj_1 = FIELD_ROW(C_1, j);
+      Hpj = FIELD_ROW(Hp, j);
+      Hmj = FIELD_ROW(Hm, j);
+      bj = FIELD_ROW(b, j);
+      b_derj = FIELD_ROW(b_der, j);
+
+      /*[Opt] Maybe I could assign directly the address (when source == NULL). BE CAREFUL:
+      if I assign the address, then I have to recover the old address of rhs (by saving temporarly the old rhs address
+      inside another variable), otherwise
+      at the next call of this function I will write over the memory of the old b*/
+      RhsRow(rhsj, bj, source != NULL ? FIELD_ROW(source, j) : NULL, lidx, ridx, dt);
 
       if (compute_inflow) {
         /*--- I compute the inflow ---*/
         // I am not sure this "2" in front of pi is ok
-        *inflow += (b_der[j][lidx-1]-b_der[j][lidx]) * Hm[j][lidx] * 2*CONST_PI*dz[j] * dt;
+        *inflow += (b_derj[lidx-1]-b_derj[lidx]) * Hmj[lidx] * 2*CONST_PI*dz[j] * dt;
         // Here the "2" in front of pi is ok
-        *inflow += (b_der[j][ridx+1]-b_der[j][ridx]) * Hp[j][ridx] * 2*CONST_PI*dz[j] * dt;
+        *inflow += (b_derj[ridx+1]-b_derj[ridx]) * Hpj[ridx] * 2*CONST_PI*dz[j] * dt;
       }
 
       /*--- Actual update ---*/
-      for (i = lidx; i <= ridx; i++)
-        v[j][i] = rhs[j][i] + dt/C[j][i] * (b_der[j][i+1]*Hp[j][i] - b_der[j][i]*(Hp[j][i]+Hm[j][i]) + b_der[j][i-1]*Hm[j][i]);
+      ExplicitRow(vj, rhsj, b_derj, Hpj, Hmj, Cj_1, lidx, ridx, dt);
     }
   } else if (dir == JDIR) {
     /********************
     * Case direction JDIR
     *********************/
 
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       i = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
@@ -545,7 +606,7 @@ void ExplicitUpdateDR (double **v, double **b, double **b_der, double **source,
 
       /*--- Actual update ---*/
       for (j = lidx; j <= ridx; j++){
-        v[j][i] = rhs[j][i] + dt/C[j][i] * (b_der[j+1][i]*Hp[j][i] - b_der[j][i]*(Hp[j][i]+Hm[j][i]) + b_der[j-1][i]*Hm[j][i]);
+        v[j][i] = rhs[j][i] + dt*C_1[j][i] * (b_der[j+1][i]*Hp[j][i] - b_der[j][i]*(Hp[j][i]+Hm[j][i]) + b_der[j-1][i]*Hm[j][i]);
         // print1("v[%d][%d]=%e\n", j,i,v[j][i]);
       }
     }
@@ -564,13 +625,12 @@ void ApplyBCsonGhosts(double **v, Lines *lines,
                       int dir) {
   int i,j,l;
   int ridx, lidx;
-  int Nlines = lines->N;
 
   if (dir == IDIR) {
     /********************
     * Case direction IDIR
     *********************/
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       j = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
@@ -607,7 +667,7 @@ void ApplyBCsonGhosts(double **v, Lines *lines,
     /********************
     * Case direction JDIR
     *********************/
-    for (l = 0; l < Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       i = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
@@ -675,6 +735,59 @@ void tdm_solver(double *x, double const *diagonal, double *up,
     x[i] = rhs[i] - up[i]*x[i+1];
 }
 
+/************************************************************
+ * Solve a linear system made by a block tridiagonal matrix with
+ * 2x2 blocks (same algorithm of tdm_solver(), with blocks instead of numbers).
+ * Blocks are stored row by row ({a11, a12, a21, a22}).
+ * BE CAREFUL: THIS FUNC. MODIFIES ITS INPUT (NOT ONLY X!)
+ *
+ * N: the number of blocks in diagonal (and of couples in x, rhs).
+ * lower[i]: block multiplying x[i] in row i+1
+ * x: solution
+ * *********************************************************/
+void btdm_solver(double (*x)[2], double (*diagonal)[4], double (*up)[4],
+                 double (*lower)[4], double (*rhs)[2], int const N) {
+  int i;
+  double m[4], minv[4], u[4], r[2];
+  double det;
+
+  for (i=0; i<N; i++) {
+    /* m = diagonal[i] - lower[i-1]*up[i-1], r = rhs[i] - lower[i-1]*rhs[i-1] */
+    if (i == 0) {
+      m[0] = diagonal[i][0]; m[1] = diagonal[i][1];
+      m[2] = diagonal[i][2]; m[3] = diagonal[i][3];
+      r[0] = rhs[i][0];      r[1] = rhs[i][1];
+    } else {
+      m[0] = diagonal[i][0] - (lower[i-1][0]*up[i-1][0] + lower[i-1][1]*up[i-1][2]);
+      m[1] = diagonal[i][1] - (lower[i-1][0]*up[i-1][1] + lower[i-1][1]*up[i-1][3]);
+      m[2] = diagonal[i][2] - (lower[i-1][2]*up[i-1][0] + lower[i-1][3]*up[i-1][2]);
+      m[3] = diagonal[i][3] - (lower[i-1][2]*up[i-1][1] + lower[i-1][3]*up[i-1][3]);
+      r[0] = rhs[i][0] - (lower[i-1][0]*rhs[i-1][0] + lower[i-1][1]*rhs[i-1][1]);
+      r[1] = rhs[i][1] - (lower[i-1][2]*rhs[i-1][0] + lower[i-1][3]*rhs[i-1][1]);
+    }
+    det = m[0]*m[3] - m[1]*m[2];
+    minv[0] =  m[3]/det;  minv[1] = -m[1]/det;
+    minv[2] = -m[2]/det;  minv[3] =  m[0]/det;
+
+    if (i < N-1) {
+      u[0] = up[i][0]; u[1] = up[i][1]; u[2] = up[i][2]; u[3] = up[i][3];
+      up[i][0] = minv[0]*u[0] + minv[1]*u[2];
+      up[i][1] = minv[0]*u[1] + minv[1]*u[3];
+      up[i][2] = minv[2]*u[0] + minv[3]*u[2];
+      up[i][3] = minv[2]*u[1] + minv[3]*u[3];
+    }
+    rhs[i][0] = minv[0]*r[0] + minv[1]*r[1];
+    rhs[i][1] = minv[2]*r[0] + minv[3]*r[1];
+  }
+
+  x[N-1][0] = rhs[N-1][0];
+  x[N-1][1] = rhs[N-1][1];
+  for (i=N-2; i>-1; i--) {
+    x[i][0] = rhs[i][0] - (up[i][0]*x[i+1][0] + up[i][1]*x[i+1][1]);
+    x[i][1] = rhs[i][1] - (up[i][2]*x[i+1][0] + up[i][3]*x[i+1][1]);
+  }
+}
+
 /* ***********************************************************
  * Modified Peachman-Rachford ADI method (I have no clue whether this
  * is docuemnted in literature and how accurate it is. I hope it is fine
@@ -717,21 +830,21 @@ void PeacemanRachfordMod(double **v_new, double **v_old,
   #endif
 
   if (first_call) {
-    v_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    v_old_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    v_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    v_old_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #if (JOULE_EFFECT_AND_MAG_ENG)
-      dUres_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      dUres_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
     #if (JOULE_EFFECT_AND_MAG_ENG && !POW_INSIDE_ADI)
-      Br_avg = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      dUres_aux1 = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      Br_avg = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      dUres_aux1 = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
-    Ip = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Im = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Jp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Jm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    CI = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    CJ = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    Ip = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Im = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Jp = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Jm = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    CI = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    CJ = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     first_call = 0;
   }
 
@@ -828,7 +941,7 @@ void PeacemanRachfordMod(double **v_new, double **v_old,
      (a.2) Implicit update sweeping DIR2
     **********************************/
     ApplyBCs(lines, d, grid, t_now + dts*(1-fract), dir2);
-    ImplicitUpdate (v_new, v_aux, NULL, H2p, H2m, C2, &lines[dir2],
+    ImplicitUpdate (v_new, v_aux, NULL, NULL, H2p, H2m, C2, &lines[dir2],
                       lines[dir2].lbound[diff], lines[dir2].rbound[diff],
                       (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                       (1-fract)*dts, dir2);
@@ -887,7 +1000,7 @@ void PeacemanRachfordMod(double **v_new, double **v_old,
      (b.2) Implicit update sweeping DIR1
     **********************************/
     ApplyBCs(lines, d, grid, t_now + dts, dir1);
-    ImplicitUpdate (v_new, v_aux, NULL, H1p, H1m, C1, &lines[dir1],
+    ImplicitUpdate (v_new, v_aux, NULL, NULL, H1p, H1m, C1, &lines[dir1],
                       lines[dir1].lbound[diff], lines[dir1].rbound[diff],
                       (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                       (1-fract)*dts, dir1);
@@ -950,6 +1063,23 @@ void PeacemanRachfordMod(double **v_new, double **v_old,
   }
 }
 
+#ifdef PARALLEL
+/* ***********************************************************
+ * Adds b to a on the own lines of direction dir (see adi_mpi.c)
+ * ***********************************************************/
+static void AddOnOwnLines(double **a, double **b, Lines *lines, int dir) {
+  int l, i, j;
+
+  if (dir == IDIR) {
+    OWN_LINES_LOOP(lines[IDIR], l, j, i)
+      a[j][i] += b[j][i];
+  } else {
+    OWN_LINES_LOOP(lines[JDIR], l, i, j)
+      a[j][i] += b[j][i];
+  }
+}
+#endif
+
 /* ***********************************************************
  * Douglas-Rachford ADI method
  *
@@ -975,6 +1105,14 @@ void DouglasRachford (double **v_new, double **v_old,
   #if THERMAL_CONDUCTION==ALTERNATING_DIRECTION_IMPLICIT
     static double **IpT, **ImT, **CIT, **JpT, **JmT, **CJT;
   #endif
+  #if RAD_LOSS_ADI
+    static double **rad_src, **rad_sink; // linearized radiative loss (only for TDIFF)
+  #endif
+  double **src1 = NULL, **sink1 = NULL;
+  #if VISCOSITY_ADI
+    static double **IpVr, **ImVr, **CIVr, **JpVr, **JmVr, **CJVr;
+    static double **IpVz, **ImVz, **CIVz, **JpVz, **JmVz, **CJVz;
+  #endif
   static int first_call = 1;
   double **H1p, **H1m, **H2p, **H2m, **C1, **C2;
   // void (*BoundaryADI) (Lines, const Data, Grid, double);
@@ -986,38 +1124,93 @@ void DouglasRachford (double **v_new, double **v_old,
   #if (JOULE_EFFECT_AND_MAG_ENG)
     static double **dUres_aux; // auxiliary vector containing a contribution to ohmic heating
   #endif
+  int async_taken = 0; // Tells whether the operators have been built by the helper thread
+  /* Lines of the point-wise work and grid of the sweeps: in parallel the local lines and
+     the global grid (the sweeps are done on the own lines, in global indexes, see adi_mpi.c) */
+  Lines *lines_pw = lines;
+  Grid *grid_sw = grid;
+  double **dEdT_sw = dEdT;
+  #ifdef PARALLEL
+    static double **blk_aux[3]; // Work fields on the local block
+    #if (JOULE_EFFECT_AND_MAG_ENG)
+      static double **dUres_lines[2]; // Power of the sweeps along IDIR and JDIR, on their own lines
+    #endif
+    #if RAD_LOSS_ADI && EN_CONS_CHECK
+      static double **dEdT_lines;
+    #endif
+    #if RAD_LOSS_ADI
+      double **rad_lines[2];
+    #endif
+  #endif
 
   /*
   print1("\nAttenzione al calcolo dell'energia che entra dai bordi per conduzione/elettromagnetica:\n");
   print1("\npotrebbe essere che sia sbagliata per come ho implmentato lo schema D-R (e per l'uso di variabili globali)\n");
   */
   if (first_call) {
-    v_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    v_hat = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    v_old_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    #ifdef PARALLEL
+      // The fields of the sweeps are indexed as the global domain
+      SetGlobalIndexesADI(grid);
+    #endif
+    v_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    v_hat = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    v_old_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #if (JOULE_EFFECT_AND_MAG_ENG)
-      dUres_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      dUres_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    #endif
+    #if RAD_LOSS_ADI
+      rad_src = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      rad_sink = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    #endif
+    #ifdef PARALLEL
+      #if (JOULE_EFFECT_AND_MAG_ENG)
+        dUres_lines[IDIR] = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+        dUres_lines[JDIR] = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      #endif
+      #if RAD_LOSS_ADI && EN_CONS_CHECK
+        dEdT_lines = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      #endif
+      SetLocalIndexesADI();
+      for (s = 0; s < 3; s++) blk_aux[s] = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
 
     #if RESISTIVITY==ALTERNATING_DIRECTION_IMPLICIT
-      IpB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      ImB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      JpB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      JmB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      CIB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      CJB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      IpB = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      ImB = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JpB = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JmB = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CIB = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CJB = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
     #if THERMAL_CONDUCTION==ALTERNATING_DIRECTION_IMPLICIT
-      IpT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      ImT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      JpT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      JmT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      CIT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      CJT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      IpT = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      ImT = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JpT = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JmT = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CIT = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CJT = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    #endif
+    #if VISCOSITY_ADI
+      IpVr = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      ImVr = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JpVr = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JmVr = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CIVr = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CJVr = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      IpVz = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      ImVz = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JpVz = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      JmVz = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CIVz = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CJVz = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
 
     first_call = 0;
   }
+  #ifdef PARALLEL
+    lines_pw = LocalLinesADI();
+    grid_sw = GlobalGridADI(grid);
+  #endif
 
   // /* Set the direction order*/
   // if (order == FIRST_IDIR) {
@@ -1033,6 +1226,33 @@ void DouglasRachford (double **v_new, double **v_old,
   //   dir1 = JDIR;  dir2 = IDIR;
   // }
 
+  #if ASYNC_OP_REBUILD
+    /* If the helper thread has rebuilt the operators (see adi_async.c) I swap them in,
+       before setting the H and C pointers */
+    if (recompute_operators) {
+      switch(diff) {
+        #if RESISTIVITY==ALTERNATING_DIRECTION_IMPLICIT
+          case BDIFF:
+            async_taken = TakeRebuiltOperatorsADI(BDIFF, &IpB, &ImB, &JpB, &JmB, &CIB, &CJB, NULL);
+            break;
+        #endif
+        #if THERMAL_CONDUCTION==ALTERNATING_DIRECTION_IMPLICIT
+          case TDIFF:
+            async_taken = TakeRebuiltOperatorsADI(TDIFF, &IpT, &ImT, &JpT, &JmT, &CIT, &CJT, dEdT);
+            break;
+        #endif
+        #if VISCOSITY_ADI
+          case VRDIFF:
+            async_taken = TakeRebuiltOperatorsADI(VRDIFF, &IpVr, &ImVr, &JpVr, &JmVr, &CIVr, &CJVr, NULL);
+            break;
+          case VZDIFF:
+            async_taken = TakeRebuiltOperatorsADI(VZDIFF, &IpVz, &ImVz, &JpVz, &JmVz, &CIVz, &CJVz, NULL);
+            break;
+        #endif
+      }
+    }
+  #endif
+
     /* Set the direction order and diffusion parameters/operators*/
   if (order == FIRST_IDIR) {
     dir1 = IDIR;  dir2 = JDIR;
@@ -1051,6 +1271,18 @@ void DouglasRachford (double **v_new, double **v_old,
           C1 = CIT;      C2 = CJT;
           break;
       #endif
+      #if VISCOSITY_ADI
+        case VRDIFF:
+          H1p = IpVr;    H1m = ImVr;
+          H2p = JpVr;    H2m = JmVr;
+          C1 = CIVr;     C2 = CJVr;
+          break;
+        case VZDIFF:
+          H1p = IpVz;    H1m = ImVz;
+          H2p = JpVz;    H2m = JmVz;
+          C1 = CIVz;     C2 = CJVz;
+          break;
+      #endif
     }
   } else if (order == FIRST_JDIR) {
     dir1 = JDIR;  dir2 = IDIR;
@@ -1065,11 +1297,23 @@ void DouglasRachford (double **v_new, double **v_old,
       #endif
       #if THERMAL_CONDUCTION==ALTERNATING_DIRECTION_IMPLICIT
         case TDIFF:
-          H1p = JpB;     H1m = JmB;
-          H2p = IpB;     H2m = ImB;
-          C1 = CJB;      C2 = CIB;
+          H1p = JpT;     H1m = JmT;
+          H2p = IpT;     H2m = ImT;
+          C1 = CJT;      C2 = CIT;
           break;
       #endif 
+      #if VISCOSITY_ADI
+        case VRDIFF:
+          H1p = JpVr;    H1m = JmVr;
+          H2p = IpVr;    H2m = ImVr;
+          C1 = CJVr;     C2 = CIVr;
+          break;
+        case VZDIFF:
+          H1p = JpVz;    H1m = JmVz;
+          H2p = IpVz;    H2m = ImVz;
+          C1 = CJVz;     C2 = CIVz;
+          break;
+      #endif
     }
   }
 
@@ -1084,6 +1328,12 @@ void DouglasRachford (double **v_new, double **v_old,
         ApplyBCs = BoundaryADI_TC;
         break;
     #endif
+    #if VISCOSITY_ADI
+      case VRDIFF:
+      case VZDIFF:
+        ApplyBCs = BoundaryADI_Visc;
+        break;
+    #endif
     default:
       print1("\n[PeachmanRachford]Wrong setting for diffusion (diff) problem");
       QUIT_PLUTO(1);
@@ -1091,8 +1341,14 @@ void DouglasRachford (double **v_new, double **v_old,
   }
 
   // I copy v_old inside v_old_aux, as I cannot use directly v_old in the cycle, it will be modified!
-  LINES_LOOP(lines[IDIR], l, j, i)
-    v_old_aux[j][i] = v_old[j][i];
+  #ifdef PARALLEL
+    // (on the own lines of both the directions)
+    ExchangeLinesADI(&v_old, ADI_BLOCK, &v_old_aux, dir1, 1);
+    ExchangeLinesADI(&v_old, ADI_BLOCK, &v_old_aux, dir2, 1);
+  #else
+    LINES_LOOP(lines[IDIR], l, j, i)
+      v_old_aux[j][i] = v_old[j][i];
+  #endif
 
   // print1("\nI apply a Douglas-Rachford scheme for diff=%d (BDIFF=%d,TDIFF=%d)\n", diff, BDIFF, TDIFF);
   // print1(" -> I do %d calls to ImplicitUpdate() and %d calls to ExplicitUpdate()\n", 2*M,2*M);
@@ -1105,20 +1361,28 @@ void DouglasRachford (double **v_new, double **v_old,
   dts = dt/M;
   t_now = t0;
 
-  ApplyBCs(lines, d, grid, t_now, dir1);
-  ApplyBCs(lines, d, grid, t_now, dir2);
+  ApplyBCs(lines, d, grid_sw, t_now, dir1);
+  ApplyBCs(lines, d, grid_sw, t_now, dir2);
 
-  if (recompute_operators){
+  if (recompute_operators && !async_taken){
     // print1("I update diff operators (diff=%d, BDIFF=%d, TDIFF=%d)", diff, BDIFF, TDIFF);
     switch(diff) {
       #if RESISTIVITY==ALTERNATING_DIRECTION_IMPLICIT
         case BDIFF:
-          BuildIJ_Res(d, grid, lines, IpB, ImB, JpB, JmB, CIB, CJB, dEdT);
+          BuildIJ_Res(d, grid, lines_pw, IpB, ImB, JpB, JmB, CIB, CJB, dEdT);
           break;
       #endif
       #if THERMAL_CONDUCTION==ALTERNATING_DIRECTION_IMPLICIT
         case TDIFF:
-          BuildIJ_TC(d, grid, lines, IpT, ImT, JpT, JmT, CIT, CJT, dEdT);
+          BuildIJ_TC(d, grid, lines_pw, IpT, ImT, JpT, JmT, CIT, CJT, dEdT);
+          break;
+      #endif
+      #if VISCOSITY_ADI
+        case VRDIFF:
+          BuildIJ_ViscR(d, grid, lines_pw, IpVr, ImVr, JpVr, JmVr, CIVr, CJVr, NULL);
+          break;
+        case VZDIFF:
+          BuildIJ_ViscZ(d, grid, lines_pw, IpVz, ImVz, JpVz, JmVz, CIVz, CJVz, NULL);
           break;
       #endif
     }
@@ -1126,30 +1390,70 @@ void DouglasRachford (double **v_new, double **v_old,
   // } else {
   //   print1("I DO NOT update diff operators (diff=%d, BDIFF=%d, TDIFF=%d)", diff, BDIFF, TDIFF);
   // }
+  #ifdef PARALLEL
+    // The operators have been built on the block, the sweeps use them on the own lines
+    SetGlobalIndexesADI(grid);
+    OperatorsOnLinesADI(diff, dir1, recompute_operators, &H1p, &H1m, &C1, &H2p, &H2m, &C2);
+    SetLocalIndexesADI();
+    #if RAD_LOSS_ADI && EN_CONS_CHECK
+      if (diff == TDIFF) {
+        ExchangeLinesADI(&dEdT, ADI_BLOCK, &dEdT_lines, IDIR, 1);
+        dEdT_sw = dEdT_lines;
+      }
+    #endif
+  #endif
 
   #if (JOULE_EFFECT_AND_MAG_ENG && POW_INSIDE_ADI)
       if (diff == BDIFF) {
-        LINES_LOOP(lines[IDIR], l, j, i)
+        LINES_LOOP(lines_pw[IDIR], l, j, i)
           dUres[j][i] = 0.0;
+        #ifdef PARALLEL
+          OWN_LINES_LOOP(lines[IDIR], l, j, i) dUres_lines[IDIR][j][i] = 0.0;
+          OWN_LINES_LOOP(lines[JDIR], l, i, j) dUres_lines[JDIR][j][i] = 0.0;
+        #endif
       }
   #endif
 
   for (s=0; s<M; s++) {
+    #if RAD_LOSS_ADI
+      /* The radiative loss is Lie-split from the diffusion: it is advanced (backward Euler,
+         linearized around the T at the start of the sub-step) only in the last implicit sweep */
+      if (diff == TDIFF) {
+        #ifdef PARALLEL
+          // I compute it on the block, and it is used on the own lines of dir1
+          ExchangeLinesADI(&v_old_aux, dir1, blk_aux, ADI_BLOCK, 1);
+          BuildRadLossTC(d, lines_pw, blk_aux[0], dEdT, blk_aux[1], blk_aux[2]);
+          rad_lines[0] = rad_src;
+          rad_lines[1] = rad_sink;
+          ExchangeLinesADI(blk_aux+1, ADI_BLOCK, rad_lines, dir1, 2);
+        #else
+          BuildRadLossTC(d, lines, v_old_aux, dEdT, rad_src, rad_sink);
+        #endif
+        src1 = rad_src;
+        sink1 = rad_sink;
+      }
+    #endif
 
-    ApplyBCs(lines, d, grid, t_now, dir1);
+    #ifdef PARALLEL
+      SetGlobalIndexesADI(grid);
+    #endif
+    ApplyBCs(lines, d, grid_sw, t_now, dir1);
     /**********************************
      (a.1) Explicit update sweeping DIR1
     **********************************/
     ExplicitUpdate (v_aux, v_old_aux, NULL, H1p, H1m, C1, &lines[dir1],
                     lines[dir1].lbound[diff], lines[dir1].rbound[diff],
-                    0, NULL, grid,
+                    0, NULL, grid_sw,
                     dts, dir1);
     // [Err] decomment next lines
     // I apply the BCs at t0 for later (if I do it later, I will need to call ApplyBCs() once more)
-    ApplyBCs(lines, d, grid, t_now, dir2);
+    ApplyBCs(lines, d, grid_sw, t_now, dir2);
     ApplyBCsonGhosts (v_old_aux, &lines[dir2],
                       lines[dir2].lbound[diff], lines[dir2].rbound[diff],
                       dir2);
+    #ifdef PARALLEL
+      SyncLinesADI(v_aux, dir1);
+    #endif
     #ifdef DEBUG_EMA
       printf("\ns = %d", s);
       printf("\nafter expl dir1:\n");
@@ -1170,11 +1474,11 @@ void DouglasRachford (double **v_new, double **v_old,
     /**********************************
      (a.2) Implicit update sweeping DIR2
     **********************************/
-    ApplyBCs(lines, d, grid, t_now + dts, dir2);
+    ApplyBCs(lines, d, grid_sw, t_now + dts, dir2);
     // I compute phi^ (and save it in v_hat)
-    ImplicitUpdate (v_hat, v_aux, NULL, H2p, H2m, C2, &lines[dir2],
+    ImplicitUpdate (v_hat, v_aux, NULL, NULL, H2p, H2m, C2, &lines[dir2],
                     lines[dir2].lbound[diff], lines[dir2].rbound[diff],
-                    0, NULL, grid,
+                    0, NULL, grid_sw,
                     dts, dir2);
     #ifdef DEBUG_EMA
       printf("\nafter impl dir2:\n");
@@ -1190,7 +1494,7 @@ void DouglasRachford (double **v_new, double **v_old,
     // I compute phi~ (and save it in v_aux)
     // Note: I have already set the BCs on v_old_aux in dir2!
     ExplicitUpdateDR (v_aux, v_old_aux, v_hat, NULL, H2p, H2m, C2, &lines[dir2],
-                      (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
+                      (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid_sw,
                       dts, dir2);
     #ifdef DEBUG_EMA
       printf("\nafter expl(DR) dir2:\n");
@@ -1202,13 +1506,16 @@ void DouglasRachford (double **v_new, double **v_old,
       printmat(v_aux, NX2_TOT, NX1_TOT);
     #endif
 
+    #ifdef PARALLEL
+      SyncLinesADI(v_aux, dir2);
+    #endif
     /**********************************
      (b.2) Implicit update sweeping DIR1
     **********************************/
-    ApplyBCs (lines, d, grid, t_now + dts, dir1);
-    ImplicitUpdate (v_old_aux, v_aux, NULL, H1p, H1m, C1, &lines[dir1],
+    ApplyBCs (lines, d, grid_sw, t_now + dts, dir1);
+    ImplicitUpdate (v_old_aux, v_aux, src1, sink1, H1p, H1m, C1, &lines[dir1],
                     lines[dir1].lbound[diff], lines[dir1].rbound[diff],
-                    (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
+                    (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid_sw,
                     dts, dir1);
     #ifdef DEBUG_EMA
       printf("\nafter impl dir1:\n");
@@ -1217,23 +1524,43 @@ void DouglasRachford (double **v_new, double **v_old,
       printf("\nv_old_aux(result)\n");
       printmat(v_old_aux, NX2_TOT, NX1_TOT);
     #endif
+    #ifdef PARALLEL
+      SyncLinesADI(v_old_aux, dir1);
+    #endif
+    #if RAD_LOSS_ADI && EN_CONS_CHECK
+      if (diff == TDIFF) {
+        /* Energy radiated in the sub-step (code units, > 0 for a loss): the implicit update
+           has done T += dts*(rad_src - rad_sink*T_new), and dEdT is per code unit of T */
+        OWN_LINES_LOOP(lines[IDIR], l, j, i)
+          en_rad_out += (rad_sink[j][i]*v_old_aux[j][i] - rad_src[j][i])*dEdT_sw[j][i]
+                        * 2*CONST_PI*grid_sw[IDIR].dV[i]*grid_sw[JDIR].dV[j] * dts;
+      }
+    #endif
     #if (JOULE_EFFECT_AND_MAG_ENG && POW_INSIDE_ADI)
       if (diff == BDIFF) {
         ApplyBCsonGhosts (v_old_aux, &lines[dir2],
                           lines[dir2].lbound[diff], lines[dir2].rbound[diff],
                           dir2);
+        #ifdef PARALLEL
+          // (ResEnergyIncrease() along dir1 reads them too, where they are shared)
+          SyncGhostsADI(v_old_aux, dir2);
+        #endif
 
-        ResEnergyIncreaseDR(dUres_aux, H2p, H2m, v_old_aux, v_hat, grid, &lines[dir2],
+        ResEnergyIncreaseDR(dUres_aux, H2p, H2m, v_old_aux, v_hat, grid_sw, &lines[dir2],
                             dts, dir2);
         #ifdef DEBUG_EMA
           printf("\nafter ResEnergyIncrease dir1");
           printf("\ndUres_aux\n");
           printmat(dUres_aux, NX2_TOT, NX1_TOT);
         #endif
-        LINES_LOOP(lines[IDIR], l, j, i)
-          dUres[j][i] += dUres_aux[j][i];
+        #ifdef PARALLEL
+          AddOnOwnLines(dUres_lines[dir2], dUres_aux, lines, dir2);
+        #else
+          LINES_LOOP(lines[IDIR], l, j, i)
+            dUres[j][i] += dUres_aux[j][i];
+        #endif
 
-        ResEnergyIncrease(dUres_aux, H1p, H1m, v_old_aux, grid, &lines[dir1],
+        ResEnergyIncrease(dUres_aux, H1p, H1m, v_old_aux, grid_sw, &lines[dir1],
                           EN_CONS_CHECK, &en_res_in,
                           dts, dir1);
 
@@ -1242,16 +1569,36 @@ void DouglasRachford (double **v_new, double **v_old,
           printf("\ndUres_aux\n");
           printmat(dUres_aux, NX2_TOT, NX1_TOT);
         #endif
-        LINES_LOOP(lines[IDIR], l, j, i)
-          dUres[j][i] += dUres_aux[j][i];
+        #ifdef PARALLEL
+          AddOnOwnLines(dUres_lines[dir1], dUres_aux, lines, dir1);
+        #else
+          LINES_LOOP(lines[IDIR], l, j, i)
+            dUres[j][i] += dUres_aux[j][i];
+        #endif
       }
     #endif
+    #ifdef PARALLEL
+      SetLocalIndexesADI();
+    #endif
 
     t_now += dts;
   }
 
-  LINES_LOOP(lines[IDIR], l, j, i)
-    v_new[j][i] = v_old_aux[j][i];
+  #if (JOULE_EFFECT_AND_MAG_ENG && POW_INSIDE_ADI) && defined(PARALLEL)
+    // The power of the sweeps of each direction is on their own lines: I bring both on the block
+    if (diff == BDIFF) {
+      ExchangeLinesADI(&dUres_lines[IDIR], IDIR, &dUres, ADI_BLOCK, 1);
+      ExchangeLinesADI(&dUres_lines[JDIR], JDIR, blk_aux, ADI_BLOCK, 1);
+      LINES_LOOP(lines_pw[IDIR], l, j, i)
+        dUres[j][i] += blk_aux[0][j][i];
+    }
+  #endif
+  #ifdef PARALLEL
+    ExchangeLinesADI(&v_old_aux, dir1, &v_new, ADI_BLOCK, 1);
+  #else
+    LINES_LOOP(lines[IDIR], l, j, i)
+      v_new[j][i] = v_old_aux[j][i];
+  #endif
 
   if (fabs((t_now-t0) - dt)/dt > DT_REL_TOLL) {
     print1("\nInaccurate dt, actual dt performed: %le, desired: %le\n", t_now-t0, dt);
@@ -1289,21 +1636,21 @@ void Strang(double **v_new, double **v_old,
   #endif
 
   if (first_call) {
-    v_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    v_hat = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    v_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    v_hat = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #if (JOULE_EFFECT_AND_MAG_ENG)
-      dUres_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      dUres_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
     #if (JOULE_EFFECT_AND_MAG_ENG && !POW_INSIDE_ADI)
-      Br_avg = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      dUres_aux1 = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      Br_avg = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      dUres_aux1 = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
-    Ip = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Im = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Jp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Jm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    CI = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    CJ = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    Ip = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Im = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Jp = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Jm = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    CI = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    CJ = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     first_call = 0;
   }
 
@@ -1370,7 +1717,7 @@ void Strang(double **v_new, double **v_old,
       (a) Implicit update sweeping DIR1
       **********************************/
       ApplyBCs(lines, d, grid, t_now+dt_now, dir1);
-      ImplicitUpdate (v_aux, v_new, NULL, H1p, H1m, C1, &lines[dir1],
+      ImplicitUpdate (v_aux, v_new, NULL, NULL, H1p, H1m, C1, &lines[dir1],
                         lines[dir1].lbound[diff], lines[dir1].rbound[diff],
                         (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                         dt_now, dir1);
@@ -1398,7 +1745,7 @@ void Strang(double **v_new, double **v_old,
        (b) Implicit update sweeping DIR2
       **********************************/
       ApplyBCs(lines, d, grid, t_now+dt_now, dir2);
-      ImplicitUpdate (v_new, v_aux, NULL, H2p, H2m, C2, &lines[dir2],
+      ImplicitUpdate (v_new, v_aux, NULL, NULL, H2p, H2m, C2, &lines[dir2],
                         lines[dir2].lbound[diff], lines[dir2].rbound[diff],
                         (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                         dt_now, dir2);
@@ -1469,16 +1816,16 @@ void FractionalTheta(double **v_new, double **v_old,
     }
 
     if (first_call) {
-      v_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      v_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
       #if (JOULE_EFFECT_AND_MAG_ENG && POW_INSIDE_ADI)
-        dUres_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+        dUres_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
       #endif
-      Ip = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      Im = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      Jp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      Jm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      CI = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-      CJ = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      Ip = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      Im = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      Jp = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      Jm = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CI = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+      CJ = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
       first_call = 0;
     }
 
@@ -1542,7 +1889,7 @@ void FractionalTheta(double **v_new, double **v_old,
      (a.2) Implicit update sweeping DIR2
     **********************************/
     ApplyBCs(lines, d, grid, t0 + theta*dt, dir2);
-    ImplicitUpdate (v_new, v_aux, NULL, H2p, H2m, C2, &lines[dir2],
+    ImplicitUpdate (v_new, v_aux, NULL, NULL, H2p, H2m, C2, &lines[dir2],
                       lines[dir2].lbound[diff], lines[dir2].rbound[diff],
                       (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                       theta*dt, dir2);
@@ -1581,7 +1928,7 @@ void FractionalTheta(double **v_new, double **v_old,
      (b.2) Implicit update sweeping DIR1
     **********************************/
     ApplyBCs(lines, d, grid, t0 + (1-theta)*dt, dir1);
-    ImplicitUpdate (v_new, v_aux, NULL, H1p, H1m, C1, &lines[dir1],
+    ImplicitUpdate (v_new, v_aux, NULL, NULL, H1p, H1m, C1, &lines[dir1],
                     lines[dir1].lbound[diff], lines[dir1].rbound[diff],
                     (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                     (1-2*theta)*dt, dir1);
@@ -1620,7 +1967,7 @@ void FractionalTheta(double **v_new, double **v_old,
      (c.2) Implicit update sweeping DIR2
     **********************************/
     ApplyBCs(lines, d, grid, t0 + dt, dir2);
-    ImplicitUpdate (v_new, v_aux, NULL, H2p, H2m, C2, &lines[dir2],
+    ImplicitUpdate (v_new, v_aux, NULL, NULL, H2p, H2m, C2, &lines[dir2],
                       lines[dir2].lbound[diff], lines[dir2].rbound[diff],
                       (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                       theta*dt, dir2);
@@ -1670,17 +2017,17 @@ void SplitImplicit(double **v_new, double **v_old,
   #endif
 
   if (first_call) {
-    v_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    v_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #if (JOULE_EFFECT_AND_MAG_ENG)
-      dUres_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      dUres_aux = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     #endif
 
-    Ip = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Im = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Jp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    Jm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    CI = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    CJ = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    Ip = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Im = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Jp = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    Jm = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    CI = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
+    CJ = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     first_call = 0;
   }
 
@@ -1748,7 +2095,7 @@ void SplitImplicit(double **v_new, double **v_old,
      (a) Implicit update sweeping DIR1
     **********************************/
     ApplyBCs(lines, d, grid, t_now+dts, dir1);
-    ImplicitUpdate (v_aux, v_new, NULL, H1p, H1m, C1, &lines[dir1],
+    ImplicitUpdate (v_aux, v_new, NULL, NULL, H1p, H1m, C1, &lines[dir1],
                       lines[dir1].lbound[diff], lines[dir1].rbound[diff],
                       (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                       dts, dir1);
@@ -1776,7 +2123,7 @@ void SplitImplicit(double **v_new, double **v_old,
      (b) Implicit update sweeping DIR2
     **********************************/
     ApplyBCs(lines, d, grid, t_now + dts, dir2);
-    ImplicitUpdate (v_new, v_aux, NULL, H2p, H2m, C2, &lines[dir2],
+    ImplicitUpdate (v_new, v_aux, NULL, NULL, H2p, H2m, C2, &lines[dir2],
                       lines[dir2].lbound[diff], lines[dir2].rbound[diff],
                       (diff == TDIFF) && EN_CONS_CHECK, &en_tc_in, grid,
                       dts, dir2);
@@ -9,6 +9,11 @@
 // Box useful for setting bcs internal to the domain
 static RBox rbox_center_capWall[2];
 static RBox rbox_center_capCorn[1];
+// Global index minus local index (0 in serial): the remarkable indexes are global
+static int i_loc_shift = 0, j_loc_shift = 0;
+
+static void ClipRBoxToLocal(RBox *box, Grid *grid);
+static void CheckMirrorIsLocal(int ib, int ie, int lbeg, int lend);
 
 double const zcap = ZCAP/UNIT_LENGTH;
 double const dzcap = DZCAP/UNIT_LENGTH;
@@ -21,9 +26,16 @@ int i_cap_inter_end, j_cap_inter_end, j_elec_start;
 double en_tc_in = 0;
 double en_adv_in = 0;
 double en_res_in = 0;
+double en_rad_out = 0;
 
 Corr d_correction[3] = { {},{},{} };
 
+// Region maps (see GetCapRegionMap()), one per grid (usually only the one of PLUTO)
+#define CAP_REGION_MAX_GRIDS 2
+static Grid *cap_region_grid[CAP_REGION_MAX_GRIDS];
+static unsigned char **cap_region_map[CAP_REGION_MAX_GRIDS];
+static int n_cap_region_maps = 0;
+
 int not_allocated_d_correction = 1;
 
 /******************************************************************/
@@ -48,9 +60,14 @@ i=0                 o-------------------------------->(axis)
     */
 
   /* I find the indexes of the cells closest to the capillary bounds*/
-  i_cap_inter_end = IBEG + FindIdxClosest(&(grid[IDIR].xr_glob[IBEG]), IEND-IBEG+1, rcap);
-  j_cap_inter_end = JBEG + FindIdxClosest(&(grid[JDIR].xr_glob[JBEG]), JEND-JBEG+1, zcap);
-  j_elec_start = JBEG + FindIdxClosest(&(grid[JDIR].xl_glob[JBEG]), JEND-JBEG+1, zcap-dzcap);
+  /* (they are global indexes, which in parallel are different from the local ones,
+     see I_GLOB(), J_GLOB())*/
+  i_cap_inter_end = grid[IDIR].gbeg + FindIdxClosest(&(grid[IDIR].xr_glob[grid[IDIR].gbeg]),
+                                                     grid[IDIR].np_int_glob, rcap);
+  j_cap_inter_end = grid[JDIR].gbeg + FindIdxClosest(&(grid[JDIR].xr_glob[grid[JDIR].gbeg]),
+                                                     grid[JDIR].np_int_glob, zcap);
+  j_elec_start = grid[JDIR].gbeg + FindIdxClosest(&(grid[JDIR].xl_glob[grid[JDIR].gbeg]),
+                                                  grid[JDIR].np_int_glob, zcap-dzcap);
 
   if (j_elec_start > j_cap_inter_end) {
     print1("\n[SetRemarkableIdxs]Electrode appears to start after end of capillary! Quitting.");
@@ -79,6 +96,8 @@ i=0                 o-------------------------------->(axis)
   print1("\n");
   
   capillary_not_set = 0;
+  // Now the regions are known, I make the map of this grid
+  GetCapRegionMap(grid);
   return 0;
 }
 
@@ -183,8 +202,12 @@ void free_Data(Data *data) {
   free((Data *) data);
 }
 
-void SetRBox_capWall(int Nghost) {
+void SetRBox_capWall(Grid *grid, int Nghost) {
   int s;
+  int ic, jc;
+
+  i_loc_shift = grid[IDIR].beg - grid[IDIR].lbeg;
+  j_loc_shift = grid[JDIR].beg - grid[JDIR].lbeg;
   /* ---------------------------------------------------
     0. set CAP_WALL_INTERNAL grid index ranges
    --------------------------------------------------- */
@@ -211,7 +234,7 @@ void SetRBox_capWall(int Nghost) {
   rbox_center_capWall[s].vpos = CENTER;
 
   rbox_center_capWall[s].ib = i_cap_inter_end + 1 + Nghost;
-  rbox_center_capWall[s].ie = NX1_TOT - 1 - Nghost;
+  rbox_center_capWall[s].ie = grid[IDIR].gend;
 
   rbox_center_capWall[s].jb = j_cap_inter_end - Nghost + 1;
   rbox_center_capWall[s].je = j_cap_inter_end;
@@ -236,6 +259,33 @@ void SetRBox_capWall(int Nghost) {
   rbox_center_capCorn[s].kb = 0;
   rbox_center_capCorn[s].ke = NX3_TOT-1;
 
+  /* ---------------------------------------------------
+    4. Boxes are defined with global indexes: I bring them
+       to the local ones (clipped to the interior of this process)
+   --------------------------------------------------- */
+  ClipRBoxToLocal(&rbox_center_capWall[CAP_WALL_INTERNAL], grid);
+  ClipRBoxToLocal(&rbox_center_capWall[CAP_WALL_EXTERNAL], grid);
+  ClipRBoxToLocal(&rbox_center_capCorn[0], grid);
+
+  /* The cells reflected inside the boxes must belong to this same process
+     (the internal bcs are applied before the exchange of the ghosts among processes) */
+  ic = i_cap_inter_end - i_loc_shift;
+  jc = j_cap_inter_end - j_loc_shift;
+  s = CAP_WALL_INTERNAL;
+  if (rbox_center_capWall[s].ib <= rbox_center_capWall[s].ie && rbox_center_capWall[s].jb <= rbox_center_capWall[s].je)
+    CheckMirrorIsLocal(2*ic-rbox_center_capWall[s].ie+1, 2*ic-rbox_center_capWall[s].ib+1,
+                       grid[IDIR].lbeg, grid[IDIR].lend);
+  s = CAP_WALL_EXTERNAL;
+  if (rbox_center_capWall[s].ib <= rbox_center_capWall[s].ie && rbox_center_capWall[s].jb <= rbox_center_capWall[s].je)
+    CheckMirrorIsLocal(2*(jc+1)-rbox_center_capWall[s].je-1, 2*(jc+1)-rbox_center_capWall[s].jb-1,
+                       grid[JDIR].lbeg, grid[JDIR].lend);
+  if (rbox_center_capCorn[0].ib <= rbox_center_capCorn[0].ie && rbox_center_capCorn[0].jb <= rbox_center_capCorn[0].je) {
+    CheckMirrorIsLocal(2*ic-rbox_center_capCorn[0].ie+1, 2*ic-rbox_center_capCorn[0].ib+1,
+                       grid[IDIR].lbeg, grid[IDIR].lend);
+    CheckMirrorIsLocal(2*(jc+1)-rbox_center_capCorn[0].je-1, 2*(jc+1)-rbox_center_capCorn[0].jb-1,
+                       grid[JDIR].lbeg, grid[JDIR].lend);
+  }
+
   #ifdef DEBUG_BCS
     printbox(rbox_center_capWall[CAP_WALL_INTERNAL], "rbox_center_capWall[CAP_WALL_INTERNAL]");
     printbox(rbox_center_capWall[CAP_WALL_EXTERNAL], "rbox_center_capWall[CAP_WALL_EXTERNAL]");
@@ -243,6 +293,26 @@ void SetRBox_capWall(int Nghost) {
   #endif
 }
 
+/* ********************************************************************* */
+/* Brings a box from global to local indexes, clipping it to the interior
+   of this process (it may become empty, i.e. ib>ie or jb>je)              */
+/* ********************************************************************* */
+void ClipRBoxToLocal(RBox *box, Grid *grid) {
+  box->ib = MAX(box->ib - i_loc_shift, grid[IDIR].lbeg);
+  box->ie = MIN(box->ie - i_loc_shift, grid[IDIR].lend);
+  box->jb = MAX(box->jb - j_loc_shift, grid[JDIR].lbeg);
+  box->je = MIN(box->je - j_loc_shift, grid[JDIR].lend);
+}
+
+/* ********************************************************************* */
+void CheckMirrorIsLocal(int ib, int ie, int lbeg, int lend) {
+  if (ib < lbeg || ie > lend) {
+    print("\n[SetRBox_capWall] The capillary wall is too close to the boundary between two processes:");
+    print("\n                  change the domain decomposition!");
+    QUIT_PLUTO(1);
+  }
+}
+
 /* ********************************************************************* */
 RBox *GetRBoxCap(int side, int vpos)
 /*!
@@ -291,6 +361,9 @@ void ReflectiveBoundCap (double ****q, int nv, int s, int side, int vpos)
 {
   int   i, j, k, pp;
   RBox *box = GetRBoxCap(side, vpos);
+  // Local indexes of the capillary wall
+  int const ic = i_cap_inter_end - i_loc_shift;
+  int const jc = j_cap_inter_end - j_loc_shift;
 
   if (not_allocated_d_correction && (side == CAP_WALL_CORNER_INTERNAL || side == CAP_WALL_CORNER_EXTERNAL)) {
     // I allocate memory for d_correction
@@ -323,15 +396,15 @@ void ReflectiveBoundCap (double ****q, int nv, int s, int side, int vpos)
                 q[nv][k][j][IEND+2] = q[nv][k][j][IEND-1]
           remember: IEND is the last cell index inside the real domain.
     */
-    BOX_LOOP(box,k,j,i) q[nv][k][j][i] = s*q[nv][k][j][2*i_cap_inter_end-i+1];
+    BOX_LOOP(box,k,j,i) q[nv][k][j][i] = s*q[nv][k][j][2*ic-i+1];
 
   } else if (side == CAP_WALL_EXTERNAL){  
-    BOX_LOOP(box,k,j,i) q[nv][k][j][i] = s*q[nv][k][2*(j_cap_inter_end+1)-j-1][i];
+    BOX_LOOP(box,k,j,i) q[nv][k][j][i] = s*q[nv][k][2*(jc+1)-j-1][i];
 
   } else if (side == CAP_WALL_CORNER_INTERNAL) {
     pp = 0;
     BOX_LOOP(box,k,j,i) {
-      d_correction[IDIR].Vc[nv][pp] = s*q[nv][k][j][2*i_cap_inter_end-i+1];
+      d_correction[IDIR].Vc[nv][pp] = s*q[nv][k][j][2*ic-i+1];
       d_correction[IDIR].i[pp] = i;
       d_correction[IDIR].j[pp] = j;
       d_correction[IDIR].k[pp] = k;
@@ -345,7 +418,7 @@ void ReflectiveBoundCap (double ****q, int nv, int s, int side, int vpos)
   } else if ( side == CAP_WALL_CORNER_EXTERNAL) {
     pp = 0;
     BOX_LOOP(box,k,j,i) {
-      d_correction[JDIR].Vc[nv][pp] = s*q[nv][k][2*(j_cap_inter_end+1)-j-1][i];
+      d_correction[JDIR].Vc[nv][pp] = s*q[nv][k][2*(jc+1)-j-1][i];
       d_correction[JDIR].i[pp] = i;
       d_correction[JDIR].j[pp] = j;
       d_correction[JDIR].k[pp] = k;
@@ -463,6 +536,71 @@ int IsOutCone(double angle, double r, double z) {
   }
 }
 
+/******************************************************************
+ * CapRegionOfPoint : Region (CAP_REGION_* bits, see capillary_wall.h)
+ * of the point (r, z), e.g. of the center of a cell. It needs the
+ * remarkable indexes (SetRemarkableIdxs()).
+ * ***************************************************/
+unsigned char CapRegionOfPoint(double r, double z) {
+  unsigned char region = 0;
+
+  if (z <= zcap_real) {
+    if (r <= rcap_real) {
+      region |= CAP_REGION_INTERIOR;
+    } else {
+      region |= CAP_REGION_WALL;
+      if (z >= zcap_real-dzcap_real) region |= CAP_REGION_ELECTRODE;
+    }
+  } else {
+    region |= CAP_REGION_PLUME;
+  }
+  #ifdef CONE_LOW_TCKAPPA
+    if (IsOutCone(CONE_LOW_TCKAPPA, r, z)) region |= CAP_REGION_LOW_KAPPA;
+  #endif
+  // Zones of REALISTIC_WALL_ETA (the same conditions of Resistive_etaFromT())
+  if (z>zcap_real-dzcap_real+dzcap_real*0.1 && z<=zcap_real && r>=rcap_real)
+    region |= CAP_REGION_ETA_COPPER;
+  else if (z<zcap_real-dzcap_real-dzcap_real*0.1 && r>=rcap_real)
+    region |= CAP_REGION_ETA_GLASS;
+  else if (z>=zcap_real-dzcap_real-dzcap_real*0.1 && z<=zcap_real-dzcap_real+dzcap_real*0.1 && r>=rcap_real)
+    region |= CAP_REGION_ETA_COPPER | CAP_REGION_ETA_GLASS;
+  return region;
+}
+
+/******************************************************************
+ * GetCapRegionMap : Map [j][i] of the regions (CapRegionOfPoint())
+ * of the cells of grid (ghosts included): it is made once per grid
+ * (for the grid of PLUTO by SetRemarkableIdxs()), then the transport
+ * coefficients, the boundaries and the diagnostics just read it
+ * instead of testing the geometry again and again.
+ * [Rob] The creation is not thread safe: a map must be made by the main
+ * thread before any helper thread uses it (the one of the grid of PLUTO
+ * is made by SetRemarkableIdxs()).
+ * ***************************************************/
+unsigned char **GetCapRegionMap(Grid *grid) {
+  int n, i, j;
+  unsigned char **map;
+
+  for (n = 0; n < n_cap_region_maps; n++)
+    if (cap_region_grid[n] == grid) return cap_region_map[n];
+
+  if (capillary_not_set) {
+    print1("\n[GetCapRegionMap] The remarkable indexes are not set yet (SetRemarkableIdxs())");
+    QUIT_PLUTO(1);
+  }
+  if (n_cap_region_maps == CAP_REGION_MAX_GRIDS) {
+    print1("\n[GetCapRegionMap] Too many grids, increase CAP_REGION_MAX_GRIDS");
+    QUIT_PLUTO(1);
+  }
+  map = ARRAY_2D(grid[JDIR].np_tot, grid[IDIR].np_tot, unsigned char);
+  for (j = 0; j < grid[JDIR].np_tot; j++)
+    for (i = 0; i < grid[IDIR].np_tot; i++)
+      map[j][i] = CapRegionOfPoint(grid[IDIR].x[i], grid[JDIR].x[j]);
+  cap_region_grid[n_cap_region_maps] = grid;
+  cap_region_map[n_cap_region_maps++] = map;
+  return map;
+}
+
 #if MULTIPLE_GHOSTS == YES
   /***********************************************
   * Author :  Ema
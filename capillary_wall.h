@@ -19,13 +19,18 @@ double extern const zcap, dzcap, rcap;
 double extern zcap_real, rcap_real, dzcap_real;
 int extern capillary_not_set;
 int extern i_cap_inter_end, j_cap_inter_end, j_elec_start;
+/* The indexes above are global: in parallel the local indexes (of the arrays of
+   this process) are converted with: */
+#define I_GLOB(grid, i) ((i) + (grid)[IDIR].beg - (grid)[IDIR].lbeg)
+#define J_GLOB(grid, j) ((j) + (grid)[JDIR].beg - (grid)[JDIR].lbeg)
 
 /* Variables defined for computation of energy conservation:
   en_res_in : energy gained by resistivity (resistive part of poynting flux
                 through the boundary)
   en_tc_in : energy gained by conduction through boundary
-  en_adv_in: energy gained by advection of the total energy rhough boundary*/
- double extern en_tc_in, en_adv_in, en_res_in;
+  en_adv_in: energy gained by advection of the total energy rhough boundary
+  en_rad_out: energy lost by radiation (only with RAD_LOSS_ADI)*/
+ double extern en_tc_in, en_adv_in, en_res_in, en_rad_out;
 
 /* ********************************************************************* */
 /*! [Ema]The Corr structure contains the correction to the solution 3D array
@@ -64,13 +69,28 @@ void copy_Data_Vc(Data *d_target, const Data *d_source);
 void free_Data(Data *data);
 
 // RBox *GetRBoxCap(int side, int vpos);
-void SetRBox_capWall(int Nghost);
+void SetRBox_capWall(Grid *grid, int Nghost);
 void ReflectiveBoundCap (double ****q, int nv, int s, int side, int vpos);
 void ZeroBoundCap (double ****q, int nv, int s, int side, int vpos);
 void SetNotEvolvedVar (int nv);
 
 int IsOutCone(double angle, double r, double z);
 
+/* Region of a cell (bits of the bytes of the map given by GetCapRegionMap()), from
+   the position of its center with respect to the capillary */
+#define CAP_REGION_INTERIOR   0x01  // Inside the capillary (r <= rcap_real, z <= zcap_real)
+#define CAP_REGION_WALL       0x02  // Wall, i.e. internal boundary (r > rcap_real, z <= zcap_real)
+#define CAP_REGION_ELECTRODE  0x04  // Part of the wall which is electrode (z >= zcap_real-dzcap_real)
+#define CAP_REGION_PLUME      0x08  // Out of the capillary (z > zcap_real)
+#define CAP_REGION_LOW_KAPPA  0x10  // Out of the cone CONE_LOW_TCKAPPA (IsOutCone()), see TC_kappa()
+/* Zones of REALISTIC_WALL_ETA (res_eta.c): the eta of copper is averaged in the first,
+   that of glass in the second, both in the cells (between them) with both bits */
+#define CAP_REGION_ETA_COPPER 0x20
+#define CAP_REGION_ETA_GLASS  0x40
+
+unsigned char CapRegionOfPoint(double r, double z);
+unsigned char **GetCapRegionMap(Grid *grid);
+
 #if MULTIPLE_GHOSTS == YES
   void ApplyMultipleGhosts(const Data*, int);
 #endif
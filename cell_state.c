@@ -0,0 +1,537 @@
+/*Cache of the thermodynamic state (T, mu, ionization, heat capacity) and of the
+transport coefficients (kappa, eta) of the cells (see cell_state.h)*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "cell_state.h"
+#include "tc_kappa.h"
+#include "res_eta.h"
+#include "capillary_wall.h"
+#include "inv_eos_table.h"
+#include "transport_tables.h"
+#if EOS==PVTE_LAW
+  #include "pvte_law_heat_capacity.h"
+#endif
+
+/****************************************************************************
+How it works:
+  the temperature was computed (by inverting the EOS) again and again for the same
+  cells of the same state: by ADI() to get T_old, by TC_kappa() and Resistive_eta() for
+  every cell of BuildIJ_TC()/BuildIJ_Res(), for the heat capacity of BuildIJ_TC(), and by
+  ComputeUserVar() once per output variable. Now they all ask the Cell*() functions below,
+  which compute a value the first time it is asked for a cell and keep it until the next
+  InvalidateCellState() of the same Data.
+  CellKappaRow() and CellEtaRow() do the same for a segment of a row of cells (a line
+  along IDIR): the outdated cells are gathered in arrays and given to TC_kappaLine() and
+  Resistive_etaLine(), instead of calling TC_kappaFromT()/Resistive_etaFromT() per cell.
+  Who changes Vc must call InvalidateCellState(): ADI() calls it after each Boundary()
+  (which follows the ConsToPrimLines() of the previous sub-iteration) and at its end,
+  ComputeUserVar() at its start (the hydro step changes Vc without calling it).
+  With MULTI_FIELD_TABLE, once T is known, mu, dE/dT, kappa and eta of a cell come from a
+  single lookup of the multi-field table (transport_tables.c): UpdateCellFieldsRow() does
+  it for the outdated cells of a segment of a row, whichever of them is asked first. The
+  functions without the grid (CellMu(), CellHeatCapacity(), ...) cannot know the region
+  of the cell, so they leave kappa and eta outdated.
+*****************************************************************************/
+
+// Cells done at once by CellKappaRow() and CellEtaRow() (size of their scratch arrays)
+#define CELL_ROW_CHUNK 64
+
+static CellState cell_states[CELL_STATE_MAX_DATA];
+static int n_cell_states = 0;
+#if MULTI_FIELD_TABLE
+  static int mf_tab_not_done = 1;
+  static void UpdateCellFieldsRow(CellState *cs, const unsigned char *region_row,
+                                  int k, int j, int ibeg, int iend);
+#endif
+
+/****************************************************************************
+Gives the cache of d, creating it if it does not exist yet.
+[Rob] The arrays are allocated with the current NX2_TOT/NX1_TOT, so under PARALLEL the cache
+must not be created while the global indexes of adi_mpi.c are set (ADI() works on the local
+block, the global indexes are set only around the sweeps).
+[Rob] The creation is not thread safe: the cache of a Data used by the helper thread of
+adi_async.c is created by the main thread (by InvalidateCellState()) before launching it.
+For the same reason the multi-field table (MULTI_FIELD_TABLE) is made here.
+*****************************************************************************/
+static CellState *GetCellState(const Data *d) {
+  int n, i, j, k;
+  CellState *cs;
+
+  for (n = 0; n < n_cell_states; n++)
+    if (cell_states[n].d == d) return &(cell_states[n]);
+
+  if (n_cell_states == CELL_STATE_MAX_DATA) {
+    print1("\n[GetCellState] Too many Data structures cached, increase CELL_STATE_MAX_DATA");
+    QUIT_PLUTO(1);
+  }
+  #if MULTI_FIELD_TABLE
+    if (mf_tab_not_done) {
+      MakeMultiFieldTable();
+      mf_tab_not_done = 0;
+    }
+  #endif
+  cs = &(cell_states[n_cell_states++]);
+  cs->d = d;
+  cs->epoch = 1;
+  cs->n_T_table = cs->n_T_warm = cs->n_T_warm_iter = cs->n_T_warm_fail = cs->n_T_cold = 0;
+  cs->stamp_T = ARRAY_2D(NX2_TOT, NX1_TOT, long);
+  cs->stamp_dEdT = ARRAY_2D(NX2_TOT, NX1_TOT, long);
+  cs->stamp_kappa = ARRAY_2D(NX2_TOT, NX1_TOT, long);
+  cs->stamp_eta = ARRAY_2D(NX2_TOT, NX1_TOT, long);
+  cs->stamp_mu = ARRAY_2D(NX2_TOT, NX1_TOT, long);
+  cs->T = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  cs->mu = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  cs->x = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  cs->dEdT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  cs->kappa = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  cs->eta = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  TOT_LOOP(k,j,i) {
+    cs->stamp_T[j][i] = 0;
+    cs->stamp_dEdT[j][i] = 0;
+    cs->stamp_kappa[j][i] = 0;
+    cs->stamp_eta[j][i] = 0;
+    cs->stamp_mu[j][i] = 0;
+  }
+
+  return cs;
+}
+
+/****************************************************************************
+Marks as outdated all the values cached for d
+*****************************************************************************/
+void InvalidateCellState(const Data *d) {
+  GetCellState(d)->epoch++;
+}
+
+/****************************************************************************
+Computes T, mu and the ionization of the cell (if they are not up to date), and with
+PVTE_LAW also the heat capacity (EOSStateFromT(), from the same Saha solution).
+With INV_EOS_TABLE the temperature is looked up in the table T(rho, p); outside it
+(or without the table), with WARM_T_INVERSION, if the cell has a temperature from a
+previous state (stamp_T != 0, the values are kept across the invalidations) I start
+from it; the last resort is GetPV_Temperature().
+*****************************************************************************/
+static void UpdateCellTemperature(CellState *cs, int k, int j, int i) {
+  int nv;
+  double v[NVAR];
+  double T, mu;
+  #if EOS==PVTE_LAW && !MULTI_FIELD_TABLE
+    EOSState eos;
+  #endif
+  int found = 0; // Tells whether T has been found by the table or by the warm start
+  #if WARM_T_INVERSION
+    int nit;
+  #endif
+
+  if (cs->stamp_T[j][i] == cs->epoch) return;
+
+  for (nv=NVAR; nv--;) v[nv] = cs->d->Vc[nv][k][j][i];
+  #if EOS==PVTE_LAW
+    #if INV_EOS_TABLE
+      found = (GetTemperatureFromPressureTable(v[RHO], v[PRS], &T) == 0);
+      if (found) cs->n_T_table++;
+    #endif
+    #if WARM_T_INVERSION
+      if (!found && cs->stamp_T[j][i] != 0) {
+        nit = GetPV_TemperatureWarm(v, cs->T[j][i], &T);
+        cs->n_T_warm++;
+        if (nit > 0) cs->n_T_warm_iter += nit;
+        else cs->n_T_warm_fail++;
+        found = (nit > 0);
+      }
+    #endif
+    if (!found) {
+      cs->n_T_cold++;
+      if (GetPV_Temperature(v, &T)!=0) {
+        #if WARN_ERR_COMP_TEMP
+          print1("\nCellTemperature:[Ema]Err.comp.temp");
+        #endif
+      }
+    }
+    #if !MULTI_FIELD_TABLE
+      /* mu, x and the heat capacity from one solution of the Saha equation (instead of
+         one for GetMu() and one for HeatCapacity(), later) */
+      EOSStateFromT(v, T, &eos);
+      cs->mu[j][i] = eos.mu;
+      cs->x[j][i] = eos.x;
+      cs->dEdT[j][i] = eos.dEdT;
+      cs->stamp_dEdT[j][i] = cs->epoch;
+    #endif
+  #else
+    mu = MeanMolecularWeight(v);
+    T = v[PRS]/v[RHO]*KELVIN*mu;
+    cs->mu[j][i] = mu;
+    cs->x[j][i] = 1/mu - 1;
+  #endif
+  cs->T[j][i] = T;
+  cs->stamp_T[j][i] = cs->epoch;
+}
+
+#if MULTI_FIELD_TABLE
+/****************************************************************************
+Sets mu, x, dE/dT and, if region != NULL (the regions of the cells), kappa and eta of
+the n cells idx of the row j, gathered by UpdateCellFieldsRow(), from one lookup of
+the multi-field table. The cells out of the table get mu and dE/dT from the EOS;
+their kappa and eta (if not fixed) are asked to TC_kappaLine() and
+Resistive_etaLine(), which quit telling the cell, as without the table.
+*****************************************************************************/
+static void FieldsRowChunk(CellState *cs, int j, const int *idx, const double *rho,
+                           const double *T, const unsigned char *region, int n) {
+  int m, nv;
+  double v[NVAR], fm[MF_NFIELDS];
+  EOSState eos;
+  double rho_cgs[CELL_ROW_CHUNK];
+  double eta[CELL_ROW_CHUNK], kappa[CELL_ROW_CHUNK], dEdT[CELL_ROW_CHUNK], mu[CELL_ROW_CHUNK];
+  double *f[MF_NFIELDS];
+  int kappa_fixed = (g_inputParam[KAPPA_GAU] > 0.0);
+  int eta_fixed = (g_inputParam[ETAX_GAU] > 0.0);
+
+  f[MF_ETA] = eta;
+  f[MF_KAPPA] = kappa;
+  f[MF_DEDT] = dEdT;
+  f[MF_MU] = mu;
+  for (m = 0; m < n; m++) rho_cgs[m] = rho[m]*UNIT_DENSITY;
+
+  if (GetMultiFieldFromTableBatch(rho_cgs, T, f, n) != 0) {
+    for (nv=NVAR; nv--;) v[nv] = 0.0;
+    for (m = 0; m < n; m++) {
+      if (GetMultiFieldFromTable(rho_cgs[m], T[m], fm) == 0) continue;
+      v[RHO] = rho[m];
+      EOSStateFromT(v, T[m], &eos);
+      dEdT[m] = eos.dEdT;
+      mu[m] = eos.mu;
+      if (region != NULL) {
+        #if THERMAL_CONDUCTION != NO
+          if (!kappa_fixed) TC_kappaLine(rho + m, T + m, region + m, kappa + m, 1);
+        #endif
+        #if RESISTIVITY != NO
+          if (!eta_fixed) Resistive_etaLine(rho + m, T + m, region + m, eta + m, 1);
+        #endif
+      }
+    }
+  }
+
+  for (m = 0; m < n; m++) {
+    cs->mu[j][idx[m]] = mu[m];
+    cs->x[j][idx[m]] = 1/mu[m] - 1;
+    cs->dEdT[j][idx[m]] = dEdT[m];
+    cs->stamp_mu[j][idx[m]] = cs->stamp_dEdT[j][idx[m]] = cs->epoch;
+  }
+  if (region == NULL) return;
+
+  #if THERMAL_CONDUCTION != NO
+    // The limiters and units of TC_kappaLine() (which also gives the fixed kappa)
+    if (kappa_fixed) TC_kappaLine(rho, T, region, kappa, n);
+    else TC_kappaLineFinish(rho, region, kappa, n);
+    for (m = 0; m < n; m++) {
+      cs->kappa[j][idx[m]] = kappa[m];
+      cs->stamp_kappa[j][idx[m]] = cs->epoch;
+    }
+  #endif
+  #if RESISTIVITY != NO
+    if (eta_fixed) Resistive_etaLine(rho, T, region, eta, n);
+    else Resistive_etaLineFinish(region, eta, n);
+    for (m = 0; m < n; m++) {
+      cs->eta[j][idx[m]] = eta[m];
+      cs->stamp_eta[j][idx[m]] = cs->epoch;
+    }
+  #endif
+}
+
+/****************************************************************************
+Brings up to date the fields of the multi-field table (see FieldsRowChunk()) of the
+cells ibeg..iend of the row j: the outdated ones are gathered in chunks, so that their
+lookups are done at once. kappa and eta are done only if region_row is given (the row
+j of GetCapRegionMap()).
+*****************************************************************************/
+static void UpdateCellFieldsRow(CellState *cs, const unsigned char *region_row,
+                                int k, int j, int ibeg, int iend) {
+  int i, n = 0;
+  int idx[CELL_ROW_CHUNK];
+  double rho[CELL_ROW_CHUNK], T[CELL_ROW_CHUNK];
+  unsigned char region[CELL_ROW_CHUNK];
+
+  for (i = ibeg; i <= iend; i++) {
+    if (cs->stamp_mu[j][i] == cs->epoch) {
+      if (region_row == NULL) continue;
+      #if THERMAL_CONDUCTION != NO && RESISTIVITY != NO
+        if (cs->stamp_kappa[j][i] == cs->epoch && cs->stamp_eta[j][i] == cs->epoch) continue;
+      #elif THERMAL_CONDUCTION != NO
+        if (cs->stamp_kappa[j][i] == cs->epoch) continue;
+      #elif RESISTIVITY != NO
+        if (cs->stamp_eta[j][i] == cs->epoch) continue;
+      #endif
+    }
+    UpdateCellTemperature(cs, k, j, i);
+    rho[n] = cs->d->Vc[RHO][k][j][i];
+    T[n] = cs->T[j][i];
+    if (region_row != NULL) region[n] = region_row[i];
+    idx[n++] = i;
+    if (n == CELL_ROW_CHUNK) {
+      FieldsRowChunk(cs, j, idx, rho, T, region_row != NULL ? region : NULL, n);
+      n = 0;
+    }
+  }
+  if (n > 0) FieldsRowChunk(cs, j, idx, rho, T, region_row != NULL ? region : NULL, n);
+}
+#endif
+
+/****************************************************************************
+Temperature (Kelvin) of the cell
+*****************************************************************************/
+double CellTemperature(const Data *d, int k, int j, int i) {
+  CellState *cs = GetCellState(d);
+  UpdateCellTemperature(cs, k, j, i);
+  return cs->T[j][i];
+}
+
+/****************************************************************************
+Mean molecular weight of the cell
+*****************************************************************************/
+double CellMu(const Data *d, int k, int j, int i) {
+  CellState *cs = GetCellState(d);
+  #if MULTI_FIELD_TABLE
+    UpdateCellFieldsRow(cs, NULL, k, j, i, i);
+  #else
+    UpdateCellTemperature(cs, k, j, i);
+  #endif
+  return cs->mu[j][i];
+}
+
+/****************************************************************************
+Ionization degree of the cell (1/mu - 1)
+*****************************************************************************/
+double CellIoniz(const Data *d, int k, int j, int i) {
+  CellState *cs = GetCellState(d);
+  #if MULTI_FIELD_TABLE
+    UpdateCellFieldsRow(cs, NULL, k, j, i, i);
+  #else
+    UpdateCellTemperature(cs, k, j, i);
+  #endif
+  return cs->x[j][i];
+}
+
+#if EOS==PVTE_LAW
+/****************************************************************************
+Heat capacity per unit volume of the cell (code units, as given by HeatCapacity())
+*****************************************************************************/
+double CellHeatCapacity(const Data *d, int k, int j, int i) {
+  CellState *cs = GetCellState(d);
+
+  if (cs->stamp_dEdT[j][i] != cs->epoch) {
+    #if MULTI_FIELD_TABLE
+      UpdateCellFieldsRow(cs, NULL, k, j, i, i);
+    #else
+      // It is computed together with T (EOSStateFromT())
+      UpdateCellTemperature(cs, k, j, i);
+    #endif
+  }
+  return cs->dEdT[j][i];
+}
+
+/****************************************************************************
+Heat capacity (as CellHeatCapacity()) of the cells ibeg..iend of the row j: returns the
+row of the cache, up to date from ibeg to iend
+*****************************************************************************/
+const double *CellHeatCapacityRow(const Data *d, int k, int j, int ibeg, int iend) {
+  int i;
+  CellState *cs = GetCellState(d);
+
+  #if MULTI_FIELD_TABLE
+    UpdateCellFieldsRow(cs, NULL, k, j, ibeg, iend);
+  #else
+    for (i = ibeg; i <= iend; i++) CellHeatCapacity(d, k, j, i);
+  #endif
+  return cs->dEdT[j];
+}
+#endif
+
+#if THERMAL_CONDUCTION != NO
+/****************************************************************************
+Thermal conductivity of the cell (knor of TC_kappa(), code units)
+*****************************************************************************/
+double CellKappa(const Data *d, Grid *grid, int k, int j, int i) {
+  int nv;
+  double v[NVAR];
+  double T = 0.0;
+  double kpar, phi;
+  CellState *cs = GetCellState(d);
+
+  if (cs->stamp_kappa[j][i] != cs->epoch) {
+    #if MULTI_FIELD_TABLE
+      // Together with the other fields of the multi-field table
+      UpdateCellFieldsRow(cs, GetCapRegionMap(grid)[j], k, j, i, i);
+      return cs->kappa[j][i];
+    #endif
+    for (nv=NVAR; nv--;) v[nv] = d->Vc[nv][k][j][i];
+    // As in TC_kappa(), T is not needed with a fixed kappa
+    if (g_inputParam[KAPPA_GAU] <= 0.0) {
+      UpdateCellTemperature(cs, k, j, i);
+      T = cs->T[j][i];
+    }
+    TC_kappaFromT(v, T, GetCapRegionMap(grid)[j][i], grid[IDIR].x[i], grid[JDIR].x[j],
+                  grid[KDIR].x[k], &kpar, &(cs->kappa[j][i]), &phi);
+    cs->stamp_kappa[j][i] = cs->epoch;
+  }
+  return cs->kappa[j][i];
+}
+
+/****************************************************************************
+Computes (TC_kappaLine()) and caches the thermal conductivity of the n cells idx of the
+row j, gathered by CellKappaRow()
+*****************************************************************************/
+static void KappaRowChunk(CellState *cs, int j, const int *idx, const double *rho,
+                          const double *T, const unsigned char *region, int n) {
+  int m;
+  double kappa[CELL_ROW_CHUNK];
+
+  TC_kappaLine(rho, T, region, kappa, n);
+  for (m = 0; m < n; m++) {
+    cs->kappa[j][idx[m]] = kappa[m];
+    cs->stamp_kappa[j][idx[m]] = cs->epoch;
+  }
+}
+
+/****************************************************************************
+Thermal conductivity (as CellKappa()) of the cells ibeg..iend of the row j: returns the
+row of the cache, up to date from ibeg to iend
+*****************************************************************************/
+const double *CellKappaRow(const Data *d, Grid *grid, int k, int j, int ibeg, int iend) {
+  int i, n = 0;
+  int idx[CELL_ROW_CHUNK];
+  double rho[CELL_ROW_CHUNK], T[CELL_ROW_CHUNK];
+  unsigned char region[CELL_ROW_CHUNK];
+  unsigned char *region_row = GetCapRegionMap(grid)[j];
+  int fixed = (g_inputParam[KAPPA_GAU] > 0.0); // As in TC_kappa(), T is not needed with a fixed kappa
+  CellState *cs = GetCellState(d);
+
+  #if MULTI_FIELD_TABLE
+    // Together with the other fields of the multi-field table
+    UpdateCellFieldsRow(cs, region_row, k, j, ibeg, iend);
+    return cs->kappa[j];
+  #endif
+
+  for (i = ibeg; i <= iend; i++) {
+    if (cs->stamp_kappa[j][i] == cs->epoch) continue;
+    if (!fixed) UpdateCellTemperature(cs, k, j, i);
+    rho[n] = d->Vc[RHO][k][j][i];
+    T[n] = fixed ? 0.0 : cs->T[j][i];
+    region[n] = region_row[i];
+    idx[n++] = i;
+    if (n == CELL_ROW_CHUNK) {
+      KappaRowChunk(cs, j, idx, rho, T, region, n);
+      n = 0;
+    }
+  }
+  if (n > 0) KappaRowChunk(cs, j, idx, rho, T, region, n);
+  return cs->kappa[j];
+}
+#endif
+
+#if RESISTIVITY != NO
+/****************************************************************************
+Electrical resistivity of the cell (eta[0] of Resistive_eta(), code units)
+*****************************************************************************/
+double CellEta(const Data *d, Grid *grid, int k, int j, int i) {
+  int nv;
+  double v[NVAR];
+  double T = 0.0;
+  double eta[3];
+  CellState *cs = GetCellState(d);
+
+  if (cs->stamp_eta[j][i] != cs->epoch) {
+    #if MULTI_FIELD_TABLE
+      // Together with the other fields of the multi-field table
+      UpdateCellFieldsRow(cs, GetCapRegionMap(grid)[j], k, j, i, i);
+      return cs->eta[j][i];
+    #endif
+    for (nv=NVAR; nv--;) v[nv] = d->Vc[nv][k][j][i];
+    // As in Resistive_eta(), T is not needed with a fixed eta
+    if (g_inputParam[ETAX_GAU] <= 0.0) {
+      UpdateCellTemperature(cs, k, j, i);
+      T = cs->T[j][i];
+    }
+    Resistive_etaFromT(v, T, GetCapRegionMap(grid)[j][i], grid[IDIR].x[i], grid[JDIR].x[j],
+                       grid[KDIR].x[k], NULL, eta);
+    cs->eta[j][i] = eta[0];
+    cs->stamp_eta[j][i] = cs->epoch;
+  }
+  return cs->eta[j][i];
+}
+
+/****************************************************************************
+Computes (Resistive_etaLine()) and caches the electrical resistivity of the n cells idx
+of the row j, gathered by CellEtaRow()
+*****************************************************************************/
+static void EtaRowChunk(CellState *cs, int j, const int *idx, const double *rho,
+                        const double *T, const unsigned char *region, int n) {
+  int m;
+  double eta[CELL_ROW_CHUNK];
+
+  Resistive_etaLine(rho, T, region, eta, n);
+  for (m = 0; m < n; m++) {
+    cs->eta[j][idx[m]] = eta[m];
+    cs->stamp_eta[j][idx[m]] = cs->epoch;
+  }
+}
+
+/****************************************************************************
+Electrical resistivity (as CellEta()) of the cells ibeg..iend of the row j: returns the
+row of the cache, up to date from ibeg to iend
+*****************************************************************************/
+const double *CellEtaRow(const Data *d, Grid *grid, int k, int j, int ibeg, int iend) {
+  int i, n = 0;
+  int idx[CELL_ROW_CHUNK];
+  double rho[CELL_ROW_CHUNK], T[CELL_ROW_CHUNK];
+  unsigned char region[CELL_ROW_CHUNK];
+  unsigned char *region_row = GetCapRegionMap(grid)[j];
+  int fixed = (g_inputParam[ETAX_GAU] > 0.0); // As in Resistive_eta(), T is not needed with a fixed eta
+  CellState *cs = GetCellState(d);
+
+  #if MULTI_FIELD_TABLE
+    // Together with the other fields of the multi-field table
+    UpdateCellFieldsRow(cs, region_row, k, j, ibeg, iend);
+    return cs->eta[j];
+  #endif
+
+  for (i = ibeg; i <= iend; i++) {
+    if (cs->stamp_eta[j][i] == cs->epoch) continue;
+    if (!fixed) UpdateCellTemperature(cs, k, j, i);
+    rho[n] = d->Vc[RHO][k][j][i];
+    T[n] = fixed ? 0.0 : cs->T[j][i];
+    region[n] = region_row[i];
+    idx[n++] = i;
+    if (n == CELL_ROW_CHUNK) {
+      EtaRowChunk(cs, j, idx, rho, T, region, n);
+      n = 0;
+    }
+  }
+  if (n > 0) EtaRowChunk(cs, j, idx, rho, T, region, n);
+  return cs->eta[j];
+}
+#endif
+
+#if CELL_STATE_REPORT
+/****************************************************************************
+Prints the counters of the temperature inversions of all the cached Data
+*****************************************************************************/
+void ReportCellState() {
+  int n;
+  long n_table = 0, n_warm = 0, n_iter = 0, n_fail = 0, n_cold = 0;
+
+  for (n = 0; n < n_cell_states; n++) {
+    n_table += cell_states[n].n_T_table;
+    n_warm += cell_states[n].n_T_warm;
+    n_iter += cell_states[n].n_T_warm_iter;
+    n_fail += cell_states[n].n_T_warm_fail;
+    n_cold += cell_states[n].n_T_cold;
+  }
+  print1("\n[CellState] T inversions: table %ld, warm %ld (%ld not converged, %.2f Newton it. for the others), full %ld",
+         n_table, n_warm, n_fail, n_warm > n_fail ? (double)n_iter/(n_warm - n_fail) : 0.0, n_cold);
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef CELL_STATE_H
+#define CELL_STATE_H
+#include "inv_eos_table.h"
+/* Cache of the thermodynamic state and transport coefficients of the cells, computed
+   from Vc once per state and shared by the diffusion schemes and by the output */
+
+/* If YES (PVTE_LAW only), the temperature of a cell is found by Newton iterations
+   starting from the temperature it had in the previous state (GetPV_TemperatureWarm()),
+   falling back to GetPV_Temperature() when they do not converge */
+#ifndef WARM_T_INVERSION
+  #define WARM_T_INVERSION NO
+#endif
+#ifndef WARM_T_REPORT_PERIOD
+  #define WARM_T_REPORT_PERIOD 100
+#endif
+#if WARM_T_INVERSION && EOS != PVTE_LAW
+  #error WARM_T_INVERSION is implemented only for PVTE_LAW
+#endif
+// The counters of the temperature inversions are printed (every WARM_T_REPORT_PERIOD steps)
+#define CELL_STATE_REPORT (WARM_T_INVERSION || INV_EOS_TABLE)
+
+// Max number of Data structures (e.g. d, the snapshot of adi_async.c) cached at once
+#define CELL_STATE_MAX_DATA 4
+
+/* The cached values of the cells of a Data (indexes [j][i], as in the ADI arrays).
+   A value is valid if its stamp equals epoch; InvalidateCellState() increases epoch,
+   so that every value is recomputed (lazily, cell by cell) the next time it is asked */
+typedef struct CELL_STATE {
+  const Data *d;   /**< Data whose Vc the values are computed from */
+  long epoch;
+  long **stamp_T, **stamp_dEdT, **stamp_kappa, **stamp_eta;
+  long **stamp_mu; /**< (MULTI_FIELD_TABLE) mu and x come from the table, not with T */
+  double **T;      /**< Temperature (Kelvin) */
+  double **mu;     /**< Mean molecular weight */
+  double **x;      /**< Ionization degree (Saha) */
+  double **dEdT;   /**< Heat capacity per unit volume (code units, as HeatCapacity()) */
+  double **kappa;  /**< Thermal conductivity (knor of TC_kappa(), code units) */
+  double **eta;    /**< Electrical resistivity (eta[0] of Resistive_eta(), code units) */
+  // Counters of the temperature inversions (INV_EOS_TABLE, WARM_T_INVERSION)
+  long n_T_table;      /**< Temperatures found in the table T(rho, p) */
+  long n_T_warm;       /**< Inversions started from the previous T of the cell */
+  long n_T_warm_iter;  /**< Newton iterations done by those which converged */
+  long n_T_warm_fail;  /**< Those which did not converge (and went to GetPV_Temperature()) */
+  long n_T_cold;       /**< Inversions done by GetPV_Temperature() (failures included) */
+} CellState;
+
+/* Must be called whenever Vc of d changes (PLUTO changes it without telling, so who gets
+   a Data from PLUTO calls it before reading the cache) */
+void InvalidateCellState(const Data *d);
+
+#if CELL_STATE_REPORT
+  void ReportCellState();
+#endif
+
+double CellTemperature(const Data *d, int k, int j, int i);
+double CellMu(const Data *d, int k, int j, int i);
+double CellIoniz(const Data *d, int k, int j, int i);
+#if EOS==PVTE_LAW
+  double CellHeatCapacity(const Data *d, int k, int j, int i);
+  const double *CellHeatCapacityRow(const Data *d, int k, int j, int ibeg, int iend);
+#endif
+#if THERMAL_CONDUCTION != NO
+  double CellKappa(const Data *d, Grid *grid, int k, int j, int i);
+  const double *CellKappaRow(const Data *d, Grid *grid, int k, int j, int ibeg, int iend);
+#endif
+#if RESISTIVITY != NO
+  double CellEta(const Data *d, Grid *grid, int k, int j, int i);
+  const double *CellEtaRow(const Data *d, Grid *grid, int k, int j, int ibeg, int iend);
+#endif
+
+#endif
@@ -0,0 +1,622 @@
+/*Coupled integration of thermal conduction and magnetic diffusion with the
+Alternating Direction Implicit algorithm: T and B*r are advanced together (Douglas-Rachford
+scheme) and every line is solved as a 2x2 block tridiagonal system, where the Joule heating
+and the dependence of eta on T are linearized inside the implicit operator*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "adi.h"
+#include "capillary_wall.h"
+#include "debug_utilities.h"
+
+#if COUPLED_TC_RES
+
+/*Relative tollerance for checking that at each call of an ADI scheme, the algorithm advances for all the reqired total time*/
+#define DT_REL_TOLL  1e-8
+/*Relative perturbation of T used to compute d(ln(eta))/dT by centered differences*/
+#define DLNETA_DT_REL_DELTA 1e-3
+
+/* Element of a 2D array (indexed [j][i]) addressed by line index (n) and position along the line (p)*/
+#define LINE_ELEM(a, dir, n, p) (*((dir) == IDIR ? &((a)[n][p]) : &((a)[p][n])))
+
+/* Linearization (around the state at the beginning of a sub-step) of the Joule
+   heating (Q) and of the resistive term of the B*r equation (N) in one direction.
+   m, 0, p refer to the previous cell, the cell itself and the next cell along the line*/
+typedef struct COUPLED_LIN {
+  double **Qs;                        /**< Joule heating at the linearization point */
+  double **dQdTm, **dQdT0, **dQdTp;   /**< Derivatives of Q with respect to T */
+  double **dQdBm, **dQdB0, **dQdBp;   /**< Derivatives of Q with respect to B*r */
+  double **dNdTm, **dNdT0, **dNdTp;   /**< Derivatives of N with respect to T */
+} CoupledLin;
+
+static void AllocCoupledLin(CoupledLin *lin);
+static void BuildEtaCoupled(const Data *d, Grid *grid, Lines *lines, double **T,
+                            double **eta, double **dlneta_dT);
+static void LinearizeCoupled(CoupledLin *lin, double **HpB, double **HmB, double **CB_1,
+                             double **Br, double **eta, double **dlneta_dT,
+                             Grid *grid, Lines *lines, int dir);
+static double JouleLin(CoupledLin *lin, double **T, double **Br,
+                       double **T_lin, double **Br_lin, int dir, int n, int p);
+static void CoupledExplicitUpdate(double **T, double **Br, double **T_b, double **Br_b,
+                                  double **T_der, double **Br_der, double **T_lin, double **Br_lin,
+                                  CoupledLin *lin, double **HpT, double **HmT, double **CT_1,
+                                  double **HpB, double **HmB, double **CB_1, double **dEdT,
+                                  double **dUjoule, Lines *lines, double dt, int dir);
+static void CoupledImplicitUpdate(double **T, double **Br, double **T_b, double **Br_b,
+                                  double **T_lin, double **Br_lin,
+                                  CoupledLin *lin, double **HpT, double **HmT, double **CT_1,
+                                  double **HpB, double **HmB, double **CB_1, double **dEdT,
+                                  double **dUjoule, Lines *lines, double dt, int dir);
+static void ConductionInflow(double **T, double **Hp, double **Hm, Lines *lines,
+                             Grid *grid, double dt, int dir);
+
+/* ***********************************************************
+ * Douglas-Rachford ADI method for the coupled (T, B*r) problem.
+ * It is the same scheme as DouglasRachford(), but the unknown
+ * in every cell is the couple (T, B*r).
+ *
+ * input: int order = FIRST_IDIR or FIRST_JDIR
+ *        M = number of sub-steps
+ * output: T_new, Br_new
+ *         **dUres: energy given by the electro-magnetic (poynting) flux
+ *                  (computed exactly as in DouglasRachford())
+ *         **dUjoule: Joule heating that has been put into T_new by the linearized
+ *                    operator (it must be subtracted from dEdT*(T_new-T_old) when the
+ *                    energy is updated, since the Joule effect is already in dUres)
+ *         **dEdT: updated when the operators are recomputed
+ * ***********************************************************/
+void DouglasRachfordCoupled(double **T_new, double **T_old,
+                            double **Br_new, double **Br_old,
+                            double **dUres, double **dUjoule, double **dEdT,
+                            const Data *d, Grid *grid, Lines *lines, int order,
+                            double dt, double t0, int M, int recompute_operators) {
+
+  static double **T_aux, **T_hat, **T_old_aux;
+  static double **Br_aux, **Br_hat, **Br_old_aux;
+  /* Linearization point, one per direction since the ghosts depend on the direction
+     (the cell at the internal corner of the capillary is a ghost for both) */
+  static double **T_lin[2], **Br_lin[2];
+  static double **IpT, **ImT, **CIT, **JpT, **JmT, **CJT;
+  static double **IpB, **ImB, **CIB, **JpB, **JmB, **CJB;
+  static double **eta, **dlneta_dT;
+  static double **dUres_aux;
+  static CoupledLin lin[2];
+  static int first_call = 1;
+  double **HpT[2], **HmT[2], **CT_1[2], **HpB[2], **HmB[2], **CB_1[2];
+  int dir, dir1, dir2;
+  int l,i,j,s;
+  double dts;
+  double t_now;
+
+  if (first_call) {
+    T_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    T_hat = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    T_old_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    Br_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    Br_hat = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    Br_old_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    for (dir = IDIR; dir <= JDIR; dir++) {
+      T_lin[dir] = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      Br_lin[dir] = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    }
+    dUres_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+
+    IpT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    ImT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JpT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JmT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    CIT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    CJT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    IpB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    ImB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JpB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JmB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    CIB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    CJB = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+
+    eta = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    dlneta_dT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    AllocCoupledLin(&lin[IDIR]);
+    AllocCoupledLin(&lin[JDIR]);
+
+    first_call = 0;
+  }
+
+  /* Operators sorted by direction */
+  HpT[IDIR] = IpT;  HmT[IDIR] = ImT;  CT_1[IDIR] = CIT;
+  HpT[JDIR] = JpT;  HmT[JDIR] = JmT;  CT_1[JDIR] = CJT;
+  HpB[IDIR] = IpB;  HmB[IDIR] = ImB;  CB_1[IDIR] = CIB;
+  HpB[JDIR] = JpB;  HmB[JDIR] = JmB;  CB_1[JDIR] = CJB;
+
+  if (order == FIRST_IDIR) {
+    dir1 = IDIR;  dir2 = JDIR;
+  } else {
+    dir1 = JDIR;  dir2 = IDIR;
+  }
+
+  // I copy the old values inside the aux. arrays, as they will be modified in the cycle
+  LINES_LOOP(lines[IDIR], l, j, i) {
+    T_old_aux[j][i] = T_old[j][i];
+    Br_old_aux[j][i] = Br_old[j][i];
+    dUres[j][i] = 0.0;
+    dUjoule[j][i] = 0.0;
+  }
+
+  dts = dt/M;
+  t_now = t0;
+
+  for (dir = IDIR; dir <= JDIR; dir++) {
+    BoundaryADI_TC(lines, d, grid, t_now, dir);
+    BoundaryADI_Res(lines, d, grid, t_now, dir);
+  }
+
+  if (recompute_operators) {
+    BuildIJ_TC(d, grid, lines, IpT, ImT, JpT, JmT, CIT, CJT, dEdT);
+    BuildIJ_Res(d, grid, lines, IpB, ImB, JpB, JmB, CIB, CJB, NULL);
+    BuildEtaCoupled(d, grid, lines, T_old, eta, dlneta_dT);
+  }
+
+  for (s=0; s<M; s++) {
+
+    /* ---- Linearization around the state at the beginning of the sub-step ---- */
+    for (dir = IDIR; dir <= JDIR; dir++) {
+      BoundaryADI_TC(lines, d, grid, t_now, dir);
+      BoundaryADI_Res(lines, d, grid, t_now, dir);
+      for (j = 0; j < NX2_TOT; j++) {
+        for (i = 0; i < NX1_TOT; i++) {
+          T_lin[dir][j][i] = T_old_aux[j][i];
+          Br_lin[dir][j][i] = Br_old_aux[j][i];
+        }
+      }
+      ApplyBCsonGhosts(T_lin[dir], &lines[dir], lines[dir].lbound[TDIFF], lines[dir].rbound[TDIFF], dir);
+      ApplyBCsonGhosts(Br_lin[dir], &lines[dir], lines[dir].lbound[BDIFF], lines[dir].rbound[BDIFF], dir);
+      LinearizeCoupled(&lin[dir], HpB[dir], HmB[dir], CB_1[dir], Br_lin[dir],
+                       eta, dlneta_dT, grid, lines, dir);
+    }
+
+    /**********************************
+     (a.1) Explicit update sweeping DIR1
+    **********************************/
+    CoupledExplicitUpdate(T_aux, Br_aux, T_old_aux, Br_old_aux, T_lin[dir1], Br_lin[dir1],
+                          T_lin[dir1], Br_lin[dir1], &lin[dir1],
+                          HpT[dir1], HmT[dir1], CT_1[dir1], HpB[dir1], HmB[dir1], CB_1[dir1],
+                          dEdT, NULL, &lines[dir1], dts, dir1);
+
+    /**********************************
+     (a.2) Implicit update sweeping DIR2
+    **********************************/
+    BoundaryADI_TC(lines, d, grid, t_now + dts, dir2);
+    BoundaryADI_Res(lines, d, grid, t_now + dts, dir2);
+    CoupledImplicitUpdate(T_hat, Br_hat, T_aux, Br_aux, T_lin[dir2], Br_lin[dir2], &lin[dir2],
+                          HpT[dir2], HmT[dir2], CT_1[dir2], HpB[dir2], HmB[dir2], CB_1[dir2],
+                          dEdT, NULL, &lines[dir2], dts, dir2);
+
+    /**********************************
+     (b.1) Explicit update sweeping DIR2
+    **********************************/
+    CoupledExplicitUpdate(T_aux, Br_aux, T_old_aux, Br_old_aux, T_hat, Br_hat,
+                          T_lin[dir2], Br_lin[dir2], &lin[dir2],
+                          HpT[dir2], HmT[dir2], CT_1[dir2], HpB[dir2], HmB[dir2], CB_1[dir2],
+                          dEdT, dUjoule, &lines[dir2], dts, dir2);
+    #if EN_CONS_CHECK
+      ConductionInflow(T_hat, HpT[dir2], HmT[dir2], &lines[dir2], grid, dts, dir2);
+    #endif
+
+    /**********************************
+     (b.2) Implicit update sweeping DIR1
+    **********************************/
+    BoundaryADI_TC(lines, d, grid, t_now + dts, dir1);
+    BoundaryADI_Res(lines, d, grid, t_now + dts, dir1);
+    CoupledImplicitUpdate(T_old_aux, Br_old_aux, T_aux, Br_aux, T_lin[dir1], Br_lin[dir1], &lin[dir1],
+                          HpT[dir1], HmT[dir1], CT_1[dir1], HpB[dir1], HmB[dir1], CB_1[dir1],
+                          dEdT, dUjoule, &lines[dir1], dts, dir1);
+    #if EN_CONS_CHECK
+      ConductionInflow(T_old_aux, HpT[dir1], HmT[dir1], &lines[dir1], grid, dts, dir1);
+    #endif
+
+    /* ---- Electro-magnetic energy, as in DouglasRachford() ---- */
+    ApplyBCsonGhosts(Br_old_aux, &lines[dir2], lines[dir2].lbound[BDIFF], lines[dir2].rbound[BDIFF], dir2);
+    ResEnergyIncreaseDR(dUres_aux, HpB[dir2], HmB[dir2], Br_old_aux, Br_hat, grid, &lines[dir2],
+                        dts, dir2);
+    LINES_LOOP(lines[IDIR], l, j, i)
+      dUres[j][i] += dUres_aux[j][i];
+    ResEnergyIncrease(dUres_aux, HpB[dir1], HmB[dir1], Br_old_aux, grid, &lines[dir1],
+                      EN_CONS_CHECK, &en_res_in, dts, dir1);
+    LINES_LOOP(lines[IDIR], l, j, i)
+      dUres[j][i] += dUres_aux[j][i];
+
+    t_now += dts;
+  }
+
+  LINES_LOOP(lines[IDIR], l, j, i) {
+    T_new[j][i] = T_old_aux[j][i];
+    Br_new[j][i] = Br_old_aux[j][i];
+  }
+
+  if (fabs((t_now-t0) - dt)/dt > DT_REL_TOLL) {
+    print1("\nInaccurate dt, actual dt performed: %le, desired: %le\n", t_now-t0, dt);
+  }
+}
+
+/****************************************************************************
+Allocates the arrays of a CoupledLin structure
+*****************************************************************************/
+void AllocCoupledLin(CoupledLin *lin) {
+  lin->Qs = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dQdTm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dQdT0 = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dQdTp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dQdBm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dQdB0 = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dQdBp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dNdTm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dNdT0 = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  lin->dNdTp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+}
+
+/****************************************************************************
+Computes eta (the same used by BuildIJ_Res()) on the cells of the lines and on
+the ghosts next to them, and d(ln(eta))/dT (T in code units) on the cells of the lines
+(it is left 0 on the ghosts, whose T is not an unknown).
+The derivative is computed by centered differences, perturbing T at fixed rho
+(the pressure is rebuilt from the perturbed T)
+*****************************************************************************/
+void BuildEtaCoupled(const Data *d, Grid *grid, Lines *lines, double **T,
+                     double **eta, double **dlneta_dT) {
+  int i,j,k,l,nv,side;
+  double v[NVAR], vpm[NVAR];
+  double eta_c[3], eta_p[3], eta_m[3];
+  double T_K, Tpm, mu;
+  double ****Vc = d->Vc;
+  double *r, *z, *theta;
+
+  r = grid[IDIR].x;
+  z = grid[JDIR].x;
+  theta = grid[KDIR].x;
+
+  TOT_LOOP(k,j,i)
+    dlneta_dT[j][i] = 0.0;
+
+  KDOM_LOOP(k) {
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      for (nv=NVAR; nv--;) v[nv] = vpm[nv] = Vc[nv][k][j][i];
+      Resistive_eta(v, r[i], z[j], theta[k], NULL, eta_c);
+      eta[j][i] = eta_c[0];
+
+      T_K = T[j][i]*KELVIN;
+      Tpm = T_K*(1 + DLNETA_DT_REL_DELTA);
+      GetMu(Tpm, v[RHO], &mu);
+      vpm[PRS] = v[RHO]*Tpm/(KELVIN*mu);
+      Resistive_eta(vpm, r[i], z[j], theta[k], NULL, eta_p);
+      Tpm = T_K*(1 - DLNETA_DT_REL_DELTA);
+      GetMu(Tpm, v[RHO], &mu);
+      vpm[PRS] = v[RHO]*Tpm/(KELVIN*mu);
+      Resistive_eta(vpm, r[i], z[j], theta[k], NULL, eta_m);
+
+      dlneta_dT[j][i] = log(eta_p[0]/eta_m[0]) / (2*DLNETA_DT_REL_DELTA*T[j][i]);
+    }
+
+    /* Ghosts next to the lines */
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        i = side ? lines[IDIR].ridx[l]+1 : lines[IDIR].lidx[l]-1;
+        for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+        Resistive_eta(v, r[i], z[j], theta[k], NULL, eta_c);
+        eta[j][i] = eta_c[0];
+      }
+    }
+    for (l = 0; l < lines[JDIR].N; l++) {
+      i = lines[JDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        j = side ? lines[JDIR].ridx[l]+1 : lines[JDIR].lidx[l]-1;
+        for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+        Resistive_eta(v, r[i], z[j], theta[k], NULL, eta_c);
+        eta[j][i] = eta_c[0];
+      }
+    }
+  }
+}
+
+/****************************************************************************
+Linearizes, in direction dir, the Joule heating Q and the resistive term N of the
+B*r equation around Br (its ghosts must already be set).
+On every interface the Joule heating is eta*J^2 = G*H*(Delta(B*r))^2 (G is a geometric
+factor and H=Ip,Im,Jp,Jm of BuildIJ_Res()), the one of a cell is the average of its two
+interfaces (on the axis interface J is not defined, so I only use the other one).
+H depends on the T of the two cells of the interface through the harmonic average of eta.
+*****************************************************************************/
+void LinearizeCoupled(CoupledLin *lin, double **HpB, double **HmB, double **CB_1,
+                      double **Br, double **eta, double **dlneta_dT,
+                      Grid *grid, Lines *lines, int dir) {
+  int l, n, p, lidx, ridx;
+  int Nlines = lines[dir].N;
+  double *dr, *inv_dri, *rL, *rR, *r_1;
+  double *dz, *inv_dzi;
+  double Gp, Gm, wp, wm;
+  double Hp, Hm, Dp, Dm, qp, qm;
+  double ap, am; // weights of the T of the cell in the harmonic average of eta (interfaces p and m)
+  double s0, sm, sp;
+
+  dr = grid[IDIR].dx;
+  inv_dri = grid[IDIR].inv_dxi;
+  rL = grid[IDIR].xl;
+  rR = grid[IDIR].xr;
+  r_1 = grid[IDIR].r_1;
+  dz = grid[JDIR].dx;
+  inv_dzi = grid[JDIR].inv_dxi;
+
+  for (l = 0; l < Nlines; l++) {
+    n = lines[dir].dom_line_idx[l];
+    lidx = lines[dir].lidx[l];
+    ridx = lines[dir].ridx[l];
+
+    for (p = lidx; p <= ridx; p++) {
+      wp = wm = 0.5;
+      if (dir == IDIR) {
+        Gp = dr[p]*inv_dri[p]/rR[p];
+        if (rL[p] != 0.0) {
+          Gm = dr[p]*inv_dri[p-1]/rL[p];
+        } else {
+          Gm = 0.0;
+          wp = 1.0; wm = 0.0;
+        }
+      } else {
+        Gp = dz[p]*inv_dzi[p]*r_1[n]*r_1[n];
+        Gm = dz[p]*inv_dzi[p-1]*r_1[n]*r_1[n];
+      }
+
+      Hp = LINE_ELEM(HpB, dir, n, p);
+      Hm = LINE_ELEM(HmB, dir, n, p);
+      Dp = LINE_ELEM(Br, dir, n, p+1) - LINE_ELEM(Br, dir, n, p);
+      Dm = LINE_ELEM(Br, dir, n, p) - LINE_ELEM(Br, dir, n, p-1);
+      qp = Gp*Hp*Dp*Dp;
+      qm = Gm*Hm*Dm*Dm;
+      ap = LINE_ELEM(eta, dir, n, p+1) / (LINE_ELEM(eta, dir, n, p) + LINE_ELEM(eta, dir, n, p+1));
+      am = LINE_ELEM(eta, dir, n, p-1) / (LINE_ELEM(eta, dir, n, p) + LINE_ELEM(eta, dir, n, p-1));
+      s0 = LINE_ELEM(dlneta_dT, dir, n, p);
+      sp = LINE_ELEM(dlneta_dT, dir, n, p+1);
+      sm = LINE_ELEM(dlneta_dT, dir, n, p-1);
+
+      /* :::: Joule heating :::: */
+      LINE_ELEM(lin->Qs, dir, n, p) = wp*qp + wm*qm;
+      LINE_ELEM(lin->dQdBp, dir, n, p) = 2*wp*Gp*Hp*Dp;
+      LINE_ELEM(lin->dQdBm, dir, n, p) = -2*wm*Gm*Hm*Dm;
+      LINE_ELEM(lin->dQdB0, dir, n, p) = -2*wp*Gp*Hp*Dp + 2*wm*Gm*Hm*Dm;
+      LINE_ELEM(lin->dQdT0, dir, n, p) = (wp*qp*ap + wm*qm*am)*s0;
+      LINE_ELEM(lin->dQdTp, dir, n, p) = wp*qp*(1-ap)*sp;
+      LINE_ELEM(lin->dQdTm, dir, n, p) = wm*qm*(1-am)*sm;
+
+      /* :::: Resistive term of the B*r equation :::: */
+      LINE_ELEM(lin->dNdT0, dir, n, p) = (Hp*ap*Dp - Hm*am*Dm)*s0*LINE_ELEM(CB_1, dir, n, p);
+      LINE_ELEM(lin->dNdTp, dir, n, p) = Hp*(1-ap)*Dp*sp*LINE_ELEM(CB_1, dir, n, p);
+      LINE_ELEM(lin->dNdTm, dir, n, p) = -Hm*(1-am)*Dm*sm*LINE_ELEM(CB_1, dir, n, p);
+    }
+  }
+}
+
+/****************************************************************************
+Returns the linearized Joule heating (direction dir) of the cell (n,p) evaluated on (T, Br)
+*****************************************************************************/
+double JouleLin(CoupledLin *lin, double **T, double **Br,
+                double **T_lin, double **Br_lin, int dir, int n, int p) {
+  return LINE_ELEM(lin->Qs, dir, n, p)
+       + LINE_ELEM(lin->dQdTm, dir, n, p)*(LINE_ELEM(T, dir, n, p-1) - LINE_ELEM(T_lin, dir, n, p-1))
+       + LINE_ELEM(lin->dQdT0, dir, n, p)*(LINE_ELEM(T, dir, n, p)   - LINE_ELEM(T_lin, dir, n, p))
+       + LINE_ELEM(lin->dQdTp, dir, n, p)*(LINE_ELEM(T, dir, n, p+1) - LINE_ELEM(T_lin, dir, n, p+1))
+       + LINE_ELEM(lin->dQdBm, dir, n, p)*(LINE_ELEM(Br, dir, n, p-1) - LINE_ELEM(Br_lin, dir, n, p-1))
+       + LINE_ELEM(lin->dQdB0, dir, n, p)*(LINE_ELEM(Br, dir, n, p)   - LINE_ELEM(Br_lin, dir, n, p))
+       + LINE_ELEM(lin->dQdBp, dir, n, p)*(LINE_ELEM(Br, dir, n, p+1) - LINE_ELEM(Br_lin, dir, n, p+1));
+}
+
+/****************************************************************************
+Coupled explicit update (the analogous of ExplicitUpdateDR()):
+(T, Br) = (T_b, Br_b) + dt*A*(T_der, Br_der), where A is the linearized operator
+of direction dir. The ghosts of T_der and Br_der must already be set.
+If dUjoule != NULL the Joule heating given to T is added to it.
+*****************************************************************************/
+void CoupledExplicitUpdate(double **T, double **Br, double **T_b, double **Br_b,
+                           double **T_der, double **Br_der, double **T_lin, double **Br_lin,
+                           CoupledLin *lin, double **HpT, double **HmT, double **CT_1,
+                           double **HpB, double **HmB, double **CB_1, double **dEdT,
+                           double **dUjoule, Lines *lines, double dt, int dir) {
+  int l, n, p, lidx, ridx;
+  int Nlines = lines->N;
+  double Q, rate_T, rate_B;
+
+  for (l = 0; l < Nlines; l++) {
+    n = lines->dom_line_idx[l];
+    lidx = lines->lidx[l];
+    ridx = lines->ridx[l];
+
+    for (p = lidx; p <= ridx; p++) {
+      Q = JouleLin(lin, T_der, Br_der, T_lin, Br_lin, dir, n, p);
+
+      rate_T = ( LINE_ELEM(HpT, dir, n, p)*(LINE_ELEM(T_der, dir, n, p+1) - LINE_ELEM(T_der, dir, n, p))
+                -LINE_ELEM(HmT, dir, n, p)*(LINE_ELEM(T_der, dir, n, p) - LINE_ELEM(T_der, dir, n, p-1)) )
+               * LINE_ELEM(CT_1, dir, n, p)
+               + Q/LINE_ELEM(dEdT, dir, n, p);
+
+      rate_B = ( LINE_ELEM(HpB, dir, n, p)*(LINE_ELEM(Br_der, dir, n, p+1) - LINE_ELEM(Br_der, dir, n, p))
+                -LINE_ELEM(HmB, dir, n, p)*(LINE_ELEM(Br_der, dir, n, p) - LINE_ELEM(Br_der, dir, n, p-1)) )
+               * LINE_ELEM(CB_1, dir, n, p)
+               + LINE_ELEM(lin->dNdTm, dir, n, p)*(LINE_ELEM(T_der, dir, n, p-1) - LINE_ELEM(T_lin, dir, n, p-1))
+               + LINE_ELEM(lin->dNdT0, dir, n, p)*(LINE_ELEM(T_der, dir, n, p)   - LINE_ELEM(T_lin, dir, n, p))
+               + LINE_ELEM(lin->dNdTp, dir, n, p)*(LINE_ELEM(T_der, dir, n, p+1) - LINE_ELEM(T_lin, dir, n, p+1));
+
+      LINE_ELEM(T, dir, n, p) = LINE_ELEM(T_b, dir, n, p) + dt*rate_T;
+      LINE_ELEM(Br, dir, n, p) = LINE_ELEM(Br_b, dir, n, p) + dt*rate_B;
+
+      if (dUjoule != NULL)
+        LINE_ELEM(dUjoule, dir, n, p) += dt*Q;
+    }
+  }
+}
+
+/****************************************************************************
+Coupled implicit update (the analogous of ImplicitUpdate()):
+solves (I - dt*A)(T, Br) = (T_b, Br_b), A being the linearized operator of direction dir,
+as a 2x2 block tridiagonal system on every line.
+The bcs (which must be already set in lines) are put inside the matrix as in ImplicitUpdate()
+and then applied on the ghosts of the solution.
+If dUjoule != NULL the Joule heating given to T is added to it.
+*****************************************************************************/
+void CoupledImplicitUpdate(double **T, double **Br, double **T_b, double **Br_b,
+                           double **T_lin, double **Br_lin,
+                           CoupledLin *lin, double **HpT, double **HmT, double **CT_1,
+                           double **HpB, double **HmB, double **CB_1, double **dEdT,
+                           double **dUjoule, Lines *lines, double dt, int dir) {
+  static int first_call = 1;
+  /* Blocks are stored as {TT, TB, BT, BB}, (T,B*r) couples as {T, B*r} */
+  static double (*lower)[4], (*diagonal)[4], (*upper)[4], (*rhs)[2], (*x)[2];
+  double L[4], D[4], U[4], f[2];
+  double aT, mT, aB, mB;
+  double dEdT_c, CT_1c, CB_1c;
+  Bcs *bT, *bB;
+  int l, n, p, lidx, ridx, side, q;
+  int Nlines = lines->N;
+
+  if (first_call) {
+    lower = (double (*)[4]) ARRAY_1D(4*MAX(NX1_TOT, NX2_TOT), double);
+    diagonal = (double (*)[4]) ARRAY_1D(4*MAX(NX1_TOT, NX2_TOT), double);
+    upper = (double (*)[4]) ARRAY_1D(4*MAX(NX1_TOT, NX2_TOT), double);
+    rhs = (double (*)[2]) ARRAY_1D(2*MAX(NX1_TOT, NX2_TOT), double);
+    x = (double (*)[2]) ARRAY_1D(2*MAX(NX1_TOT, NX2_TOT), double);
+    first_call = 0;
+  }
+
+  for (l = 0; l < Nlines; l++) {
+    n = lines->dom_line_idx[l];
+    lidx = lines->lidx[l];
+    ridx = lines->ridx[l];
+
+    for (p = lidx; p <= ridx; p++) {
+      dEdT_c = LINE_ELEM(dEdT, dir, n, p);
+      CT_1c = LINE_ELEM(CT_1, dir, n, p);
+      CB_1c = LINE_ELEM(CB_1, dir, n, p);
+
+      /* :::: Blocks of the linearized operator A (rates) :::: */
+      L[0] = LINE_ELEM(HmT, dir, n, p)*CT_1c + LINE_ELEM(lin->dQdTm, dir, n, p)/dEdT_c;
+      L[1] = LINE_ELEM(lin->dQdBm, dir, n, p)/dEdT_c;
+      L[2] = LINE_ELEM(lin->dNdTm, dir, n, p);
+      L[3] = LINE_ELEM(HmB, dir, n, p)*CB_1c;
+
+      D[0] = -(LINE_ELEM(HpT, dir, n, p) + LINE_ELEM(HmT, dir, n, p))*CT_1c
+             + LINE_ELEM(lin->dQdT0, dir, n, p)/dEdT_c;
+      D[1] = LINE_ELEM(lin->dQdB0, dir, n, p)/dEdT_c;
+      D[2] = LINE_ELEM(lin->dNdT0, dir, n, p);
+      D[3] = -(LINE_ELEM(HpB, dir, n, p) + LINE_ELEM(HmB, dir, n, p))*CB_1c;
+
+      U[0] = LINE_ELEM(HpT, dir, n, p)*CT_1c + LINE_ELEM(lin->dQdTp, dir, n, p)/dEdT_c;
+      U[1] = LINE_ELEM(lin->dQdBp, dir, n, p)/dEdT_c;
+      U[2] = LINE_ELEM(lin->dNdTp, dir, n, p);
+      U[3] = LINE_ELEM(HpB, dir, n, p)*CB_1c;
+
+      /* :::: Constant part of the linearized operator :::: */
+      f[0] = ( LINE_ELEM(lin->Qs, dir, n, p)
+              -LINE_ELEM(lin->dQdTm, dir, n, p)*LINE_ELEM(T_lin, dir, n, p-1)
+              -LINE_ELEM(lin->dQdT0, dir, n, p)*LINE_ELEM(T_lin, dir, n, p)
+              -LINE_ELEM(lin->dQdTp, dir, n, p)*LINE_ELEM(T_lin, dir, n, p+1)
+              -LINE_ELEM(lin->dQdBm, dir, n, p)*LINE_ELEM(Br_lin, dir, n, p-1)
+              -LINE_ELEM(lin->dQdB0, dir, n, p)*LINE_ELEM(Br_lin, dir, n, p)
+              -LINE_ELEM(lin->dQdBp, dir, n, p)*LINE_ELEM(Br_lin, dir, n, p+1) ) / dEdT_c;
+      f[1] = -LINE_ELEM(lin->dNdTm, dir, n, p)*LINE_ELEM(T_lin, dir, n, p-1)
+             -LINE_ELEM(lin->dNdT0, dir, n, p)*LINE_ELEM(T_lin, dir, n, p)
+             -LINE_ELEM(lin->dNdTp, dir, n, p)*LINE_ELEM(T_lin, dir, n, p+1);
+
+      /* :::: Matrix of the system (I - dt*A) :::: */
+      for (q = 0; q < 4; q++) {
+        lower[p][q] = -dt*L[q];
+        diagonal[p][q] = -dt*D[q];
+        upper[p][q] = -dt*U[q];
+      }
+      diagonal[p][0] += 1.0;
+      diagonal[p][3] += 1.0;
+      rhs[p][0] = LINE_ELEM(T_b, dir, n, p) + dt*f[0];
+      rhs[p][1] = LINE_ELEM(Br_b, dir, n, p) + dt*f[1];
+    }
+
+    /* :::: Bcs: the ghost is written as a + m*(value in the first/last cell) :::: */
+    for (side = 0; side < 2; side++) {
+      bT = side ? &lines->rbound[TDIFF][l] : &lines->lbound[TDIFF][l];
+      bB = side ? &lines->rbound[BDIFF][l] : &lines->lbound[BDIFF][l];
+      if (bT->kind == DIRICHLET) {
+        aT = 2*bT->values[0];  mT = -1.0;
+      } else if (bT->kind == NEUMANN_HOM) {
+        aT = 0.0;  mT = 1.0;
+      } else {
+        print1("\n[CoupledImplicitUpdate]Error setting bc for T, not known bc kind!");
+        QUIT_PLUTO(1);
+      }
+      if (bB->kind == DIRICHLET) {
+        aB = 2*bB->values[0];  mB = -1.0;
+      } else if (bB->kind == NEUMANN_HOM) {
+        aB = 0.0;  mB = 1.0;
+      } else {
+        print1("\n[CoupledImplicitUpdate]Error setting bc for B*r, not known bc kind!");
+        QUIT_PLUTO(1);
+      }
+      p = side ? ridx : lidx;
+      for (q = 0; q < 4; q++)
+        L[q] = side ? upper[p][q] : lower[p][q];
+      diagonal[p][0] += L[0]*mT;
+      diagonal[p][1] += L[1]*mB;
+      diagonal[p][2] += L[2]*mT;
+      diagonal[p][3] += L[3]*mB;
+      rhs[p][0] -= L[0]*aT + L[1]*aB;
+      rhs[p][1] -= L[2]*aT + L[3]*aB;
+    }
+
+    /* --- Now I solve the system --- */
+    btdm_solver(x+lidx, diagonal+lidx, upper+lidx, lower+lidx+1, rhs+lidx, ridx-lidx+1);
+    for (p = lidx; p <= ridx; p++) {
+      LINE_ELEM(T, dir, n, p) = x[p][0];
+      LINE_ELEM(Br, dir, n, p) = x[p][1];
+    }
+  }
+
+  ApplyBCsonGhosts(T, lines, lines->lbound[TDIFF], lines->rbound[TDIFF], dir);
+  ApplyBCsonGhosts(Br, lines, lines->lbound[BDIFF], lines->rbound[BDIFF], dir);
+
+  if (dUjoule != NULL) {
+    for (l = 0; l < Nlines; l++) {
+      n = lines->dom_line_idx[l];
+      for (p = lines->lidx[l]; p <= lines->ridx[l]; p++)
+        LINE_ELEM(dUjoule, dir, n, p) += dt*JouleLin(lin, T, Br, T_lin, Br_lin, dir, n, p);
+    }
+  }
+}
+
+/****************************************************************************
+Adds to en_tc_in the energy entered by conduction through the boundaries of the lines
+(same formulas of ExplicitUpdateDR()), the ghosts of T must already be set
+*****************************************************************************/
+void ConductionInflow(double **T, double **Hp, double **Hm, Lines *lines,
+                      Grid *grid, double dt, int dir) {
+  int l, n, lidx, ridx;
+  double *rR, *rL, *dz;
+  double area;
+
+  rR = grid[IDIR].xr_glob;
+  rL = grid[IDIR].xl_glob;
+  dz = grid[JDIR].dx_glob;
+
+  for (l = 0; l < lines->N; l++) {
+    n = lines->dom_line_idx[l];
+    lidx = lines->lidx[l];
+    ridx = lines->ridx[l];
+    if (dir == IDIR)
+      area = 2*CONST_PI*dz[n];
+    else
+      area = CONST_PI*(rR[n]*rR[n]-rL[n]*rL[n]);
+    en_tc_in += (LINE_ELEM(T, dir, n, lidx-1) - LINE_ELEM(T, dir, n, lidx))
+                * LINE_ELEM(Hm, dir, n, lidx) * area * dt;
+    en_tc_in += (LINE_ELEM(T, dir, n, ridx+1) - LINE_ELEM(T, dir, n, ridx))
+                * LINE_ELEM(Hp, dir, n, ridx) * area * dt;
+  }
+}
+#endif
@@ -77,6 +77,9 @@ Method for Thermal conduction and Resisitivity (when ADI is chosen), available c
   - DOUGLAS_RACHFORD
   - PEACEMAN_RACHFORD_MOD
   - STRANG
+  - JFNK (only for thermal conduction: Newton-Krylov solution of the nonlinear
+    backward Euler step, with an ADI sweep as preconditioner. NSUBS_TC is not
+    used, so NSUBS_ADI_TOT can be lowered too)
 */
 #define METHOD_TC                  DOUGLAS_RACHFORD
 #define METHOD_RES                 DOUGLAS_RACHFORD
@@ -91,6 +94,50 @@ Set the period (in number of total adi-diffusive steps) for recomputation of dis
 */
 #define DIFF_OP_RECOMPUTE_PERIOD   3
 /*
+If YES, the temperature advanced by the thermal conduction ADI is kept between
+sub-iterations (and between steps) instead of re-inverting the EOS every time.
+It is corrected for Joule heating and, once per step, for the advective change
+of energy (one Newton step starting from the previous T)
+*/
+#define CARRY_T_ADI                YES
+/*
+If YES, when the temperature of a cell is computed from its state (cell_state.c) the
+EOS is inverted by Newton iterations starting from the temperature the cell had in the
+previous state, instead of the full search of GetPV_Temperature() (used only when they
+do not converge). Every WARM_T_REPORT_PERIOD steps the iteration counts are printed.
+*/
+#define WARM_T_INVERSION           YES
+#define WARM_T_REPORT_PERIOD       100
+/*
+If YES, ConsToPrimLines() (after every ADI sub-iteration) inverts the EOS on whole stripes
+of cells at once, by Newton iterations in lock-step (GetEV_TemperatureStripe() of
+pvte_law.c, vectorized with AVX2), starting from the temperatures of the previous call.
+It is faster than ConsToPrim() only if the code is compiled with -mavx2 -mfma (commented
+out in local_make): set it to YES only together with those flags
+*/
+#define STRIPE_T_INVERSION         NO
+/*
+If YES, the temperature is looked up in tables of the inverse EOS, T(rho, p) and
+T(rho, rhoe), built at the start (inv_eos_table.c) on INV_EOS_N_RHO x INV_EOS_N_Q nodes
+covering RHO_TAB_MIN..RHO_TAB_MAX and T_TAB_MIN..T_TAB_MAX; the iterative inversions
+are used only outside them. If INV_EOS_BENCHMARK is YES, the lookups are compared
+(time and accuracy) with the iterative inversions once, after building the tables.
+*/
+#define INV_EOS_TABLE              YES
+#define INV_EOS_N_RHO              100
+#define INV_EOS_N_Q                400
+#define INV_EOS_BENCHMARK          NO
+/*
+If YES, thermal conduction and magnetic diffusion are advanced together by a
+Douglas-Rachford scheme whose unknowns are T and B*r (2x2 block tridiagonal lines):
+the Joule heating and the dependence of eta on T are linearized inside the
+implicit operator, so that they do not need to be resolved by sub-iterations.
+In this case METHOD_TC, METHOD_RES, NSUBS_TC and NSUBS_RES are not used and the
+scheme does NSUBS_COUPLED sub-steps.
+*/
+#define COUPLED_TC_RES             NO
+#define NSUBS_COUPLED              30
+/*
 Number of sub-iterations for the thermal conduction scheme (the
 conservative variables and kappa, are not updated between two iterations)
 */
@@ -101,6 +148,41 @@ conservative variables and eta, are not updated between two iterations)
 */
 #define NSUBS_RES                  70
 
+/*
+If YES, an optically thin radiative loss rate, read from the table rad_loss.dat (same
+format of the eta/kappa tables, values in erg/(cm^3 s)), is a linearized implicit sink
+of the thermal conduction (DOUGLAS_RACHFORD only), so it does not limit dt (COOLING stays NO)
+*/
+#define RAD_LOSS_ADI               NO
+/*
+If YES, viscosity (Visc_nu(), VISCOSITY must stay NO) is integrated implicitly inside ADI(),
+as two more diffusion problems (r*vr and vz) solved with DouglasRachford, with
+no-slip bcs on the capillary walls
+*/
+#define VISCOSITY_ADI              NO
+/*
+Number of sub-iterations for the viscosity scheme
+*/
+#define NSUBS_VISC                 10
+/*
+If YES, when the next ADI sub-iteration has to recompute the diffusion operators
+(see DIFF_OP_RECOMPUTE_PERIOD), they are rebuilt on a helper thread from a snapshot of
+the current state, while the sweeps of the current sub-iteration run (DOUGLAS_RACHFORD only).
+The operators are then built from the state at the start of the previous sub-iteration
+(but those of the first sub-iteration of every step, built on the main thread).
+With DIFF_OP_RECOMPUTE_PERIOD 1 the rebuild for the next sub-iteration overlaps the
+current one, with a larger period it overlaps the whole sub-iteration before the rebuild.
+Every ASYNC_OP_REPORT_PERIOD steps the rebuild time hidden behind the sweeps is printed.
+*/
+#define ASYNC_OP_REBUILD           NO
+#define ASYNC_OP_REPORT_PERIOD     100
+
+/*
+If YES, the 2D fields of the ADI kernels (field2d.c) which are bigger than 2 MiB are
+allocated on huge page boundaries and advised to be backed by transparent huge pages
+*/
+#define FIELD2D_HUGE_PAGES         NO
+
 /*Theta value for Glowinsky's fractional theta method (a value in ]0,0.5[)*/
 // #define FRACTIONAL_THETA_THETA_TC   0.3
 // #define FRACTIONAL_THETA_THETA_RES  0.3
@@ -149,12 +231,22 @@ To set the order of directions in the ADI scheme, allowed values: YES, NO, RANDO
 #define KAPPA_TABLE                YES
 #define MAKE_ETA_TAB_FILE          YES /* If YES, the ascii table file will be made with python script, */
 #define MAKE_KAPPA_TAB_FILE        YES /* instead, if NO it is assumed that the file is already present*/
+#define TRANSPORT_TAB_CACHE        YES /* If YES, the tables made by the scripts are cached (binary), see transport_tables.h */
+#define TRANSPORT_TAB_NATIVE       YES /* If YES, the tables are made in C (devoto_transport.c) instead of by the scripts */
 #define RHO_TAB_MIN                (2.5e-13)  /* You should never go below UNIT_DENSITY*1e-7 */
 #define RHO_TAB_MAX                (2.5e-5)  /* You should never go hiher than UNIT_DENSITY*1e7 */
 #define N_TAB_RHO                  50
 #define T_TAB_MIN                  (0.8*T_CUT_RHOE)
 #define T_TAB_MAX                  3.e5
 #define N_TAB_T                    120
+#define LOG_TABLE_LOOKUP           YES /* If YES, the tables are interpolated by LogTableInterpolate() (log_table.h),
+                                          specialized to their nodes, instead of Table2DInterpolate() */
+#define ETA_TAB_INTERP             LOG_TABLE_LINEAR /* LOG_TABLE_LINEAR, LOG_TABLE_LOGF or LOG_TABLE_STEFFEN */
+#define KAPPA_TAB_INTERP           LOG_TABLE_LINEAR /* (the last two need LOG_TABLE_LOOKUP), see log_table.h */
+#define TRANSPORT_TAB_ACCURACY     NO  /* If YES, the accuracy of the interpolations is printed when a table is made */
+#define DD_VEC_BENCHMARK           NO  /* If YES (and no tables), the batch DD formulas are benchmarked once, see gamma_transp_vec.h */
+#define MULTI_FIELD_TABLE          NO  /* If YES, eta, kappa, dE/dT and mu of a cell come from one lookup (transport_tables.h) */
+#define TRANSPORT_TAB_ADAPTIVE     NO  /* If YES, eta and kappa tables are refined and extended on demand (adaptive_table.h) */
 /* ---------------------------------------------------- */
 
 /* ---------------------------------------------------- */
@@ -0,0 +1,562 @@
+/*Native (C) generator of the tables of electrical resistivity and thermal conductivity of
+hydrogen, ported from the python scripts in transport_tables_scripts/ (see devoto_transport.h)*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "devoto_transport.h"
+
+/****************************************************************************
+How it works:
+  it is a line by line port of EtaTable_4pluto.py/KappaTable_4pluto.py and of what they
+  use: ionization.py (ionizDissSaha()), PlasmaPar_asDevoto.py (elRes_norm(),
+  thermCond_tot_norm() and below) and constantsGAU_ema.py (the GAU_ constants below, which
+  are NOT the CONST_ of PLUTO). Python names are kept, and so is the order of the floating
+  point operations, so that the tables are the same as those of the scripts up to the
+  rounding of the few operations done differently: the roots of the Saha polynomial (numpy
+  takes them as eigenvalues, here they are found by Newton/bisection), the determinants
+  (LAPACK vs the LU below) and a few sums (numpy sums pairwise).
+  The points of a table are independent, so MakeDevotoTable() makes them in parallel with
+  OpenMP (if enabled, see local_make).
+  Species indexes: 0 = e-, 1 = H+, 2 = H. Collision integrals: Q[l-1][s-1][i][j].
+*****************************************************************************/
+
+// constantsGAU_ema.py
+#define GAU_me     9.10938356e-28   // electron mass, grams
+#define GAU_mp     1.6726219e-24    // proton mass, grams
+#define GAU_qe     4.80320425e-10   // elementary charge, statcoulomb
+#define GAU_h      6.626070040e-27  // Planck constant, erg*s
+#define GAU_kB     1.38064852e-16   // Boltzmann constant, erg/K
+#define GAU_eV2erg (1.6022e-19*1e7)
+
+#define EULER_GAMMA 0.5772156649015329
+#define IONIZ_MIN_TAB 1e-10  // ioniz_min of the scripts
+
+#define N_SPECS 3
+typedef double CollInt[3][5][N_SPECS][N_SPECS];
+
+// g_i parameters, from table VI of Bruno, Phys Plasmas 17, 112315 (2010), [l-1][s-1]
+static const double g_eH[3][5][8] = {
+  {{10.35291134, -1.58301162, 12.45844036, -0.23285190,    5.36628573e-2, -5.34372929, 9.35561752, -2.15463427},
+   {10.09959930, -1.50068352, 12.54524872, -7.29529868e-2, 4.37301268e-2, -5.73166847, 9.09798179, -2.13265127},
+   {9.84443341,  -1.42568830, 12.97194554, -9.24067489e-2, 2.32754987e-2, -5.71948057, 8.8325970,  -2.05797013},
+   {9.65959253,  -1.38293428, 13.18865311, -6.34310879e-2, 1.11968653e-2, -5.77977010, 8.64525855, -2.02715634},
+   {9.50113220,  -1.36043711, 13.23885240, -4.44172748e-2, 7.88864536e-3, -5.83593794, 8.49000000, -2.01418763}},
+  {{0},
+   {10.33445440, -1.44880911, 12.08534341, -1.86163984e-2, 3.30723152e-2, -6.45649277, 9.15932646, -2.13494419},
+   {10.08612484, -1.39070408, 12.39823810, -3.26532858e-2, 1.75287406e-2, -6.48186913, 8.90783546, -2.08119318},
+   {9.89312188,  -1.34820033, 12.63138071, -1.96030794e-2, 4.55766915e-3, -6.50687636, 8.71405704, -2.04690115},
+   {0}},
+  {{0}, {0},
+   {9.99023294,  -1.41457896, 12.53875975, -2.82169003e-2, 2.70547916e-2, -6.11376507, 8.89657156, -2.09400530},
+   {0}, {0}}};
+
+// a_i parameters, from table I of Bruno, Phys Plasmas 17, 112315 (2010)
+static const double a_HH[3][5][7] = {
+  {{15.09506044, -1.25710008, 9.57839369, -3.80371463, 0.98646613, 9.25705877, -0.93611707},
+   {14.14566908, -1.17057105, 9.02830724, -3.00779776, 0.74653903, 9.10299040, -0.68184353},
+   {13.39722075, -1.09886403, 8.50097335, -2.86025395, 0.85345727, 8.90666490, -0.67571329},
+   {12.97073246, -1.06479185, 8.18885522, -2.78105132, 0.89401865, 8.73403138, -0.65658782},
+   {12.69248000, -1.04857945, 7.97861283, -2.73621289, 0.90816787, 8.57840253, -0.63732002}},
+  {{0},
+   {22.08948804, -1.85066626, 8.50932055, -7.66943974, 0.77454531, 9.69545318, -0.62104466},
+   {17.94703897, -1.42488999, 7.66669340, -4.76239721, 1.26783524, 9.53716768, -0.73914215},
+   {18.78590499, -1.59291967, 7.97734302, -5.66814860, 1.01816360, 9.32328437, -0.60882006},
+   {0}},
+  {{0}, {0},
+   {13.82986524, -1.01454290, 7.48970759, -3.27628187, 2.08225623, 9.21388055, -1.32086596},
+   {0}, {0}}};
+
+// a_i parameters, from table III of Bruno, Phys Plasmas 17, 112315 (2010)
+static const double a_HpH[3][5][7] = {
+  {{46.68783791, -0.33303803, 4.25686770, -2.03851201, 14.98170958, 8.59618369, -1.65616736},
+   {46.68783791, -0.33303803, 3.92217635, -2.00886829, 14.98170958, 8.24501842, -1.65616736},
+   {46.68783791, -0.33303803, 3.65740159, -2.01434735, 14.98170958, 7.97534885, -1.65616736},
+   {46.68783791, -0.33303803, 3.43102576, -2.04002032, 14.98170958, 7.76086951, -1.65616736},
+   {46.68783791, -0.33303803, 3.23079831, -2.07543755, 14.98170958, 7.58613195, -1.65616736}},
+  {{0},
+   {46.68783791, -0.33303803, 4.10212490, -1.85454858, 14.98170958, 8.86285119, -1.65616736},
+   {46.68783791, -0.33303803, 3.89701552, -1.76267951, 14.98170958, 8.61913831, -1.65616736},
+   {46.68783791, -0.33303803, 3.73496748, -1.69596577, 14.98170958, 8.41234103, -1.65616736},
+   {0}},
+  {{0}, {0},
+   {46.68783791, -0.33303803, 3.95678840, -2.00381603, 15.72150840, 8.30656354, -1.79347178},
+   {0}, {0}}};
+
+// d_i parameters, from table V of Bruno, Phys Plasmas 17, 112315 (2010), [s-1] (l = 1)
+static const double d_HHp[5][3] = {{63.5437, -5.0093, 9.8797e-2},
+                                   {61.8730, -4.9431, 9.8766e-2},
+                                   {60.6364, -4.8936, 9.8767e-2},
+                                   {59.6591, -4.8544, 9.8785e-2},
+                                   {58.8493, -4.8213, 9.8776e-2}};
+
+/* Coefficients A[l][s][m][p], B[s][m][p] of q^mp (3rd approx), Devoto, Phys. Fluids 10, 2105 (1967)
+   (the B of the script has one more, always 0, index) */
+static const double A_q[3][5][3][3] = {
+  {{{0}}},
+  {{{0}},
+   {{0}, {0, 8*1, 8*7./4}, {0, 8*7./4, 8*77./16}},
+   {{0}, {0, 0, 8*(-2.)},  {0, 8*(-2.), 8*(-7.)}},
+   {{0}, {0}, {0, 0, 8*5.}}},
+  {{{0}}}};
+static const double B_q[5][3][3] = {
+  {{8*1, 8*5./2, 8*35./8}, {8*5./2, 8*25./4, 8*175./16}, {8*35./8, 8*175./16, 8*1225./64}},
+  {{0, 8*(-3.), 8*(-21./2)}, {8*(-3.), 8*(-15.), 8*-315./8}, {8*(-21./2), 8*-315./8, 8*-735./8}},
+  {{0, 0, 8*6.}, {0, 8*12., 8*57.}, {8*6., 8*57., 8*399./2}},
+  {{0}, {0, 0, 8*-30.}, {0, 8*-30., 8*-210.}},
+  {{0}, {0}, {0, 0, 8*90.}}};
+
+/****************************************************************************
+Determinant of the n x n matrix a (destroyed), by LU with partial pivoting
+*****************************************************************************/
+static double Determinant(double a[][10], int n) {
+  int i, j, k, piv;
+  double det = 1.0, tmp, l;
+
+  for (k = 0; k < n; k++) {
+    piv = k;
+    for (i = k + 1; i < n; i++) if (fabs(a[i][k]) > fabs(a[piv][k])) piv = i;
+    if (a[piv][k] == 0.0) return 0.0;
+    if (piv != k) {
+      for (j = 0; j < n; j++) {
+        tmp = a[k][j]; a[k][j] = a[piv][j]; a[piv][j] = tmp;
+      }
+      det = -det;
+    }
+    for (i = k + 1; i < n; i++) {
+      l = a[i][k]/a[k][k];
+      for (j = k + 1; j < n; j++) a[i][j] -= l*a[k][j];
+    }
+    det *= a[k][k];
+  }
+  return det;
+}
+
+/****************************************************************************
+Inverse of the n x n matrix a (destroyed), by LU with partial pivoting and
+a forward/back substitution per column (as LAPACK dgesv, used by np.linalg.inv)
+*****************************************************************************/
+static void Inverse(double a[][10], int n, double inv[][10]) {
+  int i, j, k, piv, perm[10];
+  double tmp, x[10];
+
+  for (i = 0; i < n; i++) perm[i] = i;
+  for (k = 0; k < n; k++) {
+    piv = k;
+    for (i = k + 1; i < n; i++) if (fabs(a[i][k]) > fabs(a[piv][k])) piv = i;
+    if (piv != k) {
+      for (j = 0; j < n; j++) {
+        tmp = a[k][j]; a[k][j] = a[piv][j]; a[piv][j] = tmp;
+      }
+      i = perm[k]; perm[k] = perm[piv]; perm[piv] = i;
+    }
+    for (i = k + 1; i < n; i++) {
+      a[i][k] /= a[k][k];
+      for (j = k + 1; j < n; j++) a[i][j] -= a[i][k]*a[k][j];
+    }
+  }
+  for (j = 0; j < n; j++) {
+    for (i = 0; i < n; i++) {
+      x[i] = (perm[i] == j);
+      for (k = 0; k < i; k++) x[i] -= a[i][k]*x[k];
+    }
+    for (i = n - 1; i >= 0; i--) {
+      for (k = i + 1; k < n; k++) x[i] -= a[i][k]*x[k];
+      x[i] /= a[i][i];
+    }
+    for (i = 0; i < n; i++) inv[i][j] = x[i];
+  }
+}
+
+/* Determinant of the n x n matrix a, which is preserved */
+static double Det(double a[][10], int n) {
+  double b[10][10];
+  memcpy(b, a, sizeof(b));
+  return Determinant(b, n);
+}
+
+/****************************************************************************
+Ionization and dissociation degree of hydrogen (Saha), ionization.py
+*****************************************************************************/
+void ionizDissSaha(double rho, double kT, double *xs, double *ys) {
+  const double chi = 13.597*GAU_eV2erg;
+  const double chi_diss = 4.476*GAU_eV2erg;
+  double E1 = -chi_diss, E2 = -chi;
+  double n0_H = rho/(GAU_me + GAU_mp);
+  double n0_H2 = 0.5*n0_H;
+  double m_H = GAU_mp + GAU_me;
+  double beta = 1/(kT);
+  double A, B, c4, y, y_lo = 0.0, y_hi = 1.0, p, dp, dy;
+  int it;
+
+  A = exp(beta*E1 - 3./2*log(-beta*E1)
+          + 3./2*log(2*CONST_PI*(0.5*m_H)*(-E1)/(pow(n0_H2, 2./3)*(GAU_h*GAU_h))));
+  B = exp(beta*E2 - 3./2*log(-beta*E2)
+          + 3./2*log(2*CONST_PI*GAU_me*(-E2)/(pow(n0_H2, 2./3)*(GAU_h*GAU_h))));
+
+  /* The root in [0, 1] of 16/(A*B) y^4 + 2 y^2 + B y - B (the script takes it among all the roots
+     given by numpy): the polynomial is < 0 in 0, > 0 in 1 and increasing in between, so the root
+     is unique. Newton, falling back to bisection when it jumps out of the bracket */
+  c4 = 16/(A*B);
+  y = 0.5;
+  for (it = 0; it < 200; it++) {
+    p = ((c4*y*y + 2)*y + B)*y - B;
+    dp = (4*c4*y*y + 4)*y + B;
+    if (p < 0.0) y_lo = y;
+    else y_hi = y;
+    dy = p/dp;
+    if (!(y - dy > y_lo && y - dy < y_hi)) dy = y - 0.5*(y_lo + y_hi);
+    y -= dy;
+    if (fabs(dy) <= 1e-16*y || y_hi - y_lo <= 1e-16*y) break;
+  }
+  *ys = y;
+  // This expression for xs works better than the others (for numerical reasons)
+  *xs = (-(A - 8*y) + sqrt((A - 8*y)*(A - 8*y) - 4*4*(4*y*y - A)))/8;
+}
+
+/****************************************************************************
+Collision integrals (= pi sigma^2 Omega^(l,s)*), PlasmaPar_asDevoto.py
+*****************************************************************************/
+// e-H+ (also e-e and H+-H+), Hahn, Mason, Phys. Fluids 14, 278 (1971), formula 51
+static double Q_eHp(int l, int s, double T, double ne) {
+  double kT = GAU_kB*T;
+  double lDeb = sqrt(kT/(4*CONST_PI*2*ne*(GAU_qe*GAU_qe)));  // Electrons+ions
+  double phi0 = (GAU_qe*GAU_qe)/lDeb;
+  double T_star = kT/phi0;
+  double Nl, As, Cl, Qls_star;
+  int ss, ll;
+
+  Nl = 1/(1 - (1 + (l%2 == 0 ? 1 : -1))/(2.*(l + 1)));
+  As = 0;
+  for (ss = 2; ss < s + 1; ss++) As += 1./(ss - 1);
+  Cl = 0;
+  if (l%2 != 0) {  // l is odd
+    for (ll = 1; ll < l + 1; ll += 2) Cl += 1./ll;
+    Cl -= 1./(2*l);
+  } else {  // l is even
+    for (ll = 1; ll < l; ll += 2) Cl += 1./ll;
+  }
+
+  Qls_star = pow(T_star, -2)*l*Nl/(s*(s + 1))*log(4*T_star/exp(2*EULER_GAMMA)*exp(As - Cl) + 1);
+  return Qls_star*CONST_PI*(lDeb*lDeb);
+}
+
+// e-H, Bruno, Phys. Plasmas 17, 112315 (2010), eq. 19 and table VI
+static double Q_eH(int l, int s, double T) {
+  const double *g = g_eH[l-1][s-1];
+  double x = log(T);
+  double x1 = (x - g[0])/g[1];
+  double S;
+
+  S = g[2]*pow(x, g[4])*exp(x1)/(exp(x1) + exp(-x1))
+      + g[5]*exp(-((x - g[6])/g[7])*((x - g[6])/g[7])) + g[3];
+  S *= 1e-16;  // assuming it was in Angstrom
+  return S*CONST_PI;
+}
+
+// H-H (a = a_HH) and H+-H (a = a_HpH, with charge exchange for odd l), Bruno (2010), eq. 11
+static double Q_HH_HpH(const double *a, int l, int s, int chex, double T) {
+  double x = log(T);
+  double x1 = (x - a[2])/a[3];
+  double x2 = (x - a[5])/a[6];
+  double S, S_chex;
+  const double *d;
+
+  S = (a[0] + a[1]*x)*exp(x1)/(exp(x1) + exp(-x1)) + a[4]*exp(x2)/(exp(x2) + exp(-x2));
+  /* Odd-l terms must include the effect of inelastic collisions (eq. 16 of Bruno), not l=3
+     (Bruno does not give its parameters) */
+  if (chex && l == 1) {
+    d = d_HHp[s-1];
+    S_chex = d[0] + d[1]*x + d[2]*(x*x);
+    S = sqrt(S*S + S_chex*S_chex);
+  }
+  S *= 1e-16;  // assuming it was in Angstrom
+  return S*CONST_PI;
+}
+
+/* The collision integrals of e-, H+, H needed by the 3rd approximation (makeQ()) */
+static void makeQ(double kT, double ne, CollInt Q) {
+  static const int ls[9][2] = {{1,1},{1,2},{1,3},{1,4},{1,5},{2,2},{2,3},{2,4},{3,3}};
+  double T = kT/GAU_kB;
+  int n, l, s;
+
+  memset(Q, 0, sizeof(CollInt));
+  for (n = 0; n < 9; n++) {
+    l = ls[n][0];
+    s = ls[n][1];
+    Q[l-1][s-1][0][0] = Q_eHp(l, s, T, ne);
+    Q[l-1][s-1][0][1] = Q[l-1][s-1][1][0] = Q_eHp(l, s, T, ne);
+    Q[l-1][s-1][1][1] = Q_eHp(l, s, T, ne);
+    Q[l-1][s-1][0][2] = Q[l-1][s-1][2][0] = Q_eH(l, s, T);
+    Q[l-1][s-1][1][2] = Q[l-1][s-1][2][1] = Q_HH_HpH(a_HpH[l-1][s-1], l, s, 1, T);
+    Q[l-1][s-1][2][2] = Q_HH_HpH(a_HH[l-1][s-1], l, s, 0, T);
+  }
+}
+
+/****************************************************************************
+q^mp of Devoto, Phys. Fluids 10, 2105 (1967) (electrons only), q_mp_simple()
+*****************************************************************************/
+static double q_mp_simple(int m, int p, const double *n, CollInt Q) {
+  int l, s, j;
+  double sumAQ = 0, sumBQ = 0, sumB;
+
+  for (l = 0; l < 3; l++)
+    for (s = 0; s < 5; s++) sumAQ += A_q[l][s][m][p]*Q[l][s][0][0];
+  sumAQ = n[0]*n[0]*sqrt(2)*sumAQ;
+  for (j = 1; j < N_SPECS; j++) {
+    sumB = 0;
+    for (s = 0; s < 5; s++) sumB += B_q[s][m][p]*Q[0][s][0][j];
+    sumBQ += n[j]*sumB;
+  }
+  sumBQ *= n[0];
+  return sumAQ + sumBQ;
+}
+
+/****************************************************************************
+q^mp_ij of Devoto, Phys. Fluids 9, 1230 (1966), q_mp_complete()
+*****************************************************************************/
+static void q_mp_complete(int m, int p, const double *n, const double *mi, CollInt Q,
+                          double q[N_SPECS][N_SPECS]) {
+  int i, j, k;
+  double dm, dp, sum, mk2, mj2, mk3, mk4, mj4;
+
+  for (i = 0; i < N_SPECS; i++) {
+    for (j = 0; j < N_SPECS; j++) {
+      sum = 0;
+      mj2 = mi[j]*mi[j];
+      mj4 = pow(mi[j], 4);
+      for (k = 0; k < N_SPECS; k++) {
+        dm = (i == j) - (j == k);  // delta_ij - delta_jk
+        dp = (i == j) + (j == k);  // delta_ij + delta_jk
+        mk2 = mi[k]*mi[k];
+        mk3 = pow(mi[k], 3);
+        mk4 = pow(mi[k], 4);
+        if (m + p == 0) {
+          sum += n[k]*sqrt(mi[i])/sqrt(mi[i] + mi[k])*Q[0][0][i][k]
+                 *(n[i]*sqrt(mi[k])/sqrt(mi[j])*dm - n[j]*sqrt(mi[k])*sqrt(mi[j])/mi[i]*(1 - (i == k)));
+        } else if (m*p == 0 && m + p == 1) {
+          sum += n[k]*pow(mi[k], 1.5)/pow(mi[i] + mi[k], 1.5)
+                 *(5./2*Q[0][0][i][k] - 3*Q[0][1][i][k])*dm;
+        } else if (m == 1 && p == 1) {
+          sum += n[k]*sqrt(mi[k])/pow(mi[i] + mi[k], 5./2)
+                 *(dm*(5./4*(6*mj2 + 5*mk2)*Q[0][0][i][k] - 15*mk2*Q[0][1][i][k] + 12*mk2*Q[0][2][i][k])
+                   + dp*4*mi[j]*mi[k]*Q[1][1][i][k]);
+        } else if (m*p == 0) {
+          sum += n[k]*pow(mi[k], 5./2)/pow(mi[i] + mi[k], 5./2)
+                 *dm*(35./8*Q[0][0][i][k] - 21./2*Q[0][1][i][k] + 6*Q[0][2][i][k]);
+        } else if (m + p == 3) {
+          sum += n[k]*pow(mi[k], 3./2)/pow(mi[i] + mi[k], 7./2)
+                 *(dm*(35./16*(12*mj2 + 5*mk2)*Q[0][0][i][k] - 63./2*(mj2 + 5./4*mk2)*Q[0][1][i][k]
+                       + 57*mk2*Q[0][2][i][k] - 30*mk2*Q[0][3][i][k])
+                   + dp*(14*mi[j]*mi[k]*Q[1][1][i][k] - 16*mi[j]*mi[k]*Q[1][2][i][k]));
+        } else {  // m == p == 2
+          sum += n[k]*sqrt(mi[k])/pow(mi[i] + mi[k], 9./2)
+                 *(dm*(35./64*(40*mj4 + 168*mj2*mk2 + 35*mk4)*Q[0][0][i][k]
+                       - 21./8*mk2*(84*mj2 + 35*mk2)*Q[0][1][i][k]
+                       + 3./2*mk2*(108*mj2 + 133*mk2)*Q[0][2][i][k]
+                       - 210*mk4*Q[0][3][i][k] + 90*mk4*Q[0][4][i][k] + 24*mj2*mk2*Q[2][2][i][k])
+                   + dp*(7*mi[j]*mi[k]*(4*mj2 + 7*mk2)*Q[1][1][i][k]
+                         - 112*mi[j]*mk3*Q[1][2][i][k] + 80*mi[j]*mk3*Q[1][3][i][k]));
+        }
+      }
+
+      if (m + p == 0)                    q[i][j] = 8*sum;
+      else if (m*p == 0 && m + p == 1)  q[i][j] = 8*n[i]*(pow(mi[i], 1.5)/pow(mi[j], 1.5))*sum;
+      else if (m == 1 && p == 1)         q[i][j] = 8*n[i]*pow(mi[i]/mi[j], 3./2)*sum;
+      else if (m*p == 0)                 q[i][j] = 8*n[i]*pow(mi[i], 5./2)/pow(mi[j], 5./2)*sum;
+      else                               q[i][j] = 8*n[i]*pow(mi[i]/mi[j], 5./2)*sum;
+
+      if (m == 1 && p == 0) q[i][j] *= mi[j]/mi[i];                        // q^10
+      if (m == 2 && p == 0) q[i][j] *= (mi[j]/mi[i])*(mi[j]/mi[i]);        // q^20
+      if (m == 2 && p == 1) q[i][j] *= mi[j]/mi[i];                        // q^21
+    }
+  }
+}
+
+/* The 9 x 9 matrix of the q^mp_ij blocks, denomD_3() */
+static void denomD_3(const double *n, const double *mi, CollInt Q, double denom[][10]) {
+  int mm, pp, i, j;
+  double q[N_SPECS][N_SPECS];
+
+  for (mm = 0; mm < 3; mm++) {
+    for (pp = 0; pp < 3; pp++) {
+      q_mp_complete(mm, pp, n, mi, Q, q);
+      for (i = 0; i < N_SPECS; i++)
+        for (j = 0; j < N_SPECS; j++) denom[mm*N_SPECS + i][pp*N_SPECS + j] = q[i][j];
+    }
+  }
+}
+
+/****************************************************************************
+Electrical resistivity of hydrogen as computed by Devoto in "Simplified expressions
+for the transport properties of ionized monatomic gases" (1967), eq. 16, 3rd approx.
+for D11 (elRes_norm() and diffu_ee())
+*****************************************************************************/
+double elRes_norm_Dev(double z, double rho, double kT) {
+  double ne = z*rho/(GAU_mp + GAU_me);
+  double n_p = rho/(GAU_me + GAU_mp);
+  double n[N_SPECS] = {ne, ne, n_p - ne};
+  double n_sum = n[0] + n[1] + n[2];
+  double q00, q01, q11, q12, q22, q02, D11;
+  double num[10][10], denom[10][10];
+  CollInt Q;
+
+  makeQ(kT, ne, Q);
+  q00 = q_mp_simple(0, 0, n, Q);
+  q01 = q_mp_simple(0, 1, n, Q);
+  q11 = q_mp_simple(1, 1, n, Q);
+  q12 = q_mp_simple(1, 2, n, Q);
+  q22 = q_mp_simple(2, 2, n, Q);
+  q02 = q_mp_simple(0, 2, n, Q);
+
+  num[0][0] = q11; num[0][1] = q12;
+  num[1][0] = q12; num[1][1] = q22;
+  denom[0][0] = q00; denom[0][1] = q01; denom[0][2] = q02;
+  denom[1][0] = q01; denom[1][1] = q11; denom[1][2] = q12;
+  denom[2][0] = q02; denom[2][1] = q12; denom[2][2] = q22;
+
+  D11 = 3*n[0]*rho/(2*n_sum*GAU_me)*sqrt(2*CONST_PI*kT/GAU_me)*Det(num, 2)/Det(denom, 3);
+  return rho*kT/((GAU_qe*GAU_qe)*ne*n_sum*GAU_me*D11);
+}
+
+/****************************************************************************
+Translational thermal conductivity of hydrogen, Devoto, "Transport properties of
+ionized monatomic gases" (1966), eq. 17 (thermCond_norm(), with diffu(), thermDiffu(),
+lambdaPrime() and Eij()), plus the reactive one as in Jesper Janssen's PhD Thesis,
+pag 97-98 (thermCond_r_norm()), assuming complete dissociation
+*****************************************************************************/
+double thermCond_tot_norm_Dev(double z, double rho, double kT) {
+  double ne = z*rho/(GAU_mp + GAU_me);
+  double n_p = rho/(GAU_me + GAU_mp);
+  double n[N_SPECS] = {ne, ne, n_p - ne};
+  double mi[N_SPECS] = {GAU_me, GAU_mp, GAU_me + GAU_mp};
+  double n_sum = n[0] + n[1] + n[2];
+  double num[10][10], denom[10][10], det_denom;
+  double D[N_SPECS][N_SPECS], DT[N_SPECS], E[10][10], Einv[10][10];
+  double lprime, addend, T, mu, Om00, p, Dkl, A_r, x[N_SPECS], DH, lambda_r;
+  static const double R[N_SPECS] = {+1, +1, -1};  // Stoichiometric coefficients (e- + H+ <-> H)
+  int i, j, k, ii, jj;
+  CollInt Q;
+
+  makeQ(kT, ne, Q);
+  denomD_3(n, mi, Q, denom);
+  det_denom = Det(denom, 9);
+
+  // lambda' (lambdaPrime())
+  memset(num, 0, sizeof(num));
+  for (i = 0; i < 9; i++)
+    for (j = 0; j < 9; j++) num[i][j] = denom[i][j];
+  for (k = 0; k < N_SPECS; k++) {
+    num[9][N_SPECS + k] = n[k]/sqrt(mi[k]);
+    num[N_SPECS + k][9] = n[k];
+  }
+  lprime = -75*GAU_kB/8*sqrt(2*CONST_PI*kT)*Det(num, 10)/det_denom;
+
+  // Ordinary diffusion coefficients (diffu())
+  for (k = 0; k < N_SPECS; k++) num[9][N_SPECS + k] = num[N_SPECS + k][9] = 0.0;
+  for (ii = 0; ii < N_SPECS; ii++) {
+    for (jj = 0; jj < N_SPECS; jj++) {
+      for (k = 0; k < N_SPECS; k++) {
+        num[9][k] = (k == ii);
+        num[k][9] = (k == jj) - (k == ii);
+      }
+      D[ii][jj] = 3*rho*n[ii]/(2*n_sum*mi[jj])*sqrt(2*CONST_PI*kT/mi[ii])*Det(num, 10)/det_denom;
+    }
+  }
+
+  // Thermal diffusion coefficients (thermDiffu())
+  for (k = 0; k < N_SPECS; k++) {
+    num[k][9] = 0.0;
+    num[N_SPECS + k][9] = n[k];
+  }
+  for (ii = 0; ii < N_SPECS; ii++) {
+    for (k = 0; k < N_SPECS; k++) num[9][k] = (k == ii);
+    DT[ii] = 15*n[ii]*sqrt(2*CONST_PI*mi[ii]*kT)/4*Det(num, 10)/det_denom;
+  }
+
+  // E = (D_ij m_j)^-1 (Eij())
+  for (i = 0; i < N_SPECS; i++)
+    for (j = 0; j < N_SPECS; j++) E[i][j] = D[i][j]*mi[j];
+  Inverse(E, N_SPECS, Einv);
+
+  addend = 0;
+  for (ii = 0; ii < N_SPECS; ii++)
+    for (jj = 0; jj < N_SPECS; jj++)
+      addend += Einv[ii][jj]*DT[ii]*DT[jj]/(n[ii]*mi[ii]*mi[jj]);
+  addend *= rho*GAU_kB/n_sum;
+
+  // Reactive thermal conductivity (thermCond_r_norm())
+  T = kT/GAU_kB;
+  p = n_sum*kT;
+  A_r = 0;
+  for (k = 0; k < N_SPECS; k++) x[k] = n[k]/n_sum;
+  for (i = 0; i < N_SPECS - 1; i++) {
+    for (j = i + 1; j < N_SPECS; j++) {
+      mu = mi[i]*mi[j]/(mi[i] + mi[j]);  // reduced mass
+      Om00 = Q[0][0][i][j]*0.5*2.0*1.0/sqrt(2*CONST_PI*mu/kT);  // Q2Om(), l = s = 1
+      Dkl = 3./16*(kT*kT)/(p*mu*Om00);
+      A_r += kT/(Dkl*p)*x[i]*x[j]*((R[i]/x[i] - R[j]/x[j])*(R[i]/x[i] - R[j]/x[j]));
+    }
+  }
+  // Enthalpy difference (in reaction e- + H+ <-> H) per particle, in erg
+  DH = 13.6*1.6e-12;
+  DH += 5./2*kT;  // See the reason for this at page 50 of Ema's INFN book (Q3)
+  lambda_r = 1/(kT*T)*(DH*DH)/A_r;
+
+  return addend + lprime + lambda_r;
+}
+
+/****************************************************************************
+Value of a table of MakeDevotoTable() (quantity DEVOTO_ETA or DEVOTO_KAPPA) at a single
+point, rho and T in cgs (also used to make the nodes of the adaptive tables,
+adaptive_table.c)
+*****************************************************************************/
+double DevotoPoint(int quantity, double rho, double T) {
+  double kT = T*GAU_kB, xs, ys;
+
+  ionizDissSaha(rho, kT, &xs, &ys);
+  ys = MAX(IONIZ_MIN_TAB, ys);
+  if (quantity == DEVOTO_ETA) return elRes_norm_Dev(ys, rho, kT);
+  else                        return thermCond_tot_norm_Dev(ys, rho, kT);
+}
+
+/****************************************************************************
+Fills f[j][i] (N_rho x N_T) with eta (DEVOTO_ETA) or kappa (DEVOTO_KAPPA), in cgs, on the
+nodes of EtaTable_4pluto.py/KappaTable_4pluto.py (np.logspace() of T and rho), with the
+ionization of ionizDissSaha() (at least IONIZ_MIN_TAB)
+*****************************************************************************/
+void MakeDevotoTable(int quantity, double T_min, double T_max, int N_T,
+                     double rho_min, double rho_max, int N_rho, double **f) {
+  int i, j;
+  double *T, *rho;
+  double lT0 = log10(T_min), lT1 = log10(T_max), lr0 = log10(rho_min), lr1 = log10(rho_max);
+
+  T = ARRAY_1D(N_T, double);
+  rho = ARRAY_1D(N_rho, double);
+  // As np.logspace() (np.linspace() of the exponents, with the last one exactly the end)
+  for (i = 0; i < N_T; i++) T[i] = pow(10.0, i < N_T - 1 ? i*((lT1 - lT0)/(N_T - 1)) + lT0 : lT1);
+  for (j = 0; j < N_rho; j++) rho[j] = pow(10.0, j < N_rho - 1 ? j*((lr1 - lr0)/(N_rho - 1)) + lr0 : lr1);
+
+  MakeDevotoTableOnNodes(quantity, T, N_T, rho, N_rho, f);
+
+  FreeArray1D((void *)T);
+  FreeArray1D((void *)rho);
+}
+
+/****************************************************************************
+The same on any nodes T[i], rho[j] (e.g. not uniform in log10, see transport_tables.c)
+*****************************************************************************/
+void MakeDevotoTableOnNodes(int quantity, const double *T, int N_T,
+                            const double *rho, int N_rho, double **f) {
+  int i, j;
+
+  #ifdef _OPENMP
+  #pragma omp parallel for private(i) schedule(dynamic)
+  #endif
+  for (j = 0; j < N_rho; j++)
+    for (i = 0; i < N_T; i++)
+      f[j][i] = DevotoPoint(quantity, rho[j], T[i]);
+}
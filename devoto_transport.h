@@ -0,0 +1,24 @@
+#ifndef DEVOTO_TRANSPORT_H
+#define DEVOTO_TRANSPORT_H
+/* Native port of the python scripts making the eta and kappa tables (transport_tables_scripts/):
+   Chapman-Enskog transport coefficients of a fully dissociated, partially ionized hydrogen
+   gas (e-, H+, H) as in Devoto (1966, 1967), with the collision integrals of Bruno (2010) */
+
+/* Version of the formulas: it is part of the key of the binary table cache, so it must be
+   increased whenever devoto_transport.c changes the values it computes */
+#define DEVOTO_TAB_VERSION 1
+
+// Quantities of MakeDevotoTable()
+#define DEVOTO_ETA   0
+#define DEVOTO_KAPPA 1
+
+void ionizDissSaha(double rho, double kT, double *xs, double *ys);
+double elRes_norm_Dev(double z, double rho, double kT);
+double thermCond_tot_norm_Dev(double z, double rho, double kT);
+double DevotoPoint(int quantity, double rho, double T);
+void MakeDevotoTable(int quantity, double T_min, double T_max, int N_T,
+                     double rho_min, double rho_max, int N_rho, double **f);
+void MakeDevotoTableOnNodes(int quantity, const double *T, int N_T,
+                            const double *rho, int N_rho, double **f);
+
+#endif
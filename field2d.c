@@ -0,0 +1,70 @@
+/*Contiguous and aligned 2D fields (see field2d.h)*/
+
+#include "pluto.h"
+#include "field2d.h"
+#include <stdlib.h>
+#if FIELD2D_HUGE_PAGES
+  #include <sys/mman.h>
+#endif
+
+// Size of a (transparent) huge page on x86-64
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+/****************************************************************************
+Allocates a nrows x ncols field, with rows padded to a multiple of FIELD2D_ALIGN
+bytes, and sets its row pointers. The values are set to zero.
+The row pointers and the Field2D are a single block (the Field2D after the pointers),
+so that FreeArray2D(f->row) frees all of it (see field2d.h).
+*****************************************************************************/
+Field2D *NewField2D(int nrows, int ncols) {
+  Field2D *f;
+  double **row;
+  size_t align = FIELD2D_ALIGN;
+  size_t size;
+  int j;
+  int const doubles_per_align = FIELD2D_ALIGN/sizeof(double);
+
+  // (the Field2D holds pointers, so right after nrows pointers it is aligned)
+  row = (double **)malloc(nrows*sizeof(double *) + sizeof(Field2D));
+  if (row == NULL) {
+    print1("\n[NewField2D] Error while allocating the row pointers");
+    QUIT_PLUTO(1);
+  }
+  f = (Field2D *)(row + nrows);
+  f->row = row;
+  f->nrows = nrows;
+  f->ncols = ncols;
+  f->stride = ((ncols + doubles_per_align - 1)/doubles_per_align)*doubles_per_align;
+  size = (size_t)nrows*f->stride*sizeof(double);
+
+  #if FIELD2D_HUGE_PAGES
+    if (size >= HUGE_PAGE_SIZE) align = HUGE_PAGE_SIZE;
+  #endif
+  if (posix_memalign((void **)&(f->data), align, size) != 0) {
+    print1("\n[NewField2D] Error while allocating a %d x %d field", nrows, ncols);
+    QUIT_PLUTO(1);
+  }
+  #if FIELD2D_HUGE_PAGES && defined(MADV_HUGEPAGE)
+    // It is only an advice: if huge pages are not available nothing changes
+    if (align == HUGE_PAGE_SIZE) madvise(f->data, size, MADV_HUGEPAGE);
+  #endif
+
+  for (j = 0; j < nrows; j++)
+    f->row[j] = f->data + (size_t)j*f->stride;
+
+  for (j = 0; j < nrows*f->stride; j++)
+    f->data[j] = 0.0;
+
+  return f;
+}
+
+/****************************************************************************
+Frees a field allocated by NewField2D() (f itself is in the block of the row
+pointers, so it is freed with them)
+*****************************************************************************/
+void FreeField2D(Field2D *f) {
+  double **row = f->row;
+
+  free(f->data);
+  free(row);
+}
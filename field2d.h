@@ -0,0 +1,55 @@
+#ifndef FIELD2D_H
+#define FIELD2D_H
+/* Contiguous and aligned 2D fields, used by the ADI kernels */
+
+// Alignment (in bytes) of the fields and of each of their rows
+#define FIELD2D_ALIGN 64
+
+/* If YES, the fields bigger than a huge page are allocated on huge page boundaries
+   and the kernel is advised to back them with (transparent) huge pages */
+#ifndef FIELD2D_HUGE_PAGES
+  #define FIELD2D_HUGE_PAGES NO
+#endif
+
+/* A 2D field: a single FIELD2D_ALIGN aligned allocation, whose rows are padded to a
+   multiple of FIELD2D_ALIGN bytes. The row pointers are kept in row[], so a field can be
+   used as any double ** coming from ARRAY_2D() (and passed to the same functions),
+   while the kernels take the raw rows into restrict-qualified pointers (FIELD_ROW()).
+   As for ARRAY_2D(), row[0] is the start of the values (data) and row is the start of a
+   block of its own; this Field2D lives in that block too, right after the row pointers.
+   So FreeArray2D(row) (which frees row[0] and row) frees the whole field, as
+   FreeField2D() does */
+typedef struct FIELD2D {
+  double *data;   /**< The values, element [j][i] is data[j*stride + i] */
+  double **row;   /**< Row pointers (row[j] = data + j*stride) */
+  int nrows, ncols;
+  int stride;     /**< Distance (in number of doubles) between two consecutive rows */
+} Field2D;
+
+Field2D *NewField2D(int nrows, int ncols);
+void FreeField2D(Field2D *f);
+
+/* Drop-in replacement of ARRAY_2D(nrows, ncols, double): allocates a field and gives its
+   rows, to be freed with FreeArray2D() (see above) */
+#define ARRAY_2D_FIELD(nrows, ncols) (NewField2D((nrows), (ncols))->row)
+
+/* Raw access to the row j, and distance between the rows, of a field
+   (also valid for any ARRAY_2D(), as it is contiguous too).
+   To let the compiler vectorize, pass the rows to a function with restrict parameters */
+#define FIELD_ROW(f, j)   ((f)[j])
+#define FIELD_STRIDE(f)   ((int)((f)[1] - (f)[0]))
+
+/* Element-wise operations on rows, for ibeg <= i <= iend (the rows must not overlap).
+   Note: gcc trusts restrict only on function parameters, so the loops meant to be
+   vectorized are written as functions like these ones */
+static inline void CopyRow(double *restrict out, double const *restrict a, int ibeg, int iend) {
+  int i;
+  for (i = ibeg; i <= iend; i++) out[i] = a[i];
+}
+static inline void MulRow(double *restrict out, double const *restrict a,
+                          double const *restrict b, int ibeg, int iend) {
+  int i;
+  for (i = ibeg; i <= iend; i++) out[i] = a[i]*b[i];
+}
+
+#endif
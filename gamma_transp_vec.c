@@ -0,0 +1,262 @@
+/*Batch (SoA, n cells at once) versions of the DD transport formulas of gamma_transp.c
+(elRes_norm_DD(), thermCond_norm_DD()) and of the Saha ionization of pvte_law.c (GetMu())*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "gamma_transp.h"
+#include "gamma_transp_vec.h"
+#include "vec_math.h"
+#if DD_VEC_BENCHMARK
+  #include <time.h>
+#endif
+
+/****************************************************************************
+How it works:
+  the formulas are the same of the scalar functions, operation by operation, with
+  the branches turned into selections (both sides are computed, then blended).
+  With AVX2 the cells are done 4 at a time; the transcendental functions, which are
+  most of the cost of the scalar versions, are replaced by Log4() and Exp4() (vec_math.h):
+  vector ports of the log() and exp() of fdlibm (the usual reduction, then the same
+  minimax polynomials), whose error is below 1 ulp (glibc's is ~0.5 ulp), so the
+  results differ from the scalar ones by a few ulp (see BenchmarkDDBatch()).
+  pow(Z_ion, 0.89) becomes exp(0.89*log(Z_ion)), exactly 1 for Z_ion = 1 (always, for
+  hydrogen). The cells left over (n not a multiple of 4), and all the cells without
+  AVX2, are done by the scalar formulas.
+*****************************************************************************/
+
+#define ERG2KEV(kT) ((kT)/CONST_eV/1e3)  // As in gamma_transp.c
+extern const double sigma_ea;
+
+/****************************************************************************
+Ionization of the Saha equation, as GetMu() (SahaXFrac() of pvte_law.c, T in Kelvin,
+rho in code units), then as TC_kappaFromT() and Resistive_etaFromT() use it
+*****************************************************************************/
+static double IonizDD(double T, double rho) {
+  double me, kT, h3, c, x, n, mu;
+  double chi = 13.6*CONST_eV;
+
+  rho *= UNIT_DENSITY;
+  me = 2.0*CONST_PI*CONST_me;
+  kT = CONST_kB*T;
+  h3 = CONST_h*CONST_h*CONST_h;
+  n  = rho/CONST_mp;
+  c  = me*kT*sqrt(me*kT)/(h3*n)*exp(-chi/kT);
+  x = 2.0/(sqrt(1.0 + 4.0/c) + 1.0);
+  mu = 1.0/(1.0 + x);
+  return fmax(1/mu - 1, IONIZMIN);
+}
+
+#ifdef __AVX2__
+// IonizDD() of 4 cells
+static inline __m256d IonizDD4(__m256d T, __m256d rho) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  __m256d me = _mm256_set1_pd(2.0*CONST_PI*CONST_me);
+  __m256d h3 = _mm256_set1_pd(CONST_h*CONST_h*CONST_h);
+  __m256d kT, mekT, n, c, x, mu;
+
+  rho = _mm256_mul_pd(rho, _mm256_set1_pd(UNIT_DENSITY));
+  kT = _mm256_mul_pd(_mm256_set1_pd(CONST_kB), T);
+  n = _mm256_div_pd(rho, _mm256_set1_pd(CONST_mp));
+  mekT = _mm256_mul_pd(me, kT);
+  c = _mm256_div_pd(_mm256_mul_pd(mekT, _mm256_sqrt_pd(mekT)), _mm256_mul_pd(h3, n));
+  c = _mm256_mul_pd(c, Exp4(_mm256_div_pd(_mm256_set1_pd(-13.6*CONST_eV), kT)));
+  x = _mm256_div_pd(_mm256_set1_pd(2.0),
+        _mm256_add_pd(_mm256_sqrt_pd(_mm256_add_pd(one, _mm256_div_pd(_mm256_set1_pd(4.0), c))), one));
+  mu = _mm256_div_pd(one, _mm256_add_pd(one, x));
+  return _mm256_max_pd(_mm256_sub_pd(_mm256_div_pd(one, mu), one), _mm256_set1_pd(IONIZMIN));
+}
+
+// elRes_norm_DD() of 4 cells
+static inline __m256d ElRes4(__m256d z, __m256d rho, __m256d kT) {
+  const __m256d one = _mm256_set1_pd(1.0), half = _mm256_set1_pd(0.5);
+  __m256d TkeV, sqrt_TkeV, Z_ion, Z_ion_sq, ne, en, ei, cl_quant, cl_low, cl;
+
+  TkeV = _mm256_div_pd(_mm256_div_pd(kT, _mm256_set1_pd(CONST_eV)), _mm256_set1_pd(1e3));
+  Z_ion = _mm256_max_pd(one, z);
+  Z_ion_sq = _mm256_mul_pd(Z_ion, Z_ion);
+  ne = _mm256_div_pd(_mm256_mul_pd(z, rho), _mm256_set1_pd(CONST_mp+CONST_me));
+  sqrt_TkeV = _mm256_sqrt_pd(TkeV);
+
+  en = _mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(1.03e-14), _mm256_sub_pd(one, z)),
+                     _mm256_add_pd(z, _mm256_set1_pd(1e-20)));
+  en = _mm256_mul_pd(_mm256_mul_pd(en, sqrt_TkeV), _mm256_set1_pd(sigma_ea/1.4e-15));
+
+  cl_quant = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(7.1),
+               _mm256_mul_pd(half, Log4(_mm256_div_pd(ne, _mm256_set1_pd(1e21))))), Log4(TkeV));
+  cl_low = _mm256_add_pd(_mm256_add_pd(cl_quant, _mm256_set1_pd(2.3)),
+                         _mm256_mul_pd(half, Log4(_mm256_div_pd(TkeV, Z_ion_sq))));
+  cl = _mm256_blendv_pd(cl_quant, cl_low,
+         _mm256_cmp_pd(TkeV, _mm256_div_pd(_mm256_set1_pd(0.01), Z_ion_sq), _CMP_LT_OQ));
+  cl = _mm256_max_pd(cl, one);
+
+  ei = _mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(1.840e-19), cl), _mm256_mul_pd(TkeV, sqrt_TkeV));
+  ei = _mm256_mul_pd(ei, Z_ion);
+  return _mm256_add_pd(ei, en);
+}
+
+// thermCond_norm_DD() of 4 cells
+static inline __m256d ThermCond4(__m256d z, __m256d rho, __m256d kT) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  __m256d ne, Z_ion, Z_ion_sq, Zp, T, Tsq, sqrt_T, sq_ne, arg_low, arg_high, low, cl, deleps, chie, den;
+
+  ne = _mm256_div_pd(_mm256_mul_pd(z, rho), _mm256_set1_pd(CONST_mp+CONST_me));
+  Z_ion = _mm256_max_pd(one, z);
+  Z_ion_sq = _mm256_mul_pd(Z_ion, Z_ion);
+  Zp = Exp4(_mm256_mul_pd(_mm256_set1_pd(0.89), Log4(Z_ion)));
+  T = _mm256_div_pd(kT, _mm256_set1_pd(CONST_kB));
+  Tsq = _mm256_mul_pd(T, T);
+  sqrt_T = _mm256_sqrt_pd(T);
+  sq_ne = _mm256_sqrt_pd(_mm256_div_pd(ne, _mm256_set1_pd(CONST_NA)));
+
+  // One log, of the argument of the branch taken
+  low = _mm256_cmp_pd(T, _mm256_mul_pd(_mm256_set1_pd(1.57e5), Z_ion_sq), _CMP_LE_OQ);
+  arg_low = _mm256_div_pd(_mm256_mul_pd(T, sqrt_T), _mm256_mul_pd(sq_ne, Z_ion));
+  arg_high = _mm256_div_pd(T, sq_ne);
+  cl = _mm256_add_pd(_mm256_blendv_pd(_mm256_set1_pd(-12.36), _mm256_set1_pd(-18.34), low),
+                     Log4(_mm256_blendv_pd(arg_high, arg_low, low)));
+
+  deleps = _mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(0.4), Zp), _mm256_add_pd(_mm256_set1_pd(3.25), Zp));
+  chie = _mm256_mul_pd(_mm256_mul_pd(deleps, _mm256_set1_pd(1.96e-4)), _mm256_mul_pd(Tsq, sqrt_T));
+  chie = _mm256_div_pd(_mm256_div_pd(chie, cl), Z_ion);
+
+  // 1 + 4e-9*(1-z)/z/Z_ion_sq*(sigma_ea/1.4e-15)*Tsq, only where z < 1
+  den = _mm256_div_pd(_mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(4e-9), _mm256_sub_pd(one, z)), z), Z_ion_sq);
+  den = _mm256_add_pd(one, _mm256_mul_pd(_mm256_mul_pd(den, _mm256_set1_pd(sigma_ea/1.4e-15)), Tsq));
+  return _mm256_blendv_pd(chie, _mm256_div_pd(chie, den), _mm256_cmp_pd(z, one, _CMP_LT_OQ));
+}
+#endif
+
+/****************************************************************************
+Ionization z = max(1/mu - 1, IONIZMIN) (mu of GetMu()) of n cells, from their
+temperature T (Kelvin) and density rho (code units)
+*****************************************************************************/
+void IonizDDBatch(const double *T, const double *rho, double *z, int n) {
+  int m = 0;
+  #ifdef __AVX2__
+    for (; m + 4 <= n; m += 4)
+      _mm256_storeu_pd(z + m, IonizDD4(_mm256_loadu_pd(T + m), _mm256_loadu_pd(rho + m)));
+  #endif
+  for (; m < n; m++) z[m] = IonizDD(T[m], rho[m]);
+}
+
+/****************************************************************************
+elRes_norm_DD() of n cells (z, rho in g/cm^3, kT in erg)
+*****************************************************************************/
+void elRes_norm_DD_Batch(const double *z, const double *rho, const double *kT, double *eta, int n) {
+  int m = 0;
+  #ifdef __AVX2__
+    for (; m + 4 <= n; m += 4)
+      _mm256_storeu_pd(eta + m, ElRes4(_mm256_loadu_pd(z + m), _mm256_loadu_pd(rho + m),
+                                       _mm256_loadu_pd(kT + m)));
+  #endif
+  for (; m < n; m++) eta[m] = elRes_norm_DD(z[m], rho[m], kT[m]);
+}
+
+/****************************************************************************
+thermCond_norm_DD() of n cells (z, rho in g/cm^3, kT in erg)
+*****************************************************************************/
+void thermCond_norm_DD_Batch(const double *z, const double *rho, const double *kT, double *kappa, int n) {
+  int m = 0;
+  #ifdef __AVX2__
+    for (; m + 4 <= n; m += 4)
+      _mm256_storeu_pd(kappa + m, ThermCond4(_mm256_loadu_pd(z + m), _mm256_loadu_pd(rho + m),
+                                             _mm256_loadu_pd(kT + m)));
+  #endif
+  for (; m < n; m++) kappa[m] = thermCond_norm_DD(z[m], rho[m], kT[m]);
+}
+
+#if DD_VEC_BENCHMARK
+static double ElapsedNs(struct timespec *beg, struct timespec *end, int n) {
+  return ((end->tv_sec - beg->tv_sec)*1.e9 + (end->tv_nsec - beg->tv_nsec))/n;
+}
+
+/****************************************************************************
+Compares the batch functions with the scalar ones (as TC_kappaFromT() and
+Resistive_etaFromT() call them), on (rho, T) spread over the range of the transport
+tables (R2 quasi-random sequence): prints the time per cell and the max relative error
+*****************************************************************************/
+void BenchmarkDDBatch() {
+  int const N = 100000;
+  int n;
+  double *rho, *rho_cgs, *T, *kT, *z_s, *z_b, *f_s, *f_b;
+  double err_z = 0.0, err_eta = 0.0, err_kappa = 0.0;
+  double t_z_s, t_z_b, t_eta_s, t_eta_b, t_kappa_s, t_kappa_b;
+  double lnrho_min = log(RHO_TAB_MIN/UNIT_DENSITY), lnrho_max = log(RHO_TAB_MAX/UNIT_DENSITY);
+  double lnT_min = log(T_TAB_MIN), lnT_max = log(T_TAB_MAX);
+  struct timespec t_beg, t_end;
+
+  rho = ARRAY_1D(N, double);
+  rho_cgs = ARRAY_1D(N, double);
+  T = ARRAY_1D(N, double);
+  kT = ARRAY_1D(N, double);
+  z_s = ARRAY_1D(N, double);
+  z_b = ARRAY_1D(N, double);
+  f_s = ARRAY_1D(N, double);
+  f_b = ARRAY_1D(N, double);
+  for (n = 0; n < N; n++) {
+    rho[n] = exp(lnrho_min + fmod(0.5 + n*0.7548776662466927, 1.0)*(lnrho_max - lnrho_min));
+    T[n] = exp(lnT_min + fmod(0.5 + n*0.5698402909980532, 1.0)*(lnT_max - lnT_min));
+    rho_cgs[n] = rho[n]*UNIT_DENSITY;
+    kT[n] = T[n]*CONST_kB;
+  }
+
+  /* ---- Ionization ---- */
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  for (n = 0; n < N; n++) z_s[n] = IonizDD(T[n], rho[n]);
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_z_s = ElapsedNs(&t_beg, &t_end, N);
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  IonizDDBatch(T, rho, z_b, N);
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_z_b = ElapsedNs(&t_beg, &t_end, N);
+  for (n = 0; n < N; n++) err_z = fmax(err_z, fabs(z_b[n] - z_s[n])/z_s[n]);
+
+  /* ---- eta (with the same z) ---- */
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  for (n = 0; n < N; n++) f_s[n] = elRes_norm_DD(z_s[n], rho_cgs[n], kT[n]);
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_eta_s = ElapsedNs(&t_beg, &t_end, N);
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  elRes_norm_DD_Batch(z_s, rho_cgs, kT, f_b, N);
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_eta_b = ElapsedNs(&t_beg, &t_end, N);
+  for (n = 0; n < N; n++) err_eta = fmax(err_eta, fabs(f_b[n] - f_s[n])/f_s[n]);
+
+  /* ---- kappa (with the same z) ---- */
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  for (n = 0; n < N; n++) f_s[n] = thermCond_norm_DD(z_s[n], rho_cgs[n], kT[n]);
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_kappa_s = ElapsedNs(&t_beg, &t_end, N);
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  thermCond_norm_DD_Batch(z_s, rho_cgs, kT, f_b, N);
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_kappa_b = ElapsedNs(&t_beg, &t_end, N);
+  for (n = 0; n < N; n++) err_kappa = fmax(err_kappa, fabs(f_b[n] - f_s[n])/f_s[n]);
+
+  print1("\n> BenchmarkDDBatch(): %d cells, %s", N,
+  #ifdef __AVX2__
+         "AVX2");
+  #else
+         "no AVX2 (scalar loops)");
+  #endif
+  print1("\n  ionization: scalar %.1f ns/cell, batch %.1f ns/cell, max rel. err. %.2e",
+         t_z_s, t_z_b, err_z);
+  print1("\n  eta:        scalar %.1f ns/cell, batch %.1f ns/cell, max rel. err. %.2e",
+         t_eta_s, t_eta_b, err_eta);
+  print1("\n  kappa:      scalar %.1f ns/cell, batch %.1f ns/cell, max rel. err. %.2e",
+         t_kappa_s, t_kappa_b, err_kappa);
+
+  FreeArray1D((void *)rho);
+  FreeArray1D((void *)rho_cgs);
+  FreeArray1D((void *)T);
+  FreeArray1D((void *)kT);
+  FreeArray1D((void *)z_s);
+  FreeArray1D((void *)z_b);
+  FreeArray1D((void *)f_s);
+  FreeArray1D((void *)f_b);
+}
+#endif
@@ -0,0 +1,19 @@
+#ifndef GAMMA_TRANSP_VEC_H
+#define GAMMA_TRANSP_VEC_H
+/* Versions for n cells at once (SoA arrays) of the DD formulas of gamma_transp.c and of the
+   Saha ionization used with them, vectorized with AVX2 (4 cells per instruction) if the code
+   is compiled with -mavx2 (see local_make), otherwise they are loops on the scalar formulas */
+
+// If YES, the batch formulas are compared (time and error) with the scalar ones, once
+#ifndef DD_VEC_BENCHMARK
+  #define DD_VEC_BENCHMARK NO
+#endif
+
+void IonizDDBatch(const double *T, const double *rho, double *z, int n);
+void elRes_norm_DD_Batch(const double *z, const double *rho, const double *kT, double *eta, int n);
+void thermCond_norm_DD_Batch(const double *z, const double *rho, const double *kT, double *kappa, int n);
+#if DD_VEC_BENCHMARK
+  void BenchmarkDDBatch();
+#endif
+
+#endif
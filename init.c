@@ -202,6 +202,10 @@ void Analysis (const Data *d, Grid *grid)
     double Mtot=0;
     double current = GetCurrADI();
     double en_adv_in_gau, en_tc_in_gau, en_res_in_gau;
+    double en_sums[7];
+    #if RAD_LOSS_ADI
+      double en_rad_out_gau;
+    #endif
     int i, j, k;
     // int nv;
     // double v[NVAR];
@@ -211,9 +215,9 @@ void Analysis (const Data *d, Grid *grid)
     double *rR, *rL, *dz;
     RBox *box = GetRBox(DOM, CENTER);
 
-    rR = grid[IDIR].xr_glob;
-    rL = grid[IDIR].xl_glob;
-    dz = grid[JDIR].dx_glob;
+    rR = grid[IDIR].xr;
+    rL = grid[IDIR].xl;
+    dz = grid[JDIR].dx;
 
     Vc = d->Vc;
     Uc = d->Uc;
@@ -222,7 +226,7 @@ void Analysis (const Data *d, Grid *grid)
 
     DOM_LOOP (k,j,i) {
       // I do this to exclude points belonging to the wall
-      if (i<=i_cap_inter_end || j>j_cap_inter_end) {
+      if (!(GetCapRegionMap(grid)[j][i] & CAP_REGION_WALL)) {
         #if GEOMETRY == CYLINDRICAL
         /* Note that I could use instead some element (like dV) of the grid itself,
           I don't do that to make this chunk of code compatible for both the 2015 and 2018 version of PLUTO */
@@ -236,13 +240,29 @@ void Analysis (const Data *d, Grid *grid)
       }
     }
 
+    #ifdef PARALLEL
+      /* Every process has its own part of the domain (and of the ADI lines, for the
+         energy entering through the boundaries) */
+      en_sums[0] = etot;      en_sums[1] = Vtot;     en_sums[2] = Mtot;
+      en_sums[3] = en_adv_in; en_sums[4] = en_tc_in; en_sums[5] = en_res_in;
+      en_sums[6] = en_rad_out;
+      MPI_Allreduce(MPI_IN_PLACE, en_sums, 7, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+      etot = en_sums[0];      Vtot = en_sums[1];     Mtot = en_sums[2];
+    #else
+      en_sums[3] = en_adv_in; en_sums[4] = en_tc_in; en_sums[5] = en_res_in;
+      en_sums[6] = en_rad_out;
+    #endif
+
     // I convert values to physical units
     etot *= unit_en;
     Vtot *= UNIT_LENGTH*UNIT_LENGTH*UNIT_LENGTH;
     Mtot *= UNIT_DENSITY*UNIT_LENGTH*UNIT_LENGTH*UNIT_LENGTH;
-    en_adv_in_gau = en_adv_in*unit_en;
-    en_tc_in_gau = en_tc_in*unit_en;
-    en_res_in_gau = en_res_in*unit_en;    
+    en_adv_in_gau = en_sums[3]*unit_en;
+    en_tc_in_gau = en_sums[4]*unit_en;
+    en_res_in_gau = en_sums[5]*unit_en;    
+    #if RAD_LOSS_ADI
+      en_rad_out_gau = en_sums[6]*unit_en;
+    #endif
 
     /* Write to file (remember: prank is the processor rank (0 in serial mode),
       so this chunk of code should work also in parallel mode!).
@@ -256,8 +276,13 @@ void Analysis (const Data *d, Grid *grid)
       if (g_stepNumber == 0) { /* Open for writing only when we’re starting */
         fp = fopen(fname,"w"); /* from beginning */
         fprintf (fp,"# Energy conservation table. Advice: read with R: read.table()\n");
-        fprintf (fp,"%6s %12s %12s %12s %12s %12s %12s %12s %12s %12s\n", "", "t", "dt", "volume", "mass",
-                 "current", "Etot", "E_adv_in", "E_tc_in", "E_res_in");
+        #if RAD_LOSS_ADI
+          fprintf (fp,"%6s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s\n", "", "t", "dt", "volume", "mass",
+                   "current", "Etot", "E_adv_in", "E_tc_in", "E_res_in", "E_rad_out");
+        #else
+          fprintf (fp,"%6s %12s %12s %12s %12s %12s %12s %12s %12s %12s\n", "", "t", "dt", "volume", "mass",
+                   "current", "Etot", "E_adv_in", "E_tc_in", "E_res_in");
+        #endif
       } else {
         /* Append if this is not step 0 */
         if (tpos < 0.0) { /* Obtain time coordinate of to last written row */
@@ -274,9 +299,15 @@ void Analysis (const Data *d, Grid *grid)
       }
       if (g_time > tpos){
       /* Write if current time if > tpos */
-      fprintf (fp, "%6d %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e\n", 
-               ncall_an, t, dt, Vtot, Mtot, current, etot,
-               en_adv_in_gau, en_tc_in_gau, en_res_in_gau);
+      #if RAD_LOSS_ADI
+        fprintf (fp, "%6d %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e\n", 
+                 ncall_an, t, dt, Vtot, Mtot, current, etot,
+                 en_adv_in_gau, en_tc_in_gau, en_res_in_gau, en_rad_out_gau);
+      #else
+        fprintf (fp, "%6d %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e %12.6e\n", 
+                 ncall_an, t, dt, Vtot, Mtot, current, etot,
+                 en_adv_in_gau, en_tc_in_gau, en_res_in_gau);
+      #endif
       }
       fclose(fp);
     }
@@ -369,15 +400,13 @@ void UserDefBoundary (const Data *d, RBox *box, int side, Grid *grid)
   }
   if (first_call) {
     /* Set internal boundary flag on internal boundary points*/
-    KTOT_LOOP(k) {
-      for (j=0; j<=j_cap_inter_end; j++) {
-        for (i=i_cap_inter_end+1; i<NX1_TOT; i++) {
-          d->flag[k][j][i] |= FLAG_INTERNAL_BOUNDARY;
-        }
+    TOT_LOOP(k,j,i) {
+      if (GetCapRegionMap(grid)[j][i] & CAP_REGION_WALL) {
+        d->flag[k][j][i] |= FLAG_INTERNAL_BOUNDARY;
       }
     }
 
-    SetRBox_capWall(GetNghost());
+    SetRBox_capWall(grid, GetNghost());
 
     first_call = 0;
   }
@@ -565,11 +594,9 @@ Inoltre per altre quantità (e.g. la temperatura e il campo mag.) il valore sul
      Set internal boundary flag on internal boundary points
     **********************/
     /*** At every step I must set the flag, at the program resets it automatically***/
-    KTOT_LOOP(k) {
-      for (j=0; j<=j_cap_inter_end; j++) {
-        for (i=i_cap_inter_end+1; i<NX1_TOT; i++) {
-          d->flag[k][j][i] |= FLAG_INTERNAL_BOUNDARY;
-        }
+    TOT_LOOP(k,j,i) {
+      if (GetCapRegionMap(grid)[j][i] & CAP_REGION_WALL) {
+        d->flag[k][j][i] |= FLAG_INTERNAL_BOUNDARY;
       }
     }
     /*** ***/
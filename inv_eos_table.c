@@ -0,0 +1,290 @@
+/*Tables of the inverse of the PVTE_LAW EOS: the temperature as a function of
+(rho, rhoe/rho), built from InternalEnergyFunc() (T_LIM_IEN/BETA_IEN modification
+included), and as a function of (rho, p/rho), built from the pressure law T/mu(T,rho).
+They replace the iterative inversions (GetEV_Temperature(), GetPV_Temperature()),
+which remain only as a fallback for the states outside the tables*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "inv_eos_table.h"
+#include "pvte_law_heat_capacity.h"
+#if INV_EOS_BENCHMARK
+  #include <time.h>
+#endif
+
+#if INV_EOS_TABLE
+
+/* A table of ln(T) on uniform nodes of ln(rho) (rows) and of ln(q) (columns), where q is
+   rhoe/rho or p/rho*KELVIN (code units). The range of q is the one spanned by
+   T_TAB_MIN..T_TAB_MAX at any rho of RHO_TAB_MIN..RHO_TAB_MAX, so at a given rho some
+   nodes are outside it: they hold INV_EOS_NO_T */
+typedef struct INV_EOS_TAB {
+  double lnrho_min, dlnrho_1;  // ln(rho) of the first row and 1/(spacing of the rows)
+  double lnq_min, dlnq_1;      // ln(q) of the first column and 1/(spacing of the columns)
+  int nrho, nq;
+  double **lnT;
+} InvEOSTable;
+
+#define INV_EOS_NO_T (-1.0)      // ln(T) of the table is always > 0
+#define INV_EOS_BISECT_ITER 60   // Bisections (in ln(T)) to find the T of a node
+
+static InvEOSTable e_tab, p_tab;
+static int inv_eos_tab_not_done = 1;
+
+// The quantities q(T) (monotonic in T) the two tables invert
+static double SpecificEnergy(double *v, double T) {
+  return InternalEnergyFunc(v, T)/v[RHO];
+}
+static double PressureOverRho(double *v, double T) {
+  double df_dT;
+  return TemperatureFuncAndDerivative(v, T, &df_dT);
+}
+
+/****************************************************************************
+Fills the table tab with the T which solves Q(v,T) = q at every node
+*****************************************************************************/
+static void BuildInvEOSTable(InvEOSTable *tab, double (*Q)(double *, double)) {
+  int i, j, it;
+  double v[NVAR];
+  double lnT_min = log(T_TAB_MIN), lnT_max = log(T_TAB_MAX);
+  double lnrho_max, q_min, q_max, q_lo, q_hi, q;
+  double lo, hi, mid;
+
+  tab->nrho = INV_EOS_N_RHO;
+  tab->nq = INV_EOS_N_Q;
+  tab->lnrho_min = log(RHO_TAB_MIN/UNIT_DENSITY);
+  lnrho_max = log(RHO_TAB_MAX/UNIT_DENSITY);
+  tab->dlnrho_1 = (tab->nrho - 1)/(lnrho_max - tab->lnrho_min);
+
+  // Range of q
+  q_min = 1.e300;
+  q_max = 0.0;
+  for (j = 0; j < tab->nrho; j++) {
+    v[RHO] = exp(tab->lnrho_min + j/tab->dlnrho_1);
+    q_min = fmin(q_min, Q(v, T_TAB_MIN));
+    q_max = fmax(q_max, Q(v, T_TAB_MAX));
+  }
+  tab->lnq_min = log(q_min);
+  tab->dlnq_1 = (tab->nq - 1)/(log(q_max) - tab->lnq_min);
+
+  tab->lnT = ARRAY_2D(tab->nrho, tab->nq, double);
+  for (j = 0; j < tab->nrho; j++) {
+    v[RHO] = exp(tab->lnrho_min + j/tab->dlnrho_1);
+    q_lo = Q(v, T_TAB_MIN);
+    q_hi = Q(v, T_TAB_MAX);
+    for (i = 0; i < tab->nq; i++) {
+      q = exp(tab->lnq_min + i/tab->dlnq_1);
+      if (q < q_lo || q > q_hi) {
+        tab->lnT[j][i] = INV_EOS_NO_T;
+        continue;
+      }
+      // Q is monotonic in T, a bisection is slow but it cannot fail (and it is done once)
+      lo = lnT_min;
+      hi = lnT_max;
+      for (it = 0; it < INV_EOS_BISECT_ITER; it++) {
+        mid = 0.5*(lo + hi);
+        if (Q(v, exp(mid)) < q) lo = mid;
+        else hi = mid;
+      }
+      tab->lnT[j][i] = 0.5*(lo + hi);
+    }
+  }
+}
+
+/****************************************************************************
+Bilinear interpolation of ln(T) in (ln(rho), ln(q)).
+Returns 0 on success, 1 if (rho, q) is outside the table (then T is not set).
+*****************************************************************************/
+static int LookupInvEOSTable(InvEOSTable *tab, double rho, double q, double *T) {
+  int i, j;
+  double x, y, fx, fy;
+  double f00, f01, f10, f11;
+
+  if (!(rho > 0.0 && q > 0.0)) return 1;
+
+  y = (log(rho) - tab->lnrho_min)*tab->dlnrho_1;
+  x = (log(q) - tab->lnq_min)*tab->dlnq_1;
+  if (!(y >= 0.0 && y <= tab->nrho - 1 && x >= 0.0 && x <= tab->nq - 1)) return 1;
+
+  j = (int)y;
+  i = (int)x;
+  if (j == tab->nrho - 1) j--;
+  if (i == tab->nq - 1) i--;
+  fy = y - j;
+  fx = x - i;
+
+  f00 = tab->lnT[j][i];
+  f01 = tab->lnT[j][i+1];
+  f10 = tab->lnT[j+1][i];
+  f11 = tab->lnT[j+1][i+1];
+  if (f00 < 0.0 || f01 < 0.0 || f10 < 0.0 || f11 < 0.0) return 1;
+
+  *T = exp((1.0 - fy)*((1.0 - fx)*f00 + fx*f01) + fy*((1.0 - fx)*f10 + fx*f11));
+  return 0;
+}
+
+#if INV_EOS_BENCHMARK
+static double ElapsedNs(struct timespec *beg, struct timespec *end, int n) {
+  return ((end->tv_sec - beg->tv_sec)*1.e9 + (end->tv_nsec - beg->tv_nsec))/n;
+}
+
+/****************************************************************************
+Compares the lookups with the iterative inversions of PLUTO, on states with
+(rho, T) spread over the whole range of the tables (R2 quasi-random sequence)
+*****************************************************************************/
+static void BenchmarkInverseEOSTables() {
+  int const N = 100000;
+  int n, miss_e = 0, miss_p = 0;
+  double *rho, *T, *rhoe, *prs, *T_tab, *T_it;
+  double v[NVAR];
+  double err, err_max_e = 0.0, err_max_p = 0.0, err_it_max = 0.0;
+  double t_tab_e, t_it_e, t_tab_p, t_it_p;
+  double lnrho_min = log(RHO_TAB_MIN/UNIT_DENSITY), lnrho_max = log(RHO_TAB_MAX/UNIT_DENSITY);
+  double lnT_min = log(T_TAB_MIN), lnT_max = log(T_TAB_MAX);
+  struct timespec t_beg, t_end;
+
+  rho = ARRAY_1D(N, double);
+  T = ARRAY_1D(N, double);
+  rhoe = ARRAY_1D(N, double);
+  prs = ARRAY_1D(N, double);
+  T_tab = ARRAY_1D(N, double);
+  T_it = ARRAY_1D(N, double);
+  for (n = 0; n < NVAR; n++) v[n] = 0.0;
+
+  for (n = 0; n < N; n++) {
+    rho[n] = exp(lnrho_min + fmod(0.5 + n*0.7548776662466927, 1.0)*(lnrho_max - lnrho_min));
+    T[n] = exp(lnT_min + fmod(0.5 + n*0.5698402909980532, 1.0)*(lnT_max - lnT_min));
+    v[RHO] = rho[n];
+    rhoe[n] = InternalEnergyFunc(v, T[n]);
+    prs[n] = rho[n]*PressureOverRho(v, T[n])/KELVIN;
+  }
+
+  /* ---- T(rho, rhoe) ---- */
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  for (n = 0; n < N; n++)
+    if (GetTemperatureFromEnergyTable(rho[n], rhoe[n], &(T_tab[n])) != 0) T_tab[n] = -1.0;
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_tab_e = ElapsedNs(&t_beg, &t_end, N);
+
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  for (n = 0; n < N; n++) {
+    v[RHO] = rho[n];
+    GetEV_Temperature(rhoe[n], v, &(T_it[n]));
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_it_e = ElapsedNs(&t_beg, &t_end, N);
+
+  for (n = 0; n < N; n++) {
+    if (T_tab[n] < 0.0) {
+      miss_e++;
+      continue;
+    }
+    err = fabs(T_tab[n] - T[n])/T[n];
+    err_max_e = fmax(err_max_e, err);
+    err_it_max = fmax(err_it_max, fabs(T_it[n] - T[n])/T[n]);
+  }
+
+  /* ---- T(rho, p) ---- */
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  for (n = 0; n < N; n++)
+    if (GetTemperatureFromPressureTable(rho[n], prs[n], &(T_tab[n])) != 0) T_tab[n] = -1.0;
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_tab_p = ElapsedNs(&t_beg, &t_end, N);
+
+  clock_gettime(CLOCK_MONOTONIC, &t_beg);
+  for (n = 0; n < N; n++) {
+    v[RHO] = rho[n];
+    v[PRS] = prs[n];
+    GetPV_Temperature(v, &(T_it[n]));
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  t_it_p = ElapsedNs(&t_beg, &t_end, N);
+
+  for (n = 0; n < N; n++) {
+    if (T_tab[n] < 0.0) {
+      miss_p++;
+      continue;
+    }
+    err = fabs(T_tab[n] - T[n])/T[n];
+    err_max_p = fmax(err_max_p, err);
+    err_it_max = fmax(err_it_max, fabs(T_it[n] - T[n])/T[n]);
+  }
+
+  print1("\n> Inverse EOS tables benchmark (%d states):", N);
+  print1("\n   T(rho,rhoe): table %.1f ns, GetEV_Temperature %.1f ns, max rel.err %.2e, misses %d",
+         t_tab_e, t_it_e, err_max_e, miss_e);
+  print1("\n   T(rho,p):    table %.1f ns, GetPV_Temperature %.1f ns, max rel.err %.2e, misses %d",
+         t_tab_p, t_it_p, err_max_p, miss_p);
+  print1("\n   (max rel.err of the iterative inversions: %.2e)", err_it_max);
+
+  FreeArray1D((void *)rho);
+  FreeArray1D((void *)T);
+  FreeArray1D((void *)rhoe);
+  FreeArray1D((void *)prs);
+  FreeArray1D((void *)T_tab);
+  FreeArray1D((void *)T_it);
+}
+#endif
+
+/****************************************************************************
+Builds the two tables (it is called by the first lookup, if not before)
+*****************************************************************************/
+void MakeInverseEOSTables() {
+  if (!inv_eos_tab_not_done) return;
+
+  print1("\n> MakeInverseEOSTables(): Generating tables (%d x %d points)",
+         INV_EOS_N_RHO, INV_EOS_N_Q);
+  BuildInvEOSTable(&e_tab, SpecificEnergy);
+  BuildInvEOSTable(&p_tab, PressureOverRho);
+  inv_eos_tab_not_done = 0;
+
+  #if INV_EOS_BENCHMARK
+    BenchmarkInverseEOSTables();
+  #endif
+}
+
+/****************************************************************************
+Temperature (Kelvin) from rho and rhoe (code units).
+Returns 0 on success, 1 if the state is outside the table.
+*****************************************************************************/
+int GetTemperatureFromEnergyTable(double rho, double rhoe, double *T) {
+  #if INV_EOS_POLISH > 0
+    double v[NVAR], drhoe_dT;
+    int it;
+  #endif
+
+  if (inv_eos_tab_not_done) MakeInverseEOSTables();
+  if (LookupInvEOSTable(&e_tab, rho, rhoe/rho, T) != 0) return 1;
+  #if INV_EOS_POLISH > 0
+    v[RHO] = rho;
+    for (it = 0; it < INV_EOS_POLISH; it++)
+      *T += (rhoe - InternalEnergyAndDerivative(v, *T, &drhoe_dT))/drhoe_dT;
+  #endif
+  return 0;
+}
+
+/****************************************************************************
+Temperature (Kelvin) from rho and p (code units).
+Returns 0 on success, 1 if the state is outside the table.
+*****************************************************************************/
+int GetTemperatureFromPressureTable(double rho, double prs, double *T) {
+  double q = prs/rho*KELVIN;
+  #if INV_EOS_POLISH > 0
+    double v[NVAR], df_dT;
+    int it;
+  #endif
+
+  if (inv_eos_tab_not_done) MakeInverseEOSTables();
+  if (LookupInvEOSTable(&p_tab, rho, q, T) != 0) return 1;
+  #if INV_EOS_POLISH > 0
+    v[RHO] = rho;
+    for (it = 0; it < INV_EOS_POLISH; it++)
+      *T += (q - TemperatureFuncAndDerivative(v, *T, &df_dT))/df_dT;
+  #endif
+  return 0;
+}
+#endif
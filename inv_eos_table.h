@@ -0,0 +1,33 @@
+#ifndef INV_EOS_TABLE_H
+#define INV_EOS_TABLE_H
+/* Tables of the inverse of the PVTE_LAW EOS: T as a function of (rho, rhoe/rho)
+   and of (rho, p/rho), see inv_eos_table.c */
+
+#ifndef INV_EOS_TABLE
+  #define INV_EOS_TABLE NO
+#endif
+// Number of nodes in log(rho) and in log(rhoe/rho) (or log(p/rho))
+#ifndef INV_EOS_N_RHO
+  #define INV_EOS_N_RHO 100
+#endif
+#ifndef INV_EOS_N_Q
+  #define INV_EOS_N_Q 400
+#endif
+/* Number of Newton steps (with the exact derivative) correcting the T interpolated from a
+   table: each one costs an evaluation of the EOS, but roughly squares the error */
+#ifndef INV_EOS_POLISH
+  #define INV_EOS_POLISH 1
+#endif
+// If YES, the lookups are compared (time and error) with the iterative inversions, once
+#ifndef INV_EOS_BENCHMARK
+  #define INV_EOS_BENCHMARK NO
+#endif
+#if INV_EOS_TABLE && EOS != PVTE_LAW
+  #error INV_EOS_TABLE is implemented only for PVTE_LAW
+#endif
+
+void MakeInverseEOSTables();
+int GetTemperatureFromEnergyTable(double rho, double rhoe, double *T);
+int GetTemperatureFromPressureTable(double rho, double prs, double *T);
+
+#endif
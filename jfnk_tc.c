@@ -0,0 +1,394 @@
+/*Jacobian-free Newton-Krylov (JFNK) solver for the nonlinear backward Euler step of
+thermal conduction: kappa(T) and the internal energy rhoe(T) are evaluated at the new
+temperature, the linear systems of the Newton iterations are solved with (right preconditioned)
+GMRES, where the preconditioner is an ADI sweep with kappa lagged at the old temperature*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "adi.h"
+#include "capillary_wall.h"
+#include "pvte_law_heat_capacity.h"
+#include "tc_kappa.h"
+#include "cell_state.h"
+
+#if THERMAL_CONDUCTION == ALTERNATING_DIRECTION_IMPLICIT && METHOD_TC == JFNK
+
+/* Newton iterations stop when max|residual|/T < JFNK_NEWTON_RTOL (the residual is
+   scaled by dEdT, so that it is a temperature) */
+#ifndef JFNK_NEWTON_RTOL
+  #define JFNK_NEWTON_RTOL 1e-6
+#endif
+#ifndef JFNK_MAX_NEWTON
+  #define JFNK_MAX_NEWTON 15
+#endif
+/* Max dimension of the Krylov subspace (no restarts: inexact Newton) */
+#ifndef JFNK_KRYLOV_DIM
+  #define JFNK_KRYLOV_DIM 20
+#endif
+/* Relative tollerance of GMRES at every Newton iteration */
+#ifndef JFNK_KRYLOV_RTOL
+  #define JFNK_KRYLOV_RTOL 1e-2
+#endif
+/* A Newton step is damped so that T does not decrease more than this fraction in any cell */
+#define JFNK_MAX_REL_DECREASE 0.5
+/* sqrt of the machine epsilon, for the finite difference Jacobian-vector product */
+#define JFNK_SQRT_EPS 1.e-8
+
+static double **kappa, **rhoe_n, **dEdT_lag;
+static double **IpN, **ImN, **JpN, **JmN; // Operators at the last evaluated temperature
+static Bcs *lbound0[2], *rbound0[2];      // Homogeneous bcs for the corrections
+
+static void ConductionResidual(double **G, double **T, const Data *d, Grid *grid,
+                               Lines *lines, double dt);
+static void PreconditionADI(double **x, double **r, double **IpT, double **ImT,
+                            double **JpT, double **JmT, double **CIT, double **CJT,
+                            Grid *grid, Lines *lines, int order, double dt);
+static double LinesDot(double **a, double **b, Lines *lines);
+
+/* ***********************************************************
+ * Advances T by one backward Euler step (of dt) of the nonlinear
+ * conduction problem, solved with Newton-Krylov:
+ *   G(T) = [rhoe(T) - rhoe(T_old)]/dEdT - dt/dEdT*div(kappa(T) grad T) = 0
+ *
+ * output: T_new
+ *         **dEdT: secant heat capacity (rhoe(T_new)-rhoe(T_old))/(T_new-T_old),
+ *                 so that dEdT*(T_new-T_old) is the exact increase of internal energy
+ *
+ * order (FIRST_IDIR or FIRST_JDIR) is the order of the sweeps of the preconditioner
+ * and of the fallback.
+ * If Newton does not converge I fall back to DouglasRachford() with NSUBS_TC sub-steps.
+ * ***********************************************************/
+void JFNK_TC(double **T_new, double **T_old, double **dEdT,
+             const Data *d, Grid *grid, Lines *lines,
+             int order, double dt, double t0) {
+  static int first_call = 1;
+  static double **IpT, **ImT, **JpT, **JmT, **CIT, **CJT;
+  static double **G, **G_pert, **T_pert, **delta, **w;
+  static double **Vk[JFNK_KRYLOV_DIM+1];
+  double h[JFNK_KRYLOV_DIM+1][JFNK_KRYLOV_DIM];
+  double cs[JFNK_KRYLOV_DIM], sn[JFNK_KRYLOV_DIM], g[JFNK_KRYLOV_DIM+1], y[JFNK_KRYLOV_DIM];
+  double beta, eps, Tnorm, wnorm, tmp, hnext, lambda, err;
+  double v[NVAR], drhoe_dT, rhoe_new;
+  double ****Vc = d->Vc;
+  double *r, *z, *theta;
+  double *rR, *rL, *dz;
+  double kpar, knor, phi;
+  int nit, kk, m, q, converged;
+  int i,j,k,l,nv,dir,side;
+  long int Ncells;
+
+  if (first_call) {
+    IpT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    ImT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JpT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JmT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    CIT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    CJT = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    IpN = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    ImN = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JpN = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    JmN = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    kappa = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    rhoe_n = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    dEdT_lag = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    G = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    G_pert = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    T_pert = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    delta = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    w = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    for (m = 0; m <= JFNK_KRYLOV_DIM; m++)
+      Vk[m] = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    for (dir = IDIR; dir <= JDIR; dir++) {
+      lbound0[dir] = ARRAY_1D(lines[dir].N, Bcs);
+      rbound0[dir] = ARRAY_1D(lines[dir].N, Bcs);
+    }
+    first_call = 0;
+  }
+
+  r = grid[IDIR].x;
+  z = grid[JDIR].x;
+  theta = grid[KDIR].x;
+
+  /* ---- Lagged operators (preconditioner) and energy at the old T ---- */
+  BuildIJ_TC(d, grid, lines, IpT, ImT, JpT, JmT, CIT, CJT, dEdT_lag);
+
+  Ncells = 0;
+  KDOM_LOOP(k)
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+      rhoe_n[j][i] = InternalEnergyAndDerivative(v, T_old[j][i]*KELVIN, &drhoe_dT);
+      T_new[j][i] = T_old[j][i];
+      Ncells++;
+    }
+
+  /* ---- kappa on the ghosts next to the lines (it stays the one of the old state) ---- */
+  KDOM_LOOP(k) {
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        i = side ? lines[IDIR].ridx[l]+1 : lines[IDIR].lidx[l]-1;
+        kappa[j][i] = CellKappa(d, grid, k, j, i);
+      }
+    }
+    for (l = 0; l < lines[JDIR].N; l++) {
+      i = lines[JDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        j = side ? lines[JDIR].ridx[l]+1 : lines[JDIR].lidx[l]-1;
+        kappa[j][i] = CellKappa(d, grid, k, j, i);
+      }
+    }
+  }
+
+  /* ---- Bcs at the end of the step (backward Euler) ---- */
+  for (dir = IDIR; dir <= JDIR; dir++) {
+    BoundaryADI_TC(lines, d, grid, t0 + dt, dir);
+    for (l = 0; l < lines[dir].N; l++) {
+      lbound0[dir][l].kind = lines[dir].lbound[TDIFF][l].kind;
+      rbound0[dir][l].kind = lines[dir].rbound[TDIFF][l].kind;
+      lbound0[dir][l].values[0] = 0.0;
+      rbound0[dir][l].values[0] = 0.0;
+    }
+  }
+
+  /*****************************************
+  * ---------------------------------------
+  *  Newton iterations
+  * ---------------------------------------
+  * ****************************************/
+  ConductionResidual(G, T_new, d, grid, lines, dt);
+  converged = 0;
+  for (nit = 0; nit <= JFNK_MAX_NEWTON; nit++) {
+
+    err = 0.0;
+    LINES_LOOP(lines[IDIR], l, j, i)
+      err = MAX(err, fabs(G[j][i])/T_new[j][i]);
+    #ifdef DEBUG_JFNK
+      print1("\n[JFNK_TC] Newton it. %d, max|G|/T = %e", nit, err);
+    #endif
+    if (err < JFNK_NEWTON_RTOL) {
+      converged = 1;
+      break;
+    }
+    if (nit == JFNK_MAX_NEWTON) break;
+
+    /* ---- GMRES (right preconditioned) for J*delta = -G ---- */
+    beta = sqrt(LinesDot(G, G, lines));
+    LINES_LOOP(lines[IDIR], l, j, i)
+      Vk[0][j][i] = -G[j][i]/beta;
+    g[0] = beta;
+    for (m = 1; m <= JFNK_KRYLOV_DIM; m++) g[m] = 0.0;
+    Tnorm = sqrt(LinesDot(T_new, T_new, lines)/Ncells);
+
+    for (kk = 0; kk < JFNK_KRYLOV_DIM; kk++) {
+      /* w = J * P^-1 * Vk[kk] (finite differences) */
+      PreconditionADI(delta, Vk[kk], IpT, ImT, JpT, JmT, CIT, CJT, grid, lines, order, dt);
+      wnorm = sqrt(LinesDot(delta, delta, lines)/Ncells);
+      eps = JFNK_SQRT_EPS*(1.0 + Tnorm)/wnorm;
+      LINES_LOOP(lines[IDIR], l, j, i)
+        T_pert[j][i] = T_new[j][i] + eps*delta[j][i];
+      ConductionResidual(G_pert, T_pert, d, grid, lines, dt);
+      LINES_LOOP(lines[IDIR], l, j, i)
+        w[j][i] = (G_pert[j][i] - G[j][i])/eps;
+
+      /* Modified Gram-Schmidt */
+      for (q = 0; q <= kk; q++) {
+        h[q][kk] = LinesDot(w, Vk[q], lines);
+        LINES_LOOP(lines[IDIR], l, j, i)
+          w[j][i] -= h[q][kk]*Vk[q][j][i];
+      }
+      h[kk+1][kk] = hnext = sqrt(LinesDot(w, w, lines));
+      if (h[kk+1][kk] > 0.0) {
+        LINES_LOOP(lines[IDIR], l, j, i)
+          Vk[kk+1][j][i] = w[j][i]/h[kk+1][kk];
+      }
+
+      /* Givens rotations */
+      for (q = 0; q < kk; q++) {
+        tmp = cs[q]*h[q][kk] + sn[q]*h[q+1][kk];
+        h[q+1][kk] = -sn[q]*h[q][kk] + cs[q]*h[q+1][kk];
+        h[q][kk] = tmp;
+      }
+      tmp = sqrt(h[kk][kk]*h[kk][kk] + h[kk+1][kk]*h[kk+1][kk]);
+      cs[kk] = h[kk][kk]/tmp;
+      sn[kk] = h[kk+1][kk]/tmp;
+      h[kk][kk] = tmp;
+      h[kk+1][kk] = 0.0;
+      g[kk+1] = -sn[kk]*g[kk];
+      g[kk] = cs[kk]*g[kk];
+
+      // hnext is the norm of the new Krylov vector before the rotation zeroes it (0 = happy breakdown)
+      if (fabs(g[kk+1]) < JFNK_KRYLOV_RTOL*beta || hnext == 0.0) {
+        kk++;
+        break;
+      }
+    }
+    if (kk > JFNK_KRYLOV_DIM) kk = JFNK_KRYLOV_DIM;
+
+    /* y = H^-1 g (upper triangular), delta = P^-1 * (V*y) */
+    for (q = kk-1; q >= 0; q--) {
+      y[q] = g[q];
+      for (m = q+1; m < kk; m++)
+        y[q] -= h[q][m]*y[m];
+      y[q] /= h[q][q];
+    }
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      w[j][i] = 0.0;
+      for (q = 0; q < kk; q++)
+        w[j][i] += y[q]*Vk[q][j][i];
+    }
+    PreconditionADI(delta, w, IpT, ImT, JpT, JmT, CIT, CJT, grid, lines, order, dt);
+
+    /* ---- Damped update ---- */
+    lambda = 1.0;
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      if (delta[j][i] < -JFNK_MAX_REL_DECREASE*T_new[j][i])
+        lambda = MIN(lambda, -JFNK_MAX_REL_DECREASE*T_new[j][i]/delta[j][i]);
+    }
+    LINES_LOOP(lines[IDIR], l, j, i)
+      T_new[j][i] += lambda*delta[j][i];
+
+    ConductionResidual(G, T_new, d, grid, lines, dt);
+  }
+
+  if (!converged) {
+    // [Rob] Maybe I should rather reduce dt and retry
+    print1("\n[JFNK_TC] Newton did not converge (max|G|/T = %e), I use DouglasRachford", err);
+    DouglasRachford(T_new, T_old, NULL, dEdT, d, grid, lines, TDIFF, order, dt, t0, NSUBS_TC, 1);
+    return;
+  }
+
+  /* ---- Secant heat capacity, so that the energy update is exact ---- */
+  KDOM_LOOP(k)
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+      rhoe_new = InternalEnergyAndDerivative(v, T_new[j][i]*KELVIN, &drhoe_dT);
+      if (fabs(T_new[j][i] - T_old[j][i]) > JFNK_SQRT_EPS*T_old[j][i])
+        dEdT[j][i] = (rhoe_new - rhoe_n[j][i])/(T_new[j][i] - T_old[j][i]);
+      else
+        dEdT[j][i] = drhoe_dT*KELVIN;
+    }
+
+  /* ---- Energy entered through the boundaries (IpN.. are the ones of the last residual) ---- */
+  #if EN_CONS_CHECK
+    rR = grid[IDIR].xr_glob;
+    rL = grid[IDIR].xl_glob;
+    dz = grid[JDIR].dx_glob;
+    ApplyBCsonGhosts(T_new, &lines[IDIR], lines[IDIR].lbound[TDIFF], lines[IDIR].rbound[TDIFF], IDIR);
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      i = lines[IDIR].lidx[l];
+      en_tc_in += (T_new[j][i-1]-T_new[j][i]) * ImN[j][i] * 2*CONST_PI*dz[j] * dt;
+      i = lines[IDIR].ridx[l];
+      en_tc_in += (T_new[j][i+1]-T_new[j][i]) * IpN[j][i] * 2*CONST_PI*dz[j] * dt;
+    }
+    ApplyBCsonGhosts(T_new, &lines[JDIR], lines[JDIR].lbound[TDIFF], lines[JDIR].rbound[TDIFF], JDIR);
+    for (l = 0; l < lines[JDIR].N; l++) {
+      i = lines[JDIR].dom_line_idx[l];
+      j = lines[JDIR].lidx[l];
+      en_tc_in += (T_new[j-1][i]-T_new[j][i]) * JmN[j][i] * CONST_PI*(rR[i]*rR[i]-rL[i]*rL[i]) * dt;
+      j = lines[JDIR].ridx[l];
+      en_tc_in += (T_new[j+1][i]-T_new[j][i]) * JpN[j][i] * CONST_PI*(rR[i]*rR[i]-rL[i]*rL[i]) * dt;
+    }
+  #endif
+}
+
+/****************************************************************************
+Computes the (scaled) residual of the backward Euler step on the lines:
+  G = [rhoe(T) - rhoe_n]/dEdT_lag - dt/dEdT_lag*div(kappa(T) grad T)
+It also sets the ghosts of T (bcs at the end of the step, at exit the ones of
+direction JDIR) and leaves in IpN, ImN, JpN, JmN the operators at T (harmonic averaging of kappa as in BuildIJ_TC())
+*****************************************************************************/
+void ConductionResidual(double **G, double **T, const Data *d, Grid *grid,
+                        Lines *lines, double dt) {
+  int i,j,k,l,nv;
+  double v[NVAR], drhoe_dT;
+  double kpar, knor, phi;
+  double ****Vc = d->Vc;
+  double *r, *z, *theta;
+  double *ArR, *ArL, *dVr, *dVz, *inv_dri, *inv_dzi;
+  double div;
+  unsigned char **region = GetCapRegionMap(grid);
+
+  r = grid[IDIR].x;
+  z = grid[JDIR].x;
+  theta = grid[KDIR].x;
+  ArR = grid[IDIR].A;
+  ArL = grid[IDIR].A - 1;
+  dVr = grid[IDIR].dV;
+  dVz = grid[JDIR].dV;
+  inv_dri = grid[IDIR].inv_dxi;
+  inv_dzi = grid[JDIR].inv_dxi;
+
+  KDOM_LOOP(k) {
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+      TC_kappaFromT(v, T[j][i]*KELVIN, region[j][i], r[i], z[j], theta[k], &kpar, &knor, &phi);
+      kappa[j][i] = knor;
+      G[j][i] = InternalEnergyAndDerivative(v, T[j][i]*KELVIN, &drhoe_dT) - rhoe_n[j][i];
+    }
+
+    /* The ghosts are set (and used) one direction at a time, since the cell at the
+       internal corner of the capillary is a ghost for both directions */
+    ApplyBCsonGhosts(T, &lines[IDIR], lines[IDIR].lbound[TDIFF], lines[IDIR].rbound[TDIFF], IDIR);
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      IpN[j][i] = 2/(1/kappa[j][i] + 1/kappa[j][i+1])*ArR[i]*inv_dri[i];
+      ImN[j][i] = 2/(1/kappa[j][i] + 1/kappa[j][i-1])*ArL[i]*inv_dri[i-1];
+      div = (IpN[j][i]*(T[j][i+1]-T[j][i]) - ImN[j][i]*(T[j][i]-T[j][i-1]))/dVr[i];
+      G[j][i] -= dt*div;
+    }
+
+    ApplyBCsonGhosts(T, &lines[JDIR], lines[JDIR].lbound[TDIFF], lines[JDIR].rbound[TDIFF], JDIR);
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      JpN[j][i] = 2/(1/kappa[j][i] + 1/kappa[j+1][i])*inv_dzi[j];
+      JmN[j][i] = 2/(1/kappa[j][i] + 1/kappa[j-1][i])*inv_dzi[j-1];
+      div = (JpN[j][i]*(T[j+1][i]-T[j][i]) - JmN[j][i]*(T[j][i]-T[j-1][i]))/dVz[j];
+      G[j][i] = (G[j][i] - dt*div)/dEdT_lag[j][i];
+    }
+  }
+}
+
+/****************************************************************************
+Preconditioner: x = (I - dt*A_J)^-1 (I - dt*A_I)^-1 r, where A_I and A_J are the
+lagged conduction operators (one ADI sweep with homogeneous bcs), with the two
+sweeps swapped if order is FIRST_JDIR
+*****************************************************************************/
+void PreconditionADI(double **x, double **r, double **IpT, double **ImT,
+                     double **JpT, double **JmT, double **CIT, double **CJT,
+                     Grid *grid, Lines *lines, int order, double dt) {
+  static double **x_aux;
+  static int first_call = 1;
+
+  if (first_call) {
+    x_aux = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    first_call = 0;
+  }
+
+  if (order == FIRST_IDIR) {
+    ImplicitUpdate(x_aux, r, NULL, NULL, IpT, ImT, CIT, &lines[IDIR],
+                   lbound0[IDIR], rbound0[IDIR], 0, NULL, grid, dt, IDIR);
+    ImplicitUpdate(x, x_aux, NULL, NULL, JpT, JmT, CJT, &lines[JDIR],
+                   lbound0[JDIR], rbound0[JDIR], 0, NULL, grid, dt, JDIR);
+  } else {
+    ImplicitUpdate(x_aux, r, NULL, NULL, JpT, JmT, CJT, &lines[JDIR],
+                   lbound0[JDIR], rbound0[JDIR], 0, NULL, grid, dt, JDIR);
+    ImplicitUpdate(x, x_aux, NULL, NULL, IpT, ImT, CIT, &lines[IDIR],
+                   lbound0[IDIR], rbound0[IDIR], 0, NULL, grid, dt, IDIR);
+  }
+}
+
+/****************************************************************************
+Scalar product on the cells of the lines
+*****************************************************************************/
+double LinesDot(double **a, double **b, Lines *lines) {
+  int i,j,l;
+  double sum = 0.0;
+
+  LINES_LOOP(lines[IDIR], l, j, i)
+    sum += a[j][i]*b[j][i];
+  return sum;
+}
+#endif
@@ -0,0 +1,396 @@
+/*Fast lookup of the 2D tables on nodes uniformly spaced in log10(x) and log10(y)
+(see log_table.h)*/
+
+// Remarkable comments:
+// [Opt] = it can be optimized (in terms of performance)
+// [Err] = it is and error (usually introduced on purpose)
+// [Rob] = it can/should be made more robust
+
+#include "pluto.h"
+#include "log_table.h"
+#ifdef __AVX2__
+  #include <immintrin.h>
+#endif
+
+/****************************************************************************
+How it works:
+  Table2DInterpolate() is generic (any spacing), so for every call it finds the
+  interval and takes the bounds from the Table2D, and it cannot be inlined. Our tables
+  have nodes uniformly spaced in log10, so the interval is just
+  i = (int)((log10(x) - log10(x[0]))/dlog10x), and the normalized coordinate inside it
+  is (x - x[i])/(x[i+1] - x[i]) with the reciprocal precomputed: a LogTable keeps these
+  numbers (and a copy of the values, contiguous) and LogTableInterpolate() (inline, in
+  log_table.h) does the rest.
+  LogTableInterpolateBatch() does the same for n points at once; with AVX2 the values
+  of 4 points are taken with gathers, otherwise it is the scalar loop.
+  A MultiLogTable keeps several tables with the same nodes (e.g. eta, kappa, dE/dT and
+  mu, see transport_tables.c) interleaved node by node: when a cell needs all of them,
+  log10(x), log10(y), the interval and the weights are computed once, and the 4 corners
+  of all the fields are 4 groups of nf contiguous values instead of 4*nf scattered ones.
+  Transport coefficients span many decades, and are close to power laws of T and rho
+  in most of the table: interpolating log(f) (LOG_TABLE_LOGF), and even more a monotone
+  cubic of it (LOG_TABLE_STEFFEN), is much more accurate than interpolating f with the
+  same nodes, so the same accuracy needs fewer nodes. Steffen's slopes never make
+  the cubic overshoot the data (no spurious extrema, e.g. no negative kappa).
+  The x nodes (T) can also be non uniform, e.g. denser where the ionization makes f
+  bend and sparser where it is a power law: then log10(x) is split in uniform cells no
+  wider than the narrowest interval (a LogNodeMap), the cell of a point is computed as
+  the interval was, and its interval is the first one of the cell or the next one
+  (if the narrowest interval would need more than 64 cells per node, the cells are
+  wider and the interval is found by bisection among the ones of the cell).
+*****************************************************************************/
+
+/****************************************************************************
+Slopes of Steffen's monotone cubic (M. Steffen, A&A 239, 443 (1990)) at the n
+values f[0], f[s], ..., f[(n-1)*s] on unit spacing
+*****************************************************************************/
+static void SteffenSlopes(const double *f, int s, int n, double *slope) {
+  int m;
+  double dl, dr, p;
+
+  if (n == 2) {
+    slope[0] = slope[s] = f[s] - f[0];
+    return;
+  }
+  for (m = 1; m < n - 1; m++) {
+    dl = f[m*s] - f[(m-1)*s];
+    dr = f[(m+1)*s] - f[m*s];
+    p = 0.5*(dl + dr);
+    // (sign(dl) + sign(dr))*min(|dl|, |dr|, |p|/2), Steffen's eq. 11
+    if (dl*dr <= 0.0) slope[m*s] = 0.0;
+    else slope[m*s] = (dl > 0.0 ? 2.0 : -2.0)*MIN(MIN(fabs(dl), fabs(dr)), 0.5*fabs(p));
+  }
+  // One-sided slopes at the ends (Steffen's eq. 26-27)
+  dl = f[s] - f[0];
+  p = 1.5*dl - 0.5*(f[2*s] - f[s]);
+  slope[0] = (p*dl <= 0.0) ? 0.0 : (fabs(p) > 2.0*fabs(dl) ? 2.0*dl : p);
+  dr = f[(n-1)*s] - f[(n-2)*s];
+  p = 1.5*dr - 0.5*(f[(n-2)*s] - f[(n-3)*s]);
+  slope[(n-1)*s] = (p*dr <= 0.0) ? 0.0 : (fabs(p) > 2.0*fabs(dr) ? 2.0*dr : p);
+}
+
+/****************************************************************************
+Map of the x nodes (n, not uniform in log10) for LogNodeMapFind(): sets *dlx_1 to
+1/(width of its cells) and *gx_max to their number
+*****************************************************************************/
+static LogNodeMap *MakeLogNodeMap(const double *x, int n, double *dlx_1, double *gx_max) {
+  int i, c;
+  double dl_min, w, lx0;
+  LogNodeMap *xm;
+
+  xm = ARRAY_1D(1, LogNodeMap);
+  xm->lx = ARRAY_1D(n, double);
+  xm->inv_dlx = ARRAY_1D(n - 1, double);
+  for (i = 0; i < n; i++) xm->lx[i] = log10(x[i]);
+  dl_min = xm->lx[n - 1] - xm->lx[0];
+  for (i = 0; i < n - 1; i++) {
+    xm->inv_dlx[i] = 1.0/(xm->lx[i+1] - xm->lx[i]);
+    dl_min = MIN(dl_min, xm->lx[i+1] - xm->lx[i]);
+  }
+
+  /* Cells not wider than the narrowest interval, but not more than 64 per node: above,
+     the cells are wider and LogNodeMapFind() has to bisect */
+  lx0 = xm->lx[0];
+  w = ceil((xm->lx[n - 1] - lx0)/dl_min);
+  xm->bisect = (w > 64.0*n);
+  xm->nmap = xm->bisect ? 64*n : (int)w;
+  w = (xm->lx[n - 1] - lx0)/xm->nmap;
+  xm->first = ARRAY_1D(xm->nmap, int);
+  for (c = 0, i = 0; c < xm->nmap; c++) {
+    while (i < n - 2 && lx0 + c*w >= xm->lx[i + 1]) i++;
+    xm->first[c] = i;
+  }
+  *dlx_1 = 1.0/w;
+  *gx_max = xm->nmap;
+  return xm;
+}
+
+static void FreeLogNodeMap(LogNodeMap *xm) {
+  FreeArray1D((void *)xm->first);
+  FreeArray1D((void *)xm->lx);
+  FreeArray1D((void *)xm->inv_dlx);
+  FreeArray1D((void *)xm);
+}
+
+/****************************************************************************
+Fills lt from tab (after FinalizeTable2D()), checking that its y nodes are uniform
+in log10 (name is the table in the error messages), to be interpolated as interp.
+The x nodes can be any increasing ones (if they are not uniform in log10 they are
+bracketed through a LogNodeMap, and STEFFEN is not available)
+*****************************************************************************/
+void MakeLogTable(LogTable *lt, Table2D *tab, const char *name, int interp) {
+  int i, j, x_uniform;
+  double dlx, dly;
+
+  lt->interp = interp;
+  lt->sx = lt->sy = NULL;
+  lt->xmap = NULL;
+  lt->nx = tab->nx;
+  lt->ny = tab->ny;
+  if (lt->nx < 2 || lt->ny < 2) {
+    print1("\n> MakeLogTable(): Error! Table %s has less than 2 nodes along x or y", name);
+    QUIT_PLUTO(1);
+  }
+
+  lt->x = ARRAY_1D(lt->nx, double);
+  lt->y = ARRAY_1D(lt->ny, double);
+  lt->inv_dx = ARRAY_1D(lt->nx - 1, double);
+  lt->inv_dy = ARRAY_1D(lt->ny - 1, double);
+  lt->fv = ARRAY_1D(lt->nx*lt->ny, double);
+
+  for (i = 0; i < lt->nx; i++) lt->x[i] = tab->x[i];
+  for (j = 0; j < lt->ny; j++) lt->y[j] = tab->y[j];
+  for (j = 0; j < lt->ny; j++)
+    for (i = 0; i < lt->nx; i++)
+      lt->fv[j*lt->nx + i] = tab->f[j][i];
+
+  lt->lxmin = log10(lt->x[0]);
+  lt->lymin = log10(lt->y[0]);
+  dlx = (log10(lt->x[lt->nx - 1]) - lt->lxmin)/(lt->nx - 1);
+  dly = (log10(lt->y[lt->ny - 1]) - lt->lymin)/(lt->ny - 1);
+  lt->dlx_1 = 1.0/dlx;
+  lt->dly_1 = 1.0/dly;
+  lt->gx_max = lt->nx - 1;
+
+  // The direct index computation is right only if the nodes are uniform in log10
+  x_uniform = 1;
+  for (i = 0; i < lt->nx - 1; i++) {
+    if (!(lt->x[i+1] > lt->x[i])) {
+      print1("\n> MakeLogTable(): Error! The x nodes of table %s are not increasing", name);
+      QUIT_PLUTO(1);
+    }
+    if (fabs(log10(lt->x[i+1]/lt->x[i]) - dlx) > 1.e-6*dlx) x_uniform = 0;
+    lt->inv_dx[i] = 1.0/(lt->x[i+1] - lt->x[i]);
+  }
+  if (!x_uniform) {
+    if (interp == LOG_TABLE_STEFFEN) {
+      print1("\n> MakeLogTable(): Error! Table %s has x nodes not uniform in log10, it cannot be STEFFEN", name);
+      QUIT_PLUTO(1);
+    }
+    lt->xmap = MakeLogNodeMap(lt->x, lt->nx, &lt->dlx_1, &lt->gx_max);
+  }
+  for (j = 0; j < lt->ny - 1; j++) {
+    if (fabs(log10(lt->y[j+1]/lt->y[j]) - dly) > 1.e-6*dly) {
+      print1("\n> MakeLogTable(): Error! The y nodes of table %s are not uniform in log10", name);
+      QUIT_PLUTO(1);
+    }
+    lt->inv_dy[j] = 1.0/(lt->y[j+1] - lt->y[j]);
+  }
+
+  if (interp == LOG_TABLE_LINEAR) return;
+
+  for (i = 0; i < lt->nx*lt->ny; i++) {
+    if (!(lt->fv[i] > 0.0)) {
+      print1("\n> MakeLogTable(): Error! Table %s has values <= 0, it can only be interpolated linearly", name);
+      QUIT_PLUTO(1);
+    }
+    lt->fv[i] = log(lt->fv[i]);
+  }
+
+  if (interp == LOG_TABLE_STEFFEN) {
+    lt->sx = ARRAY_1D(lt->nx*lt->ny, double);
+    lt->sy = ARRAY_1D(lt->nx*lt->ny, double);
+    for (j = 0; j < lt->ny; j++) SteffenSlopes(lt->fv + j*lt->nx, 1, lt->nx, lt->sx + j*lt->nx);
+    for (i = 0; i < lt->nx; i++) SteffenSlopes(lt->fv + i, lt->nx, lt->ny, lt->sy + i);
+  }
+}
+
+/****************************************************************************
+Frees the arrays of lt
+*****************************************************************************/
+void FreeLogTable(LogTable *lt) {
+  FreeArray1D((void *)lt->x);
+  FreeArray1D((void *)lt->y);
+  FreeArray1D((void *)lt->inv_dx);
+  FreeArray1D((void *)lt->inv_dy);
+  FreeArray1D((void *)lt->fv);
+  if (lt->sx != NULL) FreeArray1D((void *)lt->sx);
+  if (lt->sy != NULL) FreeArray1D((void *)lt->sy);
+  if (lt->xmap != NULL) FreeLogNodeMap(lt->xmap);
+}
+
+/****************************************************************************
+Interpolates the table at the n points (x[m], y[m]), as LogTableInterpolate().
+Returns the number of points out of the table (0 on success): f of those points
+is meaningless, the caller must find them again (e.g. with LogTableInterpolate()).
+*****************************************************************************/
+int LogTableInterpolateBatch(const LogTable *lt, const double *x, const double *y,
+                             double *f, int n) {
+  int m, m0, nc, n_out = 0;
+  int i[LOG_TABLE_CHUNK], j[LOG_TABLE_CHUNK];
+  double lx[LOG_TABLE_CHUNK], gx[LOG_TABLE_CHUNK], gy[LOG_TABLE_CHUNK], t;
+  const int nx = lt->nx;
+  const double gx_max = lt->gx_max, gy_max = lt->ny - 1;
+  #ifdef __AVX2__
+    __m128i vi, vj, vk, vnx = _mm_set1_epi32(nx);
+    __m256d vxn, vyn, f00, f01, f10, f11, vone = _mm256_set1_pd(1.0);
+  #else
+    int k;
+    double xn, yn;
+  #endif
+
+  /* [Opt] LOGF and STEFFEN go point by point (their exp() is the main cost, and
+     there is no vector exp() here) */
+  if (lt->interp != LOG_TABLE_LINEAR) {
+    for (m = 0; m < n; m++)
+      if (LogTableInterpolate(lt, x[m], y[m], f + m) != 0) n_out++;
+    return n_out;
+  }
+
+  for (m0 = 0; m0 < n; m0 += LOG_TABLE_CHUNK) {
+    nc = MIN(LOG_TABLE_CHUNK, n - m0);
+
+    /* -- Normalized log coordinates (a loop by itself, so that it can be vectorized
+          when the compiler has a vector log10) -- */
+    for (m = 0; m < nc; m++) {
+      lx[m] = log10(x[m0 + m]);
+      gx[m] = (lx[m] - lt->lxmin)*lt->dlx_1;
+      gy[m] = (log10(y[m0 + m]) - lt->lymin)*lt->dly_1;
+    }
+
+    /* -- Intervals: the points out of the table are counted and moved
+          into it (to keep the gathers inside the arrays) -- */
+    for (m = 0; m < nc; m++) {
+      if (!(gx[m] >= 0.0 && gx[m] <= gx_max && gy[m] >= 0.0 && gy[m] <= gy_max)) {
+        n_out++;
+        gx[m] = gy[m] = 0.0;
+        lx[m] = lt->lxmin;
+      }
+      if (lt->xmap == NULL) i[m] = MIN((int)gx[m], nx - 2);
+      else                  i[m] = LogNodeMapFind(lt->xmap, nx, gx[m], lx[m], &t);
+      j[m] = MIN((int)gy[m], lt->ny - 2);
+    }
+
+    #ifdef __AVX2__
+      for (m = 0; m + 4 <= nc; m += 4) {
+        vi = _mm_loadu_si128((const __m128i *)(i + m));
+        vj = _mm_loadu_si128((const __m128i *)(j + m));
+        vk = _mm_add_epi32(_mm_mullo_epi32(vj, vnx), vi);
+
+        vxn = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(x + m0 + m),
+                                          _mm256_i32gather_pd(lt->x, vi, 8)),
+                            _mm256_i32gather_pd(lt->inv_dx, vi, 8));
+        vyn = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(y + m0 + m),
+                                          _mm256_i32gather_pd(lt->y, vj, 8)),
+                            _mm256_i32gather_pd(lt->inv_dy, vj, 8));
+        f00 = _mm256_i32gather_pd(lt->fv, vk, 8);
+        f01 = _mm256_i32gather_pd(lt->fv + 1, vk, 8);
+        f10 = _mm256_i32gather_pd(lt->fv + nx, vk, 8);
+        f11 = _mm256_i32gather_pd(lt->fv + nx + 1, vk, 8);
+
+        // Same operations (and order) as LogTableInterpolate(): same results, unless the
+        // compiler contracts those into FMAs (-mfma without -ffp-contract=off)
+        f00 = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(vone, vxn), f00), _mm256_mul_pd(vxn, f01));
+        f10 = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(vone, vxn), f10), _mm256_mul_pd(vxn, f11));
+        _mm256_storeu_pd(f + m0 + m,
+                         _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(vone, vyn), f00),
+                                       _mm256_mul_pd(vyn, f10)));
+      }
+      // The last (nc % 4) points
+      for ( ; m < nc; m++) LogTableInterpolate(lt, x[m0 + m], y[m0 + m], f + m0 + m);
+    #else
+      for (m = 0; m < nc; m++) {
+        k = j[m]*nx + i[m];
+        xn = (x[m0 + m] - lt->x[i[m]])*lt->inv_dx[i[m]];
+        yn = (y[m0 + m] - lt->y[j[m]])*lt->inv_dy[j[m]];
+        f[m0 + m] = (1.0 - yn)*((1.0 - xn)*lt->fv[k] + xn*lt->fv[k + 1])
+                  + yn*((1.0 - xn)*lt->fv[k + nx] + xn*lt->fv[k + nx + 1]);
+      }
+    #endif
+  }
+
+  return n_out;
+}
+
+/****************************************************************************
+Fills mt with the nf tables tabs[q] (after FinalizeTable2D()), which must have the same
+nodes (as for MakeLogTable()); field q is interpolated as interp[q] (LOG_TABLE_LINEAR or
+LOG_TABLE_LOGF). name is the table in the error messages
+*****************************************************************************/
+void MakeMultiLogTable(MultiLogTable *mt, Table2D **tabs, const int *interp, int nf,
+                       const char *name) {
+  int i, q, N, same;
+  LogTable lt;
+
+  if (nf < 1 || nf > MULTI_LOG_TABLE_MAX_FIELDS) {
+    print1("\n> MakeMultiLogTable(): Error! Table %s must have 1 to %d fields",
+           name, MULTI_LOG_TABLE_MAX_FIELDS);
+    QUIT_PLUTO(1);
+  }
+  mt->nf = nf;
+  for (q = 0; q < nf; q++) {
+    if (interp[q] != LOG_TABLE_LINEAR && interp[q] != LOG_TABLE_LOGF) {
+      print1("\n> MakeMultiLogTable(): Error! The fields of table %s can only be LINEAR or LOGF", name);
+      QUIT_PLUTO(1);
+    }
+    // MakeLogTable() checks the nodes of every field, and takes the log of the LOGF ones
+    MakeLogTable(&lt, tabs[q], name, interp[q]);
+    if (q == 0) {
+      mt->nx = lt.nx;
+      mt->ny = lt.ny;
+      mt->lxmin = lt.lxmin;
+      mt->dlx_1 = lt.dlx_1;
+      mt->lymin = lt.lymin;
+      mt->dly_1 = lt.dly_1;
+      mt->gx_max = lt.gx_max;
+      mt->xmap = lt.xmap;
+      lt.xmap = NULL;  // (mt takes it)
+      N = mt->nx*mt->ny;
+      mt->x = ARRAY_1D(mt->nx, double);
+      mt->y = ARRAY_1D(mt->ny, double);
+      mt->inv_dx = ARRAY_1D(mt->nx - 1, double);
+      mt->inv_dy = ARRAY_1D(mt->ny - 1, double);
+      mt->fv = ARRAY_1D(N*nf, double);
+      for (i = 0; i < mt->nx; i++) mt->x[i] = lt.x[i];
+      for (i = 0; i < mt->ny; i++) mt->y[i] = lt.y[i];
+      for (i = 0; i < mt->nx - 1; i++) mt->inv_dx[i] = lt.inv_dx[i];
+      for (i = 0; i < mt->ny - 1; i++) mt->inv_dy[i] = lt.inv_dy[i];
+    } else {
+      // All the x nodes, since they need not be uniform
+      same = (lt.nx == mt->nx && lt.ny == mt->ny && lt.y[0] == mt->y[0]
+              && lt.y[lt.ny - 1] == mt->y[mt->ny - 1]);
+      for (i = 0; same && i < mt->nx; i++) same = (lt.x[i] == mt->x[i]);
+      if (!same) {
+        print1("\n> MakeMultiLogTable(): Error! The fields of table %s have different nodes", name);
+        QUIT_PLUTO(1);
+      }
+    }
+    mt->interp[q] = interp[q];
+    for (i = 0; i < N; i++) mt->fv[i*nf + q] = lt.fv[i];
+    FreeLogTable(&lt);
+  }
+}
+
+/****************************************************************************
+Frees the arrays of mt
+*****************************************************************************/
+void FreeMultiLogTable(MultiLogTable *mt) {
+  FreeArray1D((void *)mt->x);
+  FreeArray1D((void *)mt->y);
+  FreeArray1D((void *)mt->inv_dx);
+  FreeArray1D((void *)mt->inv_dy);
+  FreeArray1D((void *)mt->fv);
+  if (mt->xmap != NULL) FreeLogNodeMap(mt->xmap);
+}
+
+/****************************************************************************
+Interpolates all the fields of the table at the n points (x[m], y[m]): f[q][m] is
+field q at point m. Returns the number of points out of the table (0 on success):
+their f is meaningless, the caller must find them again.
+*****************************************************************************/
+int MultiLogTableInterpolateBatch(const MultiLogTable *mt, const double *x, const double *y,
+                                  double *const *f, int n) {
+  int m, q, n_out = 0;
+  double fm[MULTI_LOG_TABLE_MAX_FIELDS];
+
+  /* [Opt] Point by point: the gain is in sharing the index computation among the
+     fields, the 4 corners of a point are already contiguous */
+  for (m = 0; m < n; m++) {
+    if (MultiLogTableInterpolate(mt, x[m], y[m], fm) != 0) {
+      n_out++;
+      continue;
+    }
+    for (q = 0; q < mt->nf; q++) f[q][m] = fm[q];
+  }
+  return n_out;
+}
@@ -0,0 +1,202 @@
+#ifndef LOG_TABLE_H
+#define LOG_TABLE_H
+/* Fast lookup of the 2D tables whose nodes are uniformly spaced in log10(x) and log10(y)
+   (the layout of the transport tables, see transport_tables.c) */
+
+/* Interpolations of a LogTable:
+   LOG_TABLE_LINEAR:  bilinear in x and y between the nodes (as a LINEAR Table2D);
+   LOG_TABLE_LOGF:    bilinear in log(f), log10(x), log10(y) (f > 0), exact for power laws;
+   LOG_TABLE_STEFFEN: monotone cubic (Steffen 1990) in log(f) along log10(x) and log10(y),
+                      see LogTableInterpolate() */
+#define LOG_TABLE_LINEAR  0
+#define LOG_TABLE_LOGF    1
+#define LOG_TABLE_STEFFEN 2
+
+// Points interpolated at once by LogTableInterpolateBatch() (size of its scratch arrays)
+#define LOG_TABLE_CHUNK 64
+
+/* Bracketing of x nodes which are not uniform in log10 (e.g. concentrated where f bends,
+   see transport_tables.c): log10(x) is split in nmap uniform cells, and first[c] is the
+   interval of the nodes where cell c starts. The cells are not wider than the narrowest
+   interval, so from first[c] the interval of a point is at most one step further.
+   If that would take too many cells (see MakeLogNodeMap()) the cells are wider, and the
+   interval is searched by bisection between first[c] and first[c+1] (bisect = 1) */
+typedef struct LOG_NODE_MAP {
+  int nmap;
+  int bisect;               /**< 1 if the cells can be wider than the narrowest interval */
+  int *first;               /**< First interval of every cell of the map */
+  double *lx;               /**< log10 of the nodes */
+  double *inv_dlx;          /**< 1/(lx[i+1] - lx[i]) */
+} LogNodeMap;
+
+/* A view of a Table2D with logspacing 10: the node coordinates are used only through
+   the index of their interval (computed directly from log10, through a LogNodeMap if
+   the x nodes are not uniform) and the reciprocal of its width (precomputed), the
+   values f[j][i] through the contiguous array fv */
+typedef struct LOG_TABLE {
+  int nx, ny;
+  int interp;               /**< LOG_TABLE_LINEAR, LOG_TABLE_LOGF or LOG_TABLE_STEFFEN */
+  double lxmin, dlx_1;      /**< log10(x[0]) and 1/(spacing of log10(x)), or of the cells of xmap */
+  double gx_max;            /**< Max of (log10(x) - lxmin)*dlx_1 in the table */
+  LogNodeMap *xmap;         /**< NULL if the x nodes are uniform in log10 */
+  double lymin, dly_1;      /**< log10(y[0]) and 1/(spacing of log10(y)) */
+  double *x, *y;            /**< Node coordinates */
+  double *inv_dx, *inv_dy;  /**< 1/(x[i+1] - x[i]), 1/(y[j+1] - y[j]) */
+  double *fv;               /**< Values, f(x[i], y[j]) = fv[j*nx + i] (their log if interp != LINEAR) */
+  double *sx, *sy;          /**< (STEFFEN only) Slopes of fv along i and j (per node spacing) */
+} LogTable;
+
+void MakeLogTable(LogTable *lt, Table2D *tab, const char *name, int interp);
+void FreeLogTable(LogTable *lt);
+int LogTableInterpolateBatch(const LogTable *lt, const double *x, const double *y,
+                             double *f, int n);
+
+// Max number of fields of a MultiLogTable
+#define MULTI_LOG_TABLE_MAX_FIELDS 8
+
+/* Several tables on the same nodes, with the values of all the fields of a node next to
+   each other: f_q(x[i], y[j]) = fv[(j*nx + i)*nf + q], so that one computation of the
+   interval and of the weights gives all the fields, read from the same cache lines.
+   Each field is interpolated as LOG_TABLE_LINEAR or LOG_TABLE_LOGF (no STEFFEN) */
+typedef struct MULTI_LOG_TABLE {
+  int nx, ny, nf;
+  int interp[MULTI_LOG_TABLE_MAX_FIELDS];  /**< LOG_TABLE_LINEAR or LOG_TABLE_LOGF, per field */
+  double lxmin, dlx_1;      /**< As in LogTable */
+  double gx_max;
+  LogNodeMap *xmap;
+  double lymin, dly_1;
+  double *x, *y;
+  double *inv_dx, *inv_dy;
+  double *fv;               /**< Values (their log if interp[q] == LOG_TABLE_LOGF), interleaved */
+} MultiLogTable;
+
+void MakeMultiLogTable(MultiLogTable *mt, Table2D **tabs, const int *interp, int nf,
+                       const char *name);
+void FreeMultiLogTable(MultiLogTable *mt);
+int MultiLogTableInterpolateBatch(const MultiLogTable *mt, const double *x, const double *y,
+                                  double *const *f, int n);
+
+/****************************************************************************
+Interval i of the x nodes containing log10(x) = lx, and the normalized coordinate
+*t in it, for nodes not uniform in log10 (gx = (lx - lxmin)*dlx_1, in the table)
+*****************************************************************************/
+static inline int LogNodeMapFind(const LogNodeMap *xm, int nx, double gx, double lx, double *t) {
+  int c = (int)gx, i, hi, mid;
+
+  if (c > xm->nmap - 1) c = xm->nmap - 1;
+  i = xm->first[c];
+  if (!xm->bisect) {
+    if (i < nx - 2 && lx >= xm->lx[i + 1]) i++;
+  } else {
+    // The interval is in [first[c], first[c+1]] (the last cell ends at the last node)
+    hi = (c < xm->nmap - 1) ? xm->first[c + 1] : nx - 2;
+    while (i < hi) {
+      mid = (i + hi + 1)/2;
+      if (lx >= xm->lx[mid]) i = mid;
+      else hi = mid - 1;
+    }
+  }
+  *t = (lx - xm->lx[i])*xm->inv_dlx[i];
+  return i;
+}
+
+/****************************************************************************
+Cubic Hermite interpolation on [0, 1] between a (slope sa) and b (slope sb)
+*****************************************************************************/
+static inline double LogTableHermite(double a, double b, double sa, double sb, double t) {
+  double d = b - a;
+  return a + t*(sa + t*((3.0*d - 2.0*sa - sb) + t*(sa + sb - 2.0*d)));
+}
+
+/****************************************************************************
+Interpolation of the table at (x, y), as set by lt->interp (see above).
+Returns 0 on success, 1 if (x, y) is out of the table.
+STEFFEN is a cubic Hermite interpolation along i (with the node slopes sx) on the rows
+j and j+1, then along j between them, with the slopes sy interpolated linearly along i.
+It is monotone along the lines of the nodes (and C1 across them along those lines);
+in between it is only close to monotone.
+*****************************************************************************/
+static inline int LogTableInterpolate(const LogTable *lt, double x, double y, double *f) {
+  int i, j, k;
+  double lx, gx, gy, xn, yn, t, u, a0, a1, b0, b1;
+  double const *f0, *f1;
+
+  lx = log10(x);
+  gx = (lx - lt->lxmin)*lt->dlx_1;
+  gy = (log10(y) - lt->lymin)*lt->dly_1;
+  if (!(gx >= 0.0 && gx <= lt->gx_max && gy >= 0.0 && gy <= lt->ny - 1)) return 1;
+
+  if (lt->xmap == NULL) {
+    i = (int)gx;
+    if (i > lt->nx - 2) i = lt->nx - 2;
+    t = gx - i;
+  } else {
+    i = LogNodeMapFind(lt->xmap, lt->nx, gx, lx, &t);
+  }
+  j = (int)gy;
+  if (j > lt->ny - 2) j = lt->ny - 2;
+  k = j*lt->nx + i;
+  f0 = lt->fv + k;
+  f1 = f0 + lt->nx;
+
+  if (lt->interp == LOG_TABLE_LINEAR) {
+    xn = (x - lt->x[i])*lt->inv_dx[i];
+    yn = (y - lt->y[j])*lt->inv_dy[j];
+    *f = (1.0 - yn)*((1.0 - xn)*f0[0] + xn*f0[1]) + yn*((1.0 - xn)*f1[0] + xn*f1[1]);
+    return 0;
+  }
+
+  u = gy - j;
+  if (lt->interp == LOG_TABLE_LOGF) {
+    *f = exp((1.0 - u)*((1.0 - t)*f0[0] + t*f0[1]) + u*((1.0 - t)*f1[0] + t*f1[1]));
+  } else {
+    a0 = LogTableHermite(f0[0], f0[1], lt->sx[k], lt->sx[k + 1], t);
+    a1 = LogTableHermite(f1[0], f1[1], lt->sx[k + lt->nx], lt->sx[k + lt->nx + 1], t);
+    b0 = (1.0 - t)*lt->sy[k] + t*lt->sy[k + 1];
+    b1 = (1.0 - t)*lt->sy[k + lt->nx] + t*lt->sy[k + lt->nx + 1];
+    *f = exp(LogTableHermite(a0, a1, b0, b1, u));
+  }
+  return 0;
+}
+
+/****************************************************************************
+Interpolation of all the fields of the table at (x, y): f[q] is field q.
+Returns 0 on success, 1 if (x, y) is out of the table.
+*****************************************************************************/
+static inline int MultiLogTableInterpolate(const MultiLogTable *mt, double x, double y, double *f) {
+  int i, j, q;
+  const int nf = mt->nf;
+  double lx, gx, gy, xn, yn, t, u;
+  double const *f0, *f1;
+
+  lx = log10(x);
+  gx = (lx - mt->lxmin)*mt->dlx_1;
+  gy = (log10(y) - mt->lymin)*mt->dly_1;
+  if (!(gx >= 0.0 && gx <= mt->gx_max && gy >= 0.0 && gy <= mt->ny - 1)) return 1;
+
+  if (mt->xmap == NULL) {
+    i = (int)gx;
+    if (i > mt->nx - 2) i = mt->nx - 2;
+    t = gx - i;
+  } else {
+    i = LogNodeMapFind(mt->xmap, mt->nx, gx, lx, &t);
+  }
+  j = (int)gy;
+  if (j > mt->ny - 2) j = mt->ny - 2;
+  f0 = mt->fv + (j*mt->nx + i)*nf;
+  f1 = f0 + mt->nx*nf;
+
+  // The weights of both interpolations, once for all the fields
+  xn = (x - mt->x[i])*mt->inv_dx[i];
+  yn = (y - mt->y[j])*mt->inv_dy[j];
+  u = gy - j;
+  for (q = 0; q < nf; q++) {
+    if (mt->interp[q] == LOG_TABLE_LINEAR)
+      f[q] = (1.0 - yn)*((1.0 - xn)*f0[q] + xn*f0[nf + q]) + yn*((1.0 - xn)*f1[q] + xn*f1[nf + q]);
+    else
+      f[q] = exp((1.0 - u)*((1.0 - t)*f0[q] + t*f0[nf + q]) + u*((1.0 - t)*f1[q] + t*f1[nf + q]));
+  }
+  return 0;
+}
+
+#endif
@@ -1,9 +1,18 @@
 #include "pluto.h"
 #include "adi.h"
+#include "pvte_law_heat_capacity.h"
 
 #if KBEG != KEND
   #error grid in k direction should only be of 1 point
 #endif
+#if STRIPE_T_INVERSION && (EOS != PVTE_LAW || PHYSICS != MHD || ENTROPY_SWITCH)
+  #error STRIPE_T_INVERSION is implemented only for MHD with PVTE_LAW (and no ENTROPY_SWITCH)
+#endif
+
+#if STRIPE_T_INVERSION
+static int ConsToPrimStripe (double **u, double **v, int ibeg, int iend,
+                             unsigned char *flag, double *T_last);
+#endif
 
 void ConsToPrimLines (Data_Arr U, Data_Arr V, unsigned char ***flag, Lines *lines)
 /*!
@@ -18,9 +27,19 @@ void ConsToPrimLines (Data_Arr U, Data_Arr V, unsigned char ***flag, Lines *line
   int   ibeg, iend;
   int   current_dir;
   static double **v;
+  #if STRIPE_T_INVERSION
+    /* Temperature (Kelvin) of every cell at the last conversion, the starting point
+       of the next one (0 = none) */
+    static double **T_last;
+  #endif
 
   if (v == NULL){
     v = ARRAY_2D(NMAX_POINT, NVAR, double);
+    #if STRIPE_T_INVERSION
+      T_last = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+      for (j = 0; j < NX2_TOT; j++)
+        for (i = 0; i < NX1_TOT; i++) T_last[j][i] = 0.0;
+    #endif
   }
 
 /* ----------------------------------------------
@@ -42,7 +61,11 @@ void ConsToPrimLines (Data_Arr U, Data_Arr V, unsigned char ***flag, Lines *line
       ibeg = lines[IDIR].lidx[l];
       iend = lines[IDIR].ridx[l];
 
-      err = ConsToPrim (U[k][j], v, ibeg, iend, flag[k][j]);
+      #if STRIPE_T_INVERSION
+        err = ConsToPrimStripe (U[k][j], v, ibeg, iend, flag[k][j], T_last[j]);
+      #else
+        err = ConsToPrim (U[k][j], v, ibeg, iend, flag[k][j]);
+      #endif
 
       if (err) {
         #if WARN_CTP_FAIL
@@ -58,6 +81,90 @@ void ConsToPrimLines (Data_Arr U, Data_Arr V, unsigned char ***flag, Lines *line
   g_dir = current_dir; /* restore current direction */
 
 }
+#if STRIPE_T_INVERSION
+/* ********************************************************************* */
+int ConsToPrimStripe (double **u, double **v, int ibeg, int iend,
+                      unsigned char *flag, double *T_last)
+/*!
+ *  Same as ConsToPrim() (MHD, PVTE_LAW), but the temperatures of all the
+ *  cells ibeg..iend are found at once by GetEV_TemperatureStripe(),
+ *  starting from T_last (the temperatures of the previous conversion,
+ *  which are then updated). The cells where it does not converge are
+ *  inverted by GetEV_Temperature(), and where this fails too, T is floored
+ *  to T_CUT_RHOE and the energy redefined, as ConsToPrim() does.
+ *
+ *  \return 0 on success, 1 if the conversion failed in some cell.
+ *********************************************************************** */
+{
+  static double *rho, *rhoe, *T, *mu, *kinb2;
+  static unsigned char *ok;
+  int   i, nv, m, n, ifail = 0;
+  double tau, m2, b2;
+  double *uc, *vc;
+
+  if (rho == NULL) {
+    rho = ARRAY_1D(NMAX_POINT, double);
+    rhoe = ARRAY_1D(NMAX_POINT, double);
+    T = ARRAY_1D(NMAX_POINT, double);
+    mu = ARRAY_1D(NMAX_POINT, double);
+    kinb2 = ARRAY_1D(NMAX_POINT, double);
+    ok = ARRAY_1D(NMAX_POINT, unsigned char);
+  }
+
+  /* -- Everything but the pressure, and rhoe -- */
+  n = iend - ibeg + 1;
+  for (i = ibeg; i <= iend; i++) {
+    m = i - ibeg;
+    uc = u[i];
+    vc = v[i];
+
+    m2 = uc[MX1]*uc[MX1] + uc[MX2]*uc[MX2] + uc[MX3]*uc[MX3];
+    b2 = uc[BX1]*uc[BX1] + uc[BX2]*uc[BX2] + uc[BX3]*uc[BX3];
+
+    vc[RHO] = uc[RHO];
+    tau = 1.0/uc[RHO];
+    vc[VX1] = uc[MX1]*tau;
+    vc[VX2] = uc[MX2]*tau;
+    vc[VX3] = uc[MX3]*tau;
+
+    vc[BX1] = uc[BX1];
+    vc[BX2] = uc[BX2];
+    vc[BX3] = uc[BX3];
+    #ifdef GLM_MHD
+      vc[PSI_GLM] = uc[PSI_GLM];
+    #endif
+    NSCL_LOOP(nv) vc[nv] = uc[nv]*tau;
+
+    kinb2[m] = 0.5*(m2*tau + b2);
+    rho[m] = uc[RHO];
+    rhoe[m] = uc[ENG] - kinb2[m];
+    T[m] = T_last[i];
+  }
+
+  /* -- Temperature of the whole stripe, then the pressure -- */
+  GetEV_TemperatureStripe(rho, rhoe, T, mu, ok, n);
+
+  for (i = ibeg; i <= iend; i++) {
+    m = i - ibeg;
+    uc = u[i];
+    vc = v[i];
+    if (ok[m] && T[m] >= T_CUT_RHOE) {
+      vc[PRS] = vc[RHO]*T[m]/(KELVIN*mu[m]);  // As Pressure(), with the mu of the inversion
+    } else {
+      if (GetEV_Temperature (rhoe[m], vc, &(T[m])) != 0) {
+        T[m] = T_CUT_RHOE;
+        uc[ENG] = InternalEnergy(vc, T[m]) + kinb2[m];
+        flag[i] |= FLAG_CONS2PRIM_FAIL;
+        ifail = 1;
+      }
+      vc[PRS] = Pressure(vc, T[m]);
+    }
+    T_last[i] = T[m];
+  }
+  return ifail;
+}
+#endif
+
 /* ********************************************************************* */
 void PrimToConsLines (Data_Arr V, Data_Arr U, Lines *lines)
 /*!
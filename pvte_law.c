@@ -16,12 +16,37 @@
 /* /////////////////////////////////////////////////////////////////// */
 #include "pluto.h"
 #include "pvte_law_heat_capacity.h"
+#include "vec_math.h"
 
 static double SahaXFrac(double T, double rho);
+static double SahaXFracExp(double T, double rho, double *boltz);
 #define DIFF_ORDER  4   /* = 2 or 4 for 2nd or 4th accurate approximations
                            to derivatives in Gamma1()  */
 #define INTE_EXACT 1    /* Compute internal energy exactly in Gamma1() */
 
+/* Newton iterations of GetPV_TemperatureWarm(): max number, relative tolerance on T,
+   max relative step (above it the guess is considered too far) */
+#define WARM_T_MAX_ITER      6
+#define WARM_T_RTOL          1.e-10
+#define WARM_T_MAX_REL_STEP  0.5
+
+/* Iterations of GetEV_TemperatureStripe(): max number, relative tolerance on T,
+   lowest temperature of the brackets (Kelvin) */
+#define STRIPE_T_MAX_ITER    40
+#define STRIPE_T_RTOL        1.e-10
+#define STRIPE_T_FLOOR       1.0
+
+#if SAHA_EXP_COUNT
+  /* [Rob] Not atomic: with the helper thread of adi_async.c (or OpenMP) some
+     increments can be lost, the count is an estimate */
+  static long saha_exp_count = 0;
+  #define COUNT_SAHA_EXP() (saha_exp_count++)
+  #define COUNT_SAHA_EXP_N(n) (saha_exp_count += (n))
+#else
+  #define COUNT_SAHA_EXP()
+  #define COUNT_SAHA_EXP_N(n)
+#endif
+
 #if (defined(T_LIM_IEN) || defined(BETA_IEN))
   #if !defined(T_LIM_IEN) || !defined(BETA_IEN)
     #error T_LIM_IEN and BETA_IEN must either be both defined or none must be defined.
@@ -51,7 +76,7 @@ double InternalEnergyFunc(double *v, double T)
 
   kT   = CONST_kB*T;
   x    = SahaXFrac(T, v[RHO]);
-  GetMu(T,v[RHO],&mu);
+  mu   = 1.0/(1.0 + x); // As GetMu(), without solving the Saha equation again
   rho  = v[RHO]*UNIT_DENSITY;
 
   e    = 1.5*kT/(mu*CONST_amu) + chi*x/CONST_mH;
@@ -94,6 +119,19 @@ double SahaXFrac(double T, double rho)
  * ([Ema] it takes T in Kelvin)
  *
  *********************************************************************** */
+{
+  double boltz;
+  return SahaXFracExp(T, rho, &boltz);
+}
+
+/* ********************************************************************* */
+double SahaXFracExp(double T, double rho, double *boltz)
+/*!
+ * Same as SahaXFrac(), it also gives the Boltzmann factor exp(-chi/kT)
+ * it has computed, so that who needs it too (HeatCapacity(),
+ * EOSStateFromT()) does not call exp() again.
+ *
+ *********************************************************************** */
 {
   double me, kT, h3, c, x, n;
   double chi = 13.6*CONST_eV;
@@ -107,7 +145,9 @@ double SahaXFrac(double T, double rho)
     H atom mass (maybe CONST_amu, as it is used in InternalEnergyFunc())
     ( or sum the electron mass to the proton mass)!*/
   n  = rho/CONST_mp; /* = n(protons) + n(neutrals)   not   n(total) */
-  c  = me*kT*sqrt(me*kT)/(h3*n)*exp(-chi/kT);
+  *boltz = exp(-chi/kT);
+  COUNT_SAHA_EXP();
+  c  = me*kT*sqrt(me*kT)/(h3*n)*(*boltz);
 
   /*[Ema] I checked that this is equivalent to the x you get from solving
     in a straight forward way the equation 7.10 in the doc (the usual Saha equation
@@ -295,16 +335,410 @@ void HeatCapacity(double *v, double T, double *dEdT)
   double A=(2*CONST_PI*CONST_me*CONST_kB)*sqrt(2*CONST_PI*CONST_me*CONST_kB)*CONST_mp/(CONST_h*CONST_h*CONST_h);
   double D = 1.5*CONST_kB/CONST_amu;
   double sqT;
-  double x, dxdT;
+  double x, dxdT, boltz;
   double norm_unit = (UNIT_DENSITY*CONST_kB/CONST_mp);
 
-  x = SahaXFrac(T, v[RHO]);
+  // exp(B/T) is the Boltzmann factor of the Saha equation (equal up to rounding)
+  x = SahaXFracExp(T, v[RHO], &boltz);
   sqT = sqrt(T);
-  dxdT = A/(v[RHO]*UNIT_DENSITY) * (1.5*sqT - B/sqT) * exp(B/T);
+  dxdT = A/(v[RHO]*UNIT_DENSITY) * (1.5*sqT - B/sqT) * boltz;
 
   *dEdT = v[RHO]*UNIT_DENSITY * ((D*T + chi/CONST_mH)*dxdT + D*(1+x));
 
   // Normalization
   *dEdT = (*dEdT)/norm_unit;
 
-}
\ No newline at end of file
+}
+
+/* ********************************************************************* */
+void EOSStateFromT(double *v, double T, EOSState *s)
+/*!
+ * Computes the ionization x, mu, the internal energy per unit volume and
+ * the heat capacity of the gas at temperature T, as SahaXFrac(), GetMu(),
+ * InternalEnergyFunc() and HeatCapacity() would, from a single solution
+ * of the Saha equation (one exp() instead of the five of those calls),
+ * e.g. for the cell cache (cell_state.c), which needs more of them for
+ * the same (T, rho).
+ *
+ * \param [in]  v   primitive quantities in code units (only RHO is used)
+ * \param [in]  T   temperature in Kelvin
+ * \param [out] s   the state (rhoe and dEdT in code units)
+ *********************************************************************** */
+{
+  double chi = 13.6*CONST_eV;
+  double B = -chi/CONST_kB;
+  double A=(2*CONST_PI*CONST_me*CONST_kB)*sqrt(2*CONST_PI*CONST_me*CONST_kB)*CONST_mp/(CONST_h*CONST_h*CONST_h);
+  double D = 1.5*CONST_kB/CONST_amu;
+  double p0 = UNIT_DENSITY*UNIT_VELOCITY*UNIT_VELOCITY;
+  double norm_unit = (UNIT_DENSITY*CONST_kB/CONST_mp);
+  double rho = v[RHO]*UNIT_DENSITY;
+  double kT = CONST_kB*T;
+  double x, sqT, dxdT, e, boltz;
+
+  x = SahaXFracExp(T, v[RHO], &boltz);
+  s->x = x;
+  s->mu = 1.0/(1.0 + x);
+
+  // As InternalEnergyFunc()
+  e = 1.5*kT/(s->mu*CONST_amu) + chi*x/CONST_mH;
+  #ifdef T_LIM_IEN
+    if (T>T_LIM_IEN) e = 1.5*kT/(s->mu*CONST_amu)*pow(T/T_LIM_IEN, BETA_IEN) + chi*x/CONST_mH;
+  #endif
+  s->rhoe = rho*e/p0;
+
+  // As HeatCapacity()
+  sqT = sqrt(T);
+  dxdT = A/rho * (1.5*sqT - B/sqT) * boltz;
+  s->dEdT = rho * ((D*T + chi/CONST_mH)*dxdT + D*(1+x)) / norm_unit;
+}
+
+#if SAHA_EXP_COUNT
+/* ********************************************************************* */
+void ReportSahaExpCount(int n_steps)
+/*!
+ * Prints the number of exp() done to solve the Saha equation since the
+ * last call, per step (n_steps steps have been done since then).
+ *********************************************************************** */
+{
+  static long last_count = 0;
+
+  print1("\n[SahaExpCount] exp() of the Saha equation: %ld in the last %d steps, %.3g per step",
+         saha_exp_count - last_count, n_steps, (double)(saha_exp_count - last_count)/MAX(n_steps, 1));
+  last_count = saha_exp_count;
+}
+#endif
+
+/* ********************************************************************* */
+double InternalEnergyAndDerivative(double *v, double T, double *drhoe_dT)
+/*!
+ * Computes the internal energy per unit volume exactly as InternalEnergyFunc()
+ * does (T_LIM_IEN/BETA_IEN modification included) and, with the same
+ * single evaluation of the Saha equation, its derivative with respect to T.
+ * Differently from HeatCapacity(), dx/dT is the exact derivative of the
+ * Saha solution (x^2/(1-x) = c).
+ * Useful for Newton iterations on T when rhoe is known.
+ *
+ * \param [in]  v         primitive quantities in code units (only RHO is used)
+ * \param [in]  T         temperature in Kelvin
+ * \param [out] drhoe_dT  d(rhoe)/dT, rhoe in code units, T in Kelvin
+ *
+ *  \return The gas internal energy (\c rhoe) in code units.
+ *********************************************************************** */
+{
+  double chi = 13.6*CONST_eV;
+  double p0 = UNIT_DENSITY*UNIT_VELOCITY*UNIT_VELOCITY;
+  double D = 1.5*CONST_kB/CONST_amu;
+  double me, kT, h3, n, c, x;
+  double dcdT, dxdT;
+  double rho, e, dedT;
+  double alpha = 1.0, alpha_der = 1.0; /* alpha_der = d(alpha*T)/dT / alpha */
+
+  rho = v[RHO]*UNIT_DENSITY;
+
+  /* Saha equation, as in SahaXFrac() */
+  me = 2.0*CONST_PI*CONST_me;
+  kT = CONST_kB*T;
+  h3 = CONST_h*CONST_h*CONST_h;
+  n  = rho/CONST_mp;
+  c  = me*kT*sqrt(me*kT)/(h3*n)*exp(-chi/kT);
+  COUNT_SAHA_EXP();
+  x  = 2.0/(sqrt(1.0 + 4.0/c) + 1.0);
+
+  dcdT = c*(1.5 + chi/kT)/T;
+  if (x > 0.0)
+    dxdT = dcdT*(1.0-x)*(1.0-x)/(x*(2.0-x));
+  else
+    dxdT = 0.0;
+
+  #ifdef T_LIM_IEN
+    if (T>T_LIM_IEN) {
+      alpha = pow(T/T_LIM_IEN, BETA_IEN);
+      alpha_der = 1.0 + BETA_IEN;
+    }
+  #endif
+
+  /* 1.5*kT/(mu*CONST_amu) = D*T*(1+x) */
+  e    = D*T*(1.0 + x)*alpha + chi*x/CONST_mH;
+  dedT = D*(1.0 + x)*alpha*alpha_der + (D*T*alpha + chi/CONST_mH)*dxdT;
+
+  *drhoe_dT = rho*dedT/p0;
+  return rho*e/p0;
+}
+
+/* ********************************************************************* */
+double TemperatureFuncAndDerivative(double *v, double T, double *df_dT)
+/*!
+ * Computes f(T) = T/mu(T,rho) = T*(1+x), i.e. the function of T that
+ * GetPV_Temperature() matches to p/rho*KELVIN, and its exact derivative
+ * (dx/dT is the one of the Saha solution, as in InternalEnergyAndDerivative()).
+ *
+ * \param [in]  v       primitive quantities in code units (only RHO is used)
+ * \param [in]  T       temperature in Kelvin
+ * \param [out] df_dT   df/dT
+ *
+ * \return f(T) (Kelvin)
+ *********************************************************************** */
+{
+  double chi = 13.6*CONST_eV;
+  double me, kT, h3, n, c, x;
+  double dcdT, dxdT;
+
+  /* Saha equation, as in SahaXFrac() */
+  me = 2.0*CONST_PI*CONST_me;
+  kT = CONST_kB*T;
+  h3 = CONST_h*CONST_h*CONST_h;
+  n  = v[RHO]*UNIT_DENSITY/CONST_mp;
+  c  = me*kT*sqrt(me*kT)/(h3*n)*exp(-chi/kT);
+  COUNT_SAHA_EXP();
+  x  = 2.0/(sqrt(1.0 + 4.0/c) + 1.0);
+
+  dcdT = c*(1.5 + chi/kT)/T;
+  if (x > 0.0)
+    dxdT = dcdT*(1.0-x)*(1.0-x)/(x*(2.0-x));
+  else
+    dxdT = 0.0;
+
+  *df_dT = 1.0 + x + T*dxdT;
+  return T*(1.0 + x);
+}
+
+/* ********************************************************************* */
+int GetPV_TemperatureWarm(double *v, double T_guess, double *T)
+/*!
+ * Same as GetPV_Temperature(), i.e. solves T/mu(T,rho) = p/rho*KELVIN,
+ * but with Newton iterations starting from T_guess (e.g. the temperature
+ * the cell had before), instead of a bracketed search. It is meant for the
+ * cells whose state changed a little: when a Newton step is larger than
+ * WARM_T_MAX_REL_STEP*T or WARM_T_MAX_ITER iterations are not enough, it
+ * gives up, and the caller should use GetPV_Temperature().
+ *
+ * \param [in]  v        primitive quantities in code units
+ * \param [in]  T_guess  starting temperature in Kelvin
+ * \param [out] T        temperature in Kelvin (set only on success)
+ *
+ * \return the number of iterations done, 0 if it did not converge.
+ *********************************************************************** */
+{
+  double Tk = T_guess;
+  double target = v[PRS]/v[RHO]*KELVIN;
+  double f, df_dT, dT;
+  int it;
+
+  if (!(Tk > 0.0) || !(target > 0.0)) return 0;
+
+  for (it = 1; it <= WARM_T_MAX_ITER; it++) {
+    f = TemperatureFuncAndDerivative(v, Tk, &df_dT);
+    dT = (target - f)/df_dT;
+    if (!(fabs(dT) <= WARM_T_MAX_REL_STEP*Tk)) return 0;
+    Tk += dT;
+    if (fabs(dT) <= WARM_T_RTOL*Tk) {
+      *T = Tk;
+      return it;
+    }
+  }
+  return 0;
+}
+
+/****************************************************************************
+How the stripe functions work:
+  InternalEnergyStripe() is InternalEnergyAndDerivative() for n cells (SoA arrays),
+  with the branches turned into selections, so that with AVX2 the cells are done 4 at
+  a time (exp() and pow() by Exp4() and Log4() of vec_math.h, which differ from the
+  libm ones by ~1 ulp); without AVX2, and for the cells left over, it calls the scalar
+  function.
+  GetEV_TemperatureStripe() inverts rhoe(T) = rhoe on all the cells of a stripe in
+  lock-step: at every iteration one InternalEnergyStripe() on the whole stripe, then a
+  Newton step for each cell that has not converged yet. Every cell keeps a bracket of its
+  T, which shrinks at every iteration (rhoe grows with T): a Newton step which falls
+  outside it, or which is not smaller than half the step before the last one, is
+  replaced by the geometric mean of the bracket (as rtsafe() of Numerical Recipes), so
+  the iteration can neither diverge nor oscillate where rhoe(T) bends (ionization).
+  The initial bracket comes from the bounds of the Saha ionization (0 <= x <= 1) in
+  e = D*T*(1+x)*alpha + chi*x/mH:
+    T <= e/D, and T >= (e - chi/mH)/(2D) if it is <= T_LIM_IEN (alpha = 1 there).
+*****************************************************************************/
+#ifdef __AVX2__
+// InternalEnergyAndDerivative() of 4 cells (rho in code units, T in Kelvin), x is the ionization
+static inline __m256d InternalEnergy4(__m256d rho, __m256d T, __m256d *drhoe_dT, __m256d *x) {
+  const __m256d one = _mm256_set1_pd(1.0), zero = _mm256_setzero_pd();
+  const __m256d chi = _mm256_set1_pd(13.6*CONST_eV);
+  const __m256d D = _mm256_set1_pd(1.5*CONST_kB/CONST_amu);
+  const __m256d chi_mH = _mm256_set1_pd(13.6*CONST_eV/CONST_mH);
+  const __m256d p0 = _mm256_set1_pd(UNIT_DENSITY*UNIT_VELOCITY*UNIT_VELOCITY);
+  __m256d me = _mm256_set1_pd(2.0*CONST_PI*CONST_me);
+  __m256d h3 = _mm256_set1_pd(CONST_h*CONST_h*CONST_h);
+  __m256d kT, mekT, n, c, xx, dcdT, dxdT, alpha, alpha_der, DTa, e, dedT;
+
+  rho = _mm256_mul_pd(rho, _mm256_set1_pd(UNIT_DENSITY));
+  kT = _mm256_mul_pd(_mm256_set1_pd(CONST_kB), T);
+  n = _mm256_div_pd(rho, _mm256_set1_pd(CONST_mp));
+  mekT = _mm256_mul_pd(me, kT);
+  c = _mm256_div_pd(_mm256_mul_pd(mekT, _mm256_sqrt_pd(mekT)), _mm256_mul_pd(h3, n));
+  c = _mm256_mul_pd(c, Exp4(_mm256_div_pd(_mm256_sub_pd(zero, chi), kT)));
+  xx = _mm256_div_pd(_mm256_set1_pd(2.0),
+         _mm256_add_pd(_mm256_sqrt_pd(_mm256_add_pd(one, _mm256_div_pd(_mm256_set1_pd(4.0), c))), one));
+
+  // dx/dT = dc/dT*(1-x)^2/(x*(2-x)), 0 where x = 0
+  dcdT = _mm256_div_pd(_mm256_mul_pd(c, _mm256_add_pd(_mm256_set1_pd(1.5), _mm256_div_pd(chi, kT))), T);
+  dxdT = _mm256_div_pd(_mm256_mul_pd(dcdT, _mm256_mul_pd(_mm256_sub_pd(one, xx), _mm256_sub_pd(one, xx))),
+                       _mm256_mul_pd(xx, _mm256_sub_pd(_mm256_set1_pd(2.0), xx)));
+  dxdT = _mm256_and_pd(dxdT, _mm256_cmp_pd(xx, zero, _CMP_GT_OQ));
+
+  alpha = one;
+  alpha_der = one;
+  #ifdef T_LIM_IEN
+  {
+    __m256d hot = _mm256_cmp_pd(T, _mm256_set1_pd(T_LIM_IEN), _CMP_GT_OQ);
+    __m256d a = Exp4(_mm256_mul_pd(_mm256_set1_pd(BETA_IEN),
+                                   Log4(_mm256_div_pd(T, _mm256_set1_pd(T_LIM_IEN)))));
+    alpha = _mm256_blendv_pd(one, a, hot);
+    alpha_der = _mm256_blendv_pd(one, _mm256_set1_pd(1.0 + BETA_IEN), hot);
+  }
+  #endif
+
+  DTa = _mm256_mul_pd(_mm256_mul_pd(D, T), alpha);
+  e = _mm256_add_pd(_mm256_mul_pd(DTa, _mm256_add_pd(one, xx)), _mm256_mul_pd(chi_mH, xx));
+  dedT = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(D, _mm256_add_pd(one, xx)), _mm256_mul_pd(alpha, alpha_der)),
+                       _mm256_mul_pd(_mm256_add_pd(DTa, chi_mH), dxdT));
+
+  *x = xx;
+  *drhoe_dT = _mm256_div_pd(_mm256_mul_pd(rho, dedT), p0);
+  return _mm256_div_pd(_mm256_mul_pd(rho, e), p0);
+}
+#endif
+
+/* ********************************************************************* */
+void InternalEnergyStripe(const double *rho, const double *T, double *rhoe,
+                          double *drhoe_dT, double *x, int n)
+/*!
+ * InternalEnergyAndDerivative() of n cells, and their ionization x
+ * (as SahaXFrac()); x can be NULL.
+ *
+ * \param [in]  rho       densities (code units)
+ * \param [in]  T         temperatures (Kelvin)
+ * \param [out] rhoe      internal energies per unit volume (code units)
+ * \param [out] drhoe_dT  d(rhoe)/dT
+ * \param [out] x         ionization degrees (or NULL)
+ * \param [in]  n         number of cells
+ *********************************************************************** */
+{
+  int m = 0;
+  double v[NVAR], boltz;
+
+  #ifdef __AVX2__
+  {
+    __m256d d, xx, r;
+    for (; m + 4 <= n; m += 4) {
+      r = InternalEnergy4(_mm256_loadu_pd(rho + m), _mm256_loadu_pd(T + m), &d, &xx);
+      _mm256_storeu_pd(rhoe + m, r);
+      _mm256_storeu_pd(drhoe_dT + m, d);
+      if (x != NULL) _mm256_storeu_pd(x + m, xx);
+    }
+    COUNT_SAHA_EXP_N(m);
+  }
+  #endif
+  for (; m < n; m++) {
+    v[RHO] = rho[m];
+    rhoe[m] = InternalEnergyAndDerivative(v, T[m], drhoe_dT + m);
+    if (x != NULL) x[m] = SahaXFracExp(T[m], rho[m], &boltz);
+  }
+}
+
+/* ********************************************************************* */
+int GetEV_TemperatureStripe(const double *rho, const double *rhoe, double *T,
+                            double *mu, unsigned char *ok, int n)
+/*!
+ * Same as GetEV_Temperature() (solves rhoe(T, rho) = rhoe) for n cells at
+ * once, iterating all of them in lock-step (see above), with n <= NMAX_POINT.
+ * [Rob] The scratch arrays are static: it must not be called by two
+ * threads at the same time.
+ *
+ * \param [in]     rho   densities (code units)
+ * \param [in]     rhoe  internal energies per unit volume (code units)
+ * \param [in,out] T     in: guesses (Kelvin), brought inside the bracket
+ *                       of the cell (<= 0 for no guess);
+ *                       out: temperatures (Kelvin) of the cells with ok
+ * \param [out]    mu    mean molecular weights (as GetMu()) of the cells with ok
+ * \param [out]    ok    1 for the cells which converged, 0 for the others
+ *                       (rhoe <= 0 or more than STRIPE_T_MAX_ITER iterations)
+ * \param [in]     n     number of cells
+ *
+ * \return the number of cells which did not converge.
+ *********************************************************************** */
+{
+  static double *f, *df, *x, *T_lo, *T_hi, *dT_last, *dT_old;
+  double chi_mH = 13.6*CONST_eV/CONST_mH;
+  double D = 1.5*CONST_kB/CONST_amu;
+  double p0 = UNIT_DENSITY*UNIT_VELOCITY*UNIT_VELOCITY;
+  double e, T_new;
+  int m, it, n_active;
+
+  if (f == NULL) {
+    f = ARRAY_1D(NMAX_POINT, double);
+    df = ARRAY_1D(NMAX_POINT, double);
+    x = ARRAY_1D(NMAX_POINT, double);
+    T_lo = ARRAY_1D(NMAX_POINT, double);
+    T_hi = ARRAY_1D(NMAX_POINT, double);
+    dT_last = ARRAY_1D(NMAX_POINT, double);
+    dT_old = ARRAY_1D(NMAX_POINT, double);
+  }
+  if (n > NMAX_POINT) {
+    print1("[GetEV_TemperatureStripe] %d cells, at most NMAX_POINT (%d) are allowed\n", n, NMAX_POINT);
+    QUIT_PLUTO(1);
+  }
+
+  // Brackets and starting points; ok is 1 for the cells still iterating
+  n_active = 0;
+  for (m = 0; m < n; m++) {
+    e = rhoe[m]*p0/(rho[m]*UNIT_DENSITY);
+    ok[m] = (e > 0.0 && rho[m] > 0.0);
+    // The bounds are widened a little: T is often on them (x = 0 or 1)
+    T_hi[m] = e/D*(1.0 + 1.e-6);
+    T_lo[m] = (e - chi_mH)/(2.0*D);
+    #ifdef T_LIM_IEN
+      T_lo[m] = MIN(T_lo[m], T_LIM_IEN);
+    #endif
+    T_lo[m] = MAX(T_lo[m]*(1.0 - 1.e-6), STRIPE_T_FLOOR);
+    if (!ok[m] || !(T_hi[m] > T_lo[m])) {
+      ok[m] = 0;
+      T_lo[m] = T_hi[m] = T[m] = STRIPE_T_FLOOR;  // Harmless values for InternalEnergyStripe()
+      continue;
+    }
+    // A guess just outside the bracket is still better than its middle
+    if (T[m] > 0.0) T[m] = MIN(MAX(T[m], T_lo[m]), T_hi[m]);
+    else            T[m] = sqrt(T_lo[m]*T_hi[m]);
+    dT_last[m] = dT_old[m] = T_hi[m] - T_lo[m];
+    n_active++;
+  }
+
+  for (it = 0; it < STRIPE_T_MAX_ITER && n_active > 0; it++) {
+    InternalEnergyStripe(rho, T, f, df, x, n);
+    n_active = 0;
+    for (m = 0; m < n; m++) {
+      if (ok[m] != 1) continue;
+      mu[m] = 1.0/(1.0 + x[m]);
+      if (f[m] < rhoe[m]) T_lo[m] = T[m];
+      else                T_hi[m] = T[m];
+      T_new = T[m] + (rhoe[m] - f[m])/df[m];
+      if (fabs(T_new - T[m]) <= STRIPE_T_RTOL*T[m]) {
+        ok[m] = 2;  // Converged (it becomes 1 below)
+      } else {
+        // Bisection also if the steps do not halve in two iterations (Newton oscillating around an inflection)
+        if (!(T_new > T_lo[m] && T_new < T_hi[m]) || fabs(T_new - T[m]) > 0.5*dT_old[m])
+          T_new = sqrt(T_lo[m]*T_hi[m]);
+        dT_old[m] = dT_last[m];
+        dT_last[m] = fabs(T_new - T[m]);
+        n_active++;
+      }
+      T[m] = T_new;
+    }
+  }
+
+  // mu is the one of the last evaluation, whose T differs from the final one by < STRIPE_T_RTOL
+  n_active = 0;
+  for (m = 0; m < n; m++) {
+    ok[m] = (ok[m] == 2);
+    n_active += !ok[m];
+  }
+  return n_active;
+}
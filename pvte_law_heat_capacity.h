@@ -1,6 +1,39 @@
 #ifndef PVTE_LAW_HEAT_CAPACITY_H
 #define PVTE_LAW_HEAT_CAPACITY_H
 
+/* If YES, the exp() done to solve the Saha equation (pvte_law.c) are counted, and
+   printed every SAHA_EXP_REPORT_PERIOD steps (by ADI()) */
+#ifndef SAHA_EXP_COUNT
+  #define SAHA_EXP_COUNT NO
+#endif
+#ifndef SAHA_EXP_REPORT_PERIOD
+  #define SAHA_EXP_REPORT_PERIOD 100
+#endif
+/* If YES, ConsToPrimLines() (mappersLines.c) inverts the EOS on whole stripes at once,
+   with GetEV_TemperatureStripe(), instead of calling ConsToPrim() */
+#ifndef STRIPE_T_INVERSION
+  #define STRIPE_T_INVERSION NO
+#endif
+
+// Thermodynamic state of the gas at a given (T, rho), see EOSStateFromT()
+typedef struct EOS_STATE {
+  double x;     /**< Ionization degree (as SahaXFrac()) */
+  double mu;    /**< Mean molecular weight (as GetMu()) */
+  double rhoe;  /**< Internal energy per unit volume (code units, as InternalEnergyFunc()) */
+  double dEdT;  /**< Heat capacity per unit volume (code units, as HeatCapacity()) */
+} EOSState;
+
 /*[Ema] This is for computing the heat capacity, user supplied (inside pvte_law.c)*/
 void HeatCapacity(double *v, double T, double *dEdT);
+double InternalEnergyAndDerivative(double *v, double T, double *drhoe_dT);
+double TemperatureFuncAndDerivative(double *v, double T, double *df_dT);
+int GetPV_TemperatureWarm(double *v, double T_guess, double *T);
+void EOSStateFromT(double *v, double T, EOSState *s);
+void InternalEnergyStripe(const double *rho, const double *T, double *rhoe,
+                          double *drhoe_dT, double *x, int n);
+int GetEV_TemperatureStripe(const double *rho, const double *rhoe, double *T,
+                            double *mu, unsigned char *ok, int n);
+#if SAHA_EXP_COUNT
+  void ReportSahaExpCount(int n_steps);
+#endif
 #endif
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include <math.h>
 #include "pluto.h"
 #include "adi.h"
+#include "field2d.h"
 #include "capillary_wall.h"
 #include "current_table.h"
 #include "debug_utilities.h"
+#include "cell_state.h"
 
 #define UNUSED(x) (void)(x)
 
@@ -16,8 +18,11 @@ double GetCurrADI() {
 }
 
 #if RESISTIVITY == ALTERNATING_DIRECTION_IMPLICIT
+static void BuildEtaCells(const Data *d, Grid *grid, Lines *lines, double **eta_c);
+
 /****************************************************************************
-Function to build the Ip,Im,Jp,Jm for the electrical resistivity problem
+Function to build the Ip,Im,Jp,Jm (and CI, CJ, which are 1/C, see BuildIJ in adi.h)
+for the electrical resistivity problem
 (**useless parameter is intentionally unused, to make this function suitable for a pointer
  which also wants that parameter)
 *****************************************************************************/
@@ -25,211 +30,58 @@ void BuildIJ_Res (const Data *d, Grid *grid, Lines *lines,
                   double **Ip, double **Im, double **Jp,
                   double **Jm, double **CI, double **CJ, double **useless) {
 
-  static int first_call=1;
-  static double **protoIp, **protoIm, **protoJp, **protoJm, **protoCI, **protoCJ;
+  double **eta_c; // Electr. resistivity (eta[0] of Resistive_eta()) in each cell
   int i,j,k;
-  int Nlines, lidx, ridx;
-  int nv, l;
-  double eta[3], eta2[3]; // Electr. resistivity
-  double v[NVAR];
-  double ****Vc;
-  double *inv_dri, *inv_dzi, *inv_dr, *inv_dz, *r_1;
-  double *zL, *zR;
-  double *rL, *rR;
-  double *r, *z, *theta;
+  int lidx, ridx;
+  int l;
+  double eta; // Electr. resistivity at an interface
+  const OperatorGeometry *geo; // Grid-related part of Ip, Im, Jp, Jm, CI (1D vectors)
   UNUSED(**useless);
 
-  /* -- set a pointer to the primitive vars array --
-    I do this because it is done also in other parts of the code
-    maybe it makes the program faster or just easier to write/read...*/
-  Vc = d->Vc;
+  // The grid-related part is composed once forever (and shared with BuildIJ_TC()), I only update eta
+  geo = GetOperatorGeometry(grid);
 
-  theta = grid[KDIR].x;
-
-  r = grid[IDIR].x;
-  z = grid[JDIR].x;
-  rL = grid[IDIR].xl;
-  rR = grid[IDIR].xr;
-  zL = grid[JDIR].xl;
-  zR = grid[JDIR].xr;
-
-  // I compose the grid-related part once forever (in static variables) and only update eta
-  if (first_call) {
-    // Name shorthands
-    inv_dzi = grid[JDIR].inv_dxi; // reciprocal of cell spacing between centers (see set_geometry.c)
-    inv_dri = grid[IDIR].inv_dxi;
-    inv_dz = grid[JDIR].inv_dx; // reciprocal of cell spacing between interfaces (see set_geometry.c)
-    inv_dr = grid[IDIR].inv_dx;
-    r_1 = grid[IDIR].r_1;
-
-    /*Allocatin of memory for the proto variables*/
-    protoIp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoIm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoJp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoJm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoCI = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoCJ = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-
-    /*[Opt] This is probably useless, it is here just for debugging purposes*/
-    TOT_LOOP(k, j, i) {
-      protoIp[j][i] = 0.0;
-      protoIm[j][i] = 0.0;
-      protoJp[j][i] = 0.0;
-      protoJm[j][i] = 0.0;
-      protoCI[j][i] = 0.0;
-      protoCJ[j][i] = 0.0;
-    }
-    // I build the grid-related part of Im/p Jm/p, CI, CJ
-    KDOM_LOOP(k) {
-      LINES_LOOP(lines[IDIR], l, j, i) {
-        /* :::: Ip :::: */
-        protoIp[j][i] = inv_dr[i]*inv_dri[i]/rR[i];
-        /* :::: Im :::: */
-        if (rL[i]!=0.0)
-          protoIm[j][i] = inv_dr[i]*inv_dri[i-1]/rL[i];
-        else
-          protoIm[j][i] = 1/(r[i]*r[i])/rR[i];
-        /* :::: Jp :::: */
-        protoJp[j][i] = inv_dz[j]*inv_dzi[j];
-        /* :::: Jm :::: */
-        protoJm[j][i] = inv_dz[j]*inv_dzi[j-1];
-        /* :::: CI :::: */
-        protoCI[j][i] = r_1[i];
-        /* :::: CJ :::: */
-        protoCJ[j][i] = 1.0;
-      }
-    }
-    first_call = 0;
-  }
+  /* I compute eta once per cell (on the lines and on their ghosts) and then I take
+     the harmonic averages at the interfaces (eta_c is not static, as in BuildIJ_TC()) */
+  eta_c = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  BuildEtaCells(d, grid, lines, eta_c);
 
   KDOM_LOOP(k) {
     
     /* :::: Ip and Im :::: */
-    Nlines = lines[IDIR].N;
-    for (l = 0; l<Nlines; l++) {
-      j = lines->dom_line_idx[l];
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
       lidx = lines[IDIR].lidx[l];
       ridx = lines[IDIR].ridx[l];
-
-      /* :::: Im on i=lidx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][lidx];
-      Resistive_eta( v, r[lidx], z[j], theta[k], NULL, eta);  
-
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][lidx-1];
-      Resistive_eta( v, r[lidx-1], z[j], theta[k], NULL, eta2);
-      
-      eta[0] = 2/(1/eta[0] + 1/eta2[0]);
-      // if (eta[0] != eta[1] || eta[1] != eta[2]) {
-      //   ComplainAnisotropic(v, eta, rL[lidx], z[j], theta[k]);
-      //   QUIT_PLUTO(1);
-      // }
-      Im[j][lidx] = eta[0]*protoIm[j][lidx];
-
-      /* :::: Ip and Im for internal (non boundary) interfaces :::: */
-      for (i=lidx; i<ridx; i++) {
-
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j][i];  
-        Resistive_eta( v, r[i], z[j], theta[k], NULL, eta);
-
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j][i+1];
-        Resistive_eta( v, r[i+1], z[j], theta[k], NULL, eta2);
-        eta[0] = 2/(1/eta[0] + 1/eta2[0]);
-        // if (eta[0] != eta[1] || eta[1] != eta[2]) {
-        //   ComplainAnisotropic(v, eta, rR[i], z[j], theta[k]);
-        //   QUIT_PLUTO(1);
-        // }
-        Ip[j][i] = eta[0]*protoIp[j][i];
-        Im[j][i+1] = eta[0]*protoIm[j][i+1];
+      // Interface between i and i+1 (the first one is the left boundary, the last one the right boundary)
+      for (i = lidx-1; i <= ridx; i++) {
+        eta = 2/(1/eta_c[j][i] + 1/eta_c[j][i+1]);
+        if (i >= lidx) Ip[j][i] = eta*geo->res_Ip[i];
+        if (i < ridx)  Im[j][i+1] = eta*geo->res_Im[i+1];
       }
-
-      /* :::: Ip on i=ridx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][ridx];  
-      Resistive_eta( v, r[ridx], z[j], theta[k], NULL, eta);
-
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][ridx+1];
-      Resistive_eta( v, r[ridx+1], z[j], theta[k], NULL, eta2);
-
-      eta[0] = 2/(1/eta[0] + 1/eta2[0]);
-      // if (eta[0] != eta[1] || eta[1] != eta[2]) {
-      //   ComplainAnisotropic(v, eta, rR[ridx], z[j], theta[k]);
-      //   QUIT_PLUTO(1);
-      // }
-      Ip[j][ridx] = eta[0]*protoIp[j][ridx];
     }
 
     /* :::: Jp and Jm :::: */
-    Nlines = lines[JDIR].N;
-    for (l = 0; l<Nlines; l++) {
+    for (l = 0; l < lines[JDIR].N; l++) {
       i = lines[JDIR].dom_line_idx[l];
       lidx = lines[JDIR].lidx[l];
       ridx = lines[JDIR].ridx[l];
-
-      /* :::: Jm on j=lidx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][lidx][i];  
-      Resistive_eta( v, r[i], z[lidx], theta[k], NULL, eta);
-
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][lidx-1][i];
-      Resistive_eta( v, r[i], z[lidx-1], theta[k], NULL, eta2);
-
-      eta[0] = 2/(1/eta[0] + 1/eta2[0]);
-      // if (eta[0] != eta[1] || eta[1] != eta[2]) {
-      //   ComplainAnisotropic(v, eta, r[i], zL[lidx], theta[k]);
-      //   QUIT_PLUTO(1);
-      // }
-      Jm[lidx][i] = eta[0]*protoJm[lidx][i];
-
-      /* :::: Jp and Jm for internal (non boundary) interfaces :::: */
-      for (j=lidx; j<ridx; j++) {
-
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j][i];  
-        Resistive_eta( v, r[i], z[j], theta[k], NULL, eta);
-
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j+1][i];  
-        Resistive_eta( v, r[i], z[j+1], theta[k], NULL, eta2);
-
-        eta[0] = 2/(1/eta[0] + 1/eta2[0]);
-        // if (eta[0] != eta[1] || eta[1] != eta[2]) {
-        //   ComplainAnisotropic(v, eta, r[i], zR[j], theta[k]);
-        //   QUIT_PLUTO(1);
-        // }
-        Jp[j][i] = eta[0]*protoJp[j][i];
-        Jm[j+1][i] = eta[0]*protoJm[j+1][i];  
+      // Interface between j and j+1
+      for (j = lidx-1; j <= ridx; j++) {
+        eta = 2/(1/eta_c[j][i] + 1/eta_c[j+1][i]);
+        if (j >= lidx) Jp[j][i] = eta*geo->res_Jp[j];
+        if (j < ridx)  Jm[j+1][i] = eta*geo->res_Jm[j+1];
       }
-
-      /* :::: Jp on j=ridx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][ridx][i];  
-      Resistive_eta( v, r[i], z[ridx], theta[k], NULL, eta);
-
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][ridx+1][i];  
-      Resistive_eta( v, r[i], z[ridx+1], theta[k], NULL, eta2);
-
-      eta[0] = 2/(1/eta[0] + 1/eta2[0]);
-      // if (eta[0] != eta[1] || eta[1] != eta[2]) {
-      //   ComplainAnisotropic(v, eta, r[i], zR[ridx], theta[k]);
-      //   QUIT_PLUTO(1);
-      // }
-      Jp[ridx][i] = eta[0]*protoJp[ridx][i];
     }
 
     // I separate the computation of CI and CJ just to improve code readability,
     // I could also inglobate them in the previous cycles
-    LINES_LOOP(lines[IDIR], l, j, i) {
-      /* :::: CI :::: */
-      CI[j][i] = protoCI[j][i];
-      /* :::: CJ :::: */
-      CJ[j][i] = protoCJ[j][i];
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      /* :::: CI (1/C) :::: */
+      CopyRow(FIELD_ROW(CI, j), geo->res_CI, lines[IDIR].lidx[l], lines[IDIR].ridx[l]);
+      /* :::: CJ (1/C) :::: */
+      for (i = lines[IDIR].lidx[l]; i <= lines[IDIR].ridx[l]; i++) CJ[j][i] = 1.0;
     }
   }
 
@@ -244,6 +96,58 @@ void BuildIJ_Res (const Data *d, Grid *grid, Lines *lines,
     printf("\n[BuildIJ_Res] Jp:");
     printmat(Jp, NX2_TOT, NX1_TOT);
   #endif
+  FreeArray2D((void *) eta_c);
+}
+
+/****************************************************************************
+Gets the electrical resistivity (eta[0] of Resistive_eta()) of the cells of the lines
+and of the ghosts next to them (from the cell state cache, see cell_state.c)
+*****************************************************************************/
+static void BuildEtaCells(const Data *d, Grid *grid, Lines *lines, double **eta_c) {
+  int i,j,k,l,side;
+  const double *row;
+
+  KDOM_LOOP(k) {
+    /* The cells of the JDIR lines are the same of the IDIR lines, only their ghosts differ.
+       The IDIR lines (with their ghosts) are done at once by CellEtaRow() */
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      row = CellEtaRow(d, grid, k, j, lines[IDIR].lidx[l]-1, lines[IDIR].ridx[l]+1);
+      for (i = lines[IDIR].lidx[l]-1; i <= lines[IDIR].ridx[l]+1; i++)
+        eta_c[j][i] = row[i];
+    }
+    for (l = 0; l < lines[JDIR].N; l++) {
+      i = lines[JDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        j = side ? lines[JDIR].ridx[l]+1 : lines[JDIR].lidx[l]-1;
+        eta_c[j][i] = CellEta(d, grid, k, j, i);
+      }
+    }
+  }
+}
+
+/****************************************************************************
+Kernels of ResEnergyIncrease() and ResEnergyIncreaseDR() on the raw rows of the fields
+(dir==IDIR), restrict-qualified so that the loops are vectorized:
+ - FluxRowRes(): power flux through the right interface of the cells ibeg <= i <= iend
+   (Br_der is the B*r whose difference gives the current, Br the one which is averaged);
+ - EnergyRowRes(): energy increase of the cells from the fluxes on their interfaces.
+*****************************************************************************/
+static void FluxRowRes(double *restrict F, double const *restrict Hp_B,
+                       double const *restrict Br_der, double const *restrict Br,
+                       double const *restrict dr, double const *restrict r_1,
+                       int ibeg, int iend) {
+  int i;
+  for (i = ibeg; i <= iend; i++)
+    F[i] = -Hp_B[i] * (Br_der[i+1] - Br_der[i])*dr[i] * 0.5*(Br[i+1]*r_1[i+1] + Br[i]*r_1[i]);
+}
+
+static void EnergyRowRes(double *restrict dU, double const *restrict F,
+                         double const *restrict rR, double const *restrict rL,
+                         double const *restrict dV, int ibeg, int iend, double dt) {
+  int i;
+  for (i = ibeg; i <= iend; i++)
+    dU[i] = -(rR[i]*F[i] - rL[i]*F[i-1])*dt/dV[i];
 }
 
 /****************************************************************************
@@ -268,17 +172,18 @@ void ResEnergyIncrease(double **dUres, double** Hp_B, double** Hm_B, double **Br
   double *dr, *dz;
   int i,j,l;
   int lidx, ridx;
-  int Nlines = lines->N;
   int static first_call = 1;
   double *dV, *inv_dz, *r_1, *r;
   double *rL, *rR;
   Bcs *rbound, *lbound;
   double vol_lidx, vol_ridx;
+  // Raw rows of the fields (dir==IDIR), the loops on them are done by the *Row() kernels
+  double *Fj, *dUresj, *Hp_Bj, *Hm_Bj, *Brj;
 
   /*[Opt] Maybe I could do that it allocates static arrays with size NMAX_POINT (=max(NX1_TOT,NX2_TOT)) ?*/
   if (first_call) {
     /* I define it 2d in case I need to export it later*/
-    F = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    F = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     /*This is useless, it's just for debugging purposes*/
     ITOT_LOOP(i)
       JTOT_LOOP(j)
@@ -286,9 +191,12 @@ void ResEnergyIncrease(double **dUres, double** Hp_B, double** Hm_B, double **Br
     first_call = 0;
   }
   /*This is useless, it's just for debugging purposes*/
-  ITOT_LOOP(i)
-    JTOT_LOOP(j)
-      dUres[j][i] = 0.0;
+  #ifndef PARALLEL
+    // (in parallel dUres has the size of the global domain, and only the own lines are used)
+    ITOT_LOOP(i)
+      JTOT_LOOP(j)
+        dUres[j][i] = 0.0;
+  #endif
 
   lbound = lines->lbound[BDIFF];
   rbound = lines->rbound[BDIFF];
@@ -306,37 +214,39 @@ void ResEnergyIncrease(double **dUres, double** Hp_B, double** Hm_B, double **Br
     dV = grid[IDIR].dV;
     r = grid[IDIR].x_glob;
 
-    for (l = 0; l<Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       j = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
-      for (i=lidx; i<=ridx; i++){ // I start from lidx because I must treat carefully the lidx interface (at i=lidx-1), since there could be the domain axis
-        // [Err] Decomment next line (original)
-        F[j][i] = -Hp_B[j][i] * (Br[j][i+1] - Br[j][i])*dr[i] * 0.5*(Br[j][i+1]*r_1[i+1] + Br[j][i]*r_1[i]);
-        // [Err] Delete next line (test)
-        // F[j][i] = -Hp_B[j][i] * (Br[j][i+1] - Br[j][i])*dr[i] * 0.5*(Br[j][i+1] + Br[j][i])/rR[i];
-      }
+      Fj = FIELD_ROW(F, j);
+      Hp_Bj = FIELD_ROW(Hp_B, j);
+      Hm_Bj = FIELD_ROW(Hm_B, j);
+      Brj = FIELD_ROW(Br, j);
+      dUresj = FIELD_ROW(dUres, j);
+      // I start from lidx because I must treat carefully the lidx interface (at i=lidx-1), since there could be the domain axis
+      FluxRowRes(Fj, Hp_Bj, Brj, Brj, dr, r_1, lidx, ridx);
+      // [Err] Test (instead of the formula in FluxRowRes()):
+      // Fj[i] = -Hp_Bj[i] * (Brj[i+1] - Brj[i])*dr[i] * 0.5*(Brj[i+1] + Brj[i])/rR[i];
       /* I try to guess if the lower boundary in dir IDIR is the domain axis, if so I compute F consistently (with the usual formula
       I would get a division by zero) */
       if (lbound[l].kind == DIRICHLET && fabs(rL[lidx]) < 1e-20  && fabs(lbound[l].values[0]) < 1e-20) {
-        F[j][lidx-1] = 0.0;
+        Fj[lidx-1] = 0.0;
       } else {
-        F[j][lidx-1] = -Hm_B[j][lidx] * (Br[j][lidx] - Br[j][lidx-1])*dr[lidx] * 0.5*(Br[j][lidx]*r_1[lidx] + Br[j][lidx-1]*r_1[lidx-1]);
+        Fj[lidx-1] = -Hm_Bj[lidx] * (Brj[lidx] - Brj[lidx-1])*dr[lidx] * 0.5*(Brj[lidx]*r_1[lidx] + Brj[lidx-1]*r_1[lidx-1]);
       }
       // Build dU
-      for (i=lidx; i<=ridx; i++)
-        dUres[j][i] = -(rR[i]*F[j][i] - rL[i]*F[j][i-1])*dt/dV[i];
+      EnergyRowRes(dUresj, Fj, rR, rL, dV, lidx, ridx, dt);
 
       if (compute_inflow) {
         /* --- I compute the inflow (energy entering from boundary) ---*/
         // Old
-        // *inflow += F[j][lidx-1] * 2*CONST_PI*rL[lidx]*dz[j] * dt;
-        // *inflow += -F[j][ridx] * 2*CONST_PI*rR[ridx]*dz[j] * dt;
+        // *inflow += Fj[lidx-1] * 2*CONST_PI*rL[lidx]*dz[j] * dt;
+        // *inflow += -Fj[ridx] * 2*CONST_PI*rR[ridx]*dz[j] * dt;
         // Modified 27/11/2018
         vol_lidx = CONST_PI*(rR[lidx]*rR[lidx] - rL[lidx]*rL[lidx])*dz[j];
         vol_ridx = CONST_PI*(rR[ridx]*rR[ridx] - rL[ridx]*rL[ridx])*dz[j];
-        *inflow += rL[lidx]*F[j][lidx-1]*dt/dV[lidx] * vol_lidx;
-        *inflow += -rR[ridx]*F[j][ridx]*dt/dV[ridx] * vol_ridx;
+        *inflow += rL[lidx]*Fj[lidx-1]*dt/dV[lidx] * vol_lidx;
+        *inflow += -rR[ridx]*Fj[ridx]*dt/dV[ridx] * vol_ridx;
       }
     }
 
@@ -347,7 +257,7 @@ void ResEnergyIncrease(double **dUres, double** Hp_B, double** Hm_B, double **Br
 
     inv_dz = grid[JDIR].inv_dx;
 
-    for (l = 0; l<Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       i = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
@@ -397,16 +307,17 @@ void ResEnergyIncreaseDR (double **dUres, double** Hp_B, double** Hm_B,
   double *dr, *dz;
   int i,j,l;
   int lidx, ridx;
-  int Nlines = lines->N;
   int static first_call = 1;
   double *dV, *inv_dz, *r_1, *r;
   double *rL, *rR;
   Bcs *rbound, *lbound;
+  // Raw rows of the fields (dir==IDIR), the loops on them are done by the *Row() kernels
+  double *Fj, *dUresj, *Hp_Bj, *Hm_Bj, *Brj, *Br_hatj;
 
   /*[Opt] Maybe I could do that it allocates static arrays with size NMAX_POINT (=max(NX1_TOT,NX2_TOT)) ?*/
   if (first_call) {
     /* I define it 2d in case I need to export it later*/
-    F = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+    F = ARRAY_2D_FIELD(NX2_TOT, NX1_TOT);
     /*This is useless, it's just for debugging purposes*/
     ITOT_LOOP(i)
       JTOT_LOOP(j)
@@ -414,9 +325,12 @@ void ResEnergyIncreaseDR (double **dUres, double** Hp_B, double** Hm_B,
     first_call = 0;
   }
   /*This is useless, it's just for debugging purposes*/
-  ITOT_LOOP(i)
-    JTOT_LOOP(j)
-      dUres[j][i] = 0.0;
+  #ifndef PARALLEL
+    // (in parallel dUres has the size of the global domain, and only the own lines are used)
+    ITOT_LOOP(i)
+      JTOT_LOOP(j)
+        dUres[j][i] = 0.0;
+  #endif
 
   lbound = lines->lbound[BDIFF];
   rbound = lines->rbound[BDIFF];
@@ -429,32 +343,36 @@ void ResEnergyIncreaseDR (double **dUres, double** Hp_B, double** Hm_B,
     dV = grid[IDIR].dV;
     r = grid[IDIR].x_glob;
 
-    for (l = 0; l<Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       j = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
-
-      for (i=lidx; i<=ridx; i++){ // I start from lidx because I must treat carefully the lidx interface (at i=lidx-1), since there could be the domain axis
-        F[j][i] = -Hp_B[j][i] * (Br_hat[j][i+1] - Br_hat[j][i])*dr[i] * 0.5*(Br[j][i+1]*r_1[i+1] + Br[j][i]*r_1[i]);
-      }
+      Fj = FIELD_ROW(F, j);
+      Hp_Bj = FIELD_ROW(Hp_B, j);
+      Hm_Bj = FIELD_ROW(Hm_B, j);
+      Brj = FIELD_ROW(Br, j);
+      Br_hatj = FIELD_ROW(Br_hat, j);
+      dUresj = FIELD_ROW(dUres, j);
+
+      // I start from lidx because I must treat carefully the lidx interface (at i=lidx-1), since there could be the domain axis
+      FluxRowRes(Fj, Hp_Bj, Br_hatj, Brj, dr, r_1, lidx, ridx);
       /* I try to guess if the lower boundary in dir IDIR is the domain axis, if so I compute F consistently (with the usual formula
       I would get a division by zero) */
       if (lbound[l].kind == DIRICHLET && fabs(rL[lidx]) < 1e-20  && fabs(lbound[l].values[0]) < 1e-20) {
-        F[j][lidx-1] = 0.0;
+        Fj[lidx-1] = 0.0;
       } else {
-        F[j][lidx-1] = -Hm_B[j][lidx] * (Br_hat[j][lidx] - Br_hat[j][lidx-1])*dr[lidx] * 0.5*(Br[j][lidx]*r_1[lidx] + Br[j][lidx-1]*r_1[lidx-1]);
+        Fj[lidx-1] = -Hm_Bj[lidx] * (Br_hatj[lidx] - Br_hatj[lidx-1])*dr[lidx] * 0.5*(Brj[lidx]*r_1[lidx] + Brj[lidx-1]*r_1[lidx-1]);
       }
 
       // Build dU
-      for (i=lidx; i<=ridx; i++)
-        dUres[j][i] = -(rR[i]*F[j][i] - rL[i]*F[j][i-1])*dt/dV[i];
+      EnergyRowRes(dUresj, Fj, rR, rL, dV, lidx, ridx, dt);
     }
 
   } else if (dir == JDIR) {
     dz = grid[JDIR].dx;
     inv_dz = grid[JDIR].inv_dx;
 
-    for (l = 0; l<Nlines; l++) {
+    for (l = lines->lbeg; l < lines->lend; l++) {
       i = lines->dom_line_idx[l];
       lidx = lines->lidx[l];
       ridx = lines->ridx[l];
@@ -3,18 +3,43 @@
 #include "current_table.h"
 #include "capillary_wall.h"
 #include "transport_tables.h"
+#include "gamma_transp_vec.h"
+#include "res_eta.h"
 
 #define RESMAX_PLASMA 1.0e-9
 #define REALISTIC_WALL_ETA NO
+// Cells done at once by Resistive_etaLine() (size of its scratch arrays)
+#define RES_LINE_CHUNK 256
+
+#if ETA_TABLE
+  static int res_tab_not_done = 1;
+#endif
 
 void Resistive_eta(double *v, double x1, double x2, double x3, double *J, double *eta)
 {
-  #if ETA_TABLE
-  static int res_tab_not_done = 1;
-  #else
+  double T=0.0;
+
+  if (g_inputParam[ETAX_GAU] <= 0.0) {
+    if (GetPV_Temperature(v, &(T) )!=0) {
+      #if WARN_ERR_COMP_TEMP
+        print1("\nResistive_eta:[Ema]Err.comp.temp");
+      #endif
+    }
+  }
+  Resistive_etaFromT(v, T, CapRegionOfPoint(x1, x2), x1, x2, x3, J, eta);
+}
+
+/****************************************************************************
+Same as Resistive_eta(), but the temperature T (Kelvin) is given, instead of being
+computed from v (e.g. when it is already known, see cell_state.c). region is that of
+the cell (see GetCapRegionMap())
+*****************************************************************************/
+void Resistive_etaFromT(double *v, double T, unsigned char region, double x1, double x2, double x3,
+                        double *J, double *eta)
+{
+  #if !ETA_TABLE
   double mu=0.0, z=0.0;
   #endif
-  double T=0.0;
   double res=0.0;
   #if REALISTIC_WALL_ETA
     double const res_copper = 7.8e-18; // Roughly: resisitivity of warm copper
@@ -27,11 +52,6 @@ void Resistive_eta(double *v, double x1, double x2, double x3, double *J, double
     res = g_inputParam[ETAX_GAU];
 
   } else {
-    if (GetPV_Temperature(v, &(T) )!=0) {
-      #if WARN_ERR_COMP_TEMP
-        print1("\nResistive_eta:[Ema]Err.comp.temp");
-      #endif
-    }
     #if ETA_TABLE
       if (res_tab_not_done) {
         MakeElecResistivityTable();
@@ -61,12 +81,11 @@ void Resistive_eta(double *v, double x1, double x2, double x3, double *J, double
 
     #if REALISTIC_WALL_ETA
       // I check if I am on the wall or electrode (or in an intermediate region where I smooth the res)
-      if (x2>zcap_real-dzcap_real+dzcap_real*0.1 && x2<=zcap_real && x1>=rcap_real)
-        res = 0.5*(res_copper+res);
-      else if (x2<zcap_real-dzcap_real-dzcap_real*0.1 && x1>=rcap_real)
-        res = 0.5*(res_wall+res);
-      else if (x2>=zcap_real-dzcap_real-dzcap_real*0.1 && x2<=zcap_real-dzcap_real+dzcap_real*0.1 && x1>=rcap_real)
-        res = (res_copper + res_wall + res)/3;
+      switch (region & (CAP_REGION_ETA_COPPER | CAP_REGION_ETA_GLASS)) {
+        case CAP_REGION_ETA_COPPER: res = 0.5*(res_copper+res); break;
+        case CAP_REGION_ETA_GLASS:  res = 0.5*(res_wall+res); break;
+        case CAP_REGION_ETA_COPPER | CAP_REGION_ETA_GLASS: res = (res_copper + res_wall + res)/3; break;
+      }
     #endif
   }
 
@@ -80,3 +99,98 @@ void Resistive_eta(double *v, double x1, double x2, double x3, double *J, double
   eta[KDIR] =  res / UNIT_ETA;
   /**************************************************/
 }
+
+/****************************************************************************
+Line version of Resistive_etaFromT(): gives eta[0] (code units) of n cells, e.g. those
+of a line, from the arrays (SoA) of their density rho (code units) and temperature T
+(Kelvin). region[m] is the region of the cell (see GetCapRegionMap()), it is read only
+if REALISTIC_WALL_ETA (otherwise it can be NULL).
+The checks that Resistive_etaFromT() does for every cell (fixed eta, table to be made)
+are done once, the table is interpolated by GetElecResisitivityFromTableBatch() and the
+other loops on the cells are vectorizable.
+*****************************************************************************/
+void Resistive_etaLine(const double *restrict rho, const double *restrict T,
+                       const unsigned char *restrict region, double *restrict eta, int n)
+{
+  int m, m0, nc;
+  double rho_cgs[RES_LINE_CHUNK];
+  #if !ETA_TABLE
+    double z[RES_LINE_CHUNK], kT[RES_LINE_CHUNK];
+  #endif
+
+  if (g_inputParam[ETAX_GAU] > 0.0) {
+    // Fixed value from pluto.ini
+    for (m = 0; m < n; m++) eta[m] = g_inputParam[ETAX_GAU] / UNIT_ETA;
+    return;
+  }
+
+  #if ETA_TABLE
+    if (res_tab_not_done) {
+      MakeElecResistivityTable();
+      res_tab_not_done = 0;
+    }
+    for (m0 = 0; m0 < n; m0 += RES_LINE_CHUNK) {
+      nc = MIN(RES_LINE_CHUNK, n - m0);
+      for (m = 0; m < nc; m++) rho_cgs[m] = rho[m0 + m]*UNIT_DENSITY;
+      if (GetElecResisitivityFromTableBatch(rho_cgs, T + m0, eta + m0, nc) != 0) {
+        // I look for the first cell out of the table, to tell it as Resistive_eta()
+        for (m = 0; m < nc; m++) {
+          if (GetElecResisitivityFromTable(rho_cgs[m], T[m0 + m], eta + m0 + m) != 0) {
+            print1("[Resistive_etaLine] Error getting eta from table\n");
+            print1("cell %d of %d of the line\n", m0 + m, n);
+            print1("rho=%g, T=%g", rho_cgs[m], T[m0 + m]);
+            QUIT_PLUTO(1);
+          }
+        }
+      }
+    }
+  #else
+    // As Resistive_etaFromT(), with the batch (vectorized) formulas of gamma_transp_vec.c
+    for (m0 = 0; m0 < n; m0 += RES_LINE_CHUNK) {
+      nc = MIN(RES_LINE_CHUNK, n - m0);
+      IonizDDBatch(T + m0, rho + m0, z, nc);
+      for (m = 0; m < nc; m++) {
+        rho_cgs[m] = rho[m0 + m]*UNIT_DENSITY;
+        kT[m] = T[m0 + m]*CONST_kB;
+      }
+      elRes_norm_DD_Batch(z, rho_cgs, kT, eta + m0, nc);
+    }
+  #endif
+
+  Resistive_etaLineFinish(region, eta, n);
+}
+
+/****************************************************************************
+Applies to the electrical resistivity eta (cgs) of n cells, as given by the table or by
+the DD formulas, the limiters of Resistive_etaFromT() and the adimensionalization, as
+Resistive_etaLine() does (e.g. to eta interpolated from the multi-field table, see
+cell_state.c). region as in Resistive_etaLine()
+*****************************************************************************/
+void Resistive_etaLineFinish(const unsigned char *restrict region, double *restrict eta, int n)
+{
+  int m;
+  #if REALISTIC_WALL_ETA
+    double const res_copper = 7.8e-18; // Roughly: resisitivity of warm copper
+    double const res_wall = 1.0e-7; // Roughly: resistivity of glass at 1000-2000°C
+  #endif
+
+  #ifdef RESMAX_PLASMA
+    // This is a test limiter
+    for (m = 0; m < n; m++)
+      if (eta[m] > RESMAX_PLASMA) eta[m] = RESMAX_PLASMA;
+  #endif
+
+  #if REALISTIC_WALL_ETA
+    // As in Resistive_etaFromT()
+    for (m = 0; m < n; m++) {
+      switch (region[m] & (CAP_REGION_ETA_COPPER | CAP_REGION_ETA_GLASS)) {
+        case CAP_REGION_ETA_COPPER: eta[m] = 0.5*(res_copper+eta[m]); break;
+        case CAP_REGION_ETA_GLASS:  eta[m] = 0.5*(res_wall+eta[m]); break;
+        case CAP_REGION_ETA_COPPER | CAP_REGION_ETA_GLASS: eta[m] = (res_copper + res_wall + eta[m])/3; break;
+      }
+    }
+  #endif
+
+  // Adimensionalization, as in Resistive_etaFromT()
+  for (m = 0; m < n; m++) eta[m] /= UNIT_ETA;
+}
@@ -0,0 +1,10 @@
+#ifndef RES_ETA_H
+#define RES_ETA_H
+
+void Resistive_etaFromT(double *v, double T, unsigned char region, double x1, double x2, double x3,
+                        double *J, double *eta);
+void Resistive_etaLine(const double *restrict rho, const double *restrict T,
+                       const unsigned char *restrict region, double *restrict eta, int n);
+void Resistive_etaLineFinish(const unsigned char *restrict region, double *restrict eta, int n);
+
+#endif
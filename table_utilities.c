@@ -1,4 +1,10 @@
 #include "pluto.h"
+#include "table_utilities.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 // #include<math.h>
 
 /* Function to read only the first lines (containing settings) of a file containing ascii table of some quantity*/
@@ -53,6 +59,35 @@ int ReadASCIITableMatrix(const char* table_finame, double **f, int Nx, int Ny) {
   return 0;
 }
 
+/* Function to write an ascii table in the format read above (that of the python scripts:
+   2 comment lines, the settings, then the matrix with a line per x and a column per y) */
+int WriteASCIITable(const char* table_finame, int logspacing, double xmin, double xmax, int Nx, double ymin, double ymax, int Ny, double **f) {
+  FILE *table;
+  int i,j;
+  time_t now;
+
+  table = fopen(table_finame, "w");
+  if (table == NULL) {
+    print1("WriteASCIITable: Error while opening table file %s", table_finame);
+    QUIT_PLUTO(1);
+  }
+
+  now = time(NULL);
+  fprintf(table, "# %s", ctime(&now));  // ctime() ends with \n
+  fprintf(table, "# numb. meaning: logspacing(integer, only allowed:10),min(T),max(T),numb. T points,"
+                 "min(rho),max(rho),numb. rho points,"
+                 "matrix(T,rho): columns(or fastest running index) span rho\n");
+  fprintf(table, "%d\n%e\n%e\n%d\n%e\n%e\n%d\n", logspacing, xmin, xmax, Nx, ymin, ymax, Ny);
+  for (i=0; i<Nx; i++) {
+    for (j=0; j<Ny; j++) {
+      fprintf(table, j < Ny-1 ? "%.10e " : "%.10e\n", f[j][i]);
+    }
+  }
+
+  fclose(table);
+  return 0;
+}
+
 /* For testing purposes */
 void ReprintTable(Table2D *tab, const char *tabname) {
   int i,j;
@@ -89,4 +124,116 @@ void ReprintTable(Table2D *tab, const char *tabname) {
   }
   print1("-----------------------------------------------\n");
 
-}
\ No newline at end of file
+}
+
+/*****************************************************************************
+ Binary cache of a table (see table_utilities.h).
+ The file is a BinTableHeader followed by the Ny x Nx values f[j][i] (i fastest),
+ so it is read by mapping it and copying the values (no parsing).
+ *****************************************************************************/
+typedef struct BIN_TABLE_HEADER {
+  char magic[8];
+  unsigned long long hash;
+  int logspacing, Nx, Ny, pad;
+  double xmin, xmax, ymin, ymax;
+} BinTableHeader;
+
+static const char bin_table_magic[8] = "PLTBIN1";
+
+/* Updates the FNV-1a hash h with the n bytes at p (start with h = TABLE_HASH_SEED) */
+unsigned long long HashBytes(const void *p, size_t n, unsigned long long h) {
+  const unsigned char *c = (const unsigned char *)p;
+  size_t m;
+
+  for (m = 0; m < n; m++) {
+    h ^= c[m];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/* Updates the hash h with the content of a file (with its name only, if it does not exist) */
+unsigned long long HashFile(const char *finame, unsigned long long h) {
+  FILE *fp;
+  char buf[4096];
+  size_t n;
+
+  h = HashBytes(finame, strlen(finame), h);
+  fp = fopen(finame, "rb");
+  if (fp == NULL) return h;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) h = HashBytes(buf, n, h);
+  fclose(fp);
+  return h;
+}
+
+/* Writes a table to a binary cache file, tagged with hash. To a temporary file first, renamed
+   at the end, so that a run reading the cache never finds it half written. Returns 0 on success */
+int WriteBinaryTable(const char *finame, unsigned long long hash, int logspacing,
+                     double xmin, double xmax, int Nx, double ymin, double ymax, int Ny, double **f) {
+  FILE *fp;
+  BinTableHeader hd;
+  char tmp_finame[300];
+  int j, ok;
+
+  memset(&hd, 0, sizeof(hd));
+  memcpy(hd.magic, bin_table_magic, sizeof(hd.magic));
+  hd.hash = hash;
+  hd.logspacing = logspacing;
+  hd.xmin = xmin; hd.xmax = xmax; hd.Nx = Nx;
+  hd.ymin = ymin; hd.ymax = ymax; hd.Ny = Ny;
+
+  sprintf(tmp_finame, "%s.tmp%d", finame, (int)getpid());
+  fp = fopen(tmp_finame, "wb");
+  if (fp == NULL) {
+    print1("\nWriteBinaryTable: cannot write %s, the table is not cached", tmp_finame);
+    return 1;
+  }
+  ok = (fwrite(&hd, sizeof(hd), 1, fp) == 1);
+  for (j = 0; j < Ny && ok; j++) ok = (fwrite(f[j], sizeof(double), Nx, fp) == (size_t)Nx);
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok || rename(tmp_finame, finame) != 0) {
+    print1("\nWriteBinaryTable: error writing %s, the table is not cached", finame);
+    remove(tmp_finame);
+    return 1;
+  }
+  return 0;
+}
+
+/* Reads a table from a binary cache file if it exists and is tagged with hash. On success
+   (return 0) *f is allocated (ARRAY_2D(Ny, Nx)); otherwise (1) nothing is allocated */
+int ReadBinaryTable(const char *finame, unsigned long long hash, int *logspacing,
+                    double *xmin, double *xmax, int *Nx, double *ymin, double *ymax, int *Ny, double ***f) {
+  int fd, j;
+  struct stat st;
+  void *map;
+  const BinTableHeader *hd;
+  const double *val;
+
+  fd = open(finame, O_RDONLY);
+  if (fd < 0) return 1;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BinTableHeader)) {
+    close(fd);
+    return 1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return 1;
+
+  hd = (const BinTableHeader *)map;
+  if (memcmp(hd->magic, bin_table_magic, sizeof(hd->magic)) != 0 || hd->hash != hash ||
+      hd->Nx < 2 || hd->Ny < 2 ||
+      st.st_size != (off_t)(sizeof(BinTableHeader) + sizeof(double)*hd->Nx*hd->Ny)) {
+    munmap(map, st.st_size);
+    return 1;
+  }
+
+  *logspacing = hd->logspacing;
+  *xmin = hd->xmin; *xmax = hd->xmax; *Nx = hd->Nx;
+  *ymin = hd->ymin; *ymax = hd->ymax; *Ny = hd->Ny;
+  val = (const double *)(hd + 1);
+  *f = ARRAY_2D(*Ny, *Nx, double);
+  for (j = 0; j < *Ny; j++) memcpy((*f)[j], val + j*(*Nx), sizeof(double)*(*Nx));
+
+  munmap(map, st.st_size);
+  return 0;
+}
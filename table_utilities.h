@@ -3,6 +3,16 @@
 
 int ReadASCIITableSettings(const char* table_finame, int *logspacing, double *xmin, double *xmax, int *Nx, double *ymin, double *ymax, int *Ny);
 int ReadASCIITableMatrix(const char* table_finame, double **f, int Nx, int Ny);
+int WriteASCIITable(const char* table_finame, int logspacing, double xmin, double xmax, int Nx, double ymin, double ymax, int Ny, double **f);
 void ReprintTable(Table2D *tab, const char *tabname);
 
+// Binary cache of the tables (to skip their generation and the parsing of the ascii file)
+#define TABLE_HASH_SEED 14695981039346656037ULL
+unsigned long long HashBytes(const void *p, size_t n, unsigned long long h);
+unsigned long long HashFile(const char *finame, unsigned long long h);
+int WriteBinaryTable(const char *finame, unsigned long long hash, int logspacing,
+                     double xmin, double xmax, int Nx, double ymin, double ymax, int Ny, double **f);
+int ReadBinaryTable(const char *finame, unsigned long long hash, int *logspacing,
+                    double *xmin, double *xmax, int *Nx, double *ymin, double *ymax, int *Ny, double ***f);
+
 #endif
\ No newline at end of file
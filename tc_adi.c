@@ -1,13 +1,30 @@
 #include "pluto.h"
 #include "adi.h"
+#include "field2d.h"
 #include "capillary_wall.h"
 #include "Thermal_Conduction/tc.h"
 #include "pvte_law_heat_capacity.h"
+#include "transport_tables.h"
+#include "cell_state.h"
 
 #if THERMAL_CONDUCTION  == ALTERNATING_DIRECTION_IMPLICIT
 
+static void BuildKappaCells(const Data *d, Grid *grid, Lines *lines, double **kappa);
+
+// CI = dVr_1/dEdT, CJ = dVz_1/dEdT (the reciprocals of the capacities), with one division per cell
+static void InvCapacityRow(double *restrict CI, double *restrict CJ, double const *restrict dEdT,
+                           double const *restrict dVr_1, double dVz_1, int ibeg, int iend) {
+  int i;
+  double s;
+  for (i = ibeg; i <= iend; i++) {
+    s = 1.0/dEdT[i];
+    CI[i] = dVr_1[i]*s;
+    CJ[i] = dVz_1*s;
+  }
+}
+
 /****************************************************************************
-Function to build the Ip,Im,Jp,Jm, CI, CJ (and also dEdT) for the thermal conduction problem
+Function to build the Ip,Im,Jp,Jm, CI, CJ (1/C, see BuildIJ in adi.h) (and also dEdT) for the thermal conduction problem
 Note that I must make available for outside dEdT, as I will use it later to
 advance the energy in a way that conserves the energy
 Note: Harmonic averaging of k is done as suggested in paper P.Sharma,G.W.Hammett,"Preserving Monotonicity in Anisotropic Diffusion"(2007)
@@ -16,202 +33,86 @@ void BuildIJ_TC(const Data *d, Grid *grid, Lines *lines,
                    double **Ip, double **Im, double **Jp,
                    double **Jm, double **CI, double **CJ, double **dEdT) {
   static int first_call=1;
-  static double **protoIp, **protoIm, **protoJp, **protoJm, **protoCI, **protoCJ;
+  double **kappa; // Thermal conductivity (knor of TC_kappa()) in each cell
   int i,j,k;
   int nv, l;
-  double kpar, knor, knor2, phi; // Thermal conductivity
+  double knor; // Thermal conductivity at an interface
   double v[NVAR];
   double ****Vc;
-  double *inv_dri, *inv_dzi;
-  double *zL, *zR;
-  double *rL, *rR;
-  double *ArR, *ArL;
-  double *dVr, *dVz;
-  double *r, *z, *theta;
-  double T;
-  int Nlines, lidx, ridx;
+  const OperatorGeometry *geo; // Grid-related part of Ip, Im, Jp, Jm, CI, CJ (1D vectors)
+  int lidx, ridx;
+  const double *row; // A row of the cell state cache
 
   /* -- set a pointer to the primitive vars array --
     I do this because it is done also in other parts of the code
     maybe it makes the program faster or just easier to write/read...*/
   Vc = d->Vc;
 
-  theta = grid[KDIR].x;
-
-  r = grid[IDIR].x;
-  z = grid[JDIR].x;
-  rL = grid[IDIR].xl;
-  rR = grid[IDIR].xr;
-  zL = grid[JDIR].xl;
-  zR = grid[JDIR].xr;
-
-  // I compose the grid-related part once forever (in static variables) and only update eta
+  // The grid-related part is composed once forever (and shared with BuildIJ_Res()), I only update kappa
+  geo = GetOperatorGeometry(grid);
   if (first_call) {
-    // Name shorthands
-    ArR = grid[IDIR].A;
-    ArL = grid[IDIR].A - 1;
-    dVr = grid[IDIR].dV;
-    dVz = grid[JDIR].dV;
-    inv_dzi = grid[JDIR].inv_dxi;
-    inv_dri = grid[IDIR].inv_dxi;
-
-    /*Allocatin of memory for the proto variables*/
-    protoIp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoIm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoJp = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoJm = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoCI = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-    protoCJ = ARRAY_2D(NX2_TOT, NX1_TOT, double);
-
     /*[Opt] This is probably useless, it is here just for debugging purposes*/
-    TOT_LOOP(k, j, i) {
-      protoIp[j][i] = 0.0;
-      protoIm[j][i] = 0.0;
-      protoJp[j][i] = 0.0;
-      protoJm[j][i] = 0.0;
-      protoCI[j][i] = 0.0;
-      protoCJ[j][i] = 0.0;
-      dEdT[j][i] = 0.0;
-    }
-    KDOM_LOOP(k) {
-      LINES_LOOP(lines[IDIR], l, j, i) {
-        /* :::: Ip :::: */
-        protoIp[j][i] = ArR[i]*inv_dri[i];
-        /* [Opt] Here I could use the already computed k to compute
-        also Im[1,i+1] (since it needs k at the same interface).
-        Doing so I would reduce the calls to TC_kappa by almost a factor 1/2
-        (obviously I could do the same for Im/Ip) */
-        /* :::: Im :::: */
-        protoIm[j][i] = ArL[i]*inv_dri[i-1]; // forse allora Im[j][i] = Ip[j][i-1] ??
-        /* :::: Jp :::: */
-        protoJp[j][i] = inv_dzi[j];
-        /* :::: Jm :::: */
-        protoJm[j][i] = inv_dzi[j-1];
-        /* :::: CI :::: */
-        protoCI[j][i] = dVr[i];
-        /* :::: CJ :::: */
-        protoCJ[j][i] = dVz[j];
-      }
-    }
+    TOT_LOOP(k, j, i) dEdT[j][i] = 0.0;
     first_call = 0;
   }
 
 
+  /* I compute kappa once per cell (on the lines and on their ghosts) and then I take
+     the harmonic averages at the interfaces, instead of calling TC_kappa() for both the
+     neighbours of every interface.
+     kappa is allocated at every call (not static), as the helper thread of adi_async.c
+     may build the operators at the same time as the main thread */
+  kappa = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  BuildKappaCells(d, grid, lines, kappa);
+
   KDOM_LOOP(k) {
 
     /* :::: Ip and Im :::: */
-    Nlines = lines[IDIR].N;
-    for (l = 0; l<Nlines; l++) {
-      j = lines->dom_line_idx[l];
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
       lidx = lines[IDIR].lidx[l];
       ridx = lines[IDIR].ridx[l];
-
-      /* :::: Im on i=lidx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][lidx]; // [Err] no, you should use armonic average of kappa
-      TC_kappa( v, r[lidx], z[j], theta[k], &kpar, &knor, &phi);
-
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][lidx-1];
-      TC_kappa( v, r[lidx-1], z[j], theta[k], &kpar, &knor2, &phi);
-
-      knor = 2/(1/knor + 1/knor2);
-      Im[j][lidx] = knor*protoIm[j][lidx];
-
-      /* :::: Ip and Im for internal (non boundary) interfaces :::: */
-      for (i=lidx; i<ridx; i++) {
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j][i];  // [Err] no, you should use armonic average of kappa
-        TC_kappa( v, r[i], z[j], theta[k], &kpar, &knor, &phi);
-
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j][i+1];
-        TC_kappa( v, r[i+1], z[j], theta[k], &kpar, &knor2, &phi);
-        
-        knor = 2/(1/knor + 1/knor2);
-        Ip[j][i] = knor*protoIp[j][i];
-        Im[j][i+1] = knor*protoIm[j][i+1];
+      // Interface between i and i+1 (the first one is the left boundary, the last one the right boundary)
+      for (i = lidx-1; i <= ridx; i++) {
+        knor = 2/(1/kappa[j][i] + 1/kappa[j][i+1]);
+        if (i >= lidx) Ip[j][i] = knor*geo->tc_Ip[i];
+        if (i < ridx)  Im[j][i+1] = knor*geo->tc_Im[i+1];
       }
-
-      /* :::: Ip on i=ridx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][ridx];
-      TC_kappa( v, r[ridx], z[j], theta[k], &kpar, &knor, &phi);  // [Err] no, you should use armonic average of kappa
-      
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][ridx+1];
-      TC_kappa( v, r[ridx+1], z[j], theta[k], &kpar, &knor2, &phi);
-      
-      knor = 2/(1/knor + 1/knor2);
-      Ip[j][ridx] = knor*protoIp[j][ridx];
     }
 
     /* :::: Jp and Jm :::: */
-    Nlines = lines[JDIR].N;
-    for (l = 0; l<Nlines; l++) {
+    for (l = 0; l < lines[JDIR].N; l++) {
       i = lines[JDIR].dom_line_idx[l];
       lidx = lines[JDIR].lidx[l];
       ridx = lines[JDIR].ridx[l];
-
-      /* :::: Jm on j=lidx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][lidx][i];  // [Err] no, you should use armonic average of kappa
-      TC_kappa( v, r[i], z[lidx], theta[k], &kpar, &knor, &phi);
-      
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][lidx-1][i];
-      TC_kappa( v, r[i], z[lidx-1], theta[k], &kpar, &knor2, &phi);
-      
-      knor = 2/(1/knor + 1/knor2);
-      Jm[lidx][i] = knor*protoJm[lidx][i];
-
-      /* :::: Jp and Jm for internal (non boundary) interfaces :::: */
-      for (j=lidx; j<ridx; j++) {
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j][i];  // [Err] no, you should use armonic average of kappa
-        TC_kappa( v, r[i], z[j], theta[k], &kpar, &knor, &phi);
-        
-        for (nv=0; nv<NVAR; nv++)
-          v[nv] = Vc[nv][k][j+1][i];  // [Err] no, you should use armonic average of kappa
-        TC_kappa( v, r[i], z[j+1], theta[k], &kpar, &knor2, &phi);
-        
-        knor = 2/(1/knor + 1/knor2);
-        Jp[j][i] = knor*protoJp[j][i];
-        Jm[j+1][i] = knor*protoJm[j+1][i]; 
+      // Interface between j and j+1
+      for (j = lidx-1; j <= ridx; j++) {
+        knor = 2/(1/kappa[j][i] + 1/kappa[j+1][i]);
+        if (j >= lidx) Jp[j][i] = knor*geo->tc_Jp[j];
+        if (j < ridx)  Jm[j+1][i] = knor*geo->tc_Jm[j+1];
       }
-
-      /* :::: Jp on j=ridx :::: */
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][ridx][i];  // [Err] no, you should use armonic average of kappa
-      TC_kappa( v, r[i], z[ridx], theta[k], &kpar, &knor, &phi);
-      
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][ridx+1][i];  // [Err] no, you should use armonic average of kappa
-      TC_kappa( v, r[i], z[ridx+1], theta[k], &kpar, &knor2, &phi);
-      
-      knor = 2/(1/knor + 1/knor2);
-      Jp[ridx][i] = knor*protoJp[ridx][i];
     }
 
     // I separate the computation of CI and CJ just to improve code readability,
     // I could also inglobate them in the previous cycles
-    LINES_LOOP(lines[IDIR], l, j, i) {
-      for (nv=0; nv<NVAR; nv++)
-        v[nv] = Vc[nv][k][j][i];
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      lidx = lines[IDIR].lidx[l];
+      ridx = lines[IDIR].ridx[l];
       #ifdef TEST_ADI
-        HeatCapacity_test(v, r[i], z[j], theta[k], &(dEdT[j][i]) );
-      #else
-        if (GetPV_Temperature(v, &(T) )!=0) {
-          #if WARN_ERR_COMP_TEMP
-            print1("\nTC_kappa:[Ema]Err.comp.temp");
-          #endif
+        for (i = lidx; i <= ridx; i++) {
+          for (nv=0; nv<NVAR; nv++)
+            v[nv] = Vc[nv][k][j][i];
+          HeatCapacity_test(v, grid[IDIR].x[i], grid[JDIR].x[j], grid[KDIR].x[k], &(dEdT[j][i]) );
         }
-        HeatCapacity(v, T, &(dEdT[j][i]) );
+      #else
+        row = CellHeatCapacityRow(d, k, j, lidx, ridx);
+        for (i = lidx; i <= ridx; i++) dEdT[j][i] = row[i];
       #endif
-      /* :::: CI :::: */
-      CI[j][i] = dEdT[j][i]*protoCI[j][i];  
-      /* :::: CJ :::: */
-      CJ[j][i] = dEdT[j][i]*protoCJ[j][i];
+      // I keep these out of the loop above (which calls the EOS), so they are vectorized
+      /* :::: CI and CJ (1/C) :::: */
+      InvCapacityRow(FIELD_ROW(CI, j), FIELD_ROW(CJ, j), FIELD_ROW(dEdT, j), geo->tc_CI,
+                     geo->tc_CJ[j], lidx, ridx);
     }
 
   #ifdef DEBUG_BUILDIJ
@@ -229,6 +130,34 @@ void BuildIJ_TC(const Data *d, Grid *grid, Lines *lines,
     printmat(CJ, NX2_TOT, NX1_TOT);
   #endif
   }
+  FreeArray2D((void *) kappa);
+}
+
+/****************************************************************************
+Gets the thermal conductivity (knor of TC_kappa()) of the cells of the lines
+and of the ghosts next to them (from the cell state cache, see cell_state.c)
+*****************************************************************************/
+static void BuildKappaCells(const Data *d, Grid *grid, Lines *lines, double **kappa) {
+  int i,j,k,l,side;
+  const double *row;
+
+  KDOM_LOOP(k) {
+    /* The cells of the JDIR lines are the same of the IDIR lines, only their ghosts differ.
+       The IDIR lines (with their ghosts) are done at once by CellKappaRow() */
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      row = CellKappaRow(d, grid, k, j, lines[IDIR].lidx[l]-1, lines[IDIR].ridx[l]+1);
+      for (i = lines[IDIR].lidx[l]-1; i <= lines[IDIR].ridx[l]+1; i++)
+        kappa[j][i] = row[i];
+    }
+    for (l = 0; l < lines[JDIR].N; l++) {
+      i = lines[JDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        j = side ? lines[JDIR].ridx[l]+1 : lines[JDIR].lidx[l]-1;
+        kappa[j][i] = CellKappa(d, grid, k, j, i);
+      }
+    }
+  }
 }
 
 /**************************************************************************
@@ -330,4 +259,52 @@ void BoundaryADI_TC(Lines lines[2], const Data *d, Grid *grid, double t, int dir
   }
 }
 
-#endif
\ No newline at end of file
+#if RAD_LOSS_ADI
+/****************************************************************************
+Linearizes the optically thin radiative loss rate Q(rho,T) (tabulated, see
+MakeRadiativeLossTable()) around T_lin, as a source and a sink for the temperature equation
+(T_lin, as the T of the ADI, is in code units, T/KELVIN, while the table wants Kelvin):
+  dT/dt = ... - Q(T)/dEdT  ~=  ... + source - sink*T
+with sink = max(dQ/dT, Q(T_lin)/T_lin)/dEdT and source = (sink*T_lin - Q(T_lin)/dEdT).
+Using at least Q/T_lin as coefficient of the implicit part makes source>=0, so that
+the backward Euler update of T cannot become negative (and also the part of the
+cooling curve with dQ/dT<0 stays implicit).
+*****************************************************************************/
+void BuildRadLossTC(const Data *d, Lines *lines, double **T_lin, double **dEdT,
+                    double **source, double **sink) {
+  static int rad_tab_not_done = 1;
+  int i,j,k,l;
+  double rho, T_K, Q, Qp, Qm, dQdT, a;
+  double const unit_loss = UNIT_DENSITY*UNIT_VELOCITY*UNIT_VELOCITY*UNIT_VELOCITY/UNIT_LENGTH;
+  double const eps = 1.e-3;
+
+  if (rad_tab_not_done) {
+    MakeRadiativeLossTable();
+    rad_tab_not_done = 0;
+  }
+
+  KDOM_LOOP(k) {
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      rho = d->Vc[RHO][k][j][i]*UNIT_DENSITY;
+      T_K = T_lin[j][i]*KELVIN;
+      if (GetRadiativeLossFromTable(rho, T_K, &Q) != 0 ||
+          GetRadiativeLossFromTable(rho, T_K*(1+eps), &Qp) != 0 ||
+          GetRadiativeLossFromTable(rho, T_K*(1-eps), &Qm) != 0) {
+        print1("[BuildRadLossTC] Error getting the radiative loss from table\n");
+        print1("rho=%g, T=%g K", rho, T_K);
+        QUIT_PLUTO(1);
+      }
+      /* Loss rate and its derivative in code units: dQdT is per code unit of T (as dEdT),
+         the relative increment eps being the same for T_K and T_lin */
+      Q /= unit_loss;
+      dQdT = (Qp-Qm)/(2*eps*T_lin[j][i])/unit_loss;
+
+      a = MAX(dQdT, Q/T_lin[j][i]);
+      sink[j][i] = a/dEdT[j][i];
+      source[j][i] = (a*T_lin[j][i] - Q)/dEdT[j][i];
+    }
+  }
+}
+#endif
+
+#endif
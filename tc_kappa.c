@@ -2,21 +2,50 @@
 #include "gamma_transp.h"
 #include "current_table.h"
 #include "transport_tables.h"
+#include "gamma_transp_vec.h"
 #include "capillary_wall.h"
+#include "tc_kappa.h"
 
 #define KAPPAMAX 1e7
 #define KAPPA_LOW 1e3
 #define RHO_LOW (2.5e-9) 
+// Cells done at once by TC_kappaLine() (size of its scratch arrays)
+#define TC_LINE_CHUNK 256
+
+#if KAPPA_TABLE
+  static int tc_tab_not_done = 1;
+#elif DD_VEC_BENCHMARK
+  static int dd_bench_not_done = 1;
+#endif
+static void KappaLineUnits(double *restrict kappa, int n);
 
 void TC_kappa(double *v, double x1, double x2, double x3,
               double *kpar, double *knor, double *phi)
 {
-  #if KAPPA_TABLE
-  static int tc_tab_not_done = 1;
-  #else
+  double T=0.0;
+
+  if (g_inputParam[KAPPA_GAU] <= 0.0) {
+    if (GetPV_Temperature(v, &(T) )!=0) {
+      #if WARN_ERR_COMP_TEMP
+        print1("\nTC_kappa:[Ema]Err.comp.temp");
+      #endif
+    }
+  }
+  TC_kappaFromT(v, T, CapRegionOfPoint(x1, x2), x1, x2, x3, kpar, knor, phi);
+}
+
+/****************************************************************************
+Same as TC_kappa(), but the temperature T (Kelvin) is given, instead of being
+computed from v (only v[RHO] is used), e.g. when kappa has to be evaluated at
+a trial temperature. region is that of the cell (see GetCapRegionMap()), x1, x2, x3
+are used only in the error messages
+*****************************************************************************/
+void TC_kappaFromT(double *v, double T, unsigned char region, double x1, double x2, double x3,
+                   double *kpar, double *knor, double *phi)
+{
+  #if !KAPPA_TABLE
   double mu=0.0, z=0.0;
   #endif
-  double T=0.0;
   double k=0.0;
   // double unit_Mfield;
 
@@ -26,11 +55,6 @@ void TC_kappa(double *v, double x1, double x2, double x3,
     *knor = g_inputParam[KAPPA_GAU];
 
   } else {
-    if (GetPV_Temperature(v, &(T) )!=0) {
-      #if WARN_ERR_COMP_TEMP
-        print1("\nTC_kappa:[Ema]Err.comp.temp");
-      #endif
-    }
     #if KAPPA_TABLE
       if (tc_tab_not_done) {
         MakeThermConductivityTable();
@@ -69,7 +93,7 @@ void TC_kappa(double *v, double x1, double x2, double x3,
     #ifdef CONE_LOW_TCKAPPA
       // Experimental: the smaller rho is, the smaller k is, with direct proportionality,
       // k=alpha*rho (if rho=RHO_LOW, then k=KAPPA_LOW)
-      if (IsOutCone(CONE_LOW_TCKAPPA, x1, x2) && v[RHO]*UNIT_DENSITY < RHO_LOW)
+      if ((region & CAP_REGION_LOW_KAPPA) && v[RHO]*UNIT_DENSITY < RHO_LOW)
         k = v[RHO]*UNIT_DENSITY*KAPPA_LOW/RHO_LOW;
     #endif
 
@@ -105,3 +129,115 @@ void TC_kappa(double *v, double x1, double x2, double x3,
   }
 
 }
+
+/****************************************************************************
+Line version of TC_kappaFromT(): gives knor (code units) of n cells, e.g. those of a
+line, from the arrays (SoA) of their density rho (code units) and temperature T (Kelvin).
+region[m] is the region of the cell (see GetCapRegionMap()), it is read only if
+CONE_LOW_TCKAPPA is defined (otherwise it can be NULL).
+The checks that TC_kappaFromT() does for every cell (fixed kappa, table to be made)
+are done once, the table is interpolated by GetThermConductivityFromTableBatch() and
+the other loops on the cells are vectorizable.
+*****************************************************************************/
+void TC_kappaLine(const double *restrict rho, const double *restrict T,
+                  const unsigned char *restrict region, double *restrict kappa, int n)
+{
+  int m, m0, nc;
+  double rho_cgs[TC_LINE_CHUNK];
+  #if !KAPPA_TABLE
+    double z[TC_LINE_CHUNK], kT[TC_LINE_CHUNK];
+  #endif
+
+  if (g_inputParam[KAPPA_GAU] > 0.0) {
+    // Fixed value from pluto.ini
+    for (m = 0; m < n; m++) kappa[m] = g_inputParam[KAPPA_GAU];
+    KappaLineUnits(kappa, n);
+    return;
+  }
+
+  #if KAPPA_TABLE
+    if (tc_tab_not_done) {
+      MakeThermConductivityTable();
+      tc_tab_not_done = 0;
+    }
+    for (m0 = 0; m0 < n; m0 += TC_LINE_CHUNK) {
+      nc = MIN(TC_LINE_CHUNK, n - m0);
+      for (m = 0; m < nc; m++) rho_cgs[m] = rho[m0 + m]*UNIT_DENSITY;
+      if (GetThermConductivityFromTableBatch(rho_cgs, T + m0, kappa + m0, nc) != 0) {
+        // I look for the first cell out of the table, to tell it as TC_kappa()
+        for (m = 0; m < nc; m++) {
+          if (GetThermConductivityFromTable(rho_cgs[m], T[m0 + m], kappa + m0 + m) != 0) {
+            print1("[TC_kappaLine] Error getting kappa from table\n");
+            print1("cell %d of %d of the line\n", m0 + m, n);
+            print1("rho=%g, T=%g", rho_cgs[m], T[m0 + m]);
+            QUIT_PLUTO(1);
+          }
+        }
+      }
+    }
+  #else
+    #if DD_VEC_BENCHMARK
+      if (dd_bench_not_done) {
+        BenchmarkDDBatch();
+        dd_bench_not_done = 0;
+      }
+    #endif
+    // As TC_kappaFromT(), with the batch (vectorized) formulas of gamma_transp_vec.c
+    for (m0 = 0; m0 < n; m0 += TC_LINE_CHUNK) {
+      nc = MIN(TC_LINE_CHUNK, n - m0);
+      IonizDDBatch(T + m0, rho + m0, z, nc);
+      for (m = 0; m < nc; m++) {
+        rho_cgs[m] = rho[m0 + m]*UNIT_DENSITY;
+        kT[m] = T[m0 + m]*CONST_kB;
+      }
+      thermCond_norm_DD_Batch(z, rho_cgs, kT, kappa + m0, nc);
+      // See the comment in TC_kappaFromT() about the 8e4
+      for (m = 0; m < nc; m++) kappa[m0 + m] += 8e4;
+    }
+  #endif
+
+  TC_kappaLineFinish(rho, region, kappa, n);
+}
+
+/****************************************************************************
+Applies to the thermal conductivity kappa (cgs) of n cells, as given by the table or
+by the DD formulas, the limiters of TC_kappaFromT() and the adimensionalization, as
+TC_kappaLine() does (e.g. to kappa interpolated from the multi-field table, see
+cell_state.c). rho and region as in TC_kappaLine()
+*****************************************************************************/
+void TC_kappaLineFinish(const double *restrict rho, const unsigned char *restrict region,
+                        double *restrict kappa, int n)
+{
+  int m;
+
+  #ifdef KAPPAMAX
+    for (m = 0; m < n; m++)
+      if (kappa[m] > KAPPAMAX) kappa[m] = KAPPAMAX;
+  #endif
+
+  #ifdef CONE_LOW_TCKAPPA
+    for (m = 0; m < n; m++)
+      if ((region[m] & CAP_REGION_LOW_KAPPA) && rho[m]*UNIT_DENSITY < RHO_LOW)
+        kappa[m] = rho[m]*UNIT_DENSITY*KAPPA_LOW/RHO_LOW;
+  #endif
+
+  KappaLineUnits(kappa, n);
+}
+
+/****************************************************************************
+Adimensionalization of n values of kappa (cgs), as in TC_kappaFromT()
+*****************************************************************************/
+static void KappaLineUnits(double *restrict kappa, int n)
+{
+  int m;
+  double kmax = 0.0;
+
+  for (m = 0; m < n; m++) {
+    kappa[m] /= UNIT_KAPPA;
+    kmax = MAX(kmax, kappa[m]);
+  }
+  if (kmax>1e15) {
+      print1("\nDid you take the wrong convention for kappa?\n");
+      QUIT_PLUTO(1);
+  }
+}
@@ -0,0 +1,11 @@
+#ifndef TC_KAPPA_H
+#define TC_KAPPA_H
+
+void TC_kappaFromT(double *v, double T, unsigned char region, double x1, double x2, double x3,
+                   double *kpar, double *knor, double *phi);
+void TC_kappaLine(const double *restrict rho, const double *restrict T,
+                  const unsigned char *restrict region, double *restrict kappa, int n);
+void TC_kappaLineFinish(const double *restrict rho, const unsigned char *restrict region,
+                        double *restrict kappa, int n);
+
+#endif
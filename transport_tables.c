@@ -1,5 +1,17 @@
 #include "pluto.h"
 #include "table_utilities.h"
+#include "transport_tables.h"
+#include "log_table.h"
+#include "devoto_transport.h"
+#if TRANSPORT_TAB_ADAPTIVE
+  #include "adaptive_table.h"
+#endif
+#if TRANSPORT_TAB_ACCURACY
+  #include "gamma_transp.h"
+#endif
+#if MULTI_FIELD_TABLE
+  #include "pvte_law_heat_capacity.h"
+#endif
 
 #define REPRINT_ETA_TAB YES
 #define REPRINT_KAPPA_TAB YES
@@ -7,6 +19,19 @@
 #define KAPPA_TAB_SCRIPT "transport_tables_scripts/KappaTable_4pluto.py"
 #define ETA_TAB_FILE_NAME "eta.dat"
 #define KAPPA_TAB_FILE_NAME "kappa.dat"
+#define RAD_LOSS_TAB_FILE_NAME "rad_loss.dat"
+#define ETA_TAB_CACHE_NAME "eta_tab.bin"
+#define KAPPA_TAB_CACHE_NAME "kappa_tab.bin"
+
+#if TRANSPORT_TAB_CACHE && !TRANSPORT_TAB_NATIVE
+  /* Modules used by the scripts: their content is part of the key of the cache as that of
+     the scripts themselves, so that editing them makes the tables again */
+  static const char *tab_script_deps[] = {"transport_tables_scripts/PlasmaPar_asDevoto.py",
+                                          "transport_tables_scripts/ionization.py",
+                                          "transport_tables_scripts/constantsGAU_ema.py",
+                                          "transport_tables_scripts/write_ascii_transport_table.py"};
+  #define N_TAB_SCRIPT_DEPS (sizeof(tab_script_deps)/sizeof(tab_script_deps[0]))
+#endif
 
 static Table2D eta_tab; /*    A 2D table containing pre-computed values of 
                               electr. resistivity stored at equally spaced node 
@@ -14,6 +39,47 @@ static Table2D eta_tab; /*    A 2D table containing pre-computed values of
 static Table2D kappa_tab; /*    A 2D table containing pre-computed values of 
                               therm. conductivity stored at equally spaced node 
                               values of Log(T) and Log(rho) .*/
+static Table2D rad_loss_tab; /* A 2D table containing pre-computed values of the
+                              optically thin radiative loss rate (erg/(cm^3 s))
+                              stored at equally spaced node values of Log(T) and Log(rho) .*/
+#if TRANSPORT_TAB_ACCURACY
+  static void ReportTableAccuracy(const char *name, double (*f_exact)(double, double),
+                                  double T_min, double T_max, int N_T,
+                                  double rho_min, double rho_max, int N_rho);
+  static double ExactElecResistivity(double rho, double T);
+  static double ExactThermConductivity(double rho, double T);
+#endif
+static int ReadScriptTable(const char *script, int quantity, const char *table_finame,
+                           const char *cache_finame, int make_file, int *logspacing,
+                           double *T_min, double *T_max, int *N_T,
+                           double *rho_min, double *rho_max, int *N_rho, double ***f);
+#if TRANSPORT_TAB_CURV_NODES
+  // Samples of PlaceCurvatureNodes(): along log10(T), and lines of rho
+  #define CURV_PILOT_N_T   401
+  #define CURV_PILOT_N_RHO 13
+  static double *curv_T_nodes = NULL;  // T nodes of both tables, made once
+  static void PlaceCurvatureNodes(double T_min, double T_max, int N_T,
+                                  double rho_min, double rho_max, double *T_nodes);
+  static int MakeCurvNodesTable(int quantity, int *logspacing,
+                                double *T_min, double *T_max, int *N_T,
+                                double *rho_min, double *rho_max, int *N_rho, double ***f);
+#endif
+#if LOG_TABLE_LOOKUP
+  // The same tables, for the lookup specialized to their nodes (log_table.h)
+  static LogTable eta_lt, kappa_lt, rad_loss_lt;
+#endif
+#if TRANSPORT_TAB_ADAPTIVE
+  // Refined and extended on demand from the native formulas (adaptive_table.h)
+  static AdaptiveTable eta_at, kappa_at;
+  static double NativeElecResistivity(double T, double rho);
+  static double NativeThermConductivity(double T, double rho);
+#endif
+// The tables can be asked by more modules (e.g. tc_kappa.c and MakeMultiFieldTable()), they are made once
+static int eta_tab_made = 0, kappa_tab_made = 0;
+#if MULTI_FIELD_TABLE
+  // eta, kappa, dE/dT and mu interleaved (fields MF_*), see MakeMultiFieldTable()
+  static MultiLogTable mf_lt;
+#endif
 
 /*****************************************************************************/
 /* Function to build a table of electrical resistivity using a python script*/
@@ -23,23 +89,21 @@ void MakeElecResistivityTable() {
   double rho_min, rho_max, T_min, T_max;
   int N_rho, N_T;
   char table_finame[30] = ETA_TAB_FILE_NAME;
-  char command[300];
   // char options[100] = " 800.0 30000.0 6 2.5e-11 2.7e-5 4";
   double **f;
   int logspacing;
+  int generated;
 
-  #if MAKE_ETA_TAB_FILE
-    sprintf(command, "python3 %s %e %e %d %e %e %d %s", ETA_TAB_SCRIPT,
-            (double)(T_TAB_MIN), (double)(T_TAB_MAX), (int) N_TAB_T,
-            (double)(RHO_TAB_MIN), (double)(RHO_TAB_MAX), (int)(N_TAB_RHO),
-            table_finame);
-    system(command);
+  if (eta_tab_made) return;
+  // I get the table (made by the script, or from its cache)
+  #if TRANSPORT_TAB_CURV_NODES
+    generated = MakeCurvNodesTable(DEVOTO_ETA, &logspacing,
+                                   &T_min, &T_max, &N_T, &rho_min, &rho_max, &N_rho, &f);
+  #else
+    generated = ReadScriptTable(ETA_TAB_SCRIPT, DEVOTO_ETA, table_finame, ETA_TAB_CACHE_NAME,
+                                MAKE_ETA_TAB_FILE, &logspacing,
+                                &T_min, &T_max, &N_T, &rho_min, &rho_max, &N_rho, &f);
   #endif
-
-  // Now I read the just made table
-  ReadASCIITableSettings(table_finame, &logspacing,
-                         &T_min, &T_max, &N_T, 
-                         &rho_min, &rho_max, &N_rho);
   if (logspacing!=10) {
     print1("\n> MakeElecResistivityTable(): Error! Only logspacing 10 is supported!");
     QUIT_PLUTO(1);
@@ -50,32 +114,252 @@ void MakeElecResistivityTable() {
   InitializeTable2D(&eta_tab,
                     T_min, T_max, N_T, 
                     rho_min, rho_max, N_rho);
-  
-  f = ARRAY_2D(N_rho, N_T, double);
-  ReadASCIITableMatrix(table_finame, f, N_T, N_rho);
 
   for (j = 0; j < eta_tab.ny; j++)
     for (i = 0; i < eta_tab.nx; i++)
       eta_tab.f[j][i] = f[j][i];
+  #if TRANSPORT_TAB_CURV_NODES
+    // [Rob] Table2DInterpolate() would assume them uniform (LOG_TABLE_LOOKUP is required)
+    for (i = 0; i < eta_tab.nx; i++) {
+      eta_tab.x[i] = curv_T_nodes[i];
+      eta_tab.lnx[i] = log10(curv_T_nodes[i]);
+    }
+  #endif
   
   eta_tab.interpolation = LINEAR;
 
   FinalizeTable2D(&eta_tab);
+  #if LOG_TABLE_LOOKUP
+    MakeLogTable(&eta_lt, &eta_tab, "eta", ETA_TAB_INTERP);
+  #endif
+  #if TRANSPORT_TAB_ADAPTIVE
+    // On the range of the uniform table, which is still made (files, cache, multi-field table)
+    MakeAdaptiveTable(&eta_at, NativeElecResistivity, "eta", T_min, T_max, rho_min, rho_max);
+  #endif
 
   #if REPRINT_ETA_TAB
-    ReprintTable(&eta_tab, table_finame);
+    // Only when the table is new (the cached one was already printed when it was made)
+    if (generated) ReprintTable(&eta_tab, table_finame);
+  #endif
+  #if TRANSPORT_TAB_ACCURACY
+    ReportTableAccuracy("eta", ExactElecResistivity, T_min, T_max, N_T, rho_min, rho_max, N_rho);
   #endif
 
   FreeArray2D((void *)f);
+  eta_tab_made = 1;
+}
+
+/*****************************************************************************/
+/* Function to get the matrix f[rho][T] of a table made by a python script:  */
+/* from its binary cache (TRANSPORT_TAB_CACHE), if that was made by the same */
+/* command (same ranges and number of nodes) and the same scripts; otherwise */
+/* running the script (if make_file) and reading the ascii table, which is  */
+/* then cached. With TRANSPORT_TAB_NATIVE the table (quantity DEVOTO_ETA or */
+/* DEVOTO_KAPPA) is made in C instead, and the ascii file written from it.  */
+/* Returns 0 if the table comes from the cache, 1 otherwise                 */
+/*****************************************************************************/
+static int ReadScriptTable(const char *script, int quantity, const char *table_finame,
+                           const char *cache_finame, int make_file, int *logspacing,
+                           double *T_min, double *T_max, int *N_T,
+                           double *rho_min, double *rho_max, int *N_rho, double ***f) {
+  char command[300], settings[200];
+  #if TRANSPORT_TAB_CACHE
+    unsigned long long hash;
+  #endif
+  #if TRANSPORT_TAB_CACHE && !TRANSPORT_TAB_NATIVE
+    size_t n;
+  #endif
+
+  // The settings as passed to the script (so that the native table has the same nodes)
+  sprintf(settings, "%e %e %d %e %e %d",
+          (double)(T_TAB_MIN), (double)(T_TAB_MAX), (int) N_TAB_T,
+          (double)(RHO_TAB_MIN), (double)(RHO_TAB_MAX), (int)(N_TAB_RHO));
+  #if TRANSPORT_TAB_NATIVE
+    sprintf(command, "native Devoto v%d %d %s %s", DEVOTO_TAB_VERSION, quantity,
+            settings, table_finame);
+  #else
+    sprintf(command, "python3 %s %s %s", script, settings, table_finame);
+  #endif
+
+  #if TRANSPORT_TAB_CACHE
+    if (make_file) {
+      hash = HashBytes(command, strlen(command), TABLE_HASH_SEED);
+      #if !TRANSPORT_TAB_NATIVE
+        hash = HashFile(script, hash);
+        for (n = 0; n < N_TAB_SCRIPT_DEPS; n++) hash = HashFile(tab_script_deps[n], hash);
+      #endif
+      if (ReadBinaryTable(cache_finame, hash, logspacing, T_min, T_max, N_T,
+                          rho_min, rho_max, N_rho, f) == 0) {
+        print1("\n> ReadScriptTable(): table read from the cache %s", cache_finame);
+        return 0;
+      }
+    }
+  #endif
+
+  #if TRANSPORT_TAB_NATIVE
+    if (make_file) {
+      *logspacing = 10;
+      sscanf(settings, "%lf %lf %d %lf %lf %d", T_min, T_max, N_T, rho_min, rho_max, N_rho);
+      *f = ARRAY_2D(*N_rho, *N_T, double);
+      MakeDevotoTable(quantity, *T_min, *T_max, *N_T,
+                      *rho_min, *rho_max, *N_rho, *f);
+      print1("\n> ReadScriptTable(): table made by MakeDevotoTable() (devoto_transport.c)");
+      // The ascii file is still written (e.g. to be used with MAKE_*_TAB_FILE NO)
+      if (prank == 0) WriteASCIITable(table_finame, *logspacing, *T_min, *T_max, *N_T,
+                                      *rho_min, *rho_max, *N_rho, *f);
+      #if TRANSPORT_TAB_CACHE
+        if (prank == 0)
+          WriteBinaryTable(cache_finame, hash, *logspacing, *T_min, *T_max, *N_T,
+                           *rho_min, *rho_max, *N_rho, *f);
+      #endif
+      return 1;
+    }
+  #endif
+
+  if (make_file) system(command);
+
+  // Now I read the just made table
+  ReadASCIITableSettings(table_finame, logspacing,
+                         T_min, T_max, N_T,
+                         rho_min, rho_max, N_rho);
+  *f = ARRAY_2D(*N_rho, *N_T, double);
+  ReadASCIITableMatrix(table_finame, *f, *N_T, *N_rho);
+
+  #if TRANSPORT_TAB_CACHE
+    // [Rob] Every rank has run the script (as before), only the first one writes the cache
+    if (make_file && prank == 0)
+      WriteBinaryTable(cache_finame, hash, *logspacing, *T_min, *T_max, *N_T,
+                       *rho_min, *rho_max, *N_rho, *f);
+  #endif
+  return 1;
+}
+
+#if TRANSPORT_TAB_CURV_NODES
+/*****************************************************************************/
+/* Function to make a table (quantity DEVOTO_ETA or DEVOTO_KAPPA) by the    */
+/* native formulas, with the T nodes of PlaceCurvatureNodes() (made at the  */
+/* first call) and the rho nodes uniform in log10, on the ranges and with   */
+/* the number of nodes of definitions.h. Returns 1 (as ReadScriptTable()    */
+/* for a new table)                                                          */
+/*****************************************************************************/
+static int MakeCurvNodesTable(int quantity, int *logspacing,
+                              double *T_min, double *T_max, int *N_T,
+                              double *rho_min, double *rho_max, int *N_rho, double ***f) {
+  int j;
+  double *rho, lr0, lr1;
+
+  *logspacing = 10;
+  *T_min = T_TAB_MIN;
+  *T_max = T_TAB_MAX;
+  *N_T = N_TAB_T;
+  *rho_min = RHO_TAB_MIN;
+  *rho_max = RHO_TAB_MAX;
+  *N_rho = N_TAB_RHO;
+
+  if (curv_T_nodes == NULL) {
+    curv_T_nodes = ARRAY_1D(*N_T, double);
+    PlaceCurvatureNodes(*T_min, *T_max, *N_T, *rho_min, *rho_max, curv_T_nodes);
+  }
+  // As MakeDevotoTable()
+  lr0 = log10(*rho_min);
+  lr1 = log10(*rho_max);
+  rho = ARRAY_1D(*N_rho, double);
+  for (j = 0; j < *N_rho; j++)
+    rho[j] = pow(10.0, j < *N_rho - 1 ? j*((lr1 - lr0)/(*N_rho - 1)) + lr0 : lr1);
+
+  *f = ARRAY_2D(*N_rho, *N_T, double);
+  MakeDevotoTableOnNodes(quantity, curv_T_nodes, *N_T, rho, *N_rho, *f);
+  print1("\n> MakeCurvNodesTable(): table made by MakeDevotoTableOnNodes() (devoto_transport.c)");
+  FreeArray1D((void *)rho);
+  return 1;
 }
 
+/*****************************************************************************/
+/* Function to place N_T nodes of T in T_min..T_max where the tables need    */
+/* them: the second derivative of ln(eta) and ln(kappa) along log10(T) is    */
+/* sampled (CURV_PILOT_N_T x CURV_PILOT_N_RHO points), and the nodes         */
+/* equidistribute the density (1 - a)*sqrt(|f''|)/<sqrt(|f''|)> + a, with    */
+/* a = CURV_NODES_UNIFORM_FRAC: the error of the interpolation between two   */
+/* nodes goes as h^2 |f''|, so it is about the same in all the intervals     */
+/* where the first term dominates (f'' is the max over rho and the two       */
+/* quantities, also over the neighbouring samples, so that a peak between    */
+/* two samples is not missed)                                                */
+/*****************************************************************************/
+static void PlaceCurvatureNodes(double T_min, double T_max, int N_T,
+                                double rho_min, double rho_max, double *T_nodes) {
+  int p, j, q, k;
+  double T[CURV_PILOT_N_T], rho[CURV_PILOT_N_RHO];
+  double curv[CURV_PILOT_N_T], dens[CURV_PILOT_N_T], cum[CURV_PILOT_N_T];
+  double **fs[2];
+  double lT0 = log10(T_min), lT1 = log10(T_max), h, d, mean, c, dl, dl_min, dl_max;
+
+  h = (lT1 - lT0)/(CURV_PILOT_N_T - 1);
+  for (p = 0; p < CURV_PILOT_N_T; p++) T[p] = pow(10.0, lT0 + p*h);
+  for (j = 0; j < CURV_PILOT_N_RHO; j++)
+    rho[j] = rho_min*pow(rho_max/rho_min, (double)j/(CURV_PILOT_N_RHO - 1));
+  for (q = 0; q < 2; q++) {
+    fs[q] = ARRAY_2D(CURV_PILOT_N_RHO, CURV_PILOT_N_T, double);
+    MakeDevotoTableOnNodes(q == 0 ? DEVOTO_ETA : DEVOTO_KAPPA, T, CURV_PILOT_N_T,
+                           rho, CURV_PILOT_N_RHO, fs[q]);
+  }
+
+  // |d^2 ln(f)/d log10(T)^2|, max over rho and quantities
+  for (p = 1; p < CURV_PILOT_N_T - 1; p++) {
+    curv[p] = 0.0;
+    for (q = 0; q < 2; q++)
+      for (j = 0; j < CURV_PILOT_N_RHO; j++) {
+        d = log(fs[q][j][p-1]) - 2.0*log(fs[q][j][p]) + log(fs[q][j][p+1]);
+        curv[p] = MAX(curv[p], fabs(d)/(h*h));
+      }
+  }
+  curv[0] = curv[1];
+  curv[CURV_PILOT_N_T - 1] = curv[CURV_PILOT_N_T - 2];
+
+  mean = 0.0;
+  for (p = 0; p < CURV_PILOT_N_T; p++) {
+    dens[p] = sqrt(MAX(curv[MAX(p - 1, 0)], MAX(curv[p], curv[MIN(p + 1, CURV_PILOT_N_T - 1)])));
+    mean += dens[p]/CURV_PILOT_N_T;
+  }
+  for (p = 0; p < CURV_PILOT_N_T; p++)
+    dens[p] = mean > 0.0 ? (1.0 - CURV_NODES_UNIFORM_FRAC)*dens[p]/mean + CURV_NODES_UNIFORM_FRAC : 1.0;
+
+  // Nodes where the integral of the density (trapezoidal) takes equally spaced values
+  cum[0] = 0.0;
+  for (p = 1; p < CURV_PILOT_N_T; p++) cum[p] = cum[p-1] + 0.5*(dens[p-1] + dens[p]);
+  T_nodes[0] = T_min;
+  for (k = 1, p = 0; k < N_T - 1; k++) {
+    c = cum[CURV_PILOT_N_T - 1]*k/(N_T - 1);
+    while (cum[p + 1] < c) p++;
+    T_nodes[k] = pow(10.0, lT0 + h*(p + (c - cum[p])/(cum[p + 1] - cum[p])));
+  }
+  T_nodes[N_T - 1] = T_max;
+
+  dl_min = dl_max = log10(T_nodes[1]/T_nodes[0]);
+  for (k = 1; k < N_T - 1; k++) {
+    dl = log10(T_nodes[k + 1]/T_nodes[k]);
+    dl_min = MIN(dl_min, dl);
+    dl_max = MAX(dl_max, dl);
+  }
+  print1("\n> PlaceCurvatureNodes(): %d T nodes, spacing of log10(T) from %.2e to %.2e (%.2e if uniform)",
+         N_T, dl_min, dl_max, (lT1 - lT0)/(N_T - 1));
+  FreeArray2D((void **)fs[0]);
+  FreeArray2D((void **)fs[1]);
+}
+#endif
+
 /*************************************************************/
 /* Function to get the Electrical res. from table            */
 /*************************************************************/
 int GetElecResisitivityFromTable(double rho, double T, double *eta) {
   int    status;
 
-  status = Table2DInterpolate(&eta_tab, T, rho, eta);
+  #if TRANSPORT_TAB_ADAPTIVE
+    status = AdaptiveTableInterpolate(&eta_at, T, rho, eta);
+  #elif LOG_TABLE_LOOKUP
+    status = LogTableInterpolate(&eta_lt, T, rho, eta);
+  #else
+    status = Table2DInterpolate(&eta_tab, T, rho, eta);
+  #endif
   if (status != 0){
     return status;
   }
@@ -90,22 +374,20 @@ void MakeThermConductivityTable() {
   double rho_min, rho_max, T_min, T_max;
   int N_rho, N_T;
   char table_finame[30] = KAPPA_TAB_FILE_NAME;
-  char command[300];
   double **f;
   int logspacing;
+  int generated;
 
-  #if MAKE_KAPPA_TAB_FILE
-    sprintf(command, "python3 %s %e %e %d %e %e %d %s", KAPPA_TAB_SCRIPT,
-            (double)(T_TAB_MIN), (double)(T_TAB_MAX), (int) N_TAB_T,
-            (double)(RHO_TAB_MIN), (double)(RHO_TAB_MAX), (int)(N_TAB_RHO),
-            table_finame);
-    system(command);
+  if (kappa_tab_made) return;
+  // I get the table (made by the script, or from its cache)
+  #if TRANSPORT_TAB_CURV_NODES
+    generated = MakeCurvNodesTable(DEVOTO_KAPPA, &logspacing,
+                                   &T_min, &T_max, &N_T, &rho_min, &rho_max, &N_rho, &f);
+  #else
+    generated = ReadScriptTable(KAPPA_TAB_SCRIPT, DEVOTO_KAPPA, table_finame, KAPPA_TAB_CACHE_NAME,
+                                MAKE_KAPPA_TAB_FILE, &logspacing,
+                                &T_min, &T_max, &N_T, &rho_min, &rho_max, &N_rho, &f);
   #endif
-
-  // Now I read the just made table
-  ReadASCIITableSettings(table_finame, &logspacing,
-                         &T_min, &T_max, &N_T, 
-                         &rho_min, &rho_max, &N_rho);
   if (logspacing!=10) {
     print1("\n> MakeThermConductivityTable(): Error! Only logspacing 10 is supported!");
     QUIT_PLUTO(1);
@@ -116,23 +398,39 @@ void MakeThermConductivityTable() {
   InitializeTable2D(&kappa_tab,
                     T_min, T_max, N_T, 
                     rho_min, rho_max, N_rho);
-  
-  f = ARRAY_2D(N_rho, N_T, double);
-  ReadASCIITableMatrix(table_finame, f, N_T, N_rho);
 
   for (j = 0; j < kappa_tab.ny; j++)
     for (i = 0; i < kappa_tab.nx; i++)
       kappa_tab.f[j][i] = f[j][i];
+  #if TRANSPORT_TAB_CURV_NODES
+    // [Rob] Table2DInterpolate() would assume them uniform (LOG_TABLE_LOOKUP is required)
+    for (i = 0; i < kappa_tab.nx; i++) {
+      kappa_tab.x[i] = curv_T_nodes[i];
+      kappa_tab.lnx[i] = log10(curv_T_nodes[i]);
+    }
+  #endif
   
   kappa_tab.interpolation = LINEAR;
 
   FinalizeTable2D(&kappa_tab);
+  #if LOG_TABLE_LOOKUP
+    MakeLogTable(&kappa_lt, &kappa_tab, "kappa", KAPPA_TAB_INTERP);
+  #endif
+  #if TRANSPORT_TAB_ADAPTIVE
+    // On the range of the uniform table, which is still made (files, cache, multi-field table)
+    MakeAdaptiveTable(&kappa_at, NativeThermConductivity, "kappa", T_min, T_max, rho_min, rho_max);
+  #endif
 
   #if REPRINT_ETA_TAB
-    ReprintTable(&kappa_tab, table_finame);
+    // Only when the table is new (the cached one was already printed when it was made)
+    if (generated) ReprintTable(&kappa_tab, table_finame);
+  #endif
+  #if TRANSPORT_TAB_ACCURACY
+    ReportTableAccuracy("kappa", ExactThermConductivity, T_min, T_max, N_T, rho_min, rho_max, N_rho);
   #endif
 
   FreeArray2D((void *)f);
+  kappa_tab_made = 1;
 }
 
 /*************************************************************/
@@ -141,9 +439,266 @@ void MakeThermConductivityTable() {
 int GetThermConductivityFromTable(double rho, double T, double *kappa) {
   int    status;
 
-  status = Table2DInterpolate(&kappa_tab, T, rho, kappa);
+  #if TRANSPORT_TAB_ADAPTIVE
+    status = AdaptiveTableInterpolate(&kappa_at, T, rho, kappa);
+  #elif LOG_TABLE_LOOKUP
+    status = LogTableInterpolate(&kappa_lt, T, rho, kappa);
+  #else
+    status = Table2DInterpolate(&kappa_tab, T, rho, kappa);
+  #endif
+  if (status != 0){
+    return status;
+  }
+  return 0;
+}
+
+/*****************************************************************************/
+/* Function to read the table of optically thin radiative loss rate          */
+/* (no script makes it: the file must already be present, in the same       */
+/* format as the eta and kappa tables, with values in erg/(cm^3 s))          */
+/*****************************************************************************/
+void MakeRadiativeLossTable() {
+  int i,j;
+  double rho_min, rho_max, T_min, T_max;
+  int N_rho, N_T;
+  char table_finame[30] = RAD_LOSS_TAB_FILE_NAME;
+  double **f;
+  int logspacing;
+
+  ReadASCIITableSettings(table_finame, &logspacing,
+                         &T_min, &T_max, &N_T, 
+                         &rho_min, &rho_max, &N_rho);
+  if (logspacing!=10) {
+    print1("\n> MakeRadiativeLossTable(): Error! Only logspacing 10 is supported!");
+    QUIT_PLUTO(1);
+  }
+
+  print1 ("\n> MakeRadiativeLossTable(): Generating table (%d x %d points)",
+           N_T, N_rho);
+  InitializeTable2D(&rad_loss_tab,
+                    T_min, T_max, N_T, 
+                    rho_min, rho_max, N_rho);
+  
+  f = ARRAY_2D(N_rho, N_T, double);
+  ReadASCIITableMatrix(table_finame, f, N_T, N_rho);
+
+  for (j = 0; j < rad_loss_tab.ny; j++)
+    for (i = 0; i < rad_loss_tab.nx; i++)
+      rad_loss_tab.f[j][i] = f[j][i];
+  
+  rad_loss_tab.interpolation = LINEAR;
+
+  FinalizeTable2D(&rad_loss_tab);
+  #if LOG_TABLE_LOOKUP
+    MakeLogTable(&rad_loss_lt, &rad_loss_tab, "rad_loss", LOG_TABLE_LINEAR);
+  #endif
+
+  FreeArray2D((void *)f);
+}
+
+/*************************************************************/
+/* Function to get the radiative loss rate from table        */
+/*************************************************************/
+int GetRadiativeLossFromTable(double rho, double T, double *loss) {
+  int    status;
+
+  #if LOG_TABLE_LOOKUP
+    status = LogTableInterpolate(&rad_loss_lt, T, rho, loss);
+  #else
+    status = Table2DInterpolate(&rad_loss_tab, T, rho, loss);
+  #endif
   if (status != 0){
     return status;
   }
   return 0;
-}
\ No newline at end of file
+}
+
+/*************************************************************/
+/* Functions to get the Electrical res. and the thermal cond. */
+/* from table for n points at once (e.g. the cells of a line) */
+/* Return the number of points out of the table (their value */
+/* is meaningless)                                            */
+/*************************************************************/
+int GetElecResisitivityFromTableBatch(const double *rho, const double *T, double *eta, int n) {
+  #if TRANSPORT_TAB_ADAPTIVE
+    return AdaptiveTableInterpolateBatch(&eta_at, T, rho, eta, n);
+  #elif LOG_TABLE_LOOKUP
+    return LogTableInterpolateBatch(&eta_lt, T, rho, eta, n);
+  #else
+    int m, n_out = 0;
+    for (m = 0; m < n; m++)
+      if (Table2DInterpolate(&eta_tab, T[m], rho[m], eta + m) != 0) n_out++;
+    return n_out;
+  #endif
+}
+
+int GetThermConductivityFromTableBatch(const double *rho, const double *T, double *kappa, int n) {
+  #if TRANSPORT_TAB_ADAPTIVE
+    return AdaptiveTableInterpolateBatch(&kappa_at, T, rho, kappa, n);
+  #elif LOG_TABLE_LOOKUP
+    return LogTableInterpolateBatch(&kappa_lt, T, rho, kappa, n);
+  #else
+    int m, n_out = 0;
+    for (m = 0; m < n; m++)
+      if (Table2DInterpolate(&kappa_tab, T[m], rho[m], kappa + m) != 0) n_out++;
+    return n_out;
+  #endif
+}
+
+#if TRANSPORT_TAB_ADAPTIVE
+/*************************************************************/
+/* Electrical res. and thermal cond. (cgs) of the native     */
+/* tables, at any point (f_exact of the adaptive tables)     */
+/*************************************************************/
+static double NativeElecResistivity(double T, double rho) {
+  return DevotoPoint(DEVOTO_ETA, rho, T);
+}
+
+static double NativeThermConductivity(double T, double rho) {
+  return DevotoPoint(DEVOTO_KAPPA, rho, T);
+}
+#endif
+
+#if MULTI_FIELD_TABLE
+/*****************************************************************************/
+/* Function to build the table of eta, kappa, dE/dT and mu (fields MF_*):    */
+/* eta and kappa are those of their tables (made here if they were not),     */
+/* dE/dT and mu are computed (EOSStateFromT()) on the same nodes             */
+/* [Opt] mu (bounded) is interpolated linearly, dE/dT (its peak spans a      */
+/* decade) in log, eta and kappa as ETA_TAB_INTERP and KAPPA_TAB_INTERP      */
+/*****************************************************************************/
+void MakeMultiFieldTable() {
+  int i, j, nv;
+  int interp[MF_NFIELDS];
+  double v[NVAR];
+  EOSState eos;
+  Table2D dEdT_tab, mu_tab;
+  Table2D *tabs[MF_NFIELDS];
+
+  MakeElecResistivityTable();
+  MakeThermConductivityTable();
+
+  // Only the nodes and the values are used by MakeMultiLogTable() (as in ReportTableAccuracy())
+  dEdT_tab.nx = mu_tab.nx = eta_tab.nx;
+  dEdT_tab.ny = mu_tab.ny = eta_tab.ny;
+  dEdT_tab.x = mu_tab.x = eta_tab.x;
+  dEdT_tab.y = mu_tab.y = eta_tab.y;
+  dEdT_tab.f = ARRAY_2D(eta_tab.ny, eta_tab.nx, double);
+  mu_tab.f = ARRAY_2D(eta_tab.ny, eta_tab.nx, double);
+  for (nv = NVAR; nv--;) v[nv] = 0.0;
+  for (j = 0; j < eta_tab.ny; j++) {
+    v[RHO] = eta_tab.y[j]/UNIT_DENSITY;
+    for (i = 0; i < eta_tab.nx; i++) {
+      EOSStateFromT(v, eta_tab.x[i], &eos);
+      dEdT_tab.f[j][i] = eos.dEdT;
+      mu_tab.f[j][i] = eos.mu;
+    }
+  }
+
+  tabs[MF_ETA] = &eta_tab;     interp[MF_ETA] = ETA_TAB_INTERP;
+  tabs[MF_KAPPA] = &kappa_tab; interp[MF_KAPPA] = KAPPA_TAB_INTERP;
+  tabs[MF_DEDT] = &dEdT_tab;   interp[MF_DEDT] = LOG_TABLE_LOGF;
+  tabs[MF_MU] = &mu_tab;       interp[MF_MU] = LOG_TABLE_LINEAR;
+  MakeMultiLogTable(&mf_lt, tabs, interp, MF_NFIELDS, "eta-kappa-dEdT-mu");
+  FreeArray2D((void **)dEdT_tab.f);
+  FreeArray2D((void **)mu_tab.f);
+  print1("\n> MakeMultiFieldTable(): eta, kappa, dE/dT and mu interleaved (%d x %d points)",
+         mf_lt.nx, mf_lt.ny);
+}
+
+/*************************************************************/
+/* Functions to get eta, kappa, dE/dT and mu (f[MF_*]) from  */
+/* the multi-field table at once, for a point or for n      */
+/* points (f[MF_*][m]), rho in cgs. Return the number of    */
+/* points out of the table (their value is meaningless)     */
+/*************************************************************/
+int GetMultiFieldFromTable(double rho, double T, double *f) {
+  return MultiLogTableInterpolate(&mf_lt, T, rho, f);
+}
+
+int GetMultiFieldFromTableBatch(const double *rho, const double *T, double *const *f, int n) {
+  return MultiLogTableInterpolateBatch(&mf_lt, T, rho, f, n);
+}
+#endif
+
+#if TRANSPORT_TAB_ACCURACY
+/*************************************************************/
+/* Electrical res. and thermal cond. (cgs) from the DD       */
+/* formulas, as Resistive_etaFromT() and TC_kappaFromT()     */
+/* compute them without tables                               */
+/*************************************************************/
+static double ExactElecResistivity(double rho, double T) {
+  double mu, z;
+
+  GetMu(T, rho/UNIT_DENSITY, &mu);
+  z = fmax(1/mu - 1, IONIZMIN);
+  return elRes_norm_DD(z, rho, T*CONST_kB);
+}
+
+static double ExactThermConductivity(double rho, double T) {
+  double mu, z;
+
+  GetMu(T, rho/UNIT_DENSITY, &mu);
+  z = fmax(1/mu - 1, IONIZMIN);
+  return thermCond_norm_DD(z, rho, T*CONST_kB) + 8e4;
+}
+
+/*****************************************************************************/
+/* Function to print the accuracy of the interpolations of a table           */
+/* The tables read from file come from other formulas (python scripts), so   */
+/* their exact values between the nodes are not known here: I measure the   */
+/* interpolations on tables of the DD formulas (f_exact), which are as       */
+/* steep and span as many decades, on the range of the table and with its    */
+/* number of nodes (and with 2 and 4 times less). The errors are relative,   */
+/* on the points halfway between the nodes of a 2 times finer table          */
+/*****************************************************************************/
+static void ReportTableAccuracy(const char *name, double (*f_exact)(double, double),
+                                double T_min, double T_max, int N_T,
+                                double rho_min, double rho_max, int N_rho) {
+  int i, j, c, mode, n_pts, nT_p, nrho_p;
+  double T, rho, f, fe, err, err_max, err_sum;
+  const char *mode_name[3] = {"linear", "log-f", "Steffen"};
+  Table2D tab;
+  LogTable lt;
+
+  nT_p = 2*(N_T - 1);
+  nrho_p = 2*(N_rho - 1);
+  for (c = 1; c <= 4; c *= 2) {
+    tab.nx = (N_T - 1)/c + 1;
+    tab.ny = (N_rho - 1)/c + 1;
+    tab.x = ARRAY_1D(tab.nx, double);
+    tab.y = ARRAY_1D(tab.ny, double);
+    tab.f = ARRAY_2D(tab.ny, tab.nx, double);
+    for (i = 0; i < tab.nx; i++) tab.x[i] = T_min*pow(T_max/T_min, (double)i/(tab.nx - 1));
+    for (j = 0; j < tab.ny; j++) tab.y[j] = rho_min*pow(rho_max/rho_min, (double)j/(tab.ny - 1));
+    for (j = 0; j < tab.ny; j++)
+      for (i = 0; i < tab.nx; i++)
+        tab.f[j][i] = f_exact(tab.y[j], tab.x[i]);
+
+    print1("\n> ReportTableAccuracy(): %s, %d x %d nodes, rel. error max/mean:", name, tab.nx, tab.ny);
+    for (mode = LOG_TABLE_LINEAR; mode <= LOG_TABLE_STEFFEN; mode++) {
+      MakeLogTable(&lt, &tab, name, mode);
+      err_max = err_sum = 0.0;
+      n_pts = 0;
+      for (j = 0; j < nrho_p; j++) {
+        rho = rho_min*pow(rho_max/rho_min, (j + 0.5)/nrho_p);
+        for (i = 0; i < nT_p; i++) {
+          T = T_min*pow(T_max/T_min, (i + 0.5)/nT_p);
+          if (LogTableInterpolate(&lt, T, rho, &f) != 0) continue;
+          fe = f_exact(rho, T);
+          err = fabs(f - fe)/fabs(fe);
+          err_max = MAX(err_max, err);
+          err_sum += err;
+          n_pts++;
+        }
+      }
+      print1(" %s %.2e/%.2e%s", mode_name[mode], err_max, err_sum/MAX(n_pts, 1),
+             mode < LOG_TABLE_STEFFEN ? "," : "");
+      FreeLogTable(&lt);
+    }
+    FreeArray1D((void *)tab.x);
+    FreeArray1D((void *)tab.y);
+    FreeArray2D((void **)tab.f);
+  }
+}
+#endif
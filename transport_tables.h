@@ -1,9 +1,105 @@
 #ifndef TRANSPORT_TABLES_H
 #define TRANSPORT_TABLES_H
+#include "log_table.h"
+
+/* If YES, the tables are interpolated by the lookup specialized to their nodes
+   (uniform in log10, see log_table.h) instead of Table2DInterpolate() */
+#ifndef LOG_TABLE_LOOKUP
+  #define LOG_TABLE_LOOKUP NO
+#endif
+// Interpolation of the eta and kappa tables (LOG_TABLE_LINEAR, LOG_TABLE_LOGF or LOG_TABLE_STEFFEN)
+#ifndef ETA_TAB_INTERP
+  #define ETA_TAB_INTERP LOG_TABLE_LINEAR
+#endif
+#ifndef KAPPA_TAB_INTERP
+  #define KAPPA_TAB_INTERP LOG_TABLE_LINEAR
+#endif
+#if !LOG_TABLE_LOOKUP && (ETA_TAB_INTERP != LOG_TABLE_LINEAR || KAPPA_TAB_INTERP != LOG_TABLE_LINEAR)
+  #error ETA_TAB_INTERP and KAPPA_TAB_INTERP other than LOG_TABLE_LINEAR need LOG_TABLE_LOOKUP
+#endif
+/* If YES, the tables made by the python scripts are cached in a binary file (eta_tab.bin,
+   kappa_tab.bin), read instead of running the script again when the command (ranges and
+   number of nodes) and the scripts are the same */
+#ifndef TRANSPORT_TAB_CACHE
+  #define TRANSPORT_TAB_CACHE NO
+#endif
+/* If YES, the eta and kappa tables are made by the C port of the python scripts
+   (devoto_transport.c, in parallel with OpenMP if enabled) instead of running them;
+   the ascii files are written anyway, in the same format */
+#ifndef TRANSPORT_TAB_NATIVE
+  #define TRANSPORT_TAB_NATIVE NO
+#endif
+/* If YES, when a table is made the accuracy of the three interpolations is printed,
+   for tables of the exact DD formulas with the same nodes, and with 2 and 4 times less */
+#ifndef TRANSPORT_TAB_ACCURACY
+  #define TRANSPORT_TAB_ACCURACY NO
+#endif
+/* If YES, the T nodes of the eta and kappa tables (the same for both, N_TAB_T) are not
+   uniform in log10(T): they are placed by PlaceCurvatureNodes() from the curvature of
+   ln(eta) and ln(kappa) (dense where the ionization makes them bend, sparse where they are
+   power laws), a fraction CURV_NODES_UNIFORM_FRAC of them as if uniform. The tables are
+   made by the native formulas (no ascii file nor cache, whose format has uniform nodes) */
+#ifndef TRANSPORT_TAB_CURV_NODES
+  #define TRANSPORT_TAB_CURV_NODES NO
+#endif
+#ifndef CURV_NODES_UNIFORM_FRAC
+  #define CURV_NODES_UNIFORM_FRAC 0.3
+#endif
+#if TRANSPORT_TAB_CURV_NODES
+  #if !TRANSPORT_TAB_NATIVE || !LOG_TABLE_LOOKUP
+    #error TRANSPORT_TAB_CURV_NODES needs TRANSPORT_TAB_NATIVE and LOG_TABLE_LOOKUP
+  #endif
+  #if ETA_TAB_INTERP == LOG_TABLE_STEFFEN || KAPPA_TAB_INTERP == LOG_TABLE_STEFFEN
+    #error TRANSPORT_TAB_CURV_NODES interpolates only as LOG_TABLE_LINEAR or LOG_TABLE_LOGF
+  #endif
+#endif
+
+/* If YES, eta and kappa are interpolated from adaptive tables (AdaptiveTable, see
+   adaptive_table.h), made by the native formulas (devoto_transport.c): refined where the
+   interpolation is less accurate than ADAPTIVE_TAB_TOL, and extended (with a log line)
+   when rho or T fall outside them, instead of being out of the table (which quits) */
+#ifndef TRANSPORT_TAB_ADAPTIVE
+  #define TRANSPORT_TAB_ADAPTIVE NO
+#endif
+#if TRANSPORT_TAB_ADAPTIVE && !TRANSPORT_TAB_NATIVE
+  #error TRANSPORT_TAB_ADAPTIVE needs TRANSPORT_TAB_NATIVE (the nodes are made by the native formulas)
+#endif
+
+/* If YES, eta, kappa, the heat capacity and mu are interpolated at once from a table with
+   the four values interleaved node by node (MultiLogTable, log_table.h), on the nodes of
+   the eta and kappa tables: used by the cell cache (cell_state.c). eta and kappa are the
+   same as from their tables; dE/dT and mu are approximated (with 120 x 50 nodes, within 7%
+   and 0.8%, 0.1% and 0.02% on average), instead of being computed from the EOS */
+#ifndef MULTI_FIELD_TABLE
+  #define MULTI_FIELD_TABLE NO
+#endif
+#if MULTI_FIELD_TABLE
+  #if !LOG_TABLE_LOOKUP || !ETA_TABLE || !KAPPA_TABLE || EOS != PVTE_LAW
+    #error MULTI_FIELD_TABLE needs LOG_TABLE_LOOKUP, ETA_TABLE, KAPPA_TABLE and PVTE_LAW
+  #endif
+  #if ETA_TAB_INTERP == LOG_TABLE_STEFFEN || KAPPA_TAB_INTERP == LOG_TABLE_STEFFEN
+    #error MULTI_FIELD_TABLE interpolates eta and kappa only as LOG_TABLE_LINEAR or LOG_TABLE_LOGF
+  #endif
+#endif
+// Fields of the multi-field table
+#define MF_ETA     0  // Electrical resistivity (cgs, before the limiters of Resistive_etaLine())
+#define MF_KAPPA   1  // Thermal conductivity (cgs, before the limiters of TC_kappaLine())
+#define MF_DEDT    2  // Heat capacity per unit volume (code units, as HeatCapacity())
+#define MF_MU      3  // Mean molecular weight (as GetMu())
+#define MF_NFIELDS 4
 
 void MakeElecResistivityTable();
 int GetElecResisitivityFromTable(double rho, double T, double *eta);
 void MakeThermConductivityTable();
 int GetThermConductivityFromTable(double rho, double T, double *kappa);
+int GetElecResisitivityFromTableBatch(const double *rho, const double *T, double *eta, int n);
+int GetThermConductivityFromTableBatch(const double *rho, const double *T, double *kappa, int n);
+#if MULTI_FIELD_TABLE
+  void MakeMultiFieldTable();
+  int GetMultiFieldFromTable(double rho, double T, double *f);
+  int GetMultiFieldFromTableBatch(const double *rho, const double *T, double *const *f, int n);
+#endif
+void MakeRadiativeLossTable();
+int GetRadiativeLossFromTable(double rho, double T, double *loss);
 
 #endif
\ No newline at end of file
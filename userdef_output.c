@@ -4,6 +4,7 @@
 #include "current_table.h"
 #include "prototypes.h"
 #include "debug_utilities.h"
+#include "cell_state.h"
 #include "math.h"
 
 #define WRITE_T_MU_NE_IONIZ YES
@@ -36,7 +37,6 @@ void ComputeUserVar (const Data *d, Grid *grid)
     double ***T, ***ioniz, ***ne;
     double v[NVAR]; /*[Ema] I hope that NVAR as dimension is fine!*/
     int nv;
-    double mu;
   #endif
 
   #if MULTIPLE_GHOSTS==YES
@@ -51,6 +51,10 @@ void ComputeUserVar (const Data *d, Grid *grid)
     unit_Mfield = COMPUTE_UNIT_MFIELD(UNIT_VELOCITY, UNIT_DENSITY);
   #endif
 
+  /* The hydro step has changed Vc: the T, kappa, eta.. of the cells are computed once
+     (by the cell state cache) and shared by all the output variables below */
+  InvalidateCellState(d);
+
 /******************************************************/
 /*I allocate space for all the variables of the output*/
 /******************************************************/
@@ -156,31 +160,38 @@ void ComputeUserVar (const Data *d, Grid *grid)
 
   if(CheckUserVar(etax1_name)) {
     double ***etax1;
+    #if RESISTIVITY != NO
+      const double *row;
+    #endif
     etax1 = GetUserVar(etax1_name);
-    DOM_LOOP(k,j,i) {
-      for (nv=NVAR; nv--;) v[nv] = d->Vc[nv][k][j][i];
-      #if RESISTIVITY != NO
-        Resistive_eta( v, grid[IDIR].x_glob[i], grid[JDIR].x_glob[j], grid[KDIR].x_glob[k], NULL, &(etax1[k][j][i]));
-        etax1[k][j][i] *= UNIT_ETA;
-      #else
-        etax1[k][j][i] = 0.0;
-      #endif
-    }
+    #if RESISTIVITY != NO
+      KDOM_LOOP(k) {
+        JDOM_LOOP(j) {
+          row = CellEtaRow(d, grid, k, j, IBEG, IEND);
+          IDOM_LOOP(i) etax1[k][j][i] = row[i]*UNIT_ETA;
+        }
+      }
+    #else
+      DOM_LOOP(k,j,i) etax1[k][j][i] = 0.0;
+    #endif
   }
 
   if (CheckUserVar(knor_name)) {
     double ***knor;
-    double kpar, phi;
+    #if THERMAL_CONDUCTION != NO
+      const double *row;
+    #endif
     knor = GetUserVar(knor_name);
-    DOM_LOOP(k,j,i) {
-      for (nv=NVAR; nv--;) v[nv] = d->Vc[nv][k][j][i];
-      #if THERMAL_CONDUCTION != NO
-        TC_kappa( v, grid[IDIR].x_glob[i], grid[JDIR].x_glob[j], grid[KDIR].x_glob[k], &kpar, &(knor[k][j][i]), &phi);
-        knor[k][j][i] *= UNIT_KAPPA;
-      #else 
-        knor[k][j][i] = 0.0;
-      #endif
-    }
+    #if THERMAL_CONDUCTION != NO
+      KDOM_LOOP(k) {
+        JDOM_LOOP(j) {
+          row = CellKappaRow(d, grid, k, j, IBEG, IEND);
+          IDOM_LOOP(i) knor[k][j][i] = row[i]*UNIT_KAPPA;
+        }
+      }
+    #else
+      DOM_LOOP(k,j,i) knor[k][j][i] = 0.0;
+    #endif
   }
 
   if(CheckUserVar(c2p_fail_name)) {
@@ -204,20 +215,10 @@ void ComputeUserVar (const Data *d, Grid *grid)
       ne = GetUserVar("ne");
     #endif
     DOM_LOOP(k,j,i){
-      #if EOS==IDEAL
-        mu = MeanMolecularWeight(d->Vc);
-        T[k][j][i] = d->Vc[PRS][k][j][i]/d->Vc[RHO][k][j][i]*KELVIN*mu;
-      #elif EOS==PVTE_LAW
-        for (nv=NVAR; nv--;) v[nv] = d->Vc[nv][k][j][i];
-        if (GetPV_Temperature(v, &(T[k][j][i]) )!=0) {
-          #if WARN_ERR_COMP_TEMP
-            print1("ComputeUserVar:[Ema]Err.comp.temp");
-          #endif
-        }
-        // print1("\nI just assigned %g to T[%d][%d][%d] for output",T[k][j][i], k,j,i);
-        GetMu(T[k][j][i], v[RHO], &mu);
-        ioniz[k][j][i] = 1/mu - 1;
-        ne[k][j][i] = ioniz[k][j][i] * (v[RHO]*UNIT_DENSITY) / CONST_mp;
+      T[k][j][i] = CellTemperature(d, k, j, i);
+      #if EOS==PVTE_LAW
+        ioniz[k][j][i] = CellIoniz(d, k, j, i);
+        ne[k][j][i] = ioniz[k][j][i] * (d->Vc[RHO][k][j][i]*UNIT_DENSITY) / CONST_mp;
       #endif
     }
   #endif
@@ -0,0 +1,90 @@
+#ifndef VEC_MATH_H
+#define VEC_MATH_H
+/* log() and exp() of 4 doubles at once with AVX2 (only if the code is compiled with -mavx2,
+   see local_make), for the batch formulas of gamma_transp_vec.c and pvte_law.c.
+   They are vector ports of the log() and exp() of fdlibm (the usual reduction, then the
+   same minimax polynomials), whose error is below 1 ulp (glibc's is ~0.5 ulp) */
+#ifdef __AVX2__
+#include <immintrin.h>
+
+/****************************************************************************
+log(x) of 4 doubles (x positive and normal), as __ieee754_log() of fdlibm:
+x = 2^e*(1+f), with 1+f in [sqrt(2)/2, sqrt(2)), log(1+f) = 2s + s*R(s^2), s = f/(2+f)
+*****************************************************************************/
+static inline __m256d Log4(__m256d x) {
+  const __m256d ln2_hi = _mm256_set1_pd(6.93147180369123816490e-01);
+  const __m256d ln2_lo = _mm256_set1_pd(1.90821492927058770002e-10);
+  const __m256d one = _mm256_set1_pd(1.0), half = _mm256_set1_pd(0.5);
+  const __m256i mant = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+  const __m256i one_bits = _mm256_set1_epi64x(0x3FF0000000000000LL);
+  const __m256i two52_bits = _mm256_set1_epi64x(0x4330000000000000LL);
+  __m256i bits = _mm256_castpd_si256(x);
+  __m256d e, m, big, f, s, z, w, t1, t2, R, hfsq;
+
+  // Unbiased exponent, as a double: the bits of 2^52 + (biased exponent), minus 2^52 + 1023
+  e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), two52_bits));
+  e = _mm256_sub_pd(e, _mm256_set1_pd(4503599627370496.0 + 1023.0));
+  m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mant), one_bits));
+  big = _mm256_cmp_pd(m, _mm256_set1_pd(1.41421356237309504880), _CMP_GT_OQ);
+  m = _mm256_blendv_pd(m, _mm256_mul_pd(m, half), big);
+  e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+  f = _mm256_sub_pd(m, one);
+  s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+  z = _mm256_mul_pd(s, s);
+  w = _mm256_mul_pd(z, z);
+  t1 = _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(3.999999999940941908e-01),
+       _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(2.222219843214978396e-01),
+       _mm256_mul_pd(w, _mm256_set1_pd(1.531383769920937332e-01))))));
+  t2 = _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(6.666666666666735130e-01),
+       _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(2.857142874366239149e-01),
+       _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(1.818357216161805012e-01),
+       _mm256_mul_pd(w, _mm256_set1_pd(1.479819860511658591e-01))))))));
+  R = _mm256_add_pd(t2, t1);
+  hfsq = _mm256_mul_pd(_mm256_mul_pd(half, f), f);
+  // e*ln2_hi - ((hfsq - (s*(hfsq + R) + e*ln2_lo)) - f)
+  return _mm256_sub_pd(_mm256_mul_pd(e, ln2_hi),
+           _mm256_sub_pd(_mm256_sub_pd(hfsq, _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, R)),
+                                                           _mm256_mul_pd(e, ln2_lo))), f));
+}
+
+/****************************************************************************
+exp(x) of 4 doubles, as __ieee754_exp() of fdlibm: x = k*ln2 + r, |r| <= ln2/2,
+exp(r) = 1 + r + r*c/(2-c), c = r - r^2*P(r^2), then the exponent is increased by k.
+[Rob] Only for x in [-708, 709]: below it gives 0, above +inf (the arguments here are
+-13.6eV/kT and 0.89*log(Z_ion), well inside)
+*****************************************************************************/
+static inline __m256d Exp4(__m256d x) {
+  const __m256d ln2_hi = _mm256_set1_pd(6.93147180369123816490e-01);
+  const __m256d ln2_lo = _mm256_set1_pd(1.90821492927058770002e-10);
+  const __m256d lo_lim = _mm256_set1_pd(-708.0), hi_lim = _mm256_set1_pd(709.0);
+  const __m256d one = _mm256_set1_pd(1.0);
+  __m256d xc, k, hi, lo, r, t, c, y;
+  __m256i ki;
+
+  xc = _mm256_max_pd(_mm256_min_pd(x, hi_lim), lo_lim);
+  k = _mm256_round_pd(_mm256_mul_pd(xc, _mm256_set1_pd(1.44269504088896338700e+00)),
+                      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  hi = _mm256_sub_pd(xc, _mm256_mul_pd(k, ln2_hi));
+  lo = _mm256_mul_pd(k, ln2_lo);
+  r = _mm256_sub_pd(hi, lo);
+  t = _mm256_mul_pd(r, r);
+  c = _mm256_sub_pd(r, _mm256_mul_pd(t, _mm256_add_pd(_mm256_set1_pd(1.66666666666666019037e-01),
+        _mm256_mul_pd(t, _mm256_add_pd(_mm256_set1_pd(-2.77777777770155933842e-03),
+        _mm256_mul_pd(t, _mm256_add_pd(_mm256_set1_pd(6.61375632143793436117e-05),
+        _mm256_mul_pd(t, _mm256_add_pd(_mm256_set1_pd(-1.65339022054652515390e-06),
+        _mm256_mul_pd(t, _mm256_set1_pd(4.13813679705723846039e-08)))))))))));
+  // 1 - ((lo - r*c/(2 - c)) - hi)
+  y = _mm256_sub_pd(one, _mm256_sub_pd(_mm256_sub_pd(lo, _mm256_div_pd(_mm256_mul_pd(r, c),
+                                       _mm256_sub_pd(_mm256_set1_pd(2.0), c))), hi));
+  // 2^k, from the bits of the exponent
+  ki = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+  ki = _mm256_slli_epi64(_mm256_add_epi64(ki, _mm256_set1_epi64x(1023)), 52);
+  y = _mm256_mul_pd(y, _mm256_castsi256_pd(ki));
+
+  y = _mm256_blendv_pd(y, _mm256_setzero_pd(), _mm256_cmp_pd(x, lo_lim, _CMP_LT_OQ));
+  return _mm256_blendv_pd(y, _mm256_set1_pd(INFINITY), _mm256_cmp_pd(x, hi_lim, _CMP_GT_OQ));
+}
+#endif
+
+#endif
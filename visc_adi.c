@@ -0,0 +1,196 @@
+#include "pluto.h"
+#include "adi.h"
+#include "capillary_wall.h"
+
+#if VISCOSITY_ADI
+/****************************************************************************
+Viscosity integrated with the ADI schemes, as two more diffusion problems:
+  - VRDIFF for r*vr (same discrete operator of B*r in BuildIJ_Res(), with nu instead of eta):
+      rho d(r*vr)/dt = r d/dr(nu/r d(r*vr)/dr) + d/dz(nu d(r*vr)/dz)
+    which, for uniform nu, is the r component of div(nu grad(v)) in cylindrical coords
+    (including the -nu*vr/r^2 term);
+  - VZDIFF for vz (same discrete operator of T in BuildIJ_TC(), with nu instead of kappa):
+      rho dvz/dt = 1/r d/dr(r nu dvz/dr) + d/dz(nu dvz/dz).
+The terms of the stress tensor coupling vr and vz (those with div(v)) are not included.
+The energy is not changed, so the kinetic energy dissipated goes into internal energy.
+*****************************************************************************/
+
+static void BuildNu(const Data *d, Grid *grid, Lines *lines, double **nu);
+
+/****************************************************************************
+Function to build the Ip,Im,Jp,Jm, CI, CJ (1/C, see BuildIJ in adi.h) for r*vr
+(**useless parameter is intentionally unused, as in BuildIJ_Res()).
+The geometric factors are those of the magnetic diffusion (GetOperatorGeometry())
+*****************************************************************************/
+void BuildIJ_ViscR (const Data *d, Grid *grid, Lines *lines,
+                    double **Ip, double **Im, double **Jp,
+                    double **Jm, double **CI, double **CJ, double **useless) {
+  double **nu;
+  int i,j,k,l;
+  double ****Vc = d->Vc;
+  double rho_1;
+  const OperatorGeometry *geo = GetOperatorGeometry(grid);
+
+  // (not static: the helper thread of adi_async.c may build at the same time as the main thread)
+  nu = ARRAY_2D(NX2_TOT, NX1_TOT, double);
+  BuildNu(d, grid, lines, nu);
+
+  KDOM_LOOP(k) {
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      /* :::: Ip :::: */
+      Ip[j][i] = 2/(1/nu[j][i] + 1/nu[j][i+1])*geo->res_Ip[i];
+      /* :::: Im :::: */
+      Im[j][i] = 2/(1/nu[j][i] + 1/nu[j][i-1])*geo->res_Im[i];
+      /* :::: Jp :::: */
+      Jp[j][i] = 2/(1/nu[j][i] + 1/nu[j+1][i])*geo->res_Jp[j];
+      /* :::: Jm :::: */
+      Jm[j][i] = 2/(1/nu[j][i] + 1/nu[j-1][i])*geo->res_Jm[j];
+      rho_1 = 1.0/Vc[RHO][k][j][i];
+      /* :::: CI :::: */
+      CI[j][i] = rho_1*geo->res_CI[i];
+      /* :::: CJ :::: */
+      CJ[j][i] = rho_1;
+    }
+  }
+  FreeArray2D((void *) nu);
+}
+
+/****************************************************************************
+Function to build the Ip,Im,Jp,Jm, CI, CJ (1/C) for vz
+The geometric factors are those of the thermal conduction (GetOperatorGeometry())
+*****************************************************************************/
+void BuildIJ_ViscZ (const Data *d, Grid *grid, Lines *lines,
+                    double **Ip, double **Im, double **Jp,
+                    double **Jm, double **CI, double **CJ, double **useless) {
+  double **nu;
+  int i,j,k,l;
+  double ****Vc = d->Vc;
+  double rho_1;
+  const OperatorGeometry *geo = GetOperatorGeometry(grid);
+
+  nu = ARRAY_2D(NX2_TOT, NX1_TOT, double); // (not static, as in BuildIJ_ViscR())
+  BuildNu(d, grid, lines, nu);
+
+  KDOM_LOOP(k) {
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      /* :::: Ip :::: */
+      Ip[j][i] = 2/(1/nu[j][i] + 1/nu[j][i+1])*geo->tc_Ip[i];
+      /* :::: Im :::: */
+      Im[j][i] = 2/(1/nu[j][i] + 1/nu[j][i-1])*geo->tc_Im[i];
+      /* :::: Jp :::: */
+      Jp[j][i] = 2/(1/nu[j][i] + 1/nu[j+1][i])*geo->tc_Jp[j];
+      /* :::: Jm :::: */
+      Jm[j][i] = 2/(1/nu[j][i] + 1/nu[j-1][i])*geo->tc_Jm[j];
+      rho_1 = 1.0/Vc[RHO][k][j][i];
+      /* :::: CI :::: */
+      CI[j][i] = rho_1*geo->tc_CI[i];
+      /* :::: CJ :::: */
+      CJ[j][i] = rho_1*geo->tc_CJ[j];
+    }
+  }
+  FreeArray2D((void *) nu);
+}
+
+/****************************************************************************
+Computes the dynamic viscosity nu1 (Visc_nu()) on the cells of the lines and on the
+ghosts next to them
+*****************************************************************************/
+static void BuildNu(const Data *d, Grid *grid, Lines *lines, double **nu) {
+  int i,j,k,l,nv,side;
+  double v[NVAR];
+  double nu1, nu2;
+  double ****Vc = d->Vc;
+  double *r, *z, *theta;
+
+  r = grid[IDIR].x;
+  z = grid[JDIR].x;
+  theta = grid[KDIR].x;
+
+  KDOM_LOOP(k) {
+    LINES_LOOP(lines[IDIR], l, j, i) {
+      for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+      Visc_nu(v, r[i], z[j], theta[k], &nu1, &nu2);
+      nu[j][i] = nu1;
+    }
+    for (l = 0; l < lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        i = side ? lines[IDIR].ridx[l]+1 : lines[IDIR].lidx[l]-1;
+        for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+        Visc_nu(v, r[i], z[j], theta[k], &nu1, &nu2);
+        nu[j][i] = nu1;
+      }
+    }
+    for (l = 0; l < lines[JDIR].N; l++) {
+      i = lines[JDIR].dom_line_idx[l];
+      for (side = 0; side < 2; side++) {
+        j = side ? lines[JDIR].ridx[l]+1 : lines[JDIR].lidx[l]-1;
+        for (nv=NVAR; nv--;) v[nv] = Vc[nv][k][j][i];
+        Visc_nu(v, r[i], z[j], theta[k], &nu1, &nu2);
+        nu[j][i] = nu1;
+      }
+    }
+  }
+}
+
+/****************************************************************************
+Boundary conditions for r*vr (VRDIFF) and vz (VZDIFF):
+no-slip on the capillary walls, symmetry on the axis and on the plane z=0,
+homogeneous Neumann on the outer domain boundary
+*****************************************************************************/
+void BoundaryADI_Visc(Lines lines[2], const Data *d, Grid *grid, double t, int dir) {
+  int i,j,l;
+
+  if (dir == IDIR) {
+    /*-----------------------------------------------*/
+    /*----  Set bcs for lines in direction IDIR  ----*/
+    /*-----------------------------------------------*/
+    for (l=0; l<lines[IDIR].N; l++) {
+      j = lines[IDIR].dom_line_idx[l];
+      /* :::: Axis ::::*/
+      lines[IDIR].lbound[VRDIFF][l].kind = DIRICHLET;
+      lines[IDIR].lbound[VRDIFF][l].values[0] = 0.0;
+      lines[IDIR].lbound[VZDIFF][l].kind = NEUMANN_HOM;
+      lines[IDIR].lbound[VZDIFF][l].values[0] = 0.0;
+      if (j <= j_cap_inter_end) {
+        /* :::: Capillary wall (no-slip) :::: */
+        lines[IDIR].rbound[VRDIFF][l].kind = DIRICHLET;
+        lines[IDIR].rbound[VRDIFF][l].values[0] = 0.0;
+        lines[IDIR].rbound[VZDIFF][l].kind = DIRICHLET;
+        lines[IDIR].rbound[VZDIFF][l].values[0] = 0.0;
+      } else {
+        /* :::: Outer domain boundary :::: */
+        lines[IDIR].rbound[VRDIFF][l].kind = NEUMANN_HOM;
+        lines[IDIR].rbound[VRDIFF][l].values[0] = 0.0;
+        lines[IDIR].rbound[VZDIFF][l].kind = NEUMANN_HOM;
+        lines[IDIR].rbound[VZDIFF][l].values[0] = 0.0;
+      }
+    }
+  } else if (dir == JDIR) {
+    /*-----------------------------------------------*/
+    /*----  Set bcs for lines in direction JDIR  ----*/
+    /*-----------------------------------------------*/
+    for (l=0; l<lines[JDIR].N; l++) {
+      i = lines[JDIR].dom_line_idx[l];
+      if (i <= i_cap_inter_end){
+        /* :::: Capillary internal (symmetry plane) ::::*/
+        lines[JDIR].lbound[VRDIFF][l].kind = NEUMANN_HOM;
+        lines[JDIR].lbound[VRDIFF][l].values[0] = 0.0;
+        lines[JDIR].lbound[VZDIFF][l].kind = DIRICHLET;
+        lines[JDIR].lbound[VZDIFF][l].values[0] = 0.0;
+      } else {
+        /* :::: Outer capillary wall (no-slip) ::::*/
+        lines[JDIR].lbound[VRDIFF][l].kind = DIRICHLET;
+        lines[JDIR].lbound[VRDIFF][l].values[0] = 0.0;
+        lines[JDIR].lbound[VZDIFF][l].kind = DIRICHLET;
+        lines[JDIR].lbound[VZDIFF][l].values[0] = 0.0;
+      }
+      /* :::: Outer domain boundary ::::*/
+      lines[JDIR].rbound[VRDIFF][l].kind = NEUMANN_HOM;
+      lines[JDIR].rbound[VRDIFF][l].values[0] = 0.0;
+      lines[JDIR].rbound[VZDIFF][l].kind = NEUMANN_HOM;
+      lines[JDIR].rbound[VZDIFF][l].values[0] = 0.0;
+    }
+  }
+}
+#endif